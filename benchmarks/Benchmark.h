@@ -0,0 +1,427 @@
+/**
+ * @file    Benchmark.h
+ * @ingroup benchmarks
+ * @brief   Minimal self-contained benchmark harness, measuring operations and writing the results as JSON.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCpp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace SQLiteBenchmark
+{
+
+/// Result of a benchmark: time by operation of one variant (the wrapper, or the raw sqlite3 C API)
+struct Result
+{
+    std::string                     name;           ///< Name of the benchmark
+    std::string                     variant;        ///< "sqlitecpp", "sqlite3", or any other variant measured
+    int64_t                         iterations = 0; ///< Number of operations by repetition
+    double                          nsPerOp = 0.0;  ///< Median time by operation over the repetitions
+    std::map<std::string, double>   counters;       ///< Additional metrics by operation, like system calls
+};
+
+/// Options of the command line, common to all the benchmarks
+struct Options
+{
+    int64_t     iterations = 10000; ///< Number of operations by repetition (scaled by each benchmark)
+    int         repetitions = 5;    ///< Number of repetitions, the median is reported
+    std::string filter;             ///< Only run the benchmarks whose name contains this string
+    std::string output;             ///< JSON output file, or empty for the standard output
+    std::string baseline;           ///< Baseline JSON file to compare the results to, or empty
+    std::string writeBaseline;      ///< Baseline JSON file to write from the results, or empty
+    double      tolerance = 0.5;    ///< Relative increase of a ratio over its baseline reported as a regression
+};
+
+/// Parse the command line: [--iterations N] [--repetitions N] [--filter NAME] [--output FILE]
+/// [--baseline FILE] [--write-baseline FILE] [--tolerance X]
+inline Options parseOptions(const int argc, const char* const argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const char* pValue = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (pValue == nullptr)
+        {
+            std::cerr << "Missing value for " << arg << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+        if (arg == "--iterations")
+        {
+            options.iterations = std::max<int64_t>(std::atoll(pValue), 1);
+        }
+        else if (arg == "--repetitions")
+        {
+            options.repetitions = std::max(std::atoi(pValue), 1);
+        }
+        else if (arg == "--filter")
+        {
+            options.filter = pValue;
+        }
+        else if (arg == "--output")
+        {
+            options.output = pValue;
+        }
+        else if (arg == "--baseline")
+        {
+            options.baseline = pValue;
+        }
+        else if (arg == "--write-baseline")
+        {
+            options.writeBaseline = pValue;
+        }
+        else if (arg == "--tolerance")
+        {
+            options.tolerance = std::max(std::atof(pValue), 0.0);
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--iterations N] [--repetitions N] [--filter NAME] [--output FILE]"
+                      << " [--baseline FILE] [--write-baseline FILE] [--tolerance X]\n";
+            std::exit(EXIT_FAILURE);
+        }
+        ++i;
+    }
+    return options;
+}
+
+/// Return true if the benchmark named aName is selected by the filter of the options.
+inline bool isSelected(const Options& aOptions, const std::string& aName)
+{
+    return aOptions.filter.empty() || aName.find(aOptions.filter) != std::string::npos;
+}
+
+/**
+ * @brief Measure an operation: median over the repetitions of the time to call it aIterations times.
+ *
+ * The operation is called once before, to warm the caches up.
+ */
+template <typename Operation>
+Result measure(const Options& aOptions, const std::string& aName, const std::string& aVariant,
+               const int64_t aIterations, Operation&& aOperation)
+{
+    aOperation();
+    std::vector<double> durations;
+    for (int repetition = 0; repetition < aOptions.repetitions; ++repetition)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int64_t i = 0; i < aIterations; ++i)
+        {
+            aOperation();
+        }
+        const auto duration = std::chrono::steady_clock::now() - start;
+        durations.push_back(std::chrono::duration<double, std::nano>(duration).count());
+    }
+    std::sort(durations.begin(), durations.end());
+
+    Result result;
+    result.name = aName;
+    result.variant = aVariant;
+    result.iterations = aIterations;
+    result.nsPerOp = durations[durations.size() / 2] / static_cast<double>(aIterations);
+    return result;
+}
+
+/// Escape a string for JSON
+inline std::string escape(const std::string& aString)
+{
+    std::string escaped;
+    for (const char c : aString)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char code[8];
+            std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(c));
+            escaped += code;
+        }
+        else
+        {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+/// Write the results as a JSON document: {"context": {...}, "benchmarks": [{...}, ...]}
+inline void writeJson(std::ostream& aStream, const std::string& aSuite, const std::vector<Result>& aResults)
+{
+    aStream << "{\n  \"context\": {\n"
+            << "    \"suite\": \"" << escape(aSuite) << "\",\n"
+            << "    \"sqlite_version\": \"" << escape(SQLite::getLibVersion()) << "\",\n"
+            << "    \"sqlitecpp_version\": \"" << SQLITECPP_VERSION << "\"\n"
+            << "  },\n  \"benchmarks\": [";
+    for (size_t i = 0; i < aResults.size(); ++i)
+    {
+        const Result& result = aResults[i];
+        std::ostringstream nsPerOp;
+        nsPerOp.precision(6);
+        nsPerOp << result.nsPerOp;
+        aStream << (i ? ",\n" : "\n")
+                << "    {\"name\": \"" << escape(result.name) << "\", \"variant\": \"" << escape(result.variant)
+                << "\", \"iterations\": " << result.iterations << ", \"ns_per_op\": " << nsPerOp.str();
+        for (const auto& counter : result.counters)
+        {
+            aStream << ", \"" << escape(counter.first) << "\": " << counter.second;
+        }
+        aStream << "}";
+    }
+    aStream << "\n  ]\n}\n";
+}
+
+/// Write the results to the output file of the options, or to the standard output.
+inline int report(const Options& aOptions, const std::string& aSuite, const std::vector<Result>& aResults)
+{
+    if (aOptions.output.empty())
+    {
+        writeJson(std::cout, aSuite, aResults);
+        return EXIT_SUCCESS;
+    }
+    std::ofstream file(aOptions.output.c_str());
+    if (!file.is_open())
+    {
+        std::cerr << "Unable to write " << aOptions.output << "\n";
+        return EXIT_FAILURE;
+    }
+    writeJson(file, aSuite, aResults);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Return the ratio of the time of the wrapper to the time of the equivalent raw sqlite3 calls, by benchmark.
+ *
+ *  The ratios are compared to the baseline instead of the times, that depend too much on the machine.
+ */
+inline std::map<std::string, double> getRatios(const std::vector<Result>& aResults)
+{
+    std::map<std::string, double> wrapper;
+    std::map<std::string, double> raw;
+    for (const Result& result : aResults)
+    {
+        if (result.variant == "sqlitecpp")
+        {
+            wrapper[result.name] = result.nsPerOp;
+        }
+        else if (result.variant == "sqlite3")
+        {
+            raw[result.name] = result.nsPerOp;
+        }
+    }
+    std::map<std::string, double> ratios;
+    for (const auto& time : wrapper)
+    {
+        const auto iRaw = raw.find(time.first);
+        if (iRaw != raw.end() && iRaw->second > 0.0)
+        {
+            ratios[time.first] = time.second / iRaw->second;
+        }
+    }
+    return ratios;
+}
+
+/// Baseline of the ratios of the wrapper to the raw sqlite3 calls, with their tolerated relative increase
+struct Baseline
+{
+    double                          tolerance = 0.5;    ///< Default tolerance of the ratios
+    std::map<std::string, double>   ratios;             ///< Ratio by benchmark
+    std::map<std::string, double>   tolerances;         ///< Specific tolerance of some benchmarks
+};
+
+// Return the position of the value of a "key" in a JSON object, or npos
+inline size_t findValue(const std::string& aJson, const std::string& aKey, const size_t aStart, const size_t aEnd)
+{
+    const size_t key = aJson.find("\"" + aKey + "\"", aStart);
+    if (key == std::string::npos || key >= aEnd)
+    {
+        return std::string::npos;
+    }
+    const size_t colon = aJson.find(':', key);
+    if (colon == std::string::npos || colon >= aEnd)
+    {
+        return std::string::npos;
+    }
+    return aJson.find_first_not_of(" \t\r\n", colon + 1);
+}
+
+/**
+ * @brief Read a baseline file, as written by writeBaseline().
+ *
+ *  This is a minimal reader of its flat JSON objects, not a general JSON parser.
+ */
+inline Baseline readBaseline(const std::string& aFilename)
+{
+    std::ifstream file(aFilename.c_str());
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Unable to read the baseline " + aFilename);
+    }
+    std::ostringstream content;
+    content << file.rdbuf();
+    const std::string json = content.str();
+
+    Baseline baseline;
+    const size_t benchmarks = json.find("\"benchmarks\"");
+    if (benchmarks == std::string::npos)
+    {
+        throw std::runtime_error("No benchmarks in the baseline " + aFilename);
+    }
+    const size_t tolerance = findValue(json, "tolerance", 0, benchmarks);
+    if (tolerance != std::string::npos)
+    {
+        baseline.tolerance = std::atof(json.c_str() + tolerance);
+    }
+    for (size_t start = json.find('{', benchmarks); start != std::string::npos; start = json.find('{', start + 1))
+    {
+        const size_t end = json.find('}', start);
+        const size_t name = findValue(json, "name", start, end);
+        const size_t ratio = findValue(json, "ratio", start, end);
+        if (name == std::string::npos || ratio == std::string::npos || json[name] != '"')
+        {
+            throw std::runtime_error("Invalid benchmark in the baseline " + aFilename);
+        }
+        const std::string benchmark = json.substr(name + 1, json.find('"', name + 1) - name - 1);
+        baseline.ratios[benchmark] = std::atof(json.c_str() + ratio);
+        const size_t specific = findValue(json, "tolerance", start, end);
+        if (specific != std::string::npos)
+        {
+            baseline.tolerances[benchmark] = std::atof(json.c_str() + specific);
+        }
+    }
+    return baseline;
+}
+
+/// Write the ratios of the wrapper to the raw sqlite3 calls as a baseline file, to check in.
+inline void writeBaseline(const std::string& aFilename, const std::map<std::string, double>& aRatios,
+                          const double aTolerance)
+{
+    std::ofstream file(aFilename.c_str());
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Unable to write the baseline " + aFilename);
+    }
+    file << "{\n  \"sqlite_version\": \"" << escape(SQLite::getLibVersion()) << "\",\n"
+         << "  \"tolerance\": " << aTolerance << ",\n  \"benchmarks\": [";
+    bool bFirst = true;
+    for (const auto& ratio : aRatios)
+    {
+        file << (bFirst ? "\n" : ",\n") << "    {\"name\": \"" << escape(ratio.first) << "\", \"ratio\": "
+             << static_cast<double>(static_cast<int64_t>(ratio.second * 100.0 + 0.5)) / 100.0 << "}";
+        bFirst = false;
+    }
+    file << "\n  ]\n}\n";
+}
+
+/**
+ * @brief Compare the ratios to a baseline, writing a readable table of the differences.
+ *
+ * @return true if no ratio exceeds its baseline by more than its tolerance, and if the benchmarks measured
+ *         are the ones of the baseline, so that a benchmark cannot silently leave or bypass the gate
+ */
+inline bool compareToBaseline(const Baseline& aBaseline, const std::map<std::string, double>& aRatios,
+                              std::ostream& aReport)
+{
+    bool bOk = true;
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-28s %10s %10s %10s  %s\n", "benchmark", "baseline", "current", "limit",
+                  "status");
+    aReport << line;
+    for (const auto& expected : aBaseline.ratios)
+    {
+        const auto iTolerance = aBaseline.tolerances.find(expected.first);
+        const double tolerance = (iTolerance != aBaseline.tolerances.end()) ? iTolerance->second
+                                                                           : aBaseline.tolerance;
+        const double limit = expected.second * (1.0 + tolerance);
+        const auto iRatio = aRatios.find(expected.first);
+        if (iRatio == aRatios.end())
+        {
+            bOk = false;
+            std::snprintf(line, sizeof(line), "%-28s %10.2f %10s %10.2f  %s\n", expected.first.c_str(),
+                          expected.second, "-", limit, "NOT MEASURED");
+        }
+        else
+        {
+            const bool bRegression = iRatio->second > limit;
+            bOk = bOk && !bRegression;
+            std::snprintf(line, sizeof(line), "%-28s %10.2f %10.2f %10.2f  %s\n", expected.first.c_str(),
+                          expected.second, iRatio->second, limit, bRegression ? "REGRESSION" : "ok");
+        }
+        aReport << line;
+    }
+    for (const auto& ratio : aRatios)
+    {
+        if (aBaseline.ratios.find(ratio.first) == aBaseline.ratios.end())
+        {
+            bOk = false;
+            std::snprintf(line, sizeof(line), "%-28s %10s %10.2f %10s  %s\n", ratio.first.c_str(), "-",
+                          ratio.second, "-", "NOT IN THE BASELINE");
+            aReport << line;
+        }
+    }
+    return bOk;
+}
+
+/**
+ * @brief Write the results, then compare them to the baseline of the options, and write the baseline if asked to.
+ *
+ * @return EXIT_FAILURE in case of error, or if a ratio regressed over the baseline
+ */
+inline int reportAndCompare(const Options& aOptions, const std::string& aSuite, const std::vector<Result>& aResults)
+{
+    int ret = report(aOptions, aSuite, aResults);
+    try
+    {
+        const std::map<std::string, double> ratios = getRatios(aResults);
+        if (!aOptions.writeBaseline.empty())
+        {
+            writeBaseline(aOptions.writeBaseline, ratios, aOptions.tolerance);
+        }
+        if (!aOptions.baseline.empty())
+        {
+            std::cerr << "Ratios of the wrapper to the raw sqlite3 calls, compared to " << aOptions.baseline << ":\n";
+            // The benchmarks not selected by the filter are not compared
+            Baseline baseline = readBaseline(aOptions.baseline);
+            for (auto iRatio = baseline.ratios.begin(); iRatio != baseline.ratios.end();)
+            {
+                iRatio = isSelected(aOptions, iRatio->first) ? std::next(iRatio) : baseline.ratios.erase(iRatio);
+            }
+            if (!compareToBaseline(baseline, ratios, std::cerr))
+            {
+                std::cerr << "Performance regression over the baseline, or benchmarks not matching it\n";
+                ret = EXIT_FAILURE;
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        ret = EXIT_FAILURE;
+    }
+    return ret;
+}
+
+}  // namespace SQLiteBenchmark
@@ -0,0 +1,406 @@
+/**
+ * @file    concurrency_sweep.cpp
+ * @ingroup benchmarks
+ * @brief   Sweep of WAL reader threads against writer threads on one database, written as CSV to plot.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include "Benchmark.h"
+
+#include <sqlite3.h>
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <random>
+#include <thread>
+
+namespace
+{
+
+/**
+ * @brief Options of the command line: the lists of values to sweep, and the duration of each run
+ *
+ *  Each combination runs "--readers" threads reading rows by primary key, and "--writers" threads
+ *  updating a row in an IMMEDIATE transaction, each thread with its own connection to one WAL database.
+ *  The connections are opened with OPEN_NOMUTEX or OPEN_FULLMUTEX, with a private or a shared cache,
+ *  and either wait in a busy handler ("handler") or retry at once in the application ("retry").
+ */
+struct SweepOptions
+{
+    std::vector<int>            readers = { 1, 2, 4, 8, 16, 32, 64 };   ///< Numbers of reader threads
+    std::vector<int>            writers = { 0, 1, 2, 3, 4 };            ///< Numbers of writer threads
+    std::vector<std::string>    mutexes = { "nomutex", "fullmutex" };   ///< Threading modes of the connections
+    std::vector<std::string>    caches = { "private", "shared" };       ///< Cache modes of the connections
+    std::vector<std::string>    busy = { "handler", "retry" };          ///< Busy policies
+    int                         durationMs = 200;                       ///< Duration of each run
+    int                         rows = 10000;                           ///< Number of rows of the table
+    int                         checkpointFrames = 1000;                ///< WAL size triggering a checkpoint
+    std::string                 database = "concurrency.db3";           ///< Database file, recreated
+    std::string                 output;                                 ///< CSV file, or the standard output
+};
+
+// Split a comma separated list
+std::vector<std::string> split(const std::string& aList)
+{
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= aList.size())
+    {
+        const size_t end = std::min(aList.find(',', start), aList.size());
+        if (end > start)
+        {
+            items.push_back(aList.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return items;
+}
+
+// Print the usage and exit
+void usage(const char* apProgram)
+{
+    std::cerr << "Usage: " << apProgram << " [--readers 1,2,4...] [--writers 0,1...] [--mutex nomutex,fullmutex]"
+              << " [--cache private,shared] [--busy handler,retry] [--duration MS] [--rows N]"
+              << " [--checkpoint-frames N] [--database FILE] [--output FILE]\n";
+    std::exit(EXIT_FAILURE);
+}
+
+// Parse the command line
+SweepOptions parseSweepOptions(const int argc, const char* const argv[])
+{
+    SweepOptions options;
+    for (int i = 1; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+        {
+            usage(argv[0]);
+        }
+        const std::string arg = argv[i];
+        const std::string value = argv[i + 1];
+        if (arg == "--readers" || arg == "--writers")
+        {
+            std::vector<int>& counts = (arg == "--readers") ? options.readers : options.writers;
+            counts.clear();
+            for (const std::string& item : split(value))
+            {
+                counts.push_back(std::max(std::atoi(item.c_str()), 0));
+            }
+        }
+        else if (arg == "--mutex")
+        {
+            options.mutexes = split(value);
+        }
+        else if (arg == "--cache")
+        {
+            options.caches = split(value);
+        }
+        else if (arg == "--busy")
+        {
+            options.busy = split(value);
+        }
+        else if (arg == "--duration")
+        {
+            options.durationMs = std::max(std::atoi(value.c_str()), 1);
+        }
+        else if (arg == "--rows")
+        {
+            options.rows = std::max(std::atoi(value.c_str()), 1);
+        }
+        else if (arg == "--checkpoint-frames")
+        {
+            options.checkpointFrames = std::max(std::atoi(value.c_str()), 1);
+        }
+        else if (arg == "--database")
+        {
+            options.database = value;
+        }
+        else if (arg == "--output")
+        {
+            options.output = value;
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+    return options;
+}
+
+/// Counters of a thread during a run
+struct ThreadCounters
+{
+    int64_t operations = 0;     ///< Reads or write transactions done
+    int64_t retries = 0;        ///< Busy or locked attempts, retried
+    int64_t checkpoints = 0;    ///< Checkpoints run in the commits of a writer
+    double  checkpointMs = 0.0; ///< Time spent in these checkpoints
+    double  maxStallMs = 0.0;   ///< Longest of these checkpoints
+};
+
+// Busy handler counting the attempts, waiting 1ms between them up to 1s
+int countingBusyHandler(void* apCounters, const int aAttempts)
+{
+    ++static_cast<ThreadCounters*>(apCounters)->retries;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return aAttempts < 1000;
+}
+
+/// Checkpoint hook of a writer connection: a PASSIVE checkpoint once the WAL is large enough, timed
+struct CheckpointHook
+{
+    ThreadCounters* pCounters;
+    int             frames;
+};
+
+// WAL hook called after each commit, replacing the automatic checkpoint to measure it
+int checkpointHook(void* apHook, sqlite3* apSQLite, const char* apSchema, const int aFrames)
+{
+    const CheckpointHook& hook = *static_cast<CheckpointHook*>(apHook);
+    if (aFrames >= hook.frames)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        sqlite3_wal_checkpoint_v2(apSQLite, apSchema, SQLITE_CHECKPOINT_PASSIVE, nullptr, nullptr);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        ++hook.pCounters->checkpoints;
+        hook.pCounters->checkpointMs += ms;
+        hook.pCounters->maxStallMs = std::max(hook.pCounters->maxStallMs, ms);
+    }
+    return SQLITE_OK;
+}
+
+// Run an operation, retrying it while the database is busy or locked, until the end of the run
+template <typename Operation>
+void runWithRetry(Operation&& aOperation, ThreadCounters& aCounters, const std::atomic<bool>& abStop)
+{
+    while (true)
+    {
+        try
+        {
+            aOperation();
+            ++aCounters.operations;
+            return;
+        }
+        catch (const SQLite::Exception& e)
+        {
+            const int errorCode = e.getErrorCode() & 0xff;
+            if (errorCode != SQLITE_BUSY && errorCode != SQLITE_LOCKED)
+            {
+                throw;
+            }
+            ++aCounters.retries;
+            if (abStop)
+            {
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+}
+
+/// Parameters of a run
+struct Run
+{
+    int         readers;
+    int         writers;
+    std::string mutex;
+    std::string cache;
+    std::string busy;
+};
+
+// Run one combination, and write its CSV line
+void run(const SweepOptions& aOptions, const Run& aRun, std::ostream& aStream)
+{
+    int flags = SQLite::OPEN_READWRITE;
+    flags |= (aRun.mutex == "nomutex") ? SQLite::OPEN_NOMUTEX : SQLite::OPEN_FULLMUTEX;
+    flags |= (aRun.cache == "shared") ? SQLite::OPEN_SHAREDCACHE : SQLite::OPEN_PRIVATECACHE;
+    const bool bHandler = (aRun.busy == "handler");
+
+    const int nbThreads = aRun.readers + aRun.writers;
+    std::vector<ThreadCounters> counters(static_cast<size_t>(nbThreads));
+    std::atomic<int> ready(0);
+    std::atomic<bool> bStart(false);
+    std::atomic<bool> bStop(false);
+    std::vector<std::exception_ptr> errors(static_cast<size_t>(nbThreads));
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < nbThreads; ++thread)
+    {
+        threads.emplace_back([&, thread]
+        {
+            bool bReady = false;
+            try
+            {
+                const bool bWriter = (thread >= aRun.readers);
+                ThreadCounters& threadCounters = counters[static_cast<size_t>(thread)];
+                SQLite::Database db(aOptions.database, flags);
+                if (bHandler)
+                {
+                    sqlite3_busy_handler(db.getHandle(), &countingBusyHandler, &threadCounters);
+                }
+                CheckpointHook hook = { &threadCounters, aOptions.checkpointFrames };
+                if (bWriter)
+                {
+                    sqlite3_wal_hook(db.getHandle(), &checkpointHook, &hook);
+                }
+                SQLite::Statement read(db, "SELECT value FROM test WHERE id = ?");
+                SQLite::Statement write(db, "UPDATE test SET value = value + 1 WHERE id = ?");
+                std::mt19937 random(static_cast<unsigned>(thread) + 1);
+                std::uniform_int_distribution<int> ids(1, aOptions.rows);
+
+                ++ready;
+                bReady = true;
+                while (!bStart)
+                {
+                    std::this_thread::yield();
+                }
+                while (!bStop)
+                {
+                    const int id = ids(random);
+                    if (bWriter)
+                    {
+                        runWithRetry([&]
+                        {
+                            write.tryReset();
+                            SQLite::Transaction transaction(db, SQLite::TransactionBehavior::IMMEDIATE);
+                            write.bind(1, id);
+                            write.exec();
+                            transaction.commit();
+                        }, threadCounters, bStop);
+                    }
+                    else
+                    {
+                        runWithRetry([&]
+                        {
+                            read.tryReset();
+                            read.bind(1, id);
+                            while (read.executeStep())
+                            {
+                                (void)read.getColumn(0).getInt64();
+                            }
+                        }, threadCounters, bStop);
+                    }
+                }
+            }
+            catch (...)
+            {
+                // Like a failed open: end the run, and report the error from the main thread
+                errors[static_cast<size_t>(thread)] = std::current_exception();
+                bStop = true;
+                if (!bReady)
+                {
+                    ++ready;
+                }
+            }
+        });
+    }
+    while (ready < nbThreads)
+    {
+        std::this_thread::yield();
+    }
+    const auto start = std::chrono::steady_clock::now();
+    bStart = true;
+    if (!bStop)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(aOptions.durationMs));
+    }
+    bStop = true;
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    for (const std::exception_ptr& error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ThreadCounters reads;
+    ThreadCounters writes;
+    for (int thread = 0; thread < nbThreads; ++thread)
+    {
+        const ThreadCounters& threadCounters = counters[static_cast<size_t>(thread)];
+        ThreadCounters& total = (thread < aRun.readers) ? reads : writes;
+        total.operations += threadCounters.operations;
+        total.retries += threadCounters.retries;
+        total.checkpoints += threadCounters.checkpoints;
+        total.checkpointMs += threadCounters.checkpointMs;
+        total.maxStallMs = std::max(total.maxStallMs, threadCounters.maxStallMs);
+    }
+    aStream << aRun.readers << ',' << aRun.writers << ',' << aRun.mutex << ',' << aRun.cache << ',' << aRun.busy
+            << ',' << static_cast<double>(reads.operations) / seconds
+            << ',' << static_cast<double>(writes.operations) / seconds
+            << ',' << static_cast<double>(reads.retries) / seconds
+            << ',' << static_cast<double>(writes.retries) / seconds
+            << ',' << writes.checkpoints
+            << ',' << writes.checkpointMs
+            << ',' << writes.maxStallMs << std::endl;
+}
+
+// Create the table in WAL mode
+void createDatabase(const SweepOptions& aOptions)
+{
+    std::remove(aOptions.database.c_str());
+    std::remove((aOptions.database + "-wal").c_str());
+    std::remove((aOptions.database + "-shm").c_str());
+    SQLite::Database db(aOptions.database, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+    db.exec("PRAGMA journal_mode = WAL");
+    db.exec("CREATE TABLE test (id INTEGER PRIMARY KEY, value INTEGER)");
+    db.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < " +
+            std::to_string(aOptions.rows) + ") INSERT INTO test SELECT i, 0 FROM n");
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        const SweepOptions options = parseSweepOptions(argc, argv);
+        std::ofstream file;
+        if (!options.output.empty())
+        {
+            file.open(options.output.c_str());
+            if (!file.is_open())
+            {
+                std::cerr << "Unable to write " << options.output << "\n";
+                return EXIT_FAILURE;
+            }
+        }
+        std::ostream& stream = options.output.empty() ? std::cout : file;
+
+        createDatabase(options);
+        // Keep a connection open, so that the WAL and its index are not deleted between the runs
+        SQLite::Database keeper(options.database, SQLite::OPEN_READWRITE);
+
+        stream << "readers,writers,mutex,cache,busy,read_qps,write_tps,read_retries_per_s,write_retries_per_s,"
+                  "checkpoints,checkpoint_ms,max_checkpoint_stall_ms" << std::endl;
+        for (const std::string& mutex : options.mutexes)
+        {
+            for (const std::string& cache : options.caches)
+            {
+                for (const std::string& busy : options.busy)
+                {
+                    for (const int writers : options.writers)
+                    {
+                        for (const int readers : options.readers)
+                        {
+                            run(options, { readers, writers, mutex, cache, busy }, stream);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "concurrency_sweep: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,374 @@
+/**
+ * @file    wrapper_overhead.cpp
+ * @ingroup benchmarks
+ * @brief   Measure the overhead of the SQLiteC++ wrapper over the equivalent raw sqlite3 C API calls.
+ *
+ *  Each benchmark is run twice, with the "sqlitecpp" wrapper and with the raw "sqlite3" calls,
+ *  on the same in-memory database, and the results are written as JSON.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include "Benchmark.h"
+
+#include <SQLiteCpp/ExecuteMany.h>
+
+#include <sqlite3.h>
+
+#include <cstdarg>
+#include <cstdio>
+#include <tuple>
+
+namespace
+{
+
+// Number of rows of the table read by the benchmarks
+const int NB_ROWS = 100;
+
+// Keep the results of the operations alive, so that the compiler does not optimize them out
+volatile int64_t gSink = 0;
+
+// Create the table read by the benchmarks
+void createTable(SQLite::Database& aDb)
+{
+    aDb.exec("CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT, number INTEGER)");
+    aDb.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < " + std::to_string(NB_ROWS) +
+             ") INSERT INTO test SELECT i, 'value number ' || i, i * 7 FROM n");
+}
+
+// Prepare a statement with the raw C API, failing loudly
+sqlite3_stmt* prepare(SQLite::Database& aDb, const char* apQuery)
+{
+    sqlite3_stmt* pStmt = nullptr;
+    aDb.check(sqlite3_prepare_v2(aDb.getHandle(), apQuery, -1, &pStmt, nullptr));
+    return pStmt;
+}
+
+#ifndef _WIN32
+// Number of fcntl() system calls done by the unix VFS, that are the file locks
+int64_t gFcntlCalls = 0;
+sqlite3_syscall_ptr gRealFcntl = nullptr;
+
+// Count the fcntl() calls of the unix VFS, then forward them
+int countingFcntl(int aFd, int aOp, ...)
+{
+    va_list args;
+    va_start(args, aOp);
+    void* pArg = va_arg(args, void*);
+    va_end(args);
+    ++gFcntlCalls;
+    return reinterpret_cast<int (*)(int, int, ...)>(gRealFcntl)(aFd, aOp, pArg);
+}
+#endif
+
+// Time a write transaction on a database file, with the default locking or with Database::openExclusive()
+void benchmarkLocking(const SQLiteBenchmark::Options& aOptions, std::vector<SQLiteBenchmark::Result>& aResults)
+{
+    const int64_t iterations = std::max<int64_t>(aOptions.iterations / 100, 10);
+    const char* const filename = "benchmark.db3";
+#ifndef _WIN32
+    sqlite3_vfs* pVfs = sqlite3_vfs_find("unix");
+    if (pVfs != nullptr)
+    {
+        gRealFcntl = pVfs->xGetSystemCall(pVfs, "fcntl");
+        pVfs->xSetSystemCall(pVfs, "fcntl", reinterpret_cast<sqlite3_syscall_ptr>(&countingFcntl));
+    }
+#endif
+    for (const bool bExclusive : {false, true})
+    {
+        std::remove(filename);
+        {
+            SQLite::Database db = bExclusive ? SQLite::Database::openExclusive(filename)
+                                             : SQLite::Database(filename, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+            db.exec("PRAGMA journal_mode = WAL");
+            db.exec("PRAGMA synchronous = OFF");
+            db.exec("CREATE TABLE test (id INTEGER PRIMARY KEY, value INTEGER)");
+            SQLite::Statement insert(db, "INSERT INTO test (value) VALUES (?)");
+#ifndef _WIN32
+            gFcntlCalls = 0;
+#endif
+            SQLiteBenchmark::Result result = SQLiteBenchmark::measure(aOptions, "write_transaction",
+                                                                      bExclusive ? "exclusive" : "default",
+                                                                      iterations, [&]
+            {
+                SQLite::Transaction transaction(db);
+                insert.bind(1, 42);
+                insert.exec();
+                insert.reset();
+                transaction.commit();
+            });
+#ifndef _WIN32
+            const int64_t nbOps = iterations * aOptions.repetitions + 1;
+            result.counters["fcntl_per_op"] = static_cast<double>(gFcntlCalls) / static_cast<double>(nbOps);
+#endif
+            aResults.push_back(result);
+        }
+        std::remove(filename);
+        std::remove("benchmark.db3-wal");
+        std::remove("benchmark.db3-shm");
+    }
+#ifndef _WIN32
+    if (pVfs != nullptr)
+    {
+        pVfs->xSetSystemCall(pVfs, "fcntl", gRealFcntl);
+    }
+#endif
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const SQLiteBenchmark::Options options = SQLiteBenchmark::parseOptions(argc, argv);
+    const int64_t iterations = options.iterations;
+    std::vector<SQLiteBenchmark::Result> results;
+
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    sqlite3* const pDb = db.getHandle();
+    createTable(db);
+    const char* const selectOne = "SELECT value, number FROM test WHERE id = ?";
+    const char* const selectNamed = "SELECT value, number FROM test WHERE id = :id AND number > :min";
+    const char* const selectAll = "SELECT id, value, number FROM test";
+
+    if (SQLiteBenchmark::isSelected(options, "statement_construction"))
+    {
+        results.push_back(SQLiteBenchmark::measure(options, "statement_construction", "sqlitecpp", iterations, [&]
+        {
+            SQLite::Statement query(db, selectOne);
+            gSink = gSink + query.getColumnCount();
+        }));
+        results.push_back(SQLiteBenchmark::measure(options, "statement_construction", "sqlite3", iterations, [&]
+        {
+            sqlite3_stmt* pStmt = prepare(db, selectOne);
+            gSink = gSink + sqlite3_column_count(pStmt);
+            sqlite3_finalize(pStmt);
+        }));
+    }
+
+    if (SQLiteBenchmark::isSelected(options, "bind_positional"))
+    {
+        SQLite::Statement query(db, selectNamed);
+        const std::string text = "value number 1";
+        results.push_back(SQLiteBenchmark::measure(options, "bind_positional", "sqlitecpp", iterations, [&]
+        {
+            query.bind(1, 42);
+            query.bind(2, text);
+            query.reset();
+        }));
+        sqlite3_stmt* pStmt = prepare(db, selectNamed);
+        results.push_back(SQLiteBenchmark::measure(options, "bind_positional", "sqlite3", iterations, [&]
+        {
+            sqlite3_bind_int(pStmt, 1, 42);
+            sqlite3_bind_text(pStmt, 2, text.c_str(), static_cast<int>(text.size()), SQLITE_TRANSIENT);
+            sqlite3_reset(pStmt);
+        }));
+        sqlite3_finalize(pStmt);
+    }
+
+    if (SQLiteBenchmark::isSelected(options, "bind_named"))
+    {
+        SQLite::Statement query(db, selectNamed);
+        results.push_back(SQLiteBenchmark::measure(options, "bind_named", "sqlitecpp", iterations, [&]
+        {
+            query.bind(":id", 42);
+            query.bind(":min", 7);
+            query.reset();
+        }));
+        sqlite3_stmt* pStmt = prepare(db, selectNamed);
+        results.push_back(SQLiteBenchmark::measure(options, "bind_named", "sqlite3", iterations, [&]
+        {
+            sqlite3_bind_int(pStmt, sqlite3_bind_parameter_index(pStmt, ":id"), 42);
+            sqlite3_bind_int(pStmt, sqlite3_bind_parameter_index(pStmt, ":min"), 7);
+            sqlite3_reset(pStmt);
+        }));
+        sqlite3_finalize(pStmt);
+    }
+
+    // The benchmarks reading rows report the time by row
+    const int64_t scans = std::max<int64_t>(iterations / NB_ROWS, 1);
+
+    if (SQLiteBenchmark::isSelected(options, "execute_step"))
+    {
+        SQLite::Statement query(db, selectAll);
+        SQLiteBenchmark::Result result = SQLiteBenchmark::measure(options, "execute_step", "sqlitecpp", scans, [&]
+        {
+            while (query.executeStep())
+            {
+                gSink = gSink + 1;
+            }
+            query.reset();
+        });
+        result.nsPerOp /= NB_ROWS;
+        results.push_back(result);
+        sqlite3_stmt* pStmt = prepare(db, selectAll);
+        result = SQLiteBenchmark::measure(options, "execute_step", "sqlite3", scans, [&]
+        {
+            while (sqlite3_step(pStmt) == SQLITE_ROW)
+            {
+                gSink = gSink + 1;
+            }
+            sqlite3_reset(pStmt);
+        });
+        result.nsPerOp /= NB_ROWS;
+        results.push_back(result);
+        sqlite3_finalize(pStmt);
+    }
+
+    if (SQLiteBenchmark::isSelected(options, "get_column_index"))
+    {
+        SQLite::Statement query(db, selectAll);
+        SQLiteBenchmark::Result result = SQLiteBenchmark::measure(options, "get_column_index", "sqlitecpp", scans, [&]
+        {
+            while (query.executeStep())
+            {
+                gSink = gSink + query.getColumn(0).getInt64() + query.getColumn(2).getInt64();
+            }
+            query.reset();
+        });
+        result.nsPerOp /= NB_ROWS;
+        results.push_back(result);
+        sqlite3_stmt* pStmt = prepare(db, selectAll);
+        result = SQLiteBenchmark::measure(options, "get_column_index", "sqlite3", scans, [&]
+        {
+            while (sqlite3_step(pStmt) == SQLITE_ROW)
+            {
+                gSink = gSink + sqlite3_column_int64(pStmt, 0) + sqlite3_column_int64(pStmt, 2);
+            }
+            sqlite3_reset(pStmt);
+        });
+        result.nsPerOp /= NB_ROWS;
+        results.push_back(result);
+        sqlite3_finalize(pStmt);
+    }
+
+    if (SQLiteBenchmark::isSelected(options, "get_column_name"))
+    {
+        SQLite::Statement query(db, selectAll);
+        SQLiteBenchmark::Result result = SQLiteBenchmark::measure(options, "get_column_name", "sqlitecpp", scans, [&]
+        {
+            while (query.executeStep())
+            {
+                gSink = gSink + query.getColumn("id").getInt64() + query.getColumn("number").getInt64();
+            }
+            query.reset();
+        });
+        result.nsPerOp /= NB_ROWS;
+        results.push_back(result);
+        // The raw equivalent of a lookup by name is a scan of the names of the columns
+        sqlite3_stmt* pStmt = prepare(db, selectAll);
+        const auto getIndex = [pStmt](const char* apName)
+        {
+            const int nbColumns = sqlite3_column_count(pStmt);
+            for (int i = 0; i < nbColumns; ++i)
+            {
+                if (std::strcmp(sqlite3_column_name(pStmt, i), apName) == 0)
+                {
+                    return i;
+                }
+            }
+            return -1;
+        };
+        result = SQLiteBenchmark::measure(options, "get_column_name", "sqlite3", scans, [&]
+        {
+            while (sqlite3_step(pStmt) == SQLITE_ROW)
+            {
+                gSink = gSink + sqlite3_column_int64(pStmt, getIndex("id")) +
+                        sqlite3_column_int64(pStmt, getIndex("number"));
+            }
+            sqlite3_reset(pStmt);
+        });
+        result.nsPerOp /= NB_ROWS;
+        results.push_back(result);
+        sqlite3_finalize(pStmt);
+    }
+
+    if (SQLiteBenchmark::isSelected(options, "column_get_string"))
+    {
+        SQLite::Statement query(db, selectAll);
+        SQLiteBenchmark::Result result = SQLiteBenchmark::measure(options, "column_get_string", "sqlitecpp", scans, [&]
+        {
+            while (query.executeStep())
+            {
+                gSink = gSink + static_cast<int64_t>(query.getColumn(1).getString().size());
+            }
+            query.reset();
+        });
+        result.nsPerOp /= NB_ROWS;
+        results.push_back(result);
+        sqlite3_stmt* pStmt = prepare(db, selectAll);
+        result = SQLiteBenchmark::measure(options, "column_get_string", "sqlite3", scans, [&]
+        {
+            while (sqlite3_step(pStmt) == SQLITE_ROW)
+            {
+                const char* pText = reinterpret_cast<const char*>(sqlite3_column_text(pStmt, 1));
+                const std::string value(pText, static_cast<size_t>(sqlite3_column_bytes(pStmt, 1)));
+                gSink = gSink + static_cast<int64_t>(value.size());
+            }
+            sqlite3_reset(pStmt);
+        });
+        result.nsPerOp /= NB_ROWS;
+        results.push_back(result);
+        sqlite3_finalize(pStmt);
+    }
+
+#if (__cplusplus >= 201402L) || ( defined(_MSC_VER) && (_MSC_VER >= 1900) ) // c++14: Visual Studio 2015
+    if (SQLiteBenchmark::isSelected(options, "execute_many"))
+    {
+        // Time by row inserted, by batches of 4 rows rolled back to keep the table small
+        db.exec("CREATE TABLE many (id INTEGER, value TEXT)");
+        const char* const insert = "INSERT INTO many VALUES (?, ?)";
+        const int64_t batches = std::max<int64_t>(iterations / 4, 1);
+        db.exec("BEGIN");
+        SQLiteBenchmark::Result result = SQLiteBenchmark::measure(options, "execute_many", "sqlitecpp", batches, [&]
+        {
+            SQLite::execute_many(db, insert, std::make_tuple(1, "one"), std::make_tuple(2, "two"),
+                                 std::make_tuple(3, "three"), std::make_tuple(4, "four"));
+        });
+        result.nsPerOp /= 4;
+        results.push_back(result);
+        const std::tuple<int, const char*> rows[] = {
+            std::make_tuple(1, "one"), std::make_tuple(2, "two"),
+            std::make_tuple(3, "three"), std::make_tuple(4, "four")
+        };
+        result = SQLiteBenchmark::measure(options, "execute_many", "sqlite3", batches, [&]
+        {
+            sqlite3_stmt* pStmt = prepare(db, insert);
+            for (const auto& row : rows)
+            {
+                sqlite3_bind_int(pStmt, 1, std::get<0>(row));
+                sqlite3_bind_text(pStmt, 2, std::get<1>(row), -1, SQLITE_TRANSIENT);
+                sqlite3_step(pStmt);
+                sqlite3_reset(pStmt);
+            }
+            sqlite3_finalize(pStmt);
+        });
+        result.nsPerOp /= 4;
+        results.push_back(result);
+        db.exec("ROLLBACK");
+    }
+#endif
+
+    if (SQLiteBenchmark::isSelected(options, "transaction"))
+    {
+        results.push_back(SQLiteBenchmark::measure(options, "transaction", "sqlitecpp", iterations, [&]
+        {
+            SQLite::Transaction transaction(db);
+            transaction.commit();
+        }));
+        results.push_back(SQLiteBenchmark::measure(options, "transaction", "sqlite3", iterations, [&]
+        {
+            db.check(sqlite3_exec(pDb, "BEGIN", nullptr, nullptr, nullptr));
+            db.check(sqlite3_exec(pDb, "COMMIT", nullptr, nullptr, nullptr));
+        }));
+    }
+
+    if (SQLiteBenchmark::isSelected(options, "write_transaction"))
+    {
+        benchmarkLocking(options, results);
+    }
+
+    return SQLiteBenchmark::reportAndCompare(options, "wrapper_overhead", results);
+}
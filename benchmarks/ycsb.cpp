@@ -0,0 +1,608 @@
+/**
+ * @file    ycsb.cpp
+ * @ingroup benchmarks
+ * @brief   YCSB-style macro workload driver: A to F operation mixes, with uniform, zipfian or latest keys.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include "Benchmark.h"
+
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+
+/**
+ * @brief Options of the command line
+ *
+ *  The "usertable" is loaded with "--records" rows of "--field-count" fields of "--field-length" bytes,
+ *  then "--threads" threads run "--operations" operations through a pool of "--pool" connections.
+ *  With a "--target" throughput, the latencies are measured from the intended start time of each operation,
+ *  to correct the coordinated omission of a stalled driver; without it, they are the service times only.
+ */
+struct YcsbOptions
+{
+    char                        workload = 'a';         ///< YCSB core workload, from 'a' to 'f'
+    int64_t                     records = 10000;        ///< Number of records loaded before the run
+    int64_t                     operations = 100000;    ///< Number of operations of the run, for all the threads
+    int                         fieldCount = 10;        ///< Number of fields by record
+    int                         fieldLength = 100;      ///< Size of each field, in bytes
+    std::string                 distribution;           ///< uniform, zipfian or latest (default of the workload)
+    int                         threads = 1;            ///< Number of client threads
+    int                         pool = 0;               ///< Number of connections shared by the threads (0: one each)
+    double                      target = 0.0;           ///< Target throughput in operations by second (0: no limit)
+    std::vector<std::string>    pragmas;                ///< "name=value" pragmas applied to each connection
+    std::string                 database = "ycsb.db3";  ///< Database file, recreated
+    std::string                 output;                 ///< JSON output file, or empty for the standard output
+};
+
+/// Kinds of operations of the workloads
+enum Operation { Read, Update, Insert, Scan, ReadModifyWrite, NB_OPERATIONS };
+
+const char* const OPERATION_NAMES[NB_OPERATIONS] = { "read", "update", "insert", "scan", "read_modify_write" };
+
+/// Proportion of each operation of a workload, and its default key distribution
+struct Workload
+{
+    double      proportions[NB_OPERATIONS];
+    const char* distribution;
+};
+
+// Operation mixes of the YCSB core workloads
+Workload getWorkload(const char aWorkload)
+{
+    switch (aWorkload)
+    {
+    case 'a': return { { 0.50, 0.50, 0.00, 0.00, 0.00 }, "zipfian" };  // Update heavy
+    case 'b': return { { 0.95, 0.05, 0.00, 0.00, 0.00 }, "zipfian" };  // Read mostly
+    case 'c': return { { 1.00, 0.00, 0.00, 0.00, 0.00 }, "zipfian" };  // Read only
+    case 'd': return { { 0.95, 0.00, 0.05, 0.00, 0.00 }, "latest" };   // Read latest
+    case 'e': return { { 0.00, 0.00, 0.05, 0.95, 0.00 }, "zipfian" };  // Short ranges
+    case 'f': return { { 0.50, 0.00, 0.00, 0.00, 0.50 }, "zipfian" };  // Read-modify-write
+    default:
+        throw std::invalid_argument(std::string("Unknown workload ") + aWorkload);
+    }
+}
+
+// Print the usage and exit
+void usage(const char* apProgram)
+{
+    std::cerr << "Usage: " << apProgram << " [--workload a-f] [--records N] [--operations N]"
+              << " [--field-count N] [--field-length N] [--distribution uniform|zipfian|latest]"
+              << " [--threads N] [--pool N] [--target OPS] [--pragma NAME=VALUE]... [--database FILE]"
+              << " [--output FILE]\n";
+    std::exit(EXIT_FAILURE);
+}
+
+// Parse the command line
+YcsbOptions parseYcsbOptions(const int argc, const char* const argv[])
+{
+    YcsbOptions options;
+    for (int i = 1; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+        {
+            usage(argv[0]);
+        }
+        const std::string arg = argv[i];
+        const std::string value = argv[i + 1];
+        if (arg == "--workload" && value.size() == 1 && value[0] >= 'a' && value[0] <= 'f')
+        {
+            options.workload = value[0];
+        }
+        else if (arg == "--records")
+        {
+            options.records = std::max<int64_t>(std::atoll(value.c_str()), 1);
+        }
+        else if (arg == "--operations")
+        {
+            options.operations = std::max<int64_t>(std::atoll(value.c_str()), 1);
+        }
+        else if (arg == "--field-count")
+        {
+            options.fieldCount = std::max(std::atoi(value.c_str()), 1);
+        }
+        else if (arg == "--field-length")
+        {
+            options.fieldLength = std::max(std::atoi(value.c_str()), 1);
+        }
+        else if (arg == "--distribution" && (value == "uniform" || value == "zipfian" || value == "latest"))
+        {
+            options.distribution = value;
+        }
+        else if (arg == "--threads")
+        {
+            options.threads = std::max(std::atoi(value.c_str()), 1);
+        }
+        else if (arg == "--pool")
+        {
+            options.pool = std::max(std::atoi(value.c_str()), 0);
+        }
+        else if (arg == "--target")
+        {
+            options.target = std::max(std::atof(value.c_str()), 0.0);
+        }
+        else if (arg == "--pragma" && value.find('=') != std::string::npos)
+        {
+            options.pragmas.push_back(value);
+        }
+        else if (arg == "--database")
+        {
+            options.database = value;
+        }
+        else if (arg == "--output")
+        {
+            options.output = value;
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+    if (options.pool == 0)
+    {
+        options.pool = options.threads;
+    }
+    return options;
+}
+
+/**
+ * @brief Zipfian distribution of integers in [0, aItems), the smallest being the most popular.
+ *
+ *  Algorithm of Gray et al. "Quickly generating billion-record synthetic databases", as in YCSB.
+ */
+class ZipfianGenerator
+{
+public:
+    explicit ZipfianGenerator(const uint64_t aItems, const double aTheta = 0.99) :
+        mItems(aItems),
+        mTheta(aTheta)
+    {
+        double zeta2 = 0.0;
+        for (uint64_t i = 1; i <= mItems; ++i)
+        {
+            mZetaN += 1.0 / std::pow(static_cast<double>(i), mTheta);
+            if (i == 2)
+            {
+                zeta2 = mZetaN;
+            }
+        }
+        mAlpha = 1.0 / (1.0 - mTheta);
+        mEta = (1.0 - std::pow(2.0 / static_cast<double>(mItems), 1.0 - mTheta)) / (1.0 - zeta2 / mZetaN);
+    }
+
+    uint64_t next(std::mt19937_64& aRandom) const
+    {
+        const double u = std::uniform_real_distribution<double>(0.0, 1.0)(aRandom);
+        const double uz = u * mZetaN;
+        if (uz < 1.0)
+        {
+            return 0;
+        }
+        if (uz < 1.0 + std::pow(0.5, mTheta))
+        {
+            return 1;
+        }
+        const double item = static_cast<double>(mItems) * std::pow(mEta * u - mEta + 1.0, mAlpha);
+        return std::min(static_cast<uint64_t>(item), mItems - 1);
+    }
+
+private:
+    uint64_t    mItems;
+    double      mTheta;
+    double      mZetaN = 0.0;
+    double      mAlpha = 0.0;
+    double      mEta = 0.0;
+};
+
+// FNV-1a hash of a 64 bits integer, to scatter the popular zipfian items over the key space like YCSB
+uint64_t fnvHash(uint64_t aValue)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (int i = 0; i < 8; ++i)
+    {
+        hash ^= aValue & 0xFF;
+        hash *= 0x100000001B3ULL;
+        aValue >>= 8;
+    }
+    return hash;
+}
+
+/// Connection of the pool, with its prepared statements
+struct Connection
+{
+    explicit Connection(const YcsbOptions& aOptions) :
+        db(aOptions.database, SQLite::OPEN_READWRITE, 10000)
+    {
+        for (const std::string& pragma : aOptions.pragmas)
+        {
+            db.exec("PRAGMA " + pragma);
+        }
+        read.reset(new SQLite::Statement(db, "SELECT * FROM usertable WHERE ycsb_key = ?"));
+        scan.reset(new SQLite::Statement(db, "SELECT * FROM usertable WHERE ycsb_key >= ? ORDER BY ycsb_key LIMIT ?"));
+        std::string values = "?";
+        for (int field = 0; field < aOptions.fieldCount; ++field)
+        {
+            updates.emplace_back(new SQLite::Statement(db, "UPDATE usertable SET field" + std::to_string(field) +
+                                                           " = ? WHERE ycsb_key = ?"));
+            values += ", ?";
+        }
+        insert.reset(new SQLite::Statement(db, "INSERT INTO usertable VALUES (" + values + ")"));
+    }
+
+    SQLite::Database                                db;
+    std::unique_ptr<SQLite::Statement>              read;
+    std::unique_ptr<SQLite::Statement>              scan;
+    std::unique_ptr<SQLite::Statement>              insert;
+    std::vector<std::unique_ptr<SQLite::Statement>> updates;
+};
+
+/// Pool of connections shared by the client threads
+class ConnectionPool
+{
+public:
+    explicit ConnectionPool(const YcsbOptions& aOptions)
+    {
+        for (int i = 0; i < aOptions.pool; ++i)
+        {
+            mConnections.emplace_back(new Connection(aOptions));
+        }
+    }
+
+    std::unique_ptr<Connection> acquire()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this] { return !mConnections.empty(); });
+        std::unique_ptr<Connection> connection = std::move(mConnections.back());
+        mConnections.pop_back();
+        return connection;
+    }
+
+    void release(std::unique_ptr<Connection> aConnection)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mConnections.push_back(std::move(aConnection));
+        }
+        mCondition.notify_one();
+    }
+
+private:
+    std::mutex                                  mMutex;
+    std::condition_variable                     mCondition;
+    std::vector<std::unique_ptr<Connection>>    mConnections;
+};
+
+/// Latencies measured by a client thread, by operation
+struct ThreadStats
+{
+    std::vector<int64_t>    latencies[NB_OPERATIONS];  ///< In nanoseconds
+    int64_t                 errors = 0;
+};
+
+/// State shared by the client threads
+class Client
+{
+public:
+    Client(const YcsbOptions& aOptions, ConnectionPool& aPool) :
+        mOptions(aOptions),
+        mWorkload(getWorkload(aOptions.workload)),
+        mDistribution(aOptions.distribution.empty() ? mWorkload.distribution : aOptions.distribution),
+        mPool(aPool),
+        mZipfian(static_cast<uint64_t>(aOptions.records)),
+        mNextInsert(aOptions.records)
+    {
+    }
+
+    const std::string& getDistribution() const
+    {
+        return mDistribution;
+    }
+
+    // Run the operations of a client thread
+    void run(const int aThread, const int64_t aOperations, const std::chrono::steady_clock::time_point aStart,
+             ThreadStats& aStats)
+    {
+        std::mt19937_64 random(static_cast<uint64_t>(aThread) + 1);
+        std::string buffer(static_cast<size_t>(mOptions.fieldLength) * 64, ' ');
+        for (char& c : buffer)
+        {
+            c = static_cast<char>('a' + random() % 26);
+        }
+        const double interval = (mOptions.target > 0.0) ? mOptions.threads / mOptions.target : 0.0;
+
+        for (int64_t i = 0; i < aOperations; ++i)
+        {
+            const Operation operation = chooseOperation(random);
+            auto intended = std::chrono::steady_clock::now();
+            if (interval > 0.0)
+            {
+                // The intended start time does not move if the previous operations were late
+                intended = aStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(interval * static_cast<double>(i)));
+                std::this_thread::sleep_until(intended);
+            }
+            std::unique_ptr<Connection> connection = mPool.acquire();
+            try
+            {
+                execute(*connection, operation, random, buffer);
+            }
+            catch (const SQLite::Exception&)
+            {
+                ++aStats.errors;
+            }
+            mPool.release(std::move(connection));
+            const auto latency = std::chrono::steady_clock::now() - intended;
+            aStats.latencies[operation].push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+        }
+    }
+
+private:
+    // Choose the next operation according to the proportions of the workload
+    Operation chooseOperation(std::mt19937_64& aRandom) const
+    {
+        double choice = std::uniform_real_distribution<double>(0.0, 1.0)(aRandom);
+        for (int operation = 0; operation < NB_OPERATIONS; ++operation)
+        {
+            choice -= mWorkload.proportions[operation];
+            if (choice < 0.0)
+            {
+                return static_cast<Operation>(operation);
+            }
+        }
+        return Read;
+    }
+
+    // Choose an existing key according to the distribution
+    int64_t chooseKey(std::mt19937_64& aRandom) const
+    {
+        const uint64_t count = static_cast<uint64_t>(mNextInsert.load());
+        if (mDistribution == "uniform")
+        {
+            return static_cast<int64_t>(std::uniform_int_distribution<uint64_t>(0, count - 1)(aRandom));
+        }
+        if (mDistribution == "latest")
+        {
+            return static_cast<int64_t>(count - 1 - std::min(mZipfian.next(aRandom), count - 1));
+        }
+        return static_cast<int64_t>(fnvHash(mZipfian.next(aRandom)) % count);
+    }
+
+    // Bind a value of a field, taken from the random buffer
+    void bindField(SQLite::Statement& aStatement, const int aIndex, std::mt19937_64& aRandom,
+                   const std::string& aBuffer) const
+    {
+        const size_t offset = static_cast<size_t>(aRandom() % (aBuffer.size() - mOptions.fieldLength + 1));
+        aStatement.bind(aIndex, aBuffer.data() + offset, mOptions.fieldLength);
+    }
+
+    // Read a record and all its fields
+    void read(Connection& aConnection, const int64_t aKey)
+    {
+        SQLite::Statement& query = *aConnection.read;
+        query.reset();
+        query.bind(1, aKey);
+        while (query.executeStep())
+        {
+            for (int field = 1; field <= mOptions.fieldCount; ++field)
+            {
+                (void)query.getColumn(field).getBytes();
+            }
+        }
+    }
+
+    // Update one random field of a record
+    void update(Connection& aConnection, const int64_t aKey, std::mt19937_64& aRandom, const std::string& aBuffer)
+    {
+        SQLite::Statement& query = *aConnection.updates[aRandom() % aConnection.updates.size()];
+        query.reset();
+        bindField(query, 1, aRandom, aBuffer);
+        query.bind(2, aKey);
+        query.exec();
+    }
+
+    // Execute an operation
+    void execute(Connection& aConnection, const Operation aOperation, std::mt19937_64& aRandom,
+                 const std::string& aBuffer)
+    {
+        switch (aOperation)
+        {
+        case Read:
+            read(aConnection, chooseKey(aRandom));
+            break;
+        case Update:
+            update(aConnection, chooseKey(aRandom), aRandom, aBuffer);
+            break;
+        case Insert:
+        {
+            SQLite::Statement& query = *aConnection.insert;
+            query.reset();
+            query.bind(1, mNextInsert.fetch_add(1));
+            for (int field = 0; field < mOptions.fieldCount; ++field)
+            {
+                bindField(query, field + 2, aRandom, aBuffer);
+            }
+            query.exec();
+            break;
+        }
+        case Scan:
+        {
+            SQLite::Statement& query = *aConnection.scan;
+            query.reset();
+            query.bind(1, chooseKey(aRandom));
+            query.bind(2, static_cast<int>(1 + aRandom() % 100));
+            while (query.executeStep())
+            {
+                (void)query.getColumn(1).getBytes();
+            }
+            break;
+        }
+        case ReadModifyWrite:
+        {
+            const int64_t key = chooseKey(aRandom);
+            SQLite::Transaction transaction(aConnection.db, SQLite::TransactionBehavior::IMMEDIATE);
+            read(aConnection, key);
+            update(aConnection, key, aRandom, aBuffer);
+            transaction.commit();
+            break;
+        }
+        case NB_OPERATIONS:
+            break;
+        }
+    }
+
+private:
+    const YcsbOptions&      mOptions;
+    Workload                mWorkload;
+    std::string             mDistribution;
+    ConnectionPool&         mPool;
+    ZipfianGenerator        mZipfian;
+    std::atomic<int64_t>    mNextInsert;
+};
+
+// Create and load the usertable
+void load(const YcsbOptions& aOptions)
+{
+    std::remove(aOptions.database.c_str());
+    std::remove((aOptions.database + "-wal").c_str());
+    std::remove((aOptions.database + "-shm").c_str());
+    SQLite::Database db(aOptions.database, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+    for (const std::string& pragma : aOptions.pragmas)
+    {
+        db.exec("PRAGMA " + pragma);
+    }
+    std::string columns = "ycsb_key INTEGER PRIMARY KEY";
+    std::string values = "?";
+    for (int field = 0; field < aOptions.fieldCount; ++field)
+    {
+        columns += ", field" + std::to_string(field) + " BLOB";
+        values += ", ?";
+    }
+    db.exec("CREATE TABLE usertable (" + columns + ")");
+
+    std::mt19937_64 random(0);
+    std::string value(static_cast<size_t>(aOptions.fieldLength), ' ');
+    SQLite::Transaction transaction(db);
+    SQLite::Statement insert(db, "INSERT INTO usertable VALUES (" + values + ")");
+    for (int64_t key = 0; key < aOptions.records; ++key)
+    {
+        insert.reset();
+        insert.bind(1, key);
+        for (int field = 0; field < aOptions.fieldCount; ++field)
+        {
+            for (char& c : value)
+            {
+                c = static_cast<char>('a' + random() % 26);
+            }
+            insert.bind(field + 2, value.data(), aOptions.fieldLength);
+        }
+        insert.exec();
+    }
+    transaction.commit();
+}
+
+// Return the percentile of sorted latencies, in microseconds
+double percentile(const std::vector<int64_t>& aSorted, const double aPercentile)
+{
+    const size_t index = static_cast<size_t>(aPercentile / 100.0 * static_cast<double>(aSorted.size() - 1) + 0.5);
+    return static_cast<double>(aSorted[index]) / 1000.0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        const YcsbOptions options = parseYcsbOptions(argc, argv);
+        load(options);
+
+        ConnectionPool pool(options);
+        Client client(options, pool);
+        std::vector<ThreadStats> stats(static_cast<size_t>(options.threads));
+        std::vector<std::thread> threads;
+        const auto start = std::chrono::steady_clock::now();
+        for (int thread = 0; thread < options.threads; ++thread)
+        {
+            // Spread the remainder of the operations over the first threads
+            const int64_t operations = options.operations / options.threads +
+                                       ((thread < options.operations % options.threads) ? 1 : 0);
+            threads.emplace_back(&Client::run, &client, thread, operations, start, std::ref(stats[thread]));
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const std::string name = std::string("ycsb_") + options.workload;
+        std::vector<SQLiteBenchmark::Result> results;
+        SQLiteBenchmark::Result total;
+        total.name = name;
+        total.variant = client.getDistribution();
+        total.iterations = options.operations;
+        total.nsPerOp = seconds * 1e9 / static_cast<double>(options.operations);
+        total.counters["throughput_ops"] = static_cast<double>(options.operations) / seconds;
+        total.counters["threads"] = options.threads;
+        total.counters["pool"] = options.pool;
+        total.counters["target_ops"] = options.target;
+        total.counters["errors"] = 0;
+        for (const ThreadStats& threadStats : stats)
+        {
+            total.counters["errors"] += static_cast<double>(threadStats.errors);
+        }
+        results.push_back(total);
+
+        for (int operation = 0; operation < NB_OPERATIONS; ++operation)
+        {
+            std::vector<int64_t> latencies;
+            for (const ThreadStats& threadStats : stats)
+            {
+                latencies.insert(latencies.end(), threadStats.latencies[operation].begin(),
+                                 threadStats.latencies[operation].end());
+            }
+            if (latencies.empty())
+            {
+                continue;
+            }
+            std::sort(latencies.begin(), latencies.end());
+            SQLiteBenchmark::Result result;
+            result.name = name + "." + OPERATION_NAMES[operation];
+            result.variant = client.getDistribution();
+            result.iterations = static_cast<int64_t>(latencies.size());
+            double sum = 0.0;
+            for (const int64_t latency : latencies)
+            {
+                sum += static_cast<double>(latency);
+            }
+            result.nsPerOp = sum / static_cast<double>(latencies.size());
+            result.counters["p50_us"] = percentile(latencies, 50.0);
+            result.counters["p95_us"] = percentile(latencies, 95.0);
+            result.counters["p99_us"] = percentile(latencies, 99.0);
+            result.counters["p999_us"] = percentile(latencies, 99.9);
+            result.counters["max_us"] = static_cast<double>(latencies.back()) / 1000.0;
+            results.push_back(result);
+        }
+
+        SQLiteBenchmark::Options reportOptions;
+        reportOptions.output = options.output;
+        return SQLiteBenchmark::report(reportOptions, "ycsb", results);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "ycsb: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,253 @@
+/**
+ * @file    BlobStore.h
+ * @ingroup SQLiteCpp
+ * @brief   Content-addressed store of large objects, deduplicated by chunks.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+#include <SQLiteCpp/Database.h>
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Forward declaration to avoid inclusion of <sqlite3.h> in a header
+struct sqlite3_blob;
+
+namespace SQLite
+{
+
+// Forward declarations
+class Statement;
+class Savepoint;
+
+/**
+ * @brief Store of named objects, split in content-defined chunks stored only once.
+ *
+ * Objects are cut in chunks by content-defined chunking (FastCDC, with a "gear" rolling hash),
+ * so that the chunk boundaries move with the content: an insertion in an object only changes the chunks around it.
+ * Each chunk is identified by its SHA-256 hash, and stored only once with a reference count,
+ * so the duplicated content is neither written again nor stored twice.
+ *
+ * The store uses 4 tables, named after a prefix ("blobstore" by default):
+ * - <prefix>_index: hash of the unique chunks, with their reference count (WITHOUT ROWID, keyed by hash)
+ * - <prefix>_chunks: data of the unique chunks, in a rowid table to be read incrementally with sqlite3_blob
+ * - <prefix>_objects: name and size of the objects
+ * - <prefix>_object_chunks: sequence of the chunks of each object
+ *
+ * @code
+ * SQLite::BlobStore store(db);
+ * store.put("report.pdf", data.data(), data.size());
+ * SQLite::BlobStore::Reader reader = store.open("report.pdf");
+ * while (size_t size = reader.read(buffer, sizeof(buffer))) { ... }
+ * @endcode
+ *
+ * Thread-safety: a BlobStore object shall not be shared by multiple threads, as its Database connection.
+ */
+class SQLITECPP_API BlobStore
+{
+public:
+    /**
+     * @brief Streaming writer of an object, chunking and storing the data as it is written.
+     *
+     *  The object is only visible after commit(): the chunks are written in a savepoint, rolled back on destruction.
+     *  As savepoints are nested, a single writer can be open at a time on a store.
+     */
+    class SQLITECPP_API Writer
+    {
+    public:
+        Writer(Writer&& aOther) noexcept;
+        ~Writer();
+
+        // Writer is non-copyable
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        /**
+         * @brief Append data to the object, storing the chunks already complete.
+         *
+         * @throw SQLite::Exception in case of error
+         */
+        void write(const void* apData, size_t aSize);
+
+        /**
+         * @brief Store the last chunk and the object, replacing any previous object of the same name.
+         *
+         * @throw SQLite::Exception in case of error
+         */
+        void commit();
+
+    private:
+        friend class BlobStore;
+        Writer(BlobStore& aStore, const std::string& aName);
+
+        /// Store the chunks of the buffer, including the last one only at the end of the data.
+        void flush(bool abEnd);
+
+        BlobStore*                  mpStore;            ///< Store of the object
+        std::string                 mName;              ///< Name of the object
+        std::unique_ptr<Savepoint>  mpSavepoint;        ///< Savepoint of the object, released by commit()
+        int64_t                     mObjectId = 0;      ///< Identifier of the object
+        int64_t                     mSize = 0;          ///< Size of the data written
+        int64_t                     mNbChunks = 0;      ///< Number of chunks stored
+        std::vector<unsigned char>  mBuffer;            ///< Data not yet chunked
+    };
+
+    /**
+     * @brief Streaming reader of an object, reading its chunks incrementally with sqlite3_blob.
+     *
+     *  The object shall not be modified or removed while it is read.
+     */
+    class SQLITECPP_API Reader
+    {
+    public:
+        Reader(Reader&& aOther) noexcept;
+        ~Reader();
+
+        // Reader is non-copyable
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        /**
+         * @brief Read the next bytes of the object.
+         *
+         * @return the number of bytes read, less than aSize only at the end of the object
+         *
+         * @throw SQLite::Exception in case of error
+         */
+        size_t read(void* apBuffer, size_t aSize);
+
+        /// Return the size of the object.
+        int64_t getSize() const noexcept
+        {
+            return mSize;
+        }
+
+    private:
+        friend class BlobStore;
+        Reader(Database& aDatabase, const std::string& aChunksTable, std::vector<int64_t>&& aChunks, int64_t aSize);
+
+        Database*               mpDatabase;         ///< Database of the store
+        std::string             mChunksTable;       ///< Name of the table of the chunks
+        std::vector<int64_t>    mChunks;            ///< Rowids of the chunks of the object
+        int64_t                 mSize;              ///< Size of the object
+        size_t                  mChunk = 0;         ///< Index of the current chunk
+        int                     mChunkSize = 0;     ///< Size of the current chunk
+        int                     mOffset = 0;        ///< Offset in the current chunk
+        sqlite3_blob*           mpBlob = nullptr;   ///< Handle on the current chunk
+    };
+
+    /// Statistics of the store
+    struct Stats
+    {
+        int64_t nbObjects = 0;      ///< Number of objects
+        int64_t logicalBytes = 0;   ///< Total size of the objects
+        int64_t nbChunks = 0;       ///< Number of unique chunks
+        int64_t storedBytes = 0;    ///< Total size of the unique chunks
+    };
+
+    /**
+     * @brief Open the store, creating its tables if needed.
+     *
+     * @param[in] aDatabase     the SQLite Database Connection, shall outlive the store
+     * @param[in] aPrefix       Prefix of the names of the tables
+     * @param[in] aMinChunkSize Minimum size of a chunk
+     * @param[in] aAvgChunkSize Expected average size of a chunk, rounded down to a power of 2
+     * @param[in] aMaxChunkSize Maximum size of a chunk
+     *
+     * @throw SQLite::Exception in case of error, or if the chunk sizes are not in increasing order
+     */
+    explicit BlobStore(Database& aDatabase, const std::string& aPrefix = "blobstore",
+                       size_t aMinChunkSize = 2048, size_t aAvgChunkSize = 8192, size_t aMaxChunkSize = 65536);
+
+    // BlobStore is non-copyable
+    BlobStore(const BlobStore&) = delete;
+    BlobStore& operator=(const BlobStore&) = delete;
+
+    ~BlobStore();
+
+    /**
+     * @brief Start writing an object, replacing any previous object of the same name on commit.
+     *
+     * @throw SQLite::Exception if another writer is open on the store, or in case of error
+     */
+    Writer create(const std::string& aName);
+
+    /**
+     * @brief Store an object, replacing any previous object of the same name.
+     *
+     * @throw SQLite::Exception if a writer is open on the store, or in case of error
+     */
+    void put(const std::string& aName, const void* apData, size_t aSize);
+
+    /// @copydoc put(const std::string&, const void*, size_t)
+    void put(const std::string& aName, std::istream& aStream);
+
+    /**
+     * @brief Open an object for reading.
+     *
+     * @throw SQLite::Exception if the object does not exist, or in case of error
+     */
+    Reader open(const std::string& aName);
+
+    /**
+     * @brief Read a whole object in memory.
+     *
+     * @throw SQLite::Exception if the object does not exist, or in case of error
+     */
+    std::string get(const std::string& aName);
+
+    /// Test if an object exists.
+    bool exists(const std::string& aName);
+
+    /**
+     * @brief Remove an object, and the chunks no longer used by any object.
+     *
+     * @return false if the object does not exist
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    bool remove(const std::string& aName);
+
+    /// Return the statistics of the store, to measure the deduplication.
+    Stats getStats();
+
+    /**
+     * @brief Compute the content-defined chunk boundaries of some data, as the store does.
+     *
+     * @return the size of each chunk
+     */
+    std::vector<size_t> split(const void* apData, size_t aSize) const;
+
+private:
+    /// Return the size of the first chunk of the data, or aSize if all of it is the last chunk.
+    size_t findCut(const unsigned char* apData, size_t aSize) const noexcept;
+    /// Store a chunk if it is new, else add a reference to it, and append it to an object.
+    void storeChunk(int64_t aObjectId, int64_t aSeq, const unsigned char* apData, size_t aSize);
+    /// Remove an object by id, releasing its chunks.
+    void removeObject(int64_t aObjectId);
+
+    Database&   mDatabase;      ///< Reference to the SQLite Database Connection
+    std::string mPrefix;        ///< Prefix of the names of the tables
+    size_t      mMinChunkSize;  ///< Minimum size of a chunk
+    size_t      mAvgChunkSize;  ///< Average size of a chunk
+    size_t      mMaxChunkSize;  ///< Maximum size of a chunk
+    uint64_t    mMaskSmall;     ///< Harder cut condition, before the average chunk size
+    uint64_t    mMaskLarge;     ///< Easier cut condition, after the average chunk size
+    std::unique_ptr<Statement>  mpFindChunk;    ///< Find a chunk by hash
+    std::unique_ptr<Statement>  mpAddRef;       ///< Add a reference to a chunk
+    std::unique_ptr<Statement>  mpInsertData;   ///< Insert the data of a new chunk
+    std::unique_ptr<Statement>  mpInsertIndex;  ///< Index a new chunk
+    std::unique_ptr<Statement>  mpInsertLink;   ///< Append a chunk to an object
+    bool                        mbWriting = false;  ///< true while a Writer is open, until its commit or destruction
+};
+
+}  // namespace SQLite
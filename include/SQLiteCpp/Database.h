@@ -12,6 +12,7 @@
 
 #include <SQLiteCpp/SQLiteCppExport.h>
 #include <SQLiteCpp/Column.h>
+#include <SQLiteCpp/IndexAdvisor.h>
 
 // c++17: MinGW GCC version > 8
 // c++17: Visual Studio 2017 version 15.7
@@ -64,8 +65,12 @@ namespace filesystem = experimental::filesystem;
 
 #endif // SQLITECPP_HAVE_STD_EXPERIMENTAL_FILESYSTEM
 
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <string>
 #include <string.h>
+#include <vector>
 
 // Forward declarations to avoid inclusion of <sqlite3.h> in a header
 struct sqlite3;
@@ -144,6 +149,138 @@ struct Header {
     unsigned long sqliteVersion;
 };
 
+/// Space used by a table or an index, see Database::analyzeSpace()
+struct ObjectSpace
+{
+    std::string name;               ///< Name of the table or index
+    std::string tableName;          ///< Name of the table, of the index or the table itself
+    bool        isIndex = false;    ///< true for an index, false for a table (even WITHOUT ROWID)
+    int64_t     pages = 0;          ///< Total number of pages of the b-tree
+    int64_t     leafPages = 0;      ///< Number of leaf pages
+    int64_t     internalPages = 0;  ///< Number of interior pages
+    int64_t     overflowPages = 0;  ///< Number of overflow pages, of rows or keys not fitting in their b-tree page
+    int64_t     cells = 0;          ///< Number of cells in the leaf pages (rows or index entries)
+    int64_t     payloadBytes = 0;   ///< Bytes of payload (data of the rows and keys)
+    int64_t     unusedBytes = 0;    ///< Bytes unused in all the pages
+    double      fillFactor = 0.0;   ///< Ratio of the bytes of the pages in use, from 0.0 to 1.0
+    double      fragmentation = 0.0; ///< Ratio of the leaf pages not following the previous one in the file
+};
+
+/// Maintenance operation recommended by Database::analyzeSpace()
+struct SpaceRecommendation
+{
+    /// Kind of maintenance
+    enum Action
+    {
+        Vacuum,     ///< VACUUM the database, to release free pages or defragment the tables
+        Reindex,    ///< REINDEX an index, to rebuild it compact and in order
+        PageSize,   ///< Change the page size (then VACUUM), to avoid overflow pages
+    };
+
+    Action      action;     ///< Kind of maintenance
+    std::string object;     ///< Name of the table or index concerned, empty for the whole database
+    std::string reason;     ///< Human-readable explanation, with the measures triggering the recommendation
+    int         pageSize;   ///< Recommended page size for Action::PageSize, else 0
+};
+
+/// Space usage of a database, see Database::analyzeSpace()
+struct SpaceReport
+{
+    int64_t                             pageSize = 0;   ///< Size of a page in bytes
+    int64_t                             pageCount = 0;  ///< Total number of pages of the database
+    int64_t                             freePages = 0;  ///< Number of unused pages in the freelist
+    std::vector<ObjectSpace>            objects;        ///< Tables and indexes, from the largest
+    std::vector<SpaceRecommendation>    recommendations; ///< Maintenance recommended, if any
+};
+
+/// Statistics of the query planner gathered by ANALYZE, see Database::exportPlannerStats()
+struct PlannerStats
+{
+    /// Row of the sqlite_stat1 table, see https://www.sqlite.org/fileformat2.html#stat1tab
+    struct Stat1
+    {
+        std::string table;  ///< Name of the table
+        std::string index;  ///< Name of the index, empty for the statistics of the table itself
+        std::string stat;   ///< Number of rows, then average number of rows by value of the columns of the index
+    };
+
+    /// Row of the sqlite_stat4 table, see https://www.sqlite.org/fileformat2.html#stat4tab
+    struct Stat4
+    {
+        std::string table;  ///< Name of the table
+        std::string index;  ///< Name of the index
+        std::string neq;    ///< Number of rows equal to the sample, for each column of the index
+        std::string nlt;    ///< Number of rows lower than the sample, for each column of the index
+        std::string ndlt;   ///< Number of distinct values lower than the sample, for each column of the index
+        std::string sample; ///< Sample key, as a record in the SQLite file format (binary)
+    };
+
+    std::vector<Stat1> stat1;   ///< Rows of the sqlite_stat1 table
+    std::vector<Stat4> stat4;   ///< Rows of the sqlite_stat4 table, if sqlite3 is built with SQLITE_ENABLE_STAT4
+};
+
+/// Options of Database::rebuildOptimized()
+struct RebuildOptions
+{
+    /// Page size of the new database, 0 to keep the current one (ignored by VACUUM INTO from an in-memory database)
+    int                         pageSize = 0;
+    /// Rebuild the tables one by one, inserting their rows in primary key order, then create the indexes,
+    /// instead of using VACUUM INTO. The rowids of the tables without an INTEGER PRIMARY KEY are renumbered.
+    /// A database with virtual tables (FTS5, R*Tree...) is still copied with VACUUM INTO.
+    bool                        clustered = false;
+    /// Run ANALYZE on the new database
+    bool                        analyze = true;
+    /// Candidate page sizes to benchmark: the one running the workload the fastest is kept (overrides pageSize)
+    std::vector<int>            candidatePageSizes;
+    /// Queries of the workload of the benchmark, executed until their last row
+    std::vector<std::string>    workload;
+    /// Number of times the workload is run for each candidate page size
+    int                         repeat = 3;
+};
+
+/// Options of Database::warmUp()
+struct WarmUpOptions
+{
+    /// How to load the database file in the page cache of the OS
+    enum Strategy
+    {
+        Advise, ///< Ask the OS to read the whole file in the background (posix_fadvise WILLNEED), returns at once
+        Read,   ///< Read the whole file, in parallel threads
+        HotSet, ///< Read the ranges of the file recorded in hotSetFile by a PageAccessRecorder, in parallel threads
+    };
+
+    Strategy                    strategy = Read;    ///< How to load the database file
+    std::string                 hotSetFile;         ///< File of the ranges to read, for the HotSet strategy
+    unsigned                    nbThreads = 0;      ///< Number of threads, 0 for the number of hardware threads
+    std::chrono::milliseconds   budget{0};          ///< Time budget, 0 for no limit
+    /// Called from the calling thread while reading, with the bytes read so far and the bytes to read
+    std::function<void(int64_t aBytesRead, int64_t aBytesTotal)> progress;
+};
+
+/// Result of Database::warmUp()
+struct WarmUpResult
+{
+    int64_t                     bytesTotal = 0;     ///< Bytes to read
+    int64_t                     bytesRead = 0;      ///< Bytes read (or advised)
+    bool                        complete = false;   ///< false if the time budget was exhausted before the end
+    std::chrono::milliseconds   duration{0};        ///< Duration of the warm-up
+};
+
+/// Result of Database::rebuildOptimized()
+struct RebuildResult
+{
+    /// Duration of a run of the workload, for a candidate page size
+    struct Timing
+    {
+        int                         pageSize;   ///< Candidate page size
+        std::chrono::microseconds   duration;   ///< Fastest run of the workload
+    };
+
+    int                 pageSize = 0;   ///< Page size of the new database
+    int64_t             fileSize = 0;   ///< Size of the new database file in bytes
+    std::vector<Timing> timings;        ///< Benchmark of the candidate page sizes, if any
+};
+
 /**
  * @brief RAII management of a SQLite Database Connection.
  *
@@ -263,6 +400,29 @@ public:
      */
     ~Database() = default;
 
+    /**
+     * @brief Open a database owned by this process only, in a fast mode avoiding the file locking system calls.
+     *
+     * The connection uses "PRAGMA locking_mode = EXCLUSIVE", the "unix-excl" VFS (when available)
+     * keeping the WAL index in heap memory instead of a shared memory "-shm" file, and SQLite::OPEN_NOMUTEX.
+     * The file lock is taken at once and held until the connection is closed,
+     * so no other connection can access the database in the meantime, even in the same process.
+     *
+     * @note Another process is detected only if it holds a lock on the database,
+     *       that is, if it has the database open in WAL mode, or is in the middle of a transaction.
+     * @note Without a "-shm" file, a database in WAL mode can be opened with SQLite::OPEN_READONLY
+     *       only if its "-wal" file exists.
+     *
+     * @param[in] aFilename UTF-8 path/uri to the database file ("filename" sqlite3 parameter)
+     * @param[in] aFlags    SQLite::OPEN_READONLY/SQLite::OPEN_READWRITE/SQLite::OPEN_CREATE...
+     *
+     * @return The opened database, to use by one thread at a time
+     *
+     * @throw SQLite::Exception in case of error, or if another connection has the database open
+     */
+    static Database openExclusive(const std::string& aFilename,
+                                  const int aFlags = SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+
     // Deleter functor to use with smart pointers to close the SQLite database connection in an RAII fashion.
     struct Deleter
     {
@@ -588,6 +748,99 @@ public:
         return getHeaderInfo(mFilename);
     }
 
+    /**
+     * @brief Analyze the space used by the tables and indexes of a database, with the "dbstat" virtual table.
+     *
+     *  Reads all the pages of the database, so takes time proportional to its size.
+     *  The recommendations are made for:
+     *  - VACUUM if more than 25% of the pages are free, or if a table is fragmented
+     *  - REINDEX of an index filled at less than 60%, or fragmented
+     *  - a larger page size if more than 10% of the pages of a table are overflow pages
+     *  where "fragmented" means more than half of the leaf pages not following the previous one in the file,
+     *  for b-trees of at least 8 leaf pages.
+     *
+     * @param[in] apSchema  Name of the database: "main", "temp" or the name of an attached database
+     *
+     * @return SpaceReport with the space used by each table and index, and the maintenance recommended
+     *
+     * @throw SQLite::Exception in case of error, or if sqlite3 is built without SQLITE_ENABLE_DBSTAT_VTAB
+     */
+    SpaceReport analyzeSpace(const char* apSchema = "main") const;
+
+    /**
+     * @brief Propose indexes for a workload, from the full scans and temporary b-trees of its query plans.
+     *
+     * @see adviseIndexes()
+     *
+     * @throw SQLite::Exception in case of error making the scratch copy, or if the database is too large
+     *        to be copied in memory; the errors of the statements are reported by QueryAdvice::error
+     */
+    IndexAdvice indexAdvice(const std::vector<std::string>& aWorkload,
+                            const IndexAdviceOptions& aOptions = IndexAdviceOptions());
+
+    /**
+     * @brief Export the statistics of the query planner, gathered by ANALYZE.
+     *
+     *  Statistics are valid for all the databases with the same schema and a similar distribution of the data:
+     *  they can be imported in a new database, so that it gets good query plans from its first query.
+     *
+     * @param[in] apSchema  Name of the database: "main", "temp" or the name of an attached database
+     *
+     * @return Rows of the sqlite_stat1 and sqlite_stat4 tables, empty if ANALYZE has never been run
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    PlannerStats exportPlannerStats(const char* apSchema = "main") const;
+
+    /**
+     * @brief Replace the statistics of the query planner, and reload them so that they are used by the next queries.
+     *
+     *  The statistics of the tables and indexes missing from the database are ignored,
+     *  as well as the sqlite_stat4 rows if sqlite3 is not built with SQLITE_ENABLE_STAT4.
+     *
+     * @param[in] aStats    Statistics returned by exportPlannerStats() on a database with the same schema
+     * @param[in] apSchema  Name of the database: "main", "temp" or the name of an attached database
+     *
+     * @return Number of rows of statistics imported
+     *
+     * @throw SQLite::Exception in case of error; then the statistics are not modified
+     */
+    int importPlannerStats(const PlannerStats& aStats, const char* apSchema = "main");
+
+    /**
+     * @brief Run "PRAGMA optimize" with a work limit, to update the statistics of the query planner if needed.
+     *
+     *  To be called periodically, or before closing a long-lived connection.
+     *  The "analysis_limit" makes ANALYZE sample about that many rows of each index instead of reading it all.
+     *
+     * @param[in] aAnalysisLimit    Approximate number of rows to read by index, 0 for no limit
+     * @param[in] abAllTables       Consider all the tables, not only the ones used by the queries of this connection
+     * @param[in] apSchema          Name of the database: "main", "temp" or the name of an attached database
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    void optimize(int aAnalysisLimit = 400, bool abAllTables = false, const char* apSchema = "main");
+
+    /**
+     * @brief Write an optimized copy of the database to a new file, for instance during a maintenance window.
+     *
+     *  The copy is written with VACUUM INTO (or table by table in primary key order with RebuildOptions::clustered)
+     *  to a temporary file "<aFilename>.tmp", analyzed, checked with "PRAGMA integrity_check",
+     *  and then renamed to aFilename, replacing it atomically (when supported by the file system).
+     *  The database itself is not modified: the application can then switch to the new file.
+     *
+     *  If RebuildOptions::candidatePageSizes is not empty, a copy is made for each page size,
+     *  and the one running RebuildOptions::workload the fastest is kept.
+     *
+     * @param[in] aFilename Path of the new database file, different from the one of this database
+     * @param[in] aOptions  Page size, clustered rebuild and benchmark options
+     *
+     * @return Page size and size of the new database, and the benchmark of the candidate page sizes
+     *
+     * @throw SQLite::Exception in case of error, like a failed integrity check; then aFilename is not modified
+     */
+    RebuildResult rebuildOptimized(const std::string& aFilename, const RebuildOptions& aOptions = RebuildOptions());
+
     /**
      * @brief BackupType for the backup() method
      */
@@ -604,6 +857,110 @@ public:
      */
     void backup(const char* apFilename, BackupType aType);
 
+    /**
+     * @brief Method used by cloneTo() to copy the database file
+     */
+    enum class CloneMethod
+    {
+        Reflink,        ///< Copy-on-write clone of the file, sharing its blocks (Linux FICLONE on Btrfs, XFS...)
+        CopyFileRange,  ///< Copy of the file in the kernel (Linux copy_file_range, server-side on NFS...)
+        Backup,         ///< Copy page by page with the online Backup API
+    };
+
+    /**
+     * @brief Copy the database to a new file, as fast as the file system allows.
+     *
+     *  The WAL is checkpointed first, then a read transaction is held during the copy, so that the file
+     *  is not modified by the writers nor by the checkpoints. On Linux, the file is cloned by a reflink
+     *  where supported, else copied by copy_file_range(); otherwise, like for an in-memory database,
+     *  it is copied with the Backup API.
+     *
+     * @param[in] aFilename Path of the copy; an existing file is replaced, and its journal files removed
+     *
+     * @return Method used to copy the database
+     *
+     * @throw SQLite::Exception in case of error, or if a transaction is pending on this connection
+     */
+    CloneMethod cloneTo(const std::string& aFilename);
+
+    /**
+     * @brief Load the database file in the page cache of the OS, to avoid the latency of a cold start.
+     *
+     *  The Advise strategy uses posix_fadvise(WILLNEED) on Linux, and falls back to Read on the other platforms.
+     *  The HotSet strategy only reads the ranges of the file recorded by a PageAccessRecorder during a previous run,
+     *  to warm up the working set of a database larger than the memory.
+     *
+     * @param[in] aOptions  Strategy, threads, time budget and progress callback
+     *
+     * @return Bytes read and duration; nothing is read for an in-memory database
+     *
+     * @throw SQLite::Exception in case of error, like an unreadable hot set file
+     */
+    WarmUpResult warmUp(const WarmUpOptions& aOptions = WarmUpOptions()) const;
+
+    /**
+     * @brief Set the size of the chunks by which the database file grows and shrinks (SQLITE_FCNTL_CHUNK_SIZE).
+     *
+     *  Growing the file by large chunks instead of a few pages at a time reduces its fragmentation
+     *  and the number of file system metadata updates to sync. Not persistent: to set for each connection.
+     *
+     * @param[in] aBytes    Size of the chunks in bytes, 0 to disable
+     * @param[in] apSchema  Name of the database: "main", "temp" or the name of an attached database
+     *
+     * @return false if not supported by the VFS, like for an in-memory database
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    bool setChunkSize(int aBytes, const char* apSchema = "main");
+
+    /**
+     * @brief Preallocate the database file up to a size (SQLITE_FCNTL_SIZE_HINT), rounded up to the chunk size.
+     *
+     *  The unix VFS only preallocates when a chunk size is set with setChunkSize().
+     *
+     * @return false if not supported by the VFS
+     *
+     * @throw SQLite::Exception in case of error, for instance if the disk is full
+     */
+    bool sizeHint(int64_t aBytes, const char* apSchema = "main");
+
+    /**
+     * @brief Keep the WAL file when the last connection closes (SQLITE_FCNTL_PERSIST_WAL).
+     *
+     *  Avoids recreating the WAL and its shared memory at each opening, and lets read-only connections
+     *  open the database without write access to its directory.
+     *
+     * @return false if not supported by the VFS
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    bool setPersistWal(bool abPersist, const char* apSchema = "main");
+
+    /// Return true if the WAL file is kept when the last connection closes.
+    bool getPersistWal(const char* apSchema = "main") const;
+
+    /**
+     * @brief Declare that the file system does not corrupt unwritten bytes of a sector on power loss
+     *        (SQLITE_FCNTL_POWERSAFE_OVERWRITE), which saves padding of the WAL frames and journal sectors.
+     *
+     * @return false if not supported by the VFS
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    bool setPowersafeOverwrite(bool abPowersafe, const char* apSchema = "main");
+
+    /// Return true if the file system is declared to be "powersafe overwrite".
+    bool getPowersafeOverwrite(const char* apSchema = "main") const;
+
+    /**
+     * @brief Return the size of the database file in bytes, including the space preallocated at its end.
+     *
+     * @return 0 if not available from the VFS, like for an in-memory database
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    int64_t getFileSize(const char* apSchema = "main") const;
+
     /**
      * @brief Check if aRet equal SQLITE_OK, else throw a SQLite::Exception with the SQLite error message
      */
@@ -616,6 +973,9 @@ public:
     }
 
 private:
+    /// Call sqlite3_file_control(), returning false if the operation is not supported by the VFS.
+    bool fileControl(const char* apSchema, int aOperation, void* apArg) const;
+
     // TODO: perhaps switch to having Statement sharing a pointer to the Connexion
     std::unique_ptr<sqlite3, Deleter>   mSQLitePtr; ///< Pointer to SQLite Database Connection Handle
     std::string                         mFilename;  ///< UTF-8 filename used to open the database
@@ -0,0 +1,88 @@
+/**
+ * @file    FileGrowthPolicy.h
+ * @ingroup SQLiteCpp
+ * @brief   Preallocate the database file ahead of its fill rate.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+#include <SQLiteCpp/Database.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace SQLite
+{
+
+/**
+ * @brief Auto-extend policy of a database file: preallocate it ahead of its fill rate.
+ *
+ * Each call to update() measures how fast the database grows, and sizes the chunks by which the file grows
+ * (see Database::setChunkSize()) to the space filled in "aHorizon" at this rate, between a minimum and a maximum.
+ * The file is then preallocated (see Database::sizeHint()) so that at least half a chunk stays free ahead.
+ * @code
+ * SQLite::FileGrowthPolicy growth(db, 1024 * 1024, 64 * 1024 * 1024, std::chrono::seconds(60));
+ * ...
+ * growth.update(); // Periodically, or after each batch of writes
+ * @endcode
+ *
+ * @note The preallocated space is kept at the end of the file, even through the checkpoints of the WAL,
+ *       as long as the chunk size is set on the connection.
+ *
+ * Thread-safety: a FileGrowthPolicy object shall not be shared by multiple threads, as its Database connection.
+ */
+class SQLITECPP_API FileGrowthPolicy
+{
+public:
+    /**
+     * @brief Attach an auto-extend policy to a database.
+     *
+     * @param[in] aDatabase the SQLite Database Connection, shall outlive the policy
+     * @param[in] aMinAhead Minimum size of the chunks, in bytes
+     * @param[in] aMaxAhead Maximum size of the chunks, in bytes (up to 1 GiB)
+     * @param[in] aHorizon  Duration of growth to preallocate, at the measured fill rate
+     * @param[in] aSchema   Name of the database: "main", "temp" or the name of an attached database
+     */
+    FileGrowthPolicy(Database& aDatabase, int64_t aMinAhead = 1024 * 1024, int64_t aMaxAhead = 64 * 1024 * 1024,
+                     std::chrono::seconds aHorizon = std::chrono::seconds(60), const std::string& aSchema = "main");
+
+    /**
+     * @brief Measure the fill rate of the database, then resize the chunks and preallocate the file if needed.
+     *
+     * @return true if the file was extended
+     *
+     * @throw SQLite::Exception in case of error, for instance if the disk is full
+     */
+    bool update();
+
+    /// Return the fill rate of the database measured by update(), in bytes by second (smoothed).
+    double getRate() const noexcept
+    {
+        return mRate;
+    }
+
+    /// Return the current size of the chunks, 0 before the first update() or if the VFS does not support them.
+    int64_t getChunkSize() const noexcept
+    {
+        return mChunkSize;
+    }
+
+private:
+    Database&                               mDatabase;      ///< Reference to the SQLite Database Connection
+    int64_t                                 mMinAhead;      ///< Minimum size of the chunks
+    int64_t                                 mMaxAhead;      ///< Maximum size of the chunks
+    std::chrono::seconds                    mHorizon;       ///< Duration of growth to preallocate
+    std::string                             mSchema;        ///< Name of the database
+    std::chrono::steady_clock::time_point   mLastUpdate;    ///< Time of the previous update()
+    int64_t                                 mLastUsed = -1; ///< Bytes used by the database at the previous update()
+    double                                  mRate = 0.0;    ///< Smoothed fill rate, in bytes by second
+    int64_t                                 mChunkSize = 0; ///< Current size of the chunks
+};
+
+}  // namespace SQLite
@@ -0,0 +1,76 @@
+/**
+ * @file    Fingerprint.h
+ * @ingroup SQLiteCpp
+ * @brief   Fingerprint of a SQL statement: its normalized text, without the values, and a hash of it.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SQLite
+{
+
+/**
+ * @brief Fingerprint of a SQL statement, identifying its shape whatever the values used.
+ *
+ *  The normalized text is the SQL text without the comments, with one space between the tokens,
+ *  the keywords and identifiers in lower case (but the quoted identifiers), and each literal and parameter
+ *  replaced by "?". The IN lists of values are collapsed to "in (...)",
+ *  and the repeated rows of a VALUES clause to the first one followed by ", ...". So:
+ * @code
+ * SELECT * FROM orders WHERE customer_id = 42 AND state IN ('new', 'paid')
+ * select * from orders where customer_id = :id and state in (?, ?, ?)
+ * @endcode
+ *  both give "select * from orders where customer_id = ? and state in (...)".
+ */
+struct SQLITECPP_API Fingerprint
+{
+    uint64_t    hash = 0;   ///< 64-bit FNV-1a hash of the normalized text
+    std::string normalized; ///< Normalized SQL text
+
+    bool operator==(const Fingerprint& aOther) const
+    {
+        return (hash == aOther.hash) && (normalized == aOther.normalized);
+    }
+    bool operator!=(const Fingerprint& aOther) const
+    {
+        return !(*this == aOther);
+    }
+};
+
+/**
+ * @brief Return the fingerprint of a SQL statement.
+ *
+ * @param[in] apSql SQL text, UTF-8 encoded; a trailing semicolon is ignored
+ */
+SQLITECPP_API Fingerprint getFingerprint(const char* apSql);
+
+/// Return the fingerprint of a SQL statement.
+inline Fingerprint getFingerprint(const std::string& aSql)
+{
+    return getFingerprint(aSql.c_str());
+}
+
+/**
+ * @brief Return the tokens of the normalized text of a SQL statement, that getFingerprint() joins.
+ *
+ * @param[in] apSql SQL text, UTF-8 encoded; a trailing semicolon is ignored
+ */
+SQLITECPP_API std::vector<std::string> getFingerprintTokens(const char* apSql);
+
+/// Return the tokens of the normalized text of a SQL statement, that getFingerprint() joins.
+inline std::vector<std::string> getFingerprintTokens(const std::string& aSql)
+{
+    return getFingerprintTokens(aSql.c_str());
+}
+
+}  // namespace SQLite
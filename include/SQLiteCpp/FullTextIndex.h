@@ -0,0 +1,239 @@
+/**
+ * @file    FullTextIndex.h
+ * @ingroup SQLiteCpp
+ * @brief   Full-text search index on the columns of a table, using the FTS5 extension.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+#include <SQLiteCpp/Database.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SQLite
+{
+
+/**
+ * @brief Full-text index of some text columns of a table, as an FTS5 "external content" table.
+ *
+ * The index does not store a copy of the text: it refers to the rows of the content table by their rowid,
+ * and is kept in sync by triggers on the content table.
+ * @code
+ * SQLite::FullTextIndex index(db, "docs_fts", "docs", {"title", "body"});
+ * for (const SQLite::FullTextIndex::Hit& hit : index.search("sqlite NEAR wrapper", 10))
+ * {
+ *     std::cout << hit.rowid << ": " << hit.snippet << "\n";
+ * }
+ * @endcode
+ *
+ * With the "trigram" tokenizer (FullTextIndex::TRIGRAM), the index also accelerates the substring searches,
+ * with containing(), or with a "LIKE '%x%'" on a column of the index table.
+ *
+ * @note Requires the FTS5 extension, see the SQLITE_ENABLE_FTS5 CMake option to build the internal sqlite3 with it.
+ *
+ * Thread-safety: a FullTextIndex object shall not be shared by multiple threads, as its Database connection.
+ */
+class SQLITECPP_API FullTextIndex
+{
+public:
+    /// Tokenizer of substrings of 3 characters, to search any substring
+    static const char* const TRIGRAM;
+
+    /// Function receiving each token from a Tokenizer: text of the token, byte offsets in the input text,
+    /// and true for an alternative form of the previous token (synonym)
+    using TokenSink = std::function<void(const char* apToken, int aSize, int aStart, int aEnd, bool abColocated)>;
+
+    /**
+     * @brief Interface of a custom tokenizer, registered with registerTokenizer().
+     */
+    class Tokenizer
+    {
+    public:
+        virtual ~Tokenizer() = default;
+
+        /**
+         * @brief Split an UTF-8 text in tokens
+         *
+         * @param[in] apText    Text to tokenize, not null-terminated
+         * @param[in] aSize     Size of the text in bytes
+         * @param[in] aReason   FTS5_TOKENIZE_DOCUMENT, FTS5_TOKENIZE_QUERY (with FTS5_TOKENIZE_PREFIX)
+         *                      or FTS5_TOKENIZE_AUX, see https://sqlite.org/fts5.html#custom_tokenizers
+         * @param[in] aSink     Function to call for each token
+         */
+        virtual void tokenize(const char* apText, int aSize, int aReason, const TokenSink& aSink) = 0;
+    };
+
+    /// Create a Tokenizer from the arguments following its name in the "tokenize" option
+    using TokenizerFactory = std::function<std::unique_ptr<Tokenizer>(const std::vector<std::string>& aArgs)>;
+
+    /// Search result
+    struct Hit
+    {
+        int64_t     rowid;      ///< Rowid of the row of the content table
+        double      score;      ///< bm25() score, lower is better
+        std::string snippet;    ///< Extract of the text around the matches
+    };
+
+    /**
+     * @brief Open the index of a table, creating it, its triggers, and indexing the existing rows if needed.
+     *
+     * @param[in] aDatabase     the SQLite Database Connection, shall outlive the index
+     * @param[in] aName         Name of the FTS5 table of the index
+     * @param[in] aContentTable Name of the table to index
+     * @param[in] aColumns      Names of the text columns to index
+     * @param[in] aTokenizer    FTS5 "tokenize" option: "unicode61", "porter unicode61", TRIGRAM, or a custom tokenizer
+     * @param[in] aContentRowid Name of the INTEGER PRIMARY KEY of the content table, if any
+     *
+     * @throw SQLite::Exception in case of error, or if FTS5 is not available
+     */
+    FullTextIndex(Database& aDatabase, const std::string& aName, const std::string& aContentTable,
+                  const std::vector<std::string>& aColumns, const std::string& aTokenizer = "unicode61",
+                  const std::string& aContentRowid = "rowid");
+
+    // FullTextIndex is non-copyable
+    FullTextIndex(const FullTextIndex&) = delete;
+    FullTextIndex& operator=(const FullTextIndex&) = delete;
+
+    /**
+     * @brief Register a custom tokenizer on a connection, to be used by the indexes created or opened on it.
+     *
+     * @throw SQLite::Exception in case of error, or if FTS5 is not available
+     */
+    static void registerTokenizer(Database& aDatabase, const std::string& aName, TokenizerFactory aFactory);
+
+    /**
+     * @brief Search the index, ranking the results by bm25().
+     *
+     * @param[in] aQuery            FTS5 query, see https://sqlite.org/fts5.html#full_text_query_syntax
+     * @param[in] aLimit            Maximum number of results
+     * @param[in] aSnippetColumn    Index of the column of the snippets, -1 for the column with the best match
+     * @param[in] aSnippetTokens    Maximum number of tokens in a snippet (up to 64)
+     *
+     * @throw SQLite::Exception in case of error, like a query syntax error
+     */
+    std::vector<Hit> search(const std::string& aQuery, int aLimit = 10, int aSnippetColumn = -1,
+                            int aSnippetTokens = 16) const;
+
+    /**
+     * @brief Find the rows with a column containing a substring.
+     *
+     *  With the TRIGRAM tokenizer, uses the index for substrings of at least 3 characters (case insensitive).
+     *  Else a LIKE finds the substring by a full scan, as the other tokenizers only index whole tokens.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    std::vector<int64_t> containing(const std::string& aColumn, const std::string& aSubstring,
+                                    int aLimit = -1) const;
+
+    /// Set the weights of the columns for the bm25() ranking of search() (1.0 by default).
+    void setWeights(const std::vector<double>& aWeights);
+
+    /// Set the snippet markers of search() ("[", "]" and "..." by default).
+    void setSnippetMarkers(const std::string& aOpen, const std::string& aClose, const std::string& aEllipsis);
+
+    /**
+     * @brief Set the "automerge" level: number of segments of a level to merge them, 0 to disable merges.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    void setAutomerge(int aSegments);
+
+    /**
+     * @brief Set the "crisismerge" level: number of segments of a level to merge them even if automerge is disabled.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    void setCrisisMerge(int aSegments);
+
+    /**
+     * @brief Rebuild the whole index from the content table.
+     *
+     *  Merges are disabled during the rebuild, and the index optimized once at the end;
+     *  the "automerge" and "crisismerge" levels of the index are then restored.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    void rebuild();
+
+    /**
+     * @brief Insert many rows in the content table without the cost of the incremental index updates.
+     *
+     *  In a savepoint, the sync triggers are dropped, aLoader is called to modify the content table,
+     *  then the index is rebuilt and the triggers restored.
+     *
+     * @throw SQLite::Exception in case of error, or any exception thrown by aLoader; then nothing is changed
+     */
+    void bulkLoad(const std::function<void()>& aLoader);
+
+    /**
+     * @brief Merge all the segments of the index in one, for the fastest queries.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    void optimize();
+
+    /**
+     * @brief Merge some segments of the index, within a time budget, for instance when the application is idle.
+     *
+     * @param[in] aBudget   Time budget; merges are done by steps of aPages pages, so it can be slightly exceeded
+     * @param[in] aPages    Number of pages to merge at each step
+     *
+     * @return true if there is nothing more to merge, false if the budget was exhausted before
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    bool maintain(std::chrono::milliseconds aBudget, int aPages = 64);
+
+    /**
+     * @brief Check that the index matches the content table.
+     *
+     * @return false if the index is corrupted or not in sync with the content table
+     */
+    bool check();
+
+    /**
+     * @brief Drop the index and its triggers.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    void drop();
+
+    /// Return the name of the FTS5 table of the index.
+    const std::string& getName() const noexcept
+    {
+        return mName;
+    }
+
+private:
+    /// Create the triggers keeping the index in sync with the content table.
+    void createTriggers();
+    /// Drop the triggers keeping the index in sync with the content table.
+    void dropTriggers();
+    /// Set a configuration option of the index.
+    void configure(const char* apOption, int aValue);
+    /// Return a configuration option of the index, or its default value if it was never set.
+    int getConfiguration(const char* apOption, int aDefault) const;
+
+    Database&                   mDatabase;      ///< Reference to the SQLite Database Connection
+    std::string                 mName;          ///< Name of the FTS5 table
+    std::string                 mContentTable;  ///< Name of the content table
+    std::vector<std::string>    mColumns;       ///< Names of the indexed columns
+    std::string                 mContentRowid;  ///< Name of the rowid of the content table
+    std::vector<double>         mWeights;       ///< Weights of the columns for bm25()
+    std::string                 mSnippetOpen = "[";         ///< Start of a match in a snippet
+    std::string                 mSnippetClose = "]";        ///< End of a match in a snippet
+    std::string                 mSnippetEllipsis = "...";   ///< Text cut from a snippet
+    bool                        mbTrigram = false;          ///< true with the TRIGRAM tokenizer, indexing substrings
+};
+
+}  // namespace SQLite
@@ -0,0 +1,102 @@
+/**
+ * @file    IndexAdvisor.h
+ * @ingroup SQLiteCpp
+ * @brief   Propose indexes for a workload, from the full scans and temporary b-trees of its query plans.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SQLite
+{
+
+// Forward declaration
+class Database;
+
+/// Options of adviseIndexes()
+struct IndexAdviceOptions
+{
+    /// Estimate the benefit of each candidate index by running the statements on a scratch copy of the database,
+    /// without and with the index; the candidates not used by the query planner are then dropped
+    bool        bEstimate = false;
+    /// Path of the scratch copy, replaced if it exists; required for a database larger than 64 MiB,
+    /// else the copy is made in memory
+    std::string scratchFilename;
+};
+
+/// Statement of a workload, by fingerprint, analyzed by adviseIndexes()
+struct QueryAdvice
+{
+    std::string                 fingerprint;        ///< Normalized SQL text, see getFingerprint()
+    std::string                 sql;                ///< SQL text of the first execution
+    int64_t                     executions = 0;     ///< Number of executions in the workload
+    std::vector<std::string>    plan;               ///< Details of the steps of the query plan
+    std::vector<std::string>    scannedTables;      ///< Tables read by a full scan, or through an automatic index
+    std::vector<std::string>    whereColumns;       ///< Columns "table.column" compared in the WHERE and ON clauses
+    std::vector<std::string>    orderByColumns;     ///< Columns "table.column" of the ORDER BY clause
+    int64_t                     fullScanSteps = 0;  ///< Rows stepped through by full scans, in one execution
+    int64_t                     autoIndexRows = 0;  ///< Rows inserted in automatic indexes, in one execution
+    int64_t                     sorts = 0;          ///< Sort operations, in one execution
+    int64_t                     vmSteps = 0;        ///< Virtual machine steps, in one execution
+    std::string                 error;              ///< Error explaining or running the statement, if any
+};
+
+/// Index proposed by adviseIndexes()
+struct IndexCandidate
+{
+    std::string                 table;              ///< Name of the table
+    std::vector<std::string>    columns;            ///< Columns of the index, in order
+    std::string                 sql;                ///< CREATE INDEX statement
+    std::vector<std::string>    queries;            ///< Fingerprints of the statements served by the index
+    int64_t                     stepsBefore = 0;    ///< Virtual machine steps of these statements in the workload
+    int64_t                     stepsAfter = 0;     ///< Virtual machine steps of these statements with the index
+    double                      benefit = 0.0;      ///< Ratio of the steps saved, from 0.0 to 1.0
+};
+
+/// Indexes advised for a workload, see adviseIndexes()
+struct IndexAdvice
+{
+    std::vector<QueryAdvice>    queries;        ///< Statements of the workload, the most executed first
+    std::vector<IndexCandidate> candidates;     ///< Indexes proposed, the most steps saved first
+    std::vector<std::string>    unusedIndexes;  ///< Indexes used by no plan, but the UNIQUE ones enforcing a constraint
+};
+
+/**
+ * @brief Propose indexes for a workload, from the full scans and temporary b-trees of its query plans.
+ *
+ *  The statements are grouped by fingerprint (see getFingerprint()). For each one, the tables read by a full
+ *  scan or through an automatic index, and the columns of its WHERE, ON and ORDER BY clauses are found
+ *  from EXPLAIN QUERY PLAN and its SQL text. A candidate index is made for each table scanned:
+ *  the columns compared for equality, then the ORDER BY columns if the rows are sorted, or else a column
+ *  compared by range.
+ *
+ *  With IndexAdviceOptions::bEstimate, each statement is run once in a savepoint on a scratch copy,
+ *  to read its sqlite3_stmt_status() counters of full scan steps, automatic index rows, sorts and virtual
+ *  machine steps, then again with each candidate index created. The parameters are left unbound (NULL),
+ *  so the statements with literal values give the most realistic measures.
+ *
+ *  The indexes used by no plan are reported too, as they only slow down the writes.
+ *
+ * @param[in] aDatabase Database connection of the workload
+ * @param[in] aWorkload SQL texts of the statements executed, one by execution, like the executions
+ *                      of a WorkloadLog; the statements other than SELECT, INSERT, UPDATE and DELETE are ignored
+ * @param[in] aOptions  Estimation of the benefits on a scratch copy
+ *
+ * @return Statements analyzed, candidate indexes and unused indexes
+ *
+ * @throw SQLite::Exception in case of error making the scratch copy, or if the database is too large
+ *        to be copied in memory; the errors of the statements are reported by QueryAdvice::error
+ */
+SQLITECPP_API IndexAdvice adviseIndexes(Database& aDatabase, const std::vector<std::string>& aWorkload,
+                                        const IndexAdviceOptions& aOptions = IndexAdviceOptions());
+
+}  // namespace SQLite
@@ -0,0 +1,187 @@
+/**
+ * @file    KeyFilter.h
+ * @ingroup SQLiteCpp
+ * @brief   In-memory blocked Bloom filter on a key column, to skip lookups of keys that do not exist.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+#include <SQLiteCpp/Database.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SQLite
+{
+
+// Forward declaration
+class Statement;
+
+/**
+ * @brief Negative lookup accelerator: a blocked Bloom filter of the values of a key column of a table.
+ *
+ * mayContain() answers "definitely absent" without touching the database for most of the keys that do not exist,
+ * so that the b-tree lookup is only done for keys that may exist:
+ * @code
+ * SQLite::KeyFilter filter(db, "users", "email");
+ * if (filter.mayContain(email)) { ... query the table ... }
+ * @endcode
+ *
+ * The filter is a "blocked" Bloom filter: all the bits of a key are set in the same 512 bits block,
+ * so that a check costs a single cache miss.
+ *
+ * On construction, the filter is loaded from the side table "sqlitecpp_keyfilter" if it was saved before,
+ * else it is built by a full scan of the table, in parallel threads (using one read-only connection each)
+ * when the database is a file and no transaction is pending.
+ * The filter is then kept current by TEMP triggers calling a SQL function registered on the connection,
+ * so the keys inserted or updated through this connection are added to it.
+ *
+ * @note A Bloom filter cannot forget keys: deleted keys are only false positives until the next build().
+ * @note Changes made by other connections are not seen by the filter; call build() if the table was modified otherwise.
+ *       save() also creates persistent triggers on the table, flagging the saved filter as stale
+ *       on the first key inserted or updated by any connection, so that load() only reads the side table.
+ *       Drop these triggers before dropping the side table.
+ *
+ * Thread-safety: a KeyFilter object shall not be shared by multiple threads, as its Database connection.
+ */
+class SQLITECPP_API KeyFilter
+{
+public:
+    /**
+     * @brief Attach a filter to the key column of a table, loading it if saved before, else building it.
+     *
+     * @param[in] aDatabase             the SQLite Database Connection, shall outlive the filter
+     * @param[in] aTable                Name of the table
+     * @param[in] aColumn               Name of the key column of the table (can be "rowid")
+     * @param[in] aFalsePositiveRate    Target false positive rate, used to size the filter
+     * @param[in] aNbThreads            Number of threads for a build, 0 for the number of hardware threads
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    KeyFilter(Database& aDatabase, const std::string& aTable, const std::string& aColumn,
+              double aFalsePositiveRate = 0.01, unsigned aNbThreads = 0);
+
+    // KeyFilter is non-copyable (and non-movable, as its address is registered with the connection)
+    KeyFilter(const KeyFilter&) = delete;
+    KeyFilter& operator=(const KeyFilter&) = delete;
+
+    /// Detach the filter from the connection (drop its triggers and SQL function).
+    ~KeyFilter();
+
+    /// Return false if the integer key is definitely not in the table.
+    bool mayContain(int64_t aKey) const noexcept;
+    /// Return false if the text key is definitely not in the table.
+    bool mayContain(const std::string& aKey) const noexcept;
+    /// Return false if the blob key is definitely not in the table.
+    bool mayContain(const void* apKey, size_t aSize) const noexcept;
+
+    /**
+     * @brief Test if a key exists in the table, querying the table only if mayContain() returns true.
+     *
+     *  Also maintains the statistics used by getObservedFalsePositiveRate().
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    bool contains(int64_t aKey);
+    /// @copydoc contains(int64_t)
+    bool contains(const std::string& aKey);
+
+    /**
+     * @brief (Re)build the filter from a full scan of the table.
+     *
+     * @param[in] aNbThreads    Number of threads, 0 for the number of hardware threads
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    void build(unsigned aNbThreads = 0);
+
+    /**
+     * @brief Persist the filter to the side table "sqlitecpp_keyfilter", for a fast startup.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    void save();
+
+    /**
+     * @brief Load the filter persisted by save(), if it is still current.
+     *
+     * @return false if there is no saved filter, or if the keys of the table changed since it was saved.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    bool load();
+
+    /// Return the false positive rate expected from the current fill ratio of the filter.
+    double getEstimatedFalsePositiveRate() const noexcept;
+
+    /// Return the measured rate of contains() calls for absent keys that were not filtered out (0 if none).
+    double getObservedFalsePositiveRate() const noexcept;
+
+    /// Return the number of keys added to the filter.
+    uint64_t getKeyCount() const noexcept
+    {
+        return mNbKeys;
+    }
+
+    /// Return the size of the filter in bytes.
+    size_t getSizeBytes() const noexcept
+    {
+        return mBits.size() * sizeof(uint64_t);
+    }
+
+    /// Return the number of bits set for each key.
+    int getHashCount() const noexcept
+    {
+        return mNbHashes;
+    }
+
+    /// Affinity of the key column, deciding how a key value is compared to the stored ones.
+    enum class Affinity
+    {
+        None,       ///< BLOB or no declared type: keys are compared as is
+        Text,       ///< TEXT: integer keys are compared as text
+        Numeric,    ///< INTEGER, REAL or NUMERIC: text keys looking like integers are compared as integers
+    };
+
+private:
+    /// Size the filter for the given number of keys, clearing all its bits.
+    void reset(uint64_t aNbKeys);
+    /// Set the bits of a key hash.
+    void add(uint64_t aHash) noexcept;
+    /// Test the bits of a key hash.
+    bool test(uint64_t aHash) const noexcept;
+    /// Name of the side table row of the filter.
+    std::string getSavedName() const;
+    /// Name of a persistent trigger flagging the saved filter as stale ("insert" or "update").
+    std::string getTriggerName(const char* apEvent) const;
+    /// Query the table for the key bound to the lookup statement, and update the statistics.
+    bool lookup();
+
+    /// SQL function called by the triggers to add a new key.
+    static void addFunction(sqlite3_context* apContext, int aNbArgs, sqlite3_value** apArgs);
+
+    Database&                   mDatabase;          ///< Reference to the SQLite Database Connection
+    std::string                 mTable;             ///< Name of the table
+    std::string                 mColumn;            ///< Name of the key column
+    std::string                 mFunctionName;      ///< Name of the SQL function used by the triggers
+    double                      mFalsePositiveRate; ///< Target false positive rate
+    Affinity                    mAffinity = Affinity::None; ///< Affinity of the key column
+    bool                        mbIsRowid = false;  ///< true if the key column is the rowid
+    bool                        mbHasRowid = true;  ///< false for a WITHOUT ROWID table
+    std::vector<uint64_t>       mBits;              ///< Blocks of 512 bits
+    uint64_t                    mNbBlocks = 0;      ///< Number of blocks
+    int                         mNbHashes = 0;      ///< Number of bits set for each key
+    uint64_t                    mNbKeys = 0;        ///< Number of keys added
+    std::unique_ptr<Statement>  mpLookup;           ///< Statement used by contains() and bound by the caller
+    uint64_t                    mNbFiltered = 0;    ///< contains() calls answered by the filter alone
+    uint64_t                    mNbFalsePositives = 0; ///< contains() calls that queried the table for nothing
+};
+
+}  // namespace SQLite
@@ -0,0 +1,147 @@
+/**
+ * @file    MaterializedAggregate.h
+ * @ingroup SQLiteCpp
+ * @brief   A summary table of a GROUP BY query, kept current by generated triggers.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+#include <SQLiteCpp/Exception.h>
+
+#include <string>
+#include <vector>
+
+namespace SQLite
+{
+
+// Forward declaration
+class Database;
+
+/**
+ * @brief Incrementally maintained summary table of a "SELECT ... GROUP BY" aggregation query.
+ *
+ * The query is restricted to decomposable aggregates over plain columns of a single table:
+ * @code
+ * SELECT k1, k2, count(*), count(c), sum(c), total(c) FROM t GROUP BY k1, k2
+ * @endcode
+ * Each result column can be aliased with "AS alias", else it is named after its text as SQLite would.
+ *
+ * On construction, the summary table and its INSERT/UPDATE/DELETE triggers on the source table are created
+ * and the summary table is backfilled, unless the summary table already exists.
+ * Dashboard queries then become point lookups on the summary table.
+ *
+ * Non decomposable aggregates (min(), max(), avg(), group_concat()...) and WHERE/HAVING clauses are rejected.
+ *
+ * @note The summary table also holds hidden bookkeeping columns prefixed with "__".
+ * @note Floating point sums are maintained by additions and subtractions, so they can drift
+ *       slightly from a full recomputation; use refresh() to rebuild them from scratch.
+ */
+class SQLITECPP_API MaterializedAggregate
+{
+public:
+    /**
+     * @brief Parse the aggregation query, then create and backfill the summary table if it does not exist yet.
+     *
+     * @param[in] aDatabase the SQLite Database Connection
+     * @param[in] aName     Name of the summary table (also used as a prefix for its triggers)
+     * @param[in] aQuery    "SELECT ... FROM table GROUP BY ..." query with only decomposable aggregates
+     *
+     * @throw SQLite::Exception if the query is not supported, or in case of error
+     */
+    MaterializedAggregate(Database& aDatabase, const std::string& aName, const std::string& aQuery);
+
+    // MaterializedAggregate is non-copyable
+    MaterializedAggregate(const MaterializedAggregate&) = delete;
+    MaterializedAggregate& operator=(const MaterializedAggregate&) = delete;
+
+    /// Return the name of the summary table.
+    const std::string& getName() const noexcept
+    {
+        return mName;
+    }
+
+    /// Return the aggregation query.
+    const std::string& getQuery() const noexcept
+    {
+        return mQuery;
+    }
+
+    /// Return the name of the source table of the aggregation query.
+    const std::string& getSourceTable() const noexcept
+    {
+        return mSourceTable;
+    }
+
+    /**
+     * @brief Check that the summary table matches the result of the aggregation query.
+     *
+     * This runs the full aggregation query, so it is as expensive as the query being materialized.
+     *
+     * @return true if both results contain exactly the same rows.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    bool verify() const;
+
+    /**
+     * @brief Rebuild the content of the summary table from the source table.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    void refresh();
+
+    /**
+     * @brief Drop the triggers and the summary table.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    void drop();
+
+    /// Kind of a result column of the aggregation query
+    enum class Kind
+    {
+        Key,        ///< GROUP BY column
+        CountAll,   ///< count(*)
+        Count,      ///< count(column)
+        Sum,        ///< sum(column)
+        Total,      ///< total(column)
+    };
+
+    /// Description of a result column of the aggregation query
+    struct Aggregate
+    {
+        Kind        kind;       ///< Key column or kind of aggregate
+        std::string column;     ///< Source column (empty for count(*))
+        std::string name;       ///< Name of the result column in the summary table
+    };
+
+    /// Return the description of the result columns of the aggregation query.
+    const std::vector<Aggregate>& getAggregates() const noexcept
+    {
+        return mAggregates;
+    }
+
+private:
+    /// Create the summary table, its index and its triggers.
+    void create();
+    /// Fill the (empty) summary table from the source table.
+    void backfill();
+    /// Build the body of a trigger adding (aSign = +1) or removing (aSign = -1) the row aRow ("NEW" or "OLD").
+    std::string applyRow(const char* apRow, int aSign) const;
+    /// Build the condition matching the summary row of the source row aRow ("NEW" or "OLD").
+    std::string matchRow(const char* apRow) const;
+
+    Database&               mDatabase;      ///< Reference to the SQLite Database Connection
+    std::string             mName;          ///< Name of the summary table
+    std::string             mQuery;         ///< Aggregation query
+    std::string             mSourceTable;   ///< Name of the source table
+    std::vector<Aggregate>  mAggregates;    ///< Result columns of the aggregation query, in order
+    std::vector<std::string> mKeys;         ///< GROUP BY columns
+};
+
+}  // namespace SQLite
@@ -0,0 +1,109 @@
+/**
+ * @file    PageAccessRecorder.h
+ * @ingroup SQLiteCpp
+ * @brief   Instrumented VFS recording the ranges read from the database files, to warm up their hot set later.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+#include <SQLiteCpp/Database.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Forward declaration to avoid inclusion of <sqlite3.h> in a header
+struct sqlite3_vfs;
+
+namespace SQLite
+{
+
+/**
+ * @brief Instrumented VFS recording the ranges of the main database files read by SQLite.
+ *
+ * The VFS forwards all the calls to the default VFS. The databases to record shall be opened with it:
+ * @code
+ * SQLite::PageAccessRecorder recorder;
+ * SQLite::Database db("app.db3", SQLite::OPEN_READONLY, 0, recorder.getVfsName().c_str());
+ * ... typical workload ...
+ * recorder.save(db, "app.hotset");
+ *
+ * // At the next start:
+ * SQLite::WarmUpOptions options;
+ * options.strategy = SQLite::WarmUpOptions::HotSet;
+ * options.hotSetFile = "app.hotset";
+ * db.warmUp(options);
+ * @endcode
+ *
+ * The hot set file is a text file with one "offset length" range of the database file by line.
+ *
+ * Thread-safety: the recording is thread-safe; the recorder shall outlive the connections using its VFS.
+ */
+class SQLITECPP_API PageAccessRecorder
+{
+public:
+    /// Range of a file: offset and length in bytes
+    using Range = std::pair<int64_t, int64_t>;
+
+    /**
+     * @brief Register the recording VFS, on top of the default VFS.
+     *
+     * @param[in] aVfsName  Name of the VFS to register
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    explicit PageAccessRecorder(const std::string& aVfsName = "sqlitecpp_recorder");
+
+    /// Unregister the recording VFS.
+    ~PageAccessRecorder();
+
+    // PageAccessRecorder is non-copyable
+    PageAccessRecorder(const PageAccessRecorder&) = delete;
+    PageAccessRecorder& operator=(const PageAccessRecorder&) = delete;
+
+    /// Return the name of the recording VFS, to open the databases with.
+    const std::string& getVfsName() const noexcept
+    {
+        return mVfsName;
+    }
+
+    /// Return the ranges read from the main file of a database, sorted and merged.
+    std::vector<Range> getRanges(const Database& aDatabase) const;
+
+    /**
+     * @brief Save the ranges read from the main file of a database, for WarmUpOptions::HotSet.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    void save(const Database& aDatabase, const std::string& aHotSetFile) const;
+
+    /// Forget the ranges recorded so far.
+    void clear();
+
+    /// Record a range read from a file (called by the VFS).
+    void record(const char* apFilename, int64_t aOffset, int64_t aLength);
+
+    /// Return the VFS the recording VFS forwards the calls to.
+    sqlite3_vfs* getRootVfs() const noexcept
+    {
+        return mpRootVfs;
+    }
+
+private:
+    std::string                                         mVfsName;   ///< Name of the recording VFS
+    std::unique_ptr<sqlite3_vfs>                        mpVfs;      ///< Recording VFS
+    sqlite3_vfs*                                        mpRootVfs;  ///< Default VFS, doing the actual work
+    mutable std::mutex                                  mMutex;     ///< Protects mRanges
+    std::map<std::string, std::map<int64_t, int64_t>>   mRanges;    ///< Length read at each offset of each file
+};
+
+}  // namespace SQLite
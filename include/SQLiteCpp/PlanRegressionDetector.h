@@ -0,0 +1,187 @@
+/**
+ * @file    PlanRegressionDetector.h
+ * @ingroup SQLiteCpp
+ * @brief   Detect the changes of the query plans of the statements, after a schema change or an ANALYZE.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Fingerprint.h>
+#include <SQLiteCpp/QueryPlan.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Forward declarations to avoid inclusion of <sqlite3.h> in a header
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace SQLite
+{
+
+/**
+ * @brief Change of the query plan of a statement fingerprint, reported by a PlanRegressionDetector.
+ */
+struct PlanChange
+{
+    Fingerprint fingerprint;            ///< Fingerprint of the statement
+    std::string sql;                    ///< SQL text of the first execution captured
+    QueryPlan   oldPlan;                ///< Plan captured before
+    QueryPlan   newPlan;                ///< Plan now chosen by the query planner
+    bool        bRegression = false;    ///< true if the new plan adds a full scan, a temp b-tree or an automatic index
+};
+
+/**
+ * @brief Options of a PlanRegressionDetector.
+ */
+struct PlanRegressionOptions
+{
+    /// Mark all the plans captured as stale when a schema change, an ANALYZE or a write to the statistics
+    /// of the query planner is committed on an attached connection, to be re-checked by checkStale()
+    bool bRecheckOnSchemaChange = true;
+    /// Called with each change of plan; it shall not use the connections attached
+    std::function<void(const PlanChange&)> callback;
+};
+
+/**
+ * @brief Opt-in detector of the silent changes of the query plans, like an index search becoming a full scan.
+ *
+ *  The first time a statement fingerprint (see getFingerprint()) is executed on an attached connection,
+ *  the detector captures the shape of its plan, as reported by EXPLAIN QUERY PLAN, and persists it to
+ *  the table "sqlitecpp_plans" of a sidecar database. When a schema change (CREATE, DROP, ALTER, REINDEX...),
+ *  an ANALYZE or a write to sqlite_stat1 is committed, the plans captured are marked as stale.
+ *  checkStale() re-checks them, out of the statements of the application, and each plan that changed of shape
+ *  is reported with the old and the new plans, and recorded in the table "sqlitecpp_plan_changes":
+ * @code
+ * SQLite::PlanRegressionOptions options;
+ * options.callback = [](const SQLite::PlanChange& aChange)
+ * {
+ *     LOG(aChange.sql << "\n" << aChange.oldPlan.toString() << "became\n" << aChange.newPlan.toString());
+ * };
+ * SQLite::PlanRegressionDetector detector("app.db3-plans", options);
+ * detector.attach(db);
+ * ...
+ * db.exec("CREATE INDEX ...");
+ * detector.checkStale();
+ * @endcode
+ *
+ *  The plans persisted across runs are compared to the current ones at the first execution of their
+ *  fingerprint, and check() re-checks them all on demand, like after an ANALYZE run by another process.
+ *
+ *  The plans are explained on a separate read-only connection to the database file, so that the statements
+ *  executed on the attached connections are not disturbed; the database shall thus be a file,
+ *  and the statements on temporary tables are ignored. The sidecar database shall be another file.
+ *
+ *  Thread-safety: the detection is thread-safe.
+ */
+class SQLITECPP_API PlanRegressionDetector
+{
+public:
+    /**
+     * @brief Open or create the sidecar database of the plans, and load the plans captured before.
+     *
+     * @param[in] aSidecarFilename  Sidecar database, where the plans and their changes are persisted
+     * @param[in] aOptions          Options of the detection
+     *
+     * @throw SQLite::Exception in case of error on the sidecar database
+     */
+    explicit PlanRegressionDetector(const std::string& aSidecarFilename,
+                                    PlanRegressionOptions aOptions = PlanRegressionOptions());
+
+    /// Detach all the connections.
+    ~PlanRegressionDetector();
+
+    // PlanRegressionDetector is non-copyable
+    PlanRegressionDetector(const PlanRegressionDetector&) = delete;
+    PlanRegressionDetector& operator=(const PlanRegressionDetector&) = delete;
+
+    /**
+     * @brief Start capturing the plans of the statements executed on a database connection.
+     *
+     * @throw SQLite::Exception if the connection is already attached, if its database is not a file,
+     *                          or if it is not the database file of the connections already attached
+     */
+    void attach(const Database& aDatabase);
+
+    /// Stop capturing the plans of the statements executed on a database connection.
+    void detach(const Database& aDatabase);
+
+    /**
+     * @brief Re-check now all the plans captured, reporting and returning the ones that changed.
+     *
+     * @throw SQLite::Exception in case of error on the database or the sidecar database
+     */
+    std::vector<PlanChange> check();
+
+    /**
+     * @brief Re-check the plans marked as stale by the schema changes committed, reporting and returning the changes.
+     *
+     *  The plans that could not be re-checked, like on a busy database, are still stale.
+     *
+     * @throw SQLite::Exception in case of error on the database or the sidecar database
+     */
+    std::vector<PlanChange> checkStale();
+
+    /// Return true if some plans are marked as stale by a schema change committed since their last check.
+    bool isStale() const;
+
+    /// Return the number of statement fingerprints whose plan is captured.
+    size_t getPlanCount() const;
+
+    /// Attached connection, listening to its trace events
+    struct Connection;
+
+    /// Capture the plan of a statement starting on an attached connection, if it is executed for the first time.
+    void execute(const Connection& aConnection, sqlite3_stmt* apStmt);
+
+    /// Mark the plans as stale if a statement completed on an attached connection committed a schema change.
+    void complete(const Connection& aConnection, sqlite3_stmt* apStmt);
+
+    /// Forget a connection detached or closed.
+    void forget(Connection& aConnection);
+
+private:
+    /// Plan captured for a fingerprint
+    struct Entry
+    {
+        Fingerprint fingerprint;        ///< Fingerprint of the statement
+        std::string sql;                ///< SQL text of the first execution captured
+        std::string plan;               ///< Shape of the plan, as an indented tree
+        bool        bExecuted = false;  ///< true once captured for this process, false if loaded from the sidecar
+        bool        bStale = false;     ///< true if a schema change was committed since the last check
+    };
+
+    // Return the fingerprint of a statement, cached by SQL text; called under mMutex
+    const Fingerprint& fingerprintOf(sqlite3_stmt* apStmt);
+    // Return the shape of the current plan of a statement, false if it cannot be explained; called under mMutex
+    bool explainShape(const std::string& aSql, std::string& aShape);
+    // Persist the new plan of a fingerprint, and the change from the one captured; called under mMutex
+    void persist(const Entry& aEntry, const std::string& aShape, std::vector<PlanChange>& aChanges);
+    // Re-check the stale plans, with the statistics reloaded; called under mMutex
+    void recheckStale(std::vector<PlanChange>& aChanges);
+    // Call the callback with the changes of plans, out of mMutex
+    void report(const std::vector<PlanChange>& aChanges) const;
+
+    const PlanRegressionOptions                 mOptions;       ///< Options of the detection
+    mutable std::mutex                          mMutex;         ///< Protects all the state below
+    Database                                    mSidecar;       ///< Sidecar database of the plans
+    std::string                                 mFilename;      ///< Database file of the connections attached
+    std::unique_ptr<Database>                   mpExplainer;    ///< Read-only connection explaining the plans
+    std::vector<std::unique_ptr<Connection>>    mConnections;   ///< Connections attached
+    std::map<uint64_t, Entry>                   mEntries;       ///< Plan captured of each fingerprint hash
+    std::map<std::string, Fingerprint>          mFingerprints;  ///< Fingerprints of the SQL texts executed
+    bool                                        mbSchemaChanged = false; ///< Schema change not committed yet
+};
+
+}  // namespace SQLite
@@ -0,0 +1,222 @@
+/**
+ * @file    QueryPatternDetector.h
+ * @ingroup SQLiteCpp
+ * @brief   Detect the N+1 query pattern: bursts of executions of the same statement fingerprint in a scope.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Fingerprint.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Forward declarations to avoid inclusion of <sqlite3.h> in a header
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace SQLite
+{
+
+/**
+ * @brief Burst of executions of the same statement fingerprint in a scope, reported by a QueryPatternDetector.
+ */
+struct QueryBurst
+{
+    std::string     scope;          ///< Name of the scope, or "transaction"
+    Fingerprint     fingerprint;    ///< Fingerprint of the statement
+    std::string     sql;            ///< SQL text of the first execution
+    int64_t         count = 0;      ///< Number of executions in the scope
+    std::vector<std::pair<std::string, int64_t>> tags; ///< Call sites tagged, with their executions, most first
+    std::string     suggestion;     ///< How to batch the executions
+};
+
+/**
+ * @brief Options of a QueryPatternDetector.
+ */
+struct QueryPatternOptions
+{
+    /// Number of executions of a fingerprint in a scope from which they are reported as a burst
+    int64_t threshold = 10;
+    /// Use the transactions of a connection as scopes, for the executions outside of an explicit Scope
+    bool bTransactionScopes = true;
+    /// Number of bursts kept for getBursts(), the oldest being dropped
+    size_t maxBursts = 1000;
+    /// Called with each burst at the end of its scope; it shall not use the connection
+    std::function<void(const QueryBurst&)> callback;
+};
+
+/**
+ * @brief Opt-in detector of the N+1 query pattern, built on the statement fingerprints.
+ *
+ *  An ORM loop issuing the same query shape with a different key at each iteration shows up
+ *  as many executions of the same fingerprint (see getFingerprint()) in a request or a transaction.
+ *  The detector counts the executions of each fingerprint by scope, and at the end of the scope reports
+ *  the fingerprints executed at least QueryPatternOptions::threshold times, with the call sites tagged
+ *  and a suggestion to batch them, usually binding all the keys at once as a JSON array:
+ * @code
+ * SQLite::QueryPatternOptions options;
+ * options.callback = [](const SQLite::QueryBurst& aBurst) { LOG(aBurst.scope << ": " << aBurst.suggestion); };
+ * SQLite::QueryPatternDetector detector(options);
+ * detector.attach(db);
+ * {
+ *     SQLite::QueryPatternDetector::Scope scope(detector, "GET /orders");
+ *     for (const auto& order : orders)
+ *     {
+ *         SQLite::QueryPatternDetector::Tag tag(detector, "OrderRepository::loadLines");
+ *         ... SELECT * FROM lines WHERE order_id = ? ...
+ *     }
+ * } // reports "select * from lines where order_id = ?" if executed 10 times or more
+ * @endcode
+ *
+ *  The executions are traced with sqlite3_trace_v2() (see TraceListener), and counted in the innermost Scope
+ *  of the thread executing them, or else in the current transaction of the connection (bTransactionScopes).
+ *  The executions outside of any scope are not counted.
+ *
+ *  Thread-safety: the detection is thread-safe. A Scope and a Tag shall be destroyed by the thread
+ *  that created them, before the detector.
+ */
+class SQLITECPP_API QueryPatternDetector
+{
+public:
+    /// Detect the bursts with the given options.
+    explicit QueryPatternDetector(QueryPatternOptions aOptions = QueryPatternOptions());
+
+    /// Detach all the connections, reporting the bursts of their transactions in progress.
+    ~QueryPatternDetector();
+
+    // QueryPatternDetector is non-copyable
+    QueryPatternDetector(const QueryPatternDetector&) = delete;
+    QueryPatternDetector& operator=(const QueryPatternDetector&) = delete;
+
+    /**
+     * @brief Start counting the statements executed on a database connection.
+     *
+     * @throw SQLite::Exception if the connection is already attached
+     */
+    void attach(const Database& aDatabase);
+
+    /// Stop counting the statements executed on a database connection, reporting its transaction in progress.
+    void detach(const Database& aDatabase);
+
+    /**
+     * @brief Scope of the executions of the current thread, like a request; RAII object.
+     *
+     *  The bursts of the scope are reported at its destruction. The scopes can be nested;
+     *  an execution is only counted in the innermost one.
+     */
+    class SQLITECPP_API Scope
+    {
+    public:
+        /// Open a scope on the current thread.
+        Scope(QueryPatternDetector& aDetector, std::string aName);
+        /// Close the scope, reporting its bursts.
+        ~Scope();
+
+        // Scope is non-copyable
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        QueryPatternDetector& mDetector; ///< Detector of the scope
+    };
+
+    /**
+     * @brief Call site of the executions of the current thread, reported with the bursts; RAII object.
+     *
+     *  The tags can be nested; an execution is tagged with the innermost one.
+     */
+    class SQLITECPP_API Tag
+    {
+    public:
+        /// Tag the executions of the current thread, until the destruction.
+        Tag(QueryPatternDetector& aDetector, std::string aTag);
+        /// Restore the previous tag of the current thread.
+        ~Tag();
+
+        // Tag is non-copyable
+        Tag(const Tag&) = delete;
+        Tag& operator=(const Tag&) = delete;
+
+    private:
+        QueryPatternDetector& mDetector; ///< Detector of the tag
+    };
+
+    /// Return the last bursts reported (up to QueryPatternOptions::maxBursts), the oldest first.
+    std::vector<QueryBurst> getBursts() const;
+
+    /// Forget the bursts reported so far.
+    void clearBursts();
+
+    /**
+     * @brief Return how to batch the executions of a statement, from its normalized SQL text.
+     *
+     *  A key compared for equality in the WHERE clause, as in "where customer_id = ?", is batched
+     *  by binding all the keys at once as a JSON array: "where customer_id in (select value from json_each(?))".
+     */
+    static std::string suggestBatching(const std::string& aNormalizedSql);
+
+    /// Attached connection, listening to its trace events
+    struct Connection;
+
+    /// Count an execution of a statement on an attached connection.
+    void execute(const Connection& aConnection, sqlite3_stmt* apStmt);
+
+    /// Report the bursts of the transaction in progress on a connection, detached or closed.
+    void forget(Connection& aConnection);
+
+private:
+    /// Executions of a fingerprint in a scope
+    struct Counter
+    {
+        Fingerprint                     fingerprint;    ///< Fingerprint of the statement
+        std::string                     sql;            ///< SQL text of the first execution
+        int64_t                         count = 0;      ///< Number of executions
+        std::map<std::string, int64_t>  tags;           ///< Executions by call site tagged
+    };
+
+    /// Executions counted in a scope
+    struct ScopeState
+    {
+        std::string                     name;           ///< Name of the scope
+        std::map<uint64_t, Counter>     counters;       ///< Executions of each fingerprint hash
+    };
+
+    /// Scopes and tags of a thread
+    struct ThreadState
+    {
+        std::vector<ScopeState>         scopes;         ///< Scopes opened, the innermost last
+        std::vector<std::string>        tags;           ///< Tags set, the innermost last
+    };
+
+    // Return the fingerprint of a statement, cached by SQL text; called under mMutex
+    const Fingerprint& fingerprintOf(sqlite3_stmt* apStmt);
+    // Return the bursts of a scope closed, and keep them for getBursts(); called under mMutex
+    std::vector<QueryBurst> close(ScopeState& aScope);
+    // Call the callback with the bursts of a scope closed, out of mMutex
+    void report(const std::vector<QueryBurst>& aBursts) const;
+
+    const QueryPatternOptions                   mOptions;       ///< Options of the detection
+    mutable std::mutex                          mMutex;         ///< Protects all the state below
+    std::vector<std::unique_ptr<Connection>>    mConnections;   ///< Connections attached
+    std::map<std::thread::id, ThreadState>      mThreads;       ///< Scopes and tags of each thread
+    std::map<sqlite3*, ScopeState>              mTransactions;  ///< Transaction in progress of each connection
+    std::deque<QueryBurst>                      mBursts;        ///< Last bursts reported
+    std::map<std::string, Fingerprint>          mFingerprints;  ///< Fingerprints of the SQL texts executed
+};
+
+}  // namespace SQLite
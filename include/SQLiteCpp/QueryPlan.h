@@ -0,0 +1,100 @@
+/**
+ * @file    QueryPlan.h
+ * @ingroup SQLiteCpp
+ * @brief   Query plan of a statement, from EXPLAIN QUERY PLAN, with the tables scanned and the indexes used.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+
+#include <string>
+#include <vector>
+
+// Forward declaration to avoid inclusion of <sqlite3.h> in a header
+struct sqlite3;
+
+namespace SQLite
+{
+
+// Forward declaration
+class Database;
+
+/**
+ * @brief Query plan of a statement, as reported by EXPLAIN QUERY PLAN.
+ *
+ *  The format of the details of the steps is not guaranteed by SQLite, and changes between versions:
+ *  the accessors handle both "SCAN t" and the older "SCAN TABLE t".
+ */
+struct SQLITECPP_API QueryPlan
+{
+    /// Step of a query plan, a row of EXPLAIN QUERY PLAN
+    struct Step
+    {
+        int         id = 0;     ///< Identifier of the step
+        int         parent = 0; ///< Identifier of the parent step, 0 at the top level
+        std::string detail;     ///< Description, like "SEARCH t USING INDEX idx (a=?)"
+    };
+
+    /// Access to a table by a SCAN or SEARCH step
+    struct Access
+    {
+        std::string table;              ///< Name of the table, or its alias in the statement
+        bool        bFullScan = false;  ///< true for a SCAN of all the rows of the table, or of one of its indexes
+        std::string index;              ///< Index used, "PRIMARY KEY" for the rowid or primary key, else empty
+        bool        bAutomatic = false; ///< true if the index is an automatic index, created for the statement
+        bool        bCovering = false;  ///< true if the index is a covering index, with all the columns needed
+        std::string constraints;        ///< Constraints of a SEARCH on the index, like "a=? AND b>?"
+    };
+
+    std::vector<Step> steps;    ///< Steps of the plan, in order
+
+    /// Return the accesses to the tables, in the order of the steps.
+    std::vector<Access> getAccesses() const;
+
+    /// Return the names of the indexes used, without the automatic indexes and the primary keys.
+    std::vector<std::string> getIndexes() const;
+
+    /// Return true if the plan uses an index of the given name.
+    bool usesIndex(const std::string& aIndex) const;
+
+    /// Return true if a table is read by a full scan, without index or through a covering index.
+    bool hasFullScan() const;
+
+    /// Return true if a temporary b-tree is used, for ORDER BY, GROUP BY, DISTINCT...
+    bool hasTempBTree() const;
+
+    /// Return true if an automatic index is created for the statement.
+    bool hasAutomaticIndex() const;
+
+    /// Return the plan as an indented tree, one step by line, like the sqlite3 shell.
+    std::string toString() const;
+};
+
+/**
+ * @brief Return the query plan of a SQL statement, without executing it.
+ *
+ * @param[in] aDatabase Database to prepare the statement on
+ * @param[in] aSql      SQL text of one statement; its parameters are left unbound
+ *
+ * @throw SQLite::Exception in case of error, like a syntax error in the statement
+ */
+SQLITECPP_API QueryPlan explainQueryPlan(const Database& aDatabase, const std::string& aSql);
+
+/**
+ * @brief Return the query plan of a SQL statement, without executing it, on a raw connection handle.
+ *
+ *  Used by Statement::getQueryPlan(), as a Statement only knows the handle of its connection.
+ *
+ * @param[in] apSQLite  Connection handle to prepare the statement on, as returned by Database::getHandle()
+ * @param[in] aSql      SQL text of one statement; its parameters are left unbound
+ *
+ * @throw SQLite::Exception in case of error, like a syntax error in the statement
+ */
+SQLITECPP_API QueryPlan explainQueryPlan(sqlite3* apSQLite, const std::string& aSql);
+
+}  // namespace SQLite
@@ -0,0 +1,47 @@
+/**
+ * @file    Quote.h
+ * @ingroup SQLiteCpp
+ * @brief   Quote identifiers and string literals for use in SQL statements.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <string>
+
+namespace SQLite
+{
+
+/// Enclose a text in quote characters, doubling the ones it contains.
+inline std::string quote(const std::string& aText, const char aQuote)
+{
+    std::string quoted(1, aQuote);
+    quoted.reserve(aText.size() + 2);
+    for (const char c : aText)
+    {
+        quoted += c;
+        if (c == aQuote)
+        {
+            quoted += aQuote;
+        }
+    }
+    quoted += aQuote;
+    return quoted;
+}
+
+/// Quote an identifier for use in a SQL statement.
+inline std::string quote(const std::string& aIdentifier)
+{
+    return quote(aIdentifier, '"');
+}
+
+/// Quote a string literal for use in a SQL statement.
+inline std::string quoteLiteral(const std::string& aText)
+{
+    return quote(aText, '\'');
+}
+
+}  // namespace SQLite
@@ -0,0 +1,153 @@
+/**
+ * @file    SharedMemoryDatabase.h
+ * @ingroup SQLiteCpp
+ * @brief   In-memory database shared by all the connections of the process, with the "memdb" VFS.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+#include <SQLiteCpp/Database.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace SQLite
+{
+
+/**
+ * @brief In-memory database shared by all the connections of the process, with the "memdb" VFS.
+ *
+ * The database is opened as "file:/name?vfs=memdb", so that all the connections opened by connect()
+ * access the same pages in memory, instead of a private copy per connection like with ":memory:".
+ * It lives as long as the SharedMemoryDatabase object, that keeps a connection to it.
+ * @code
+ * SQLite::SharedMemoryDatabase reference("reference");
+ * reference.load("reference.db3");                          // Snapshot on disk
+ * reference.startAutoSave("reference.db3", std::chrono::minutes(5));
+ * ...
+ * // In each worker thread:
+ * SQLite::Database db = reference.connect();
+ * @endcode
+ *
+ * @note Each connection sees the other ones as a separate process would: they use the regular locking,
+ *       so a writer blocks the readers during its transaction (the WAL mode is not supported by memdb).
+ *
+ * Thread-safety: the SharedMemoryDatabase object can be shared by multiple threads,
+ *                each one using its own connection.
+ */
+class SQLITECPP_API SharedMemoryDatabase
+{
+public:
+    /**
+     * @brief Create, or open if it already exists in the process, the shared in-memory database named aName.
+     *
+     * @param[in] aName             Name of the database, shared by all its connections
+     * @param[in] aBusyTimeoutMs    Busy timeout of the connections, to wait for the writers
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    explicit SharedMemoryDatabase(const std::string& aName, int aBusyTimeoutMs = 1000);
+
+    /// Stop the automatic persistence, and release the database if there is no other connection to it.
+    ~SharedMemoryDatabase();
+
+    // SharedMemoryDatabase is non-copyable
+    SharedMemoryDatabase(const SharedMemoryDatabase&) = delete;
+    SharedMemoryDatabase& operator=(const SharedMemoryDatabase&) = delete;
+
+    /// Return the name of the database.
+    const std::string& getName() const noexcept
+    {
+        return mName;
+    }
+
+    /// Return the URI of the database, to open it with SQLite::OPEN_URI.
+    const std::string& getUri() const noexcept
+    {
+        return mUri;
+    }
+
+    /**
+     * @brief Open a new connection to the shared database, for instance for a worker thread or a pool.
+     *
+     * @param[in] aFlags    SQLite::OPEN_READONLY/SQLite::OPEN_READWRITE... (SQLite::OPEN_URI is always added)
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    Database connect(int aFlags = SQLite::OPEN_READWRITE) const;
+
+    /**
+     * @brief Replace the content of the shared database with a snapshot file, read at once in memory.
+     *
+     *  The snapshot is loaded with sqlite3_deserialize() in a private connection,
+     *  then copied to the shared database in one transaction, so other connections can stay open.
+     *
+     * @param[in] aSnapshotFile Database file to load
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    void load(const std::string& aSnapshotFile);
+
+    /**
+     * @brief Save the content of the shared database to a file, with the online backup API.
+     *
+     * @param[in] aSnapshotFile Database file to overwrite
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    void save(const std::string& aSnapshotFile);
+
+    /**
+     * @brief Save the shared database to a file periodically, from a background thread.
+     *
+     *  The errors are ignored, the next period trying again; stopAutoSave() saves a last time.
+     *
+     * @param[in] aSnapshotFile Database file to overwrite
+     * @param[in] aPeriod       Time between two saves
+     */
+    void startAutoSave(const std::string& aSnapshotFile, std::chrono::milliseconds aPeriod);
+
+    /**
+     * @brief Stop the automatic persistence started by startAutoSave(), saving a last time.
+     *
+     * @return false if the last save failed, or if the automatic persistence was not started
+     */
+    bool stopAutoSave();
+
+    /// Return the number of times the automatic persistence has saved the database.
+    int64_t getAutoSaveCount() const;
+
+    /**
+     * @brief Return the memory used by the content of the shared database, in bytes.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    int64_t getMemoryUsed() const;
+
+private:
+    // Background thread of the automatic persistence
+    void autoSave(std::string aSnapshotFile, std::chrono::milliseconds aPeriod);
+
+private:
+    std::string             mName;                  ///< Name of the database
+    std::string             mUri;                   ///< URI of the database, with the memdb VFS
+    int                     mBusyTimeoutMs;         ///< Busy timeout of the connections
+    Database                mDatabase;              ///< Connection keeping the database alive
+    std::thread             mAutoSaveThread;        ///< Thread of the automatic persistence, if started
+    mutable std::mutex      mAutoSaveMutex;         ///< Protects the state of the automatic persistence below
+    std::condition_variable mAutoSaveCondition;     ///< Wakes the thread of the automatic persistence up to stop
+    bool                    mbStopAutoSave = false; ///< Set to stop the automatic persistence
+    bool                    mbAutoSaveOk = false;   ///< Result of the last automatic save
+    int64_t                 mAutoSaveCount = 0;     ///< Number of automatic saves
+};
+
+}  // namespace SQLite
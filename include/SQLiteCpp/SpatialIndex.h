@@ -0,0 +1,561 @@
+/**
+ * @file    SpatialIndex.h
+ * @ingroup SQLiteCpp
+ * @brief   Typed R*Tree spatial index of bounding boxes, with bulk loading and nearest neighbors search.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Quote.h>
+#include <SQLiteCpp/Savepoint.h>
+#include <SQLiteCpp/Statement.h>
+
+/// @cond
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace SQLite
+{
+
+/// @endcond
+
+/**
+ * @brief Spatial index of boxes of Dims dimensions, identified by an integer, as an R*Tree virtual table.
+ *
+ * The virtual table "aName" has the columns "id, min0, max0, min1, max1...", and can also be used in SQL queries.
+ * @code
+ * SQLite::SpatialIndex<2> fences(db, "fences");
+ * fences.insert(42, {{{-1.0, 45.0}}, {{1.0, 47.0}}});
+ * for (int64_t id : fences.containing(SQLite::SpatialIndex<2>::point({{0.5, 46.0}}))) { ... }
+ * @endcode
+ *
+ * @note Requires the R*Tree extension, see the SQLITE_ENABLE_RTREE CMake option to build the internal sqlite3 with it.
+ * @note Coordinates are stored as 32 bits floats, rounded outward, so the queries can return boxes
+ *       slightly outside of the query box: check the exact geometry when needed.
+ *
+ * Thread-safety: a SpatialIndex object shall not be shared by multiple threads, as its Database connection.
+ */
+template <std::size_t Dims>
+class SpatialIndex
+{
+    static_assert(Dims >= 1 && Dims <= 5, "An R*Tree has from 1 to 5 dimensions");
+
+public:
+    /// Point of the space
+    using Point = std::array<double, Dims>;
+
+    /// Axis aligned box, including its bounds
+    struct Box
+    {
+        Point min;  ///< Lowest coordinates
+        Point max;  ///< Highest coordinates
+    };
+
+    /// Box with its identifier
+    struct Entry
+    {
+        int64_t id; ///< Identifier of the box
+        Box     box; ///< Bounding box
+    };
+
+    /// Order of the entries for bulkLoad()
+    enum class Order
+    {
+        Hilbert,    ///< Hilbert curve order of the centers of the boxes, good for point-like boxes
+        STR,        ///< Sort-Tile-Recursive: slices along each dimension, tiles of the size of the tree nodes
+    };
+
+    /**
+     * @brief Open the spatial index, creating its R*Tree virtual table if needed.
+     *
+     * @param[in] aDatabase the SQLite Database Connection, shall outlive the index
+     * @param[in] aName     Name of the R*Tree virtual table
+     *
+     * @throw SQLite::Exception in case of error, or if the R*Tree extension is not available
+     */
+    SpatialIndex(Database& aDatabase, const std::string& aName) :
+        mDatabase(aDatabase),
+        mName(aName)
+    {
+        std::string columns;
+        std::string boxes;
+        std::string intersects;
+        std::string within;
+        std::string contains;
+        for (std::size_t d = 0; d < Dims; ++d)
+        {
+            const std::string min = "min" + std::to_string(d);
+            const std::string max = "max" + std::to_string(d);
+            const std::string minParam = std::to_string(2 * d + 1);
+            const std::string maxParam = std::to_string(2 * d + 2);
+            const std::string separator = (d > 0) ? " AND " : "";
+            columns += ", " + min + ", " + max;
+            intersects += separator + min + " <= ?" + maxParam + " AND " + max + " >= ?" + minParam;
+            within += separator + min + " >= ?" + minParam + " AND " + max + " <= ?" + maxParam;
+            contains += separator + min + " <= ?" + minParam + " AND " + max + " >= ?" + maxParam;
+        }
+        const std::string table = quote(mName);
+        mDatabase.exec("CREATE VIRTUAL TABLE IF NOT EXISTS " + table + " USING rtree(id" + columns + ")");
+        mpInsert.reset(new Statement(mDatabase, "INSERT OR REPLACE INTO " + table + " VALUES (?" +
+                                                repeat(", ?", 2 * Dims) + ")"));
+        mpRemove.reset(new Statement(mDatabase, "DELETE FROM " + table + " WHERE id = ?"));
+        mpGet.reset(new Statement(mDatabase, "SELECT * FROM " + table + " WHERE id = ?"));
+        mpIntersecting.reset(new Statement(mDatabase, "SELECT id FROM " + table + " WHERE " + intersects));
+        mpWithin.reset(new Statement(mDatabase, "SELECT id FROM " + table + " WHERE " + within));
+        mpContaining.reset(new Statement(mDatabase, "SELECT id FROM " + table + " WHERE " + contains));
+        mpCandidates.reset(new Statement(mDatabase, "SELECT * FROM " + table + " WHERE " + intersects));
+    }
+
+    // SpatialIndex is non-copyable
+    SpatialIndex(const SpatialIndex&) = delete;
+    SpatialIndex& operator=(const SpatialIndex&) = delete;
+
+    /// Return a box reduced to a point.
+    static Box point(const Point& aPoint)
+    {
+        return Box{aPoint, aPoint};
+    }
+
+    /**
+     * @brief Insert a box, or replace the box of an existing identifier.
+     *
+     * @throw SQLite::Exception in case of error, like min > max
+     */
+    void insert(const int64_t aId, const Box& aBox)
+    {
+        // INSERT OR REPLACE reports one change either way: look the identifier up to count only the new boxes
+        bool bNew = true;
+        if (mbHasBounds)
+        {
+            mpGet->bind(1, aId);
+            bNew = !mpGet->executeStep();
+            mpGet->reset();
+        }
+        mpInsert->bind(1, aId);
+        for (std::size_t d = 0; d < Dims; ++d)
+        {
+            mpInsert->bind(static_cast<int>(2 * d + 2), aBox.min[d]);
+            mpInsert->bind(static_cast<int>(2 * d + 3), aBox.max[d]);
+        }
+        mpInsert->exec();
+        mpInsert->reset();
+        extendBounds(aBox, bNew);
+    }
+
+    /**
+     * @brief Remove a box.
+     *
+     * @return false if there is no box with this identifier
+     */
+    bool remove(const int64_t aId)
+    {
+        mpRemove->bind(1, aId);
+        const bool bRemoved = (mpRemove->exec() > 0);
+        mpRemove->reset();
+        if (bRemoved && mbHasBounds)
+        {
+            --mCount;
+        }
+        return bRemoved;
+    }
+
+    /**
+     * @brief Get the box of an identifier, as stored (rounded outward to 32 bits floats).
+     *
+     * @return false if there is no box with this identifier
+     */
+    bool get(const int64_t aId, Box& aBox)
+    {
+        mpGet->bind(1, aId);
+        const bool bFound = mpGet->executeStep();
+        if (bFound)
+        {
+            aBox = readBox(*mpGet);
+        }
+        mpGet->reset();
+        return bFound;
+    }
+
+    /// Return the identifiers of the boxes intersecting (or touching) a box.
+    std::vector<int64_t> intersecting(const Box& aBox)
+    {
+        return queryIds(*mpIntersecting, aBox);
+    }
+
+    /// Return the identifiers of the boxes entirely within a box.
+    std::vector<int64_t> within(const Box& aBox)
+    {
+        return queryIds(*mpWithin, aBox);
+    }
+
+    /// Return the identifiers of the boxes entirely containing a box, or a point.
+    std::vector<int64_t> containing(const Box& aBox)
+    {
+        return queryIds(*mpContaining, aBox);
+    }
+
+    /**
+     * @brief Insert many boxes, sorted first so that nearby boxes are inserted together, to get better packed nodes.
+     *
+     * @param[in] aEntries  Boxes to insert
+     * @param[in] aOrder    Sort order
+     * @param[in] aFanout   Number of entries by node of the tree, to size the tiles of the STR order
+     *
+     * @throw SQLite::Exception in case of error; then no box is inserted
+     */
+    void bulkLoad(std::vector<Entry> aEntries, const Order aOrder = Order::Hilbert, const std::size_t aFanout = 50)
+    {
+        if (aOrder == Order::Hilbert)
+        {
+            sortHilbert(aEntries);
+        }
+        else
+        {
+            sortSTR(aEntries.begin(), aEntries.end(), 0, std::max<std::size_t>(aFanout, 2));
+        }
+        Savepoint savepoint(mDatabase, "spatialindex_bulkload");
+        for (const Entry& entry : aEntries)
+        {
+            insert(entry.id, entry.box);
+        }
+        savepoint.release();
+    }
+
+    /**
+     * @brief Find the k nearest boxes of a point, by an incremental search in growing boxes around the point.
+     *
+     * @param[in] aPoint    Point to search around
+     * @param[in] aCount    Number of neighbors to find
+     *
+     * @return identifiers and euclidean distances of the nearest boxes (0 for a box containing the point),
+     *         from the nearest, with less than aCount results only if the index has less boxes
+     */
+    std::vector<std::pair<int64_t, double>> nearest(const Point& aPoint, const std::size_t aCount)
+    {
+        std::vector<std::pair<int64_t, double>> neighbors;
+        if (0 == aCount || !updateBounds())
+        {
+            return neighbors;
+        }
+
+        // Initial radius of a box expected to contain aCount boxes if they were evenly distributed
+        double volume = 1.0;
+        double maxDistance = 0.0;
+        for (std::size_t d = 0; d < Dims; ++d)
+        {
+            const double extent = mBounds.max[d] - mBounds.min[d];
+            volume *= std::max(extent, 1e-9);
+            const double far = std::max(std::abs(aPoint[d] - mBounds.min[d]), std::abs(aPoint[d] - mBounds.max[d]));
+            maxDistance += far * far;
+        }
+        maxDistance = std::sqrt(maxDistance);
+        const double fraction = std::min(1.0, static_cast<double>(aCount) / static_cast<double>(mCount));
+        double radius = std::max(0.5 * std::pow(volume * fraction, 1.0 / Dims), 1e-9);
+
+        while (true)
+        {
+            // All the boxes at a distance <= radius intersect the box of this radius around the point
+            Box search;
+            for (std::size_t d = 0; d < Dims; ++d)
+            {
+                search.min[d] = aPoint[d] - radius;
+                search.max[d] = aPoint[d] + radius;
+            }
+            neighbors.clear();
+            bindBox(*mpCandidates, search);
+            while (mpCandidates->executeStep())
+            {
+                neighbors.emplace_back(mpCandidates->getColumn(0).getInt64(),
+                                       distance(aPoint, readBox(*mpCandidates)));
+            }
+            mpCandidates->reset();
+            std::sort(neighbors.begin(), neighbors.end(),
+                      [](const std::pair<int64_t, double>& aLeft, const std::pair<int64_t, double>& aRight)
+                      {
+                          return (aLeft.second < aRight.second) ||
+                                 (aLeft.second == aRight.second && aLeft.first < aRight.first);
+                      });
+            // The result is exact if the k-th candidate is within the radius, or if all the boxes were searched
+            const bool bComplete = (radius >= maxDistance);
+            if (bComplete || (neighbors.size() >= aCount && neighbors[aCount - 1].second <= radius))
+            {
+                break;
+            }
+            radius *= 2.0;
+        }
+        if (neighbors.size() > aCount)
+        {
+            neighbors.resize(aCount);
+        }
+        return neighbors;
+    }
+
+    /// Return the number of boxes.
+    int64_t size()
+    {
+        return mDatabase.execAndGet("SELECT count(*) FROM " + quote(mName)).getInt64();
+    }
+
+    /// Return the name of the R*Tree virtual table.
+    const std::string& getName() const noexcept
+    {
+        return mName;
+    }
+
+    /**
+     * @brief Return the index of a point on a Hilbert curve filling the space, for aBits bits by dimension.
+     *
+     *  Two points close on the curve are close in the space. Uses the algorithm of John Skilling,
+     *  "Programming the Hilbert curve" (2004), on the coordinates in [0, 2^aBits).
+     */
+    static uint64_t hilbertIndex(std::array<uint32_t, Dims> aCoordinates, const unsigned aBits)
+    {
+        // Inverse undo excess work
+        const uint32_t m = 1u << (aBits - 1);
+        for (uint32_t q = m; q > 1; q >>= 1)
+        {
+            const uint32_t p = q - 1;
+            for (std::size_t i = 0; i < Dims; ++i)
+            {
+                if (aCoordinates[i] & q)
+                {
+                    aCoordinates[0] ^= p; // invert
+                }
+                else
+                {
+                    const uint32_t t = (aCoordinates[0] ^ aCoordinates[i]) & p; // exchange
+                    aCoordinates[0] ^= t;
+                    aCoordinates[i] ^= t;
+                }
+            }
+        }
+        // Gray encode
+        for (std::size_t i = 1; i < Dims; ++i)
+        {
+            aCoordinates[i] ^= aCoordinates[i - 1];
+        }
+        uint32_t t = 0;
+        for (uint32_t q = m; q > 1; q >>= 1)
+        {
+            if (aCoordinates[Dims - 1] & q)
+            {
+                t ^= q - 1;
+            }
+        }
+        for (std::size_t i = 0; i < Dims; ++i)
+        {
+            aCoordinates[i] ^= t;
+        }
+        // Interleave the bits of the transposed index, from the most significant
+        uint64_t index = 0;
+        for (unsigned bit = aBits; bit > 0; --bit)
+        {
+            for (std::size_t i = 0; i < Dims; ++i)
+            {
+                index = (index << 1) | ((aCoordinates[i] >> (bit - 1)) & 1u);
+            }
+        }
+        return index;
+    }
+
+private:
+    using EntryIterator = typename std::vector<Entry>::iterator;
+
+    static std::string repeat(const std::string& aText, const std::size_t aCount)
+    {
+        std::string repeated;
+        for (std::size_t i = 0; i < aCount; ++i)
+        {
+            repeated += aText;
+        }
+        return repeated;
+    }
+
+    static double center(const Box& aBox, const std::size_t aDim)
+    {
+        return 0.5 * (aBox.min[aDim] + aBox.max[aDim]);
+    }
+
+    // Euclidean distance from a point to the nearest point of a box
+    static double distance(const Point& aPoint, const Box& aBox)
+    {
+        double sum = 0.0;
+        for (std::size_t d = 0; d < Dims; ++d)
+        {
+            const double delta = std::max(std::max(aBox.min[d] - aPoint[d], aPoint[d] - aBox.max[d]), 0.0);
+            sum += delta * delta;
+        }
+        return std::sqrt(sum);
+    }
+
+    // Read a box from the columns "id, min0, max0..." of a query
+    static Box readBox(Statement& aQuery)
+    {
+        Box box;
+        for (std::size_t d = 0; d < Dims; ++d)
+        {
+            box.min[d] = aQuery.getColumn(static_cast<int>(2 * d + 1)).getDouble();
+            box.max[d] = aQuery.getColumn(static_cast<int>(2 * d + 2)).getDouble();
+        }
+        return box;
+    }
+
+    // Bind a box to the parameters ?1 (min0), ?2 (max0), ?3 (min1)... of a query
+    static void bindBox(Statement& aQuery, const Box& aBox)
+    {
+        for (std::size_t d = 0; d < Dims; ++d)
+        {
+            aQuery.bind(static_cast<int>(2 * d + 1), aBox.min[d]);
+            aQuery.bind(static_cast<int>(2 * d + 2), aBox.max[d]);
+        }
+    }
+
+    static std::vector<int64_t> queryIds(Statement& aQuery, const Box& aBox)
+    {
+        std::vector<int64_t> ids;
+        bindBox(aQuery, aBox);
+        while (aQuery.executeStep())
+        {
+            ids.push_back(aQuery.getColumn(0).getInt64());
+        }
+        aQuery.reset();
+        return ids;
+    }
+
+    // Sort the entries by the Hilbert index of their centers, in the bounding box of all of them
+    static void sortHilbert(std::vector<Entry>& aEntries)
+    {
+        if (aEntries.empty())
+        {
+            return;
+        }
+        const unsigned bits = static_cast<unsigned>(std::min<std::size_t>(16, 63 / Dims));
+        Point low;
+        Point high;
+        low.fill(std::numeric_limits<double>::max());
+        high.fill(std::numeric_limits<double>::lowest());
+        for (const Entry& entry : aEntries)
+        {
+            for (std::size_t d = 0; d < Dims; ++d)
+            {
+                low[d] = std::min(low[d], center(entry.box, d));
+                high[d] = std::max(high[d], center(entry.box, d));
+            }
+        }
+        const double scale = static_cast<double>((1u << bits) - 1);
+        std::vector<std::pair<uint64_t, std::size_t>> keys;
+        keys.reserve(aEntries.size());
+        for (std::size_t e = 0; e < aEntries.size(); ++e)
+        {
+            std::array<uint32_t, Dims> coordinates;
+            for (std::size_t d = 0; d < Dims; ++d)
+            {
+                const double extent = high[d] - low[d];
+                const double position = (extent > 0.0) ? (center(aEntries[e].box, d) - low[d]) / extent : 0.0;
+                coordinates[d] = static_cast<uint32_t>(position * scale);
+            }
+            keys.emplace_back(hilbertIndex(coordinates, bits), e);
+        }
+        std::sort(keys.begin(), keys.end());
+        std::vector<Entry> sorted;
+        sorted.reserve(aEntries.size());
+        for (const std::pair<uint64_t, std::size_t>& key : keys)
+        {
+            sorted.push_back(aEntries[key.second]);
+        }
+        aEntries.swap(sorted);
+    }
+
+    // Sort-Tile-Recursive: sort along a dimension, cut in slabs, and sort each slab along the next dimensions
+    static void sortSTR(const EntryIterator aBegin, const EntryIterator aEnd, const std::size_t aDim,
+                        const std::size_t aFanout)
+    {
+        std::sort(aBegin, aEnd, [aDim](const Entry& aLeft, const Entry& aRight)
+        {
+            return center(aLeft.box, aDim) < center(aRight.box, aDim);
+        });
+        if (aDim + 1 == Dims)
+        {
+            return;
+        }
+        const std::size_t count = static_cast<std::size_t>(aEnd - aBegin);
+        const std::size_t nbLeaves = (count + aFanout - 1) / aFanout;
+        const std::size_t nbSlabs = static_cast<std::size_t>(
+            std::ceil(std::pow(static_cast<double>(nbLeaves), 1.0 / static_cast<double>(Dims - aDim))));
+        const std::size_t slabSize = aFanout * ((nbLeaves + nbSlabs - 1) / std::max<std::size_t>(nbSlabs, 1));
+        for (std::size_t first = 0; first < count; first += slabSize)
+        {
+            const std::size_t last = std::min(count, first + slabSize);
+            sortSTR(aBegin + static_cast<std::ptrdiff_t>(first), aBegin + static_cast<std::ptrdiff_t>(last),
+                    aDim + 1, aFanout);
+        }
+    }
+
+    // Extend the cached bounds of the index with a box inserted, counting it if it is a new one
+    void extendBounds(const Box& aBox, const bool abNew)
+    {
+        if (mbHasBounds)
+        {
+            for (std::size_t d = 0; d < Dims; ++d)
+            {
+                mBounds.min[d] = std::min(mBounds.min[d], aBox.min[d]);
+                mBounds.max[d] = std::max(mBounds.max[d], aBox.max[d]);
+            }
+            if (abNew)
+            {
+                ++mCount;
+            }
+        }
+    }
+
+    // Compute the bounds of the index on first use; they are then extended by insert(), never reduced by remove().
+    // Boxes inserted by other connections are not accounted for, so they could be missed by nearest().
+    bool updateBounds()
+    {
+        if (!mbHasBounds)
+        {
+            std::string aggregates = "count(*)";
+            for (std::size_t d = 0; d < Dims; ++d)
+            {
+                aggregates += ", min(min" + std::to_string(d) + "), max(max" + std::to_string(d) + ")";
+            }
+            Statement bounds(mDatabase, "SELECT " + aggregates + " FROM " + quote(mName));
+            (void)bounds.executeStep(); // Cannot return false, as the above query always return a result
+            mCount = bounds.getColumn(0).getInt64();
+            if (0 == mCount)
+            {
+                return false;
+            }
+            mBounds = readBox(bounds);
+            mbHasBounds = true;
+        }
+        return mCount > 0;
+    }
+
+    Database&                   mDatabase;              ///< Reference to the SQLite Database Connection
+    std::string                 mName;                  ///< Name of the R*Tree virtual table
+    std::unique_ptr<Statement>  mpInsert;               ///< Insert or replace a box
+    std::unique_ptr<Statement>  mpRemove;               ///< Remove a box
+    std::unique_ptr<Statement>  mpGet;                  ///< Get a box
+    std::unique_ptr<Statement>  mpIntersecting;         ///< Boxes intersecting a box
+    std::unique_ptr<Statement>  mpWithin;               ///< Boxes within a box
+    std::unique_ptr<Statement>  mpContaining;           ///< Boxes containing a box
+    std::unique_ptr<Statement>  mpCandidates;           ///< Boxes and coordinates intersecting a box
+    bool                        mbHasBounds = false;    ///< True when mBounds and mCount are computed
+    Box                         mBounds;                ///< Bounds of all the boxes (may be larger after removals)
+    int64_t                     mCount = 0;             ///< Number of boxes
+};
+
+}  // namespace SQLite
@@ -12,12 +12,14 @@
 
 #include <SQLiteCpp/SQLiteCppExport.h>
 #include <SQLiteCpp/Exception.h>
+#include <SQLiteCpp/QueryPlan.h>
 #include <SQLiteCpp/Utils.h> // SQLITECPP_PURE_FUNC
 
 #include <cstdint>
 #include <string>
-#include <map>
 #include <memory>
+#include <utility>
+#include <vector>
 
 // Forward declarations to avoid inclusion of <sqlite3.h> in a header
 struct sqlite3;
@@ -593,7 +595,7 @@ public:
      *
      * @param[in] apName    Aliased name of the column, that is, the named specified in the query (not the original name)
      *
-     * @note Uses a map of column names to indexes, build on first call.
+     * @note Uses a sorted vector of column names to indexes, build on first call.
      *
      *  Throw an exception if the specified name is not known.
      */
@@ -631,6 +633,15 @@ public:
     // Return a UTF-8 string containing the SQL text of prepared statement with bound parameters expanded.
     std::string getExpandedSQL() const;
 
+    /**
+     * @brief Return the query plan of the statement, from EXPLAIN QUERY PLAN, without executing it.
+     *
+     *  The plan is the one chosen for the SQL text, its parameters being unbound.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    QueryPlan getQueryPlan() const;
+
     /// Return the number of columns in the result set returned by the prepared statement
     int getColumnCount() const
     {
@@ -718,8 +729,8 @@ private:
     bool                    mbHasRow = false;       //!< true when a row has been fetched with executeStep()
     bool                    mbDone = false;         //!< true when the last executeStep() had no more row to fetch
 
-    /// Map of columns index by name (mutable so getColumnIndex can be const)
-    mutable std::map<std::string, int>  mColumnNames;
+    /// Columns index sorted by name, searched without allocation (mutable so getColumnIndex can be const)
+    mutable std::vector<std::pair<std::string, int>>    mColumnNames;
 };
 
 }  // namespace SQLite
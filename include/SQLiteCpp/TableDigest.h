@@ -0,0 +1,159 @@
+/**
+ * @file    TableDigest.h
+ * @ingroup SQLiteCpp
+ * @brief   Merkle tree of the rowid ranges of a table, to compare replicas by the size of their differences.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+#include <SQLiteCpp/Database.h>
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace SQLite
+{
+
+/**
+ * @brief Checksum of a table as a Merkle tree of fixed width rowid ranges.
+ *
+ * Each leaf of the tree is the hash of all the rows of a range of rowids [n * width, (n + 1) * width - 1],
+ * and each node the hash of its two children, so two copies of a table can be compared by their root hash,
+ * and their differences located by descending only in the subtrees that differ:
+ * @code
+ * SQLite::TableDigest local(localDb, "orders");
+ * SQLite::TableDigest remote(replicaDb, "orders");
+ * for (const SQLite::TableDigest::Range& range : SQLite::TableDigest::diff(local, remote))
+ * {
+ *     // copy the rows "WHERE rowid BETWEEN range.first AND range.last" from one copy to the other
+ * }
+ * @endcode
+ *
+ * The leaves are computed by a scan of the table, in parallel threads (using one read-only connection each)
+ * when the database is a file and no transaction is pending.
+ * The digest is then updated incrementally: TEMP triggers mark the leaves of the rows inserted, updated or deleted
+ * through this connection as dirty, and refresh() only rescans the dirty leaves before updating their ancestors.
+ *
+ * @note The hash is a fast 64 bits non-cryptographic hash, meant to detect accidental differences.
+ * @note Changes made by other connections are not seen by the triggers; use markDirty() or compute() for them.
+ * @note The table shall have a rowid (WITHOUT ROWID tables are not supported).
+ *
+ * Thread-safety: a TableDigest object shall not be shared by multiple threads, as its Database connection.
+ */
+class SQLITECPP_API TableDigest
+{
+public:
+    /// Inclusive range of rowids
+    struct Range
+    {
+        int64_t first;  ///< First rowid of the range
+        int64_t last;   ///< Last rowid of the range
+    };
+
+    /**
+     * @brief Compute the digest of a table, and track its changes made through the connection.
+     *
+     * @param[in] aDatabase     the SQLite Database Connection, shall outlive the digest
+     * @param[in] aTable        Name of the table
+     * @param[in] aLeafWidth    Number of rowids of each leaf; shall be the same for the digests to compare
+     * @param[in] aNbThreads    Number of threads of the scan, 0 for the number of hardware threads
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    TableDigest(Database& aDatabase, const std::string& aTable, int64_t aLeafWidth = 4096, unsigned aNbThreads = 0);
+
+    // TableDigest is non-copyable (and non-movable, as its address is registered with the connection)
+    TableDigest(const TableDigest&) = delete;
+    TableDigest& operator=(const TableDigest&) = delete;
+
+    /// Detach the digest from the connection (drop its triggers and SQL function).
+    ~TableDigest();
+
+    /**
+     * @brief Recompute the whole digest from a full scan of the table.
+     *
+     * @param[in] aNbThreads    Number of threads, 0 for the number of hardware threads
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    void compute(unsigned aNbThreads = 0);
+
+    /// Mark the leaf of a rowid as dirty, for a row changed by another connection.
+    void markDirty(int64_t aRowid);
+
+    /// Mark the leaves of a range of rowids as dirty, for rows changed by another connection.
+    void markDirty(const Range& aRange);
+
+    /**
+     * @brief Rescan the dirty leaves and update their ancestors, up to the root.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    void refresh();
+
+    /// Return the hash of the whole table (0 for an empty table), after a refresh() if some leaves are dirty.
+    uint64_t getRootHash();
+
+    /**
+     * @brief Return the ranges of rowids differing between two digests of copies of the same table.
+     *
+     *  Only the subtrees with different hashes are visited, so the cost is proportional to the number of differences.
+     *  Adjacent differing leaves are merged in a single range. Dirty leaves are refreshed first.
+     *
+     * @throw SQLite::Exception if the digests do not have the same leaf width
+     */
+    static std::vector<Range> diff(TableDigest& aLeft, TableDigest& aRight);
+
+    /// Return the number of rowids of each leaf.
+    int64_t getLeafWidth() const noexcept
+    {
+        return mLeafWidth;
+    }
+
+    /// Return the number of non-empty leaves.
+    size_t getLeafCount() const noexcept
+    {
+        return mLevels.empty() ? 0 : mLevels[0].size();
+    }
+
+    /// Return the number of leaves waiting for a refresh().
+    size_t getDirtyCount() const noexcept
+    {
+        return mDirty.size();
+    }
+
+    /// Return the range of rowids of a leaf.
+    Range getLeafRange(int64_t aLeaf) const noexcept;
+
+private:
+    /// Nodes of a level of the tree, by index (only the non-empty ones)
+    using Level = std::map<int64_t, uint64_t>;
+
+    /// Update the parents of the given changed nodes of the lowest level, up to the root.
+    void propagate(std::set<int64_t> aChanged);
+    /// Find the hash of a node, including above the top level of the tree. Return false for an empty node.
+    bool findNode(size_t aLevel, int64_t aIndex, uint64_t& aHash) const;
+    /// Descend in the subtrees differing between two digests, appending the differing leaves.
+    static void diffNode(const TableDigest& aLeft, const TableDigest& aRight, size_t aLevel, int64_t aIndex,
+                         std::vector<Range>& aRanges);
+
+    /// SQL function called by the triggers to mark the leaf of a rowid as dirty.
+    static void markFunction(sqlite3_context* apContext, int aNbArgs, sqlite3_value** apArgs);
+
+    Database&           mDatabase;      ///< Reference to the SQLite Database Connection
+    std::string         mTable;         ///< Name of the table
+    int64_t             mLeafWidth;     ///< Number of rowids of each leaf
+    std::string         mFunctionName;  ///< Name of the SQL function used by the triggers
+    std::vector<Level>  mLevels;        ///< Levels of the tree, from the leaves to the root
+    std::set<int64_t>   mDirty;         ///< Leaves to rescan
+};
+
+}  // namespace SQLite
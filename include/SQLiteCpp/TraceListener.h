@@ -0,0 +1,69 @@
+/**
+ * @file    TraceListener.h
+ * @ingroup SQLiteCpp
+ * @brief   Listener of the sqlite3_trace_v2() events of connections, shared by the instrumentation classes.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+
+// Forward declaration to avoid inclusion of <sqlite3.h> in a header
+struct sqlite3;
+
+namespace SQLite
+{
+
+/**
+ * @brief Listener of the sqlite3_trace_v2() events of connections.
+ *
+ *  A connection has only one trace callback: it dispatches the events to all the listeners subscribed,
+ *  so that a WorkloadRecorder, a QueryPatternDetector... can watch the same connection.
+ *
+ *  The events are dispatched under the mutex of the connection (in serialized mode), in order of subscription.
+ *  A listener shall not subscribe or unsubscribe from within onTrace(), except for the SQLITE_TRACE_CLOSE event,
+ *  after which it is unsubscribed anyway.
+ */
+class SQLITECPP_API TraceListener
+{
+public:
+    virtual ~TraceListener() = default;
+
+    /**
+     * @brief Handle an event of sqlite3_trace_v2().
+     *
+     * @param[in] aEvent    SQLITE_TRACE_STMT, SQLITE_TRACE_PROFILE, SQLITE_TRACE_ROW or SQLITE_TRACE_CLOSE
+     * @param[in] apP       Prepared statement, or connection for SQLITE_TRACE_CLOSE
+     * @param[in] apX       Argument of the event (see sqlite3_trace_v2())
+     */
+    virtual void onTrace(unsigned aEvent, void* apP, void* apX) = 0;
+
+    /**
+     * @brief Subscribe a listener to the trace events of a connection.
+     *
+     * @param[in] apSQLite  Connection to listen to
+     * @param[in] aListener Listener, that shall unsubscribe before its destruction
+     * @param[in] aMask     Events to listen to, a combination of SQLITE_TRACE_STMT, PROFILE, ROW and CLOSE
+     */
+    static void subscribe(sqlite3* apSQLite, TraceListener& aListener, unsigned aMask);
+
+    /// Unsubscribe a listener from the trace events of a connection; no more event is dispatched to it on return.
+    static void unsubscribe(sqlite3* apSQLite, TraceListener& aListener);
+
+    /**
+     * @brief Tell if a SQLITE_TRACE_STMT event starts a trigger of a running statement, rather than the statement.
+     *
+     *  A statement starting with a comment is not a trigger: only the text of the event is compared
+     *  to the SQL text of the statement.
+     *
+     * @param[in] apP   Prepared statement of the event
+     * @param[in] apX   Text of the event
+     */
+    static bool isTrigger(void* apP, void* apX);
+};
+
+}  // namespace SQLite
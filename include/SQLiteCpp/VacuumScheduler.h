@@ -0,0 +1,152 @@
+/**
+ * @file    VacuumScheduler.h
+ * @ingroup SQLiteCpp
+ * @brief   Release the free pages of a database in small time-sliced batches, with incremental vacuum.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+#include <SQLiteCpp/Database.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace SQLite
+{
+
+/**
+ * @brief Incremental alternative to VACUUM, for databases in "auto_vacuum = INCREMENTAL" mode.
+ *
+ * A full VACUUM rewrites the whole file and blocks the writers during all that time.
+ * With "auto_vacuum = INCREMENTAL", the free pages can instead be moved to the end of the file and truncated
+ * by small batches with "PRAGMA incremental_vacuum(N)", each one in its own short write transaction.
+ * @code
+ * SQLite::VacuumScheduler vacuum(db);
+ * vacuum.convert();   // One-time full VACUUM, if the database is not in INCREMENTAL mode yet
+ * ...
+ * // When the application is idle:
+ * vacuum.run(std::chrono::milliseconds(20));
+ * @endcode
+ *
+ * A run stops as soon as another connection holds the write lock (after the busy timeout of the connection),
+ * so that it does not delay the writers more than a batch.
+ *
+ * @note Incremental vacuum releases free pages but does not defragment the tables and indexes like VACUUM does.
+ *
+ * Thread-safety: a VacuumScheduler object shall not be shared by multiple threads, as its Database connection.
+ */
+class SQLITECPP_API VacuumScheduler
+{
+public:
+    /// Cumulated metrics of the runs
+    struct Metrics
+    {
+        int64_t                     runs = 0;           ///< Number of calls to run() doing some work
+        int64_t                     batches = 0;        ///< Number of "PRAGMA incremental_vacuum" batches executed
+        int64_t                     pagesReleased = 0;  ///< Number of free pages released to the file system
+        int64_t                     busy = 0;           ///< Number of runs interrupted because the database was locked
+        std::chrono::microseconds   duration{0};        ///< Total time spent in the runs
+        int64_t                     freePages = 0;      ///< Number of free pages at the end of the last run
+    };
+
+    /**
+     * @brief Schedule the incremental vacuum of a database.
+     *
+     * @param[in] aDatabase the SQLite Database Connection, shall outlive the scheduler
+     * @param[in] aSchema   Name of the database: "main", "temp" or the name of an attached database
+     */
+    explicit VacuumScheduler(Database& aDatabase, const std::string& aSchema = "main");
+
+    /**
+     * @brief Return true if the database is in "auto_vacuum = INCREMENTAL" mode.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    bool isIncremental() const;
+
+    /**
+     * @brief Convert the database to "auto_vacuum = INCREMENTAL", as a one-time operation.
+     *
+     *  Requires a full VACUUM of the database if it was in "auto_vacuum = NONE" mode,
+     *  so it shall not be called in a transaction.
+     *
+     * @return false if the database was already in "auto_vacuum = INCREMENTAL" mode
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    bool convert();
+
+    /**
+     * @brief Return the number of free pages of the database.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    int64_t getFreePages() const;
+
+    /**
+     * @brief Return true if there are enough free pages for a run to do some work.
+     *
+     * @throw SQLite::Exception in case of error
+     */
+    bool isNeeded() const;
+
+    /**
+     * @brief Release free pages by batches, until there is none left or the time budget is exhausted.
+     *
+     *  Does nothing if there are less than getMinFreePages() free pages. Otherwise, executes at least one batch,
+     *  so the budget can be exceeded by the duration of a batch.
+     *
+     * @param[in] aBudget   Time budget of the run
+     *
+     * @return Number of pages released
+     *
+     * @throw SQLite::Exception in case of error (but not if the database is locked),
+     *                          or if the database is not in "auto_vacuum = INCREMENTAL" mode
+     */
+    int64_t run(std::chrono::milliseconds aBudget);
+
+    /// Set the number of pages released by each batch, in its own write transaction (256 by default).
+    void setBatchPages(int aBatchPages) noexcept
+    {
+        mBatchPages = aBatchPages;
+    }
+
+    /// Return the number of pages released by each batch.
+    int getBatchPages() const noexcept
+    {
+        return mBatchPages;
+    }
+
+    /// Set the minimum number of free pages for a run to do some work (64 by default).
+    void setMinFreePages(int64_t aMinFreePages) noexcept
+    {
+        mMinFreePages = aMinFreePages;
+    }
+
+    /// Return the minimum number of free pages for a run to do some work.
+    int64_t getMinFreePages() const noexcept
+    {
+        return mMinFreePages;
+    }
+
+    /// Return the cumulated metrics of the runs.
+    const Metrics& getMetrics() const noexcept
+    {
+        return mMetrics;
+    }
+
+private:
+    Database&   mDatabase;          ///< Reference to the SQLite Database Connection
+    std::string mSchema;            ///< Quoted name of the database
+    int         mBatchPages = 256;  ///< Number of pages released by each batch
+    int64_t     mMinFreePages = 64; ///< Minimum number of free pages for a run to do some work
+    Metrics     mMetrics;           ///< Cumulated metrics of the runs
+};
+
+}  // namespace SQLite
@@ -0,0 +1,186 @@
+/**
+ * @file    WorkloadRecorder.h
+ * @ingroup SQLiteCpp
+ * @brief   Record the statements executed on database connections to a compact binary log, to replay them later.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+#include <SQLiteCpp/Database.h>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Forward declarations to avoid inclusion of <sqlite3.h> in a header
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace SQLite
+{
+
+/**
+ * @brief Content of a workload log written by a WorkloadRecorder.
+ */
+struct SQLITECPP_API WorkloadLog
+{
+    /// Value bound to a parameter of a statement
+    struct Parameter
+    {
+        int         index = 0;      ///< Index of the parameter, starting at 1
+        int         type = 0;       ///< SQLite fundamental type: SQLite::INTEGER, FLOAT, TEXT, BLOB or Null
+        int64_t     integer = 0;    ///< Value of an INTEGER
+        double      real = 0.0;     ///< Value of a FLOAT
+        std::string bytes;          ///< Value of a TEXT or a BLOB
+    };
+
+    /// Execution of a statement, from its first step to its reset, its completion or its finalization
+    struct Execution
+    {
+        uint32_t                connection = 0; ///< Index of the connection in connections
+        uint32_t                thread = 0;     ///< Number of the thread, in order of first execution
+        uint32_t                sql = 0;        ///< Index of the SQL text in sql
+        int64_t                 start = 0;      ///< Start time in nanoseconds, since the start of the recording
+        int64_t                 duration = 0;   ///< Duration in nanoseconds
+        int64_t                 rows = 0;       ///< Number of rows stepped through
+        bool                    bDone = false;  ///< true if the statement ran to completion
+        std::vector<Parameter>  parameters;     ///< Values bound to the parameters, by index
+    };
+
+    std::vector<std::string>    connections;    ///< Filename of each database connection recorded
+    std::vector<std::string>    sql;            ///< SQL text of each distinct statement prepared
+    std::vector<Execution>      executions;     ///< Executions of the statements, by start time
+
+    /**
+     * @brief Read a workload log.
+     *
+     * @throw SQLite::Exception if the file cannot be read or is not a valid workload log
+     */
+    static WorkloadLog read(const std::string& aFilename);
+};
+
+/**
+ * @brief Record the statements executed on database connections to a compact binary log.
+ *
+ *  Each execution of a statement is logged with its SQL text, the values bound to its parameters,
+ *  the number of rows stepped through, its start time, its duration and the thread executing it.
+ *  The executions are traced with sqlite3_trace_v2(), so this includes Database::exec(),
+ *  and the values bound are reported by the Statement::bind() methods of the statements.
+ *  Values bound directly with the sqlite3 C API are not recorded.
+ *
+ *  The log is then read with WorkloadLog::read() and replayed with WorkloadReplayer,
+ *  or with the sqlitecpp-replay tool (SQLITECPP_BUILD_TOOLS), to test pragmas, indexes
+ *  or library upgrades against real traffic:
+ * @code
+ * SQLite::WorkloadRecorder recorder("app.workload");
+ * recorder.attach(db);
+ * ... production workload ...
+ * recorder.detach(db);
+ * @endcode
+ *
+ *  Thread-safety: the recording is thread-safe. A connection can only be attached to one recorder at a time;
+ *  the trace events are shared with any other TraceListener. When no connection is recorded,
+ *  the overhead of the Statement instrumentation is a check of an atomic counter by bind.
+ */
+class SQLITECPP_API WorkloadRecorder
+{
+public:
+    /**
+     * @brief Create the log file.
+     *
+     * @param[in] aFilename Path of the log file, replaced if it exists
+     *
+     * @throw SQLite::Exception if the file cannot be created
+     */
+    explicit WorkloadRecorder(const std::string& aFilename);
+
+    /// Detach all the connections, and close the log file.
+    ~WorkloadRecorder();
+
+    // WorkloadRecorder is non-copyable
+    WorkloadRecorder(const WorkloadRecorder&) = delete;
+    WorkloadRecorder& operator=(const WorkloadRecorder&) = delete;
+
+    /**
+     * @brief Start recording the statements executed on a database connection.
+     *
+     * @throw SQLite::Exception if the connection is already recorded
+     */
+    void attach(const Database& aDatabase);
+
+    /// Stop recording the statements executed on a database connection; the executions in progress are lost.
+    void detach(const Database& aDatabase);
+
+    /// Write the buffered records to the log file.
+    void flush();
+
+    /// Return the number of executions recorded so far.
+    int64_t getExecutionCount() const;
+
+    /// Record a value bound to a statement parameter (called by the Statement::bind() methods).
+    static void recordBind(sqlite3_stmt* apStmt, int aIndex, int64_t aValue);
+    static void recordBind(sqlite3_stmt* apStmt, int aIndex, double aValue);
+    static void recordBind(sqlite3_stmt* apStmt, int aIndex, int aType, const void* apValue, int aSize);
+    static void recordBind(sqlite3_stmt* apStmt, int aIndex);
+
+    /// Forget the values bound to a statement (called by Statement::clearBindings() and at its finalization).
+    static void recordClearBindings(sqlite3_stmt* apStmt);
+
+    /// State of a recorded connection, listening to its trace events
+    struct Connection;
+
+    /// Handle an event of sqlite3_trace_v2() on a recorded connection.
+    void trace(Connection& aConnection, unsigned aEvent, void* apP);
+
+private:
+    // Return the number of the current thread
+    uint32_t getThread();
+    // Return the index of a SQL text, writing it to the log on first use
+    uint32_t getSql(const char* apSql);
+    // Record a value bound to a parameter of a statement of a recorded connection
+    void bind(const Connection& aConnection, sqlite3_stmt* apStmt, const WorkloadLog::Parameter& aParameter);
+    // Forget the values bound to a statement
+    void clearBindings(sqlite3_stmt* apStmt);
+    // Forget the state of the statements of a connection no longer recorded
+    void forget(const Connection& aConnection);
+    // Write a record of an execution to the log
+    void writeExecution(const WorkloadLog::Execution& aExecution);
+
+    /// Values bound to the parameters of a statement
+    struct Bindings
+    {
+        uint32_t                                connection = 0; ///< Index of the connection of the statement
+        std::vector<WorkloadLog::Parameter>     parameters;     ///< Values bound, by index
+    };
+
+    /// Execution in progress of a statement
+    struct Running
+    {
+        WorkloadLog::Execution                  execution;  ///< Execution recorded
+        std::chrono::steady_clock::time_point   start;      ///< Start time
+    };
+
+    mutable std::mutex                                      mMutex;         ///< Protects all the state below
+    std::ofstream                                           mFile;          ///< Log file
+    std::chrono::steady_clock::time_point                   mStart;         ///< Start of the recording
+    std::vector<std::unique_ptr<Connection>>                mConnections;   ///< Connections recorded
+    std::map<std::thread::id, uint32_t>                     mThreads;       ///< Number of each thread
+    std::unordered_map<std::string, uint32_t>               mSql;           ///< Index of each SQL text
+    std::map<sqlite3_stmt*, Bindings>                       mBindings;      ///< Values bound to each statement
+    std::map<sqlite3_stmt*, Running>                        mRunning;       ///< Executions in progress
+    int64_t                                                 mExecutions = 0; ///< Number of executions recorded
+};
+
+}  // namespace SQLite
@@ -0,0 +1,110 @@
+/**
+ * @file    WorkloadReplayer.h
+ * @ingroup SQLiteCpp
+ * @brief   Replay a workload log recorded by a WorkloadRecorder against a copy of the database.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/SQLiteCppExport.h>
+#include <SQLiteCpp/WorkloadRecorder.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SQLite
+{
+
+/**
+ * @brief Options of WorkloadReplayer::replay()
+ */
+struct ReplayOptions
+{
+    /// Speed of the replay relative to the recording: 1 for the original timing, 2 twice as fast,
+    /// 0 as fast as possible (no wait between the executions)
+    double                      speed = 0.0;
+    /// Number of connections replaying the workload, each one in its own thread; 0 for one by session,
+    /// a session being the executions of a recorded connection. The sessions are distributed round-robin
+    /// on the connections; the transactions of the sessions sharing a connection are then replayed as a whole,
+    /// in the order of their ends, so that they never interleave.
+    unsigned                    concurrency = 0;
+    /// SQL executed on each connection before the replay, like "PRAGMA cache_size = -65536"
+    std::vector<std::string>    setup;
+    /// Busy timeout of the connections, in milliseconds
+    int                         busyTimeoutMs = 5000;
+};
+
+/**
+ * @brief Result of WorkloadReplayer::replay()
+ */
+struct ReplayReport
+{
+    /// Executions of a statement, recorded and replayed
+    struct Query
+    {
+        std::string sql;                ///< SQL text
+        int64_t     executions = 0;     ///< Number of executions replayed
+        int64_t     errors = 0;         ///< Number of executions failed
+        int64_t     recordedNs = 0;     ///< Total duration of the executions when recorded, in nanoseconds
+        int64_t     replayedNs = 0;     ///< Total duration of the executions replayed, in nanoseconds
+    };
+
+    std::vector<Query>          queries;            ///< Statistics by SQL text, in the order of the log
+    int64_t                     executions = 0;     ///< Number of executions replayed
+    int64_t                     errors = 0;         ///< Number of executions failed
+    int64_t                     durationNs = 0;     ///< Wall-clock duration of the replay, in nanoseconds
+    unsigned                    connections = 0;    ///< Number of connections used
+    std::vector<std::string>    errorMessages;      ///< First distinct error messages
+};
+
+/**
+ * @brief Replay a workload log recorded by a WorkloadRecorder against a copy of the database.
+ *
+ *  Each execution is replayed with the same SQL text, the same values bound to its parameters,
+ *  and stepped through the same number of rows (or up to its completion). The statements
+ *  are prepared once by connection. A failed execution is counted and the replay goes on.
+ *
+ *  The replay modifies the database: run it against a copy, like one made by Database::cloneTo(),
+ *  and with the same data as at the start of the recording for a faithful replay.
+ * @code
+ * SQLite::Database("app.db3").cloneTo("replay.db3");
+ * SQLite::ReplayOptions options;
+ * options.setup.push_back("PRAGMA mmap_size = 268435456");
+ * const SQLite::ReplayReport report = SQLite::WorkloadReplayer(SQLite::WorkloadLog::read("app.workload"))
+ *                                         .replay("replay.db3", options);
+ * @endcode
+ */
+class SQLITECPP_API WorkloadReplayer
+{
+public:
+    /// Replay a workload log
+    explicit WorkloadReplayer(WorkloadLog aLog);
+
+    /**
+     * @brief Replay the workload against a database.
+     *
+     * @param[in] aFilename Database to replay the workload against, opened by each connection in read/write mode
+     * @param[in] aOptions  Speed, concurrency and setup of the connections
+     *
+     * @return Statistics of the executions replayed, by statement
+     *
+     * @throw SQLite::Exception if a connection cannot be opened or set up
+     */
+    ReplayReport replay(const std::string& aFilename, const ReplayOptions& aOptions = ReplayOptions()) const;
+
+    /// Return the workload log replayed
+    const WorkloadLog& getLog() const noexcept
+    {
+        return mLog;
+    }
+
+private:
+    WorkloadLog mLog;   ///< Workload log replayed
+};
+
+}  // namespace SQLite
@@ -0,0 +1,588 @@
+/**
+ * @file    BlobStore.cpp
+ * @ingroup SQLiteCpp
+ * @brief   Content-addressed store of large objects, deduplicated by chunks.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/BlobStore.h>
+
+#include <SQLiteCpp/Quote.h>
+#include <SQLiteCpp/Savepoint.h>
+#include <SQLiteCpp/Statement.h>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <array>
+#include <istream>
+
+namespace SQLite
+{
+
+namespace
+{
+
+// SHA-256, as specified by FIPS 180-4
+class Sha256
+{
+public:
+    static std::array<unsigned char, 32> hash(const unsigned char* apData, const size_t aSize) noexcept
+    {
+        uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                             0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+        size_t i = 0;
+        for (; i + 64 <= aSize; i += 64)
+        {
+            transform(state, apData + i);
+        }
+        // Padding: a 1 bit, zeros, then the size in bits, as big endian
+        unsigned char last[128] = {0};
+        const size_t remaining = aSize - i;
+        std::copy(apData + i, apData + aSize, last);
+        last[remaining] = 0x80;
+        const size_t nbLast = (remaining < 56) ? 64 : 128;
+        const uint64_t nbBits = static_cast<uint64_t>(aSize) * 8;
+        for (size_t b = 0; b < 8; ++b)
+        {
+            last[nbLast - 1 - b] = static_cast<unsigned char>(nbBits >> (8 * b));
+        }
+        for (size_t b = 0; b < nbLast; b += 64)
+        {
+            transform(state, last + b);
+        }
+
+        std::array<unsigned char, 32> digest;
+        for (size_t w = 0; w < 8; ++w)
+        {
+            for (size_t b = 0; b < 4; ++b)
+            {
+                digest[w * 4 + b] = static_cast<unsigned char>(state[w] >> (24 - 8 * b));
+            }
+        }
+        return digest;
+    }
+
+private:
+    static uint32_t rotr(const uint32_t aValue, const unsigned aBits) noexcept
+    {
+        return (aValue >> aBits) | (aValue << (32 - aBits));
+    }
+
+    static void transform(uint32_t* apState, const unsigned char* apBlock) noexcept
+    {
+        static const uint32_t K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+        uint32_t w[64];
+        for (size_t i = 0; i < 16; ++i)
+        {
+            w[i] = (static_cast<uint32_t>(apBlock[i * 4]) << 24) | (static_cast<uint32_t>(apBlock[i * 4 + 1]) << 16) |
+                   (static_cast<uint32_t>(apBlock[i * 4 + 2]) << 8) | static_cast<uint32_t>(apBlock[i * 4 + 3]);
+        }
+        for (size_t i = 16; i < 64; ++i)
+        {
+            const uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = apState[0], b = apState[1], c = apState[2], d = apState[3];
+        uint32_t e = apState[4], f = apState[5], g = apState[6], h = apState[7];
+        for (size_t i = 0; i < 64; ++i)
+        {
+            const uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            const uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        apState[0] += a;
+        apState[1] += b;
+        apState[2] += c;
+        apState[3] += d;
+        apState[4] += e;
+        apState[5] += f;
+        apState[6] += g;
+        apState[7] += h;
+    }
+};
+
+// Random values of the "gear" rolling hash, from a fixed seed so that the chunk boundaries never change
+const std::array<uint64_t, 256>& getGear()
+{
+    static const std::array<uint64_t, 256> gear = []()
+    {
+        std::array<uint64_t, 256> values;
+        uint64_t seed = 0x5d6b3a1c2f4e8d97ULL;
+        for (uint64_t& value : values)
+        {
+            // SplitMix64
+            seed += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            value = z ^ (z >> 31);
+        }
+        return values;
+    }();
+    return gear;
+}
+
+// Mask of the highest bits of the gear hash, which depend on the last 64 bytes
+uint64_t highBits(const unsigned aNbBits) noexcept
+{
+    return (aNbBits >= 64) ? ~0ULL : (((1ULL << aNbBits) - 1) << (64 - aNbBits));
+}
+
+} // namespace
+
+// Open the store, creating its tables if needed.
+BlobStore::BlobStore(Database& aDatabase, const std::string& aPrefix /* = "blobstore" */,
+                     const size_t aMinChunkSize /* = 2048 */, const size_t aAvgChunkSize /* = 8192 */,
+                     const size_t aMaxChunkSize /* = 65536 */) :
+    mDatabase(aDatabase),
+    mPrefix(aPrefix),
+    mMinChunkSize(aMinChunkSize),
+    mMaxChunkSize(aMaxChunkSize)
+{
+    if (!(0 < aMinChunkSize && aMinChunkSize < aAvgChunkSize && aAvgChunkSize < aMaxChunkSize &&
+          aMaxChunkSize <= 0x7fffffff))
+    {
+        throw SQLite::Exception("Chunk sizes shall be 0 < min < avg < max < 2GB.");
+    }
+
+    // Normalized chunking: a cut is harder before the average size and easier after it
+    unsigned nbBits = 0;
+    while ((static_cast<size_t>(2) << nbBits) <= aAvgChunkSize)
+    {
+        ++nbBits;
+    }
+    mAvgChunkSize = static_cast<size_t>(1) << nbBits;
+    mMaskSmall = highBits(nbBits + 1);
+    mMaskLarge = highBits(nbBits > 1 ? nbBits - 1 : 1);
+
+    const std::string index = quote(mPrefix + "_index");
+    const std::string chunks = quote(mPrefix + "_chunks");
+    const std::string objects = quote(mPrefix + "_objects");
+    const std::string links = quote(mPrefix + "_object_chunks");
+    mDatabase.exec("CREATE TABLE IF NOT EXISTS " + chunks + " (id INTEGER PRIMARY KEY, data BLOB NOT NULL);"
+                   "CREATE TABLE IF NOT EXISTS " + index + " (hash BLOB PRIMARY KEY, chunk INTEGER NOT NULL, "
+                   "size INTEGER NOT NULL, refs INTEGER NOT NULL) WITHOUT ROWID;"
+                   "CREATE TABLE IF NOT EXISTS " + objects + " (id INTEGER PRIMARY KEY, name TEXT UNIQUE, "
+                   "size INTEGER NOT NULL);"
+                   "CREATE TABLE IF NOT EXISTS " + links + " (object INTEGER NOT NULL, seq INTEGER NOT NULL, "
+                   "hash BLOB NOT NULL, chunk INTEGER NOT NULL, PRIMARY KEY (object, seq)) WITHOUT ROWID");
+
+    mpFindChunk.reset(new Statement(mDatabase, "SELECT chunk FROM " + index + " WHERE hash = ?"));
+    mpAddRef.reset(new Statement(mDatabase, "UPDATE " + index + " SET refs = refs + 1 WHERE hash = ?"));
+    mpInsertData.reset(new Statement(mDatabase, "INSERT INTO " + chunks + " (data) VALUES (?)"));
+    mpInsertIndex.reset(new Statement(mDatabase, "INSERT INTO " + index + " VALUES (?, ?, ?, 1)"));
+    mpInsertLink.reset(new Statement(mDatabase, "INSERT INTO " + links + " VALUES (?, ?, ?, ?)"));
+}
+
+// Finalize the prepared statements before the connection can be closed.
+BlobStore::~BlobStore() = default;
+
+// Start writing an object, replacing any previous object of the same name on commit.
+BlobStore::Writer BlobStore::create(const std::string& aName)
+{
+    return Writer(*this, aName);
+}
+
+// Store an object, replacing any previous object of the same name.
+void BlobStore::put(const std::string& aName, const void* apData, const size_t aSize)
+{
+    Writer writer(*this, aName);
+    writer.write(apData, aSize);
+    writer.commit();
+}
+
+// Store an object, replacing any previous object of the same name.
+void BlobStore::put(const std::string& aName, std::istream& aStream)
+{
+    Writer writer(*this, aName);
+    std::vector<char> buffer(mMaxChunkSize);
+    while (aStream)
+    {
+        aStream.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        writer.write(buffer.data(), static_cast<size_t>(aStream.gcount()));
+    }
+    if (aStream.bad())
+    {
+        throw SQLite::Exception("Error reading the stream of " + aName);
+    }
+    writer.commit();
+}
+
+// Open an object for reading.
+BlobStore::Reader BlobStore::open(const std::string& aName)
+{
+    Statement object(mDatabase, "SELECT id, size FROM " + quote(mPrefix + "_objects") + " WHERE name = ?");
+    object.bind(1, aName);
+    if (!object.executeStep())
+    {
+        throw SQLite::Exception("No such object " + aName);
+    }
+    Statement links(mDatabase, "SELECT chunk FROM " + quote(mPrefix + "_object_chunks") +
+                               " WHERE object = ? ORDER BY seq");
+    links.bind(1, object.getColumn(0).getInt64());
+    std::vector<int64_t> chunks;
+    while (links.executeStep())
+    {
+        chunks.push_back(links.getColumn(0).getInt64());
+    }
+    return Reader(mDatabase, mPrefix + "_chunks", std::move(chunks), object.getColumn(1).getInt64());
+}
+
+// Read a whole object in memory.
+std::string BlobStore::get(const std::string& aName)
+{
+    Reader reader = open(aName);
+    std::string data(static_cast<size_t>(reader.getSize()), '\0');
+    if (!data.empty())
+    {
+        data.resize(reader.read(&data[0], data.size()));
+    }
+    return data;
+}
+
+// Test if an object exists.
+bool BlobStore::exists(const std::string& aName)
+{
+    Statement object(mDatabase, "SELECT 1 FROM " + quote(mPrefix + "_objects") + " WHERE name = ?");
+    object.bind(1, aName);
+    return object.executeStep();
+}
+
+// Remove an object, and the chunks no longer used by any object.
+bool BlobStore::remove(const std::string& aName)
+{
+    Statement object(mDatabase, "SELECT id FROM " + quote(mPrefix + "_objects") + " WHERE name = ?");
+    object.bind(1, aName);
+    if (!object.executeStep())
+    {
+        return false;
+    }
+    const int64_t id = object.getColumn(0).getInt64();
+    object.reset();
+
+    Savepoint savepoint(mDatabase, "blobstore_remove");
+    removeObject(id);
+    savepoint.release();
+    return true;
+}
+
+// Return the statistics of the store, to measure the deduplication.
+BlobStore::Stats BlobStore::getStats()
+{
+    Stats stats;
+    Statement objects(mDatabase, "SELECT count(*), coalesce(sum(size), 0) FROM " + quote(mPrefix + "_objects") +
+                                 " WHERE name IS NOT NULL");
+    (void)objects.executeStep(); // Cannot return false, as the above query always return a result
+    stats.nbObjects = objects.getColumn(0).getInt64();
+    stats.logicalBytes = objects.getColumn(1).getInt64();
+    Statement chunks(mDatabase, "SELECT count(*), coalesce(sum(size), 0) FROM " + quote(mPrefix + "_index"));
+    (void)chunks.executeStep(); // Cannot return false, as the above query always return a result
+    stats.nbChunks = chunks.getColumn(0).getInt64();
+    stats.storedBytes = chunks.getColumn(1).getInt64();
+    return stats;
+}
+
+// Compute the content-defined chunk boundaries of some data, as the store does.
+std::vector<size_t> BlobStore::split(const void* apData, size_t aSize) const
+{
+    std::vector<size_t> sizes;
+    const unsigned char* pData = static_cast<const unsigned char*>(apData);
+    while (aSize > 0)
+    {
+        const size_t cut = findCut(pData, aSize);
+        sizes.push_back(cut);
+        pData += cut;
+        aSize -= cut;
+    }
+    return sizes;
+}
+
+// Return the size of the first chunk of the data, or aSize if all of it is the last chunk (FastCDC).
+size_t BlobStore::findCut(const unsigned char* apData, size_t aSize) const noexcept
+{
+    if (aSize <= mMinChunkSize)
+    {
+        return aSize;
+    }
+    if (aSize > mMaxChunkSize)
+    {
+        aSize = mMaxChunkSize;
+    }
+    const size_t normalSize = std::min(mAvgChunkSize, aSize);
+    const std::array<uint64_t, 256>& gear = getGear();
+    uint64_t hash = 0;
+    size_t i = mMinChunkSize;
+    for (; i < normalSize; ++i)
+    {
+        hash = (hash << 1) + gear[apData[i]];
+        if (0 == (hash & mMaskSmall))
+        {
+            return i + 1;
+        }
+    }
+    for (; i < aSize; ++i)
+    {
+        hash = (hash << 1) + gear[apData[i]];
+        if (0 == (hash & mMaskLarge))
+        {
+            return i + 1;
+        }
+    }
+    return aSize;
+}
+
+// Store a chunk if it is new, else add a reference to it, and append it to an object.
+void BlobStore::storeChunk(const int64_t aObjectId, const int64_t aSeq, const unsigned char* apData,
+                           const size_t aSize)
+{
+    const std::array<unsigned char, 32> hash = Sha256::hash(apData, aSize);
+    const int hashSize = static_cast<int>(hash.size());
+
+    int64_t chunk;
+    mpFindChunk->bindNoCopy(1, hash.data(), hashSize);
+    if (mpFindChunk->executeStep())
+    {
+        // Duplicated content: nothing more to write than a reference
+        chunk = mpFindChunk->getColumn(0).getInt64();
+        mpFindChunk->reset();
+        mpAddRef->bindNoCopy(1, hash.data(), hashSize);
+        mpAddRef->exec();
+        mpAddRef->reset();
+    }
+    else
+    {
+        mpFindChunk->reset();
+        mpInsertData->bindNoCopy(1, apData, static_cast<int>(aSize));
+        mpInsertData->exec();
+        mpInsertData->reset();
+        chunk = mDatabase.getLastInsertRowid();
+        mpInsertIndex->bindNoCopy(1, hash.data(), hashSize);
+        mpInsertIndex->bind(2, chunk);
+        mpInsertIndex->bind(3, static_cast<int64_t>(aSize));
+        mpInsertIndex->exec();
+        mpInsertIndex->reset();
+    }
+
+    mpInsertLink->bind(1, aObjectId);
+    mpInsertLink->bind(2, aSeq);
+    mpInsertLink->bindNoCopy(3, hash.data(), hashSize);
+    mpInsertLink->bind(4, chunk);
+    mpInsertLink->exec();
+    mpInsertLink->reset();
+}
+
+// Remove an object by id, releasing its chunks.
+void BlobStore::removeObject(const int64_t aObjectId)
+{
+    const std::string index = quote(mPrefix + "_index");
+    const std::string links = quote(mPrefix + "_object_chunks");
+    const std::string id = std::to_string(aObjectId);
+    mDatabase.exec("UPDATE " + index + " SET refs = refs - (SELECT count(*) FROM " + links +
+                   " WHERE object = " + id + " AND " + links + ".hash = " + index + ".hash) "
+                   "WHERE hash IN (SELECT hash FROM " + links + " WHERE object = " + id + ")");
+    mDatabase.exec("DELETE FROM " + quote(mPrefix + "_chunks") + " WHERE id IN (SELECT chunk FROM " + index +
+                   " WHERE refs <= 0)");
+    mDatabase.exec("DELETE FROM " + index + " WHERE refs <= 0");
+    mDatabase.exec("DELETE FROM " + links + " WHERE object = " + id);
+    mDatabase.exec("DELETE FROM " + quote(mPrefix + "_objects") + " WHERE id = " + id);
+}
+
+// Start a new object in a savepoint; it is anonymous until commit().
+BlobStore::Writer::Writer(BlobStore& aStore, const std::string& aName) :
+    mpStore(&aStore),
+    mName(aName)
+{
+    // The savepoint of a second writer would be nested in the first one, and released or rolled back with it
+    if (aStore.mbWriting)
+    {
+        throw SQLite::Exception("Another writer is open on the blob store.");
+    }
+    mpSavepoint.reset(new Savepoint(aStore.mDatabase, "blobstore_writer"));
+    aStore.mbWriting = true;
+    aStore.mDatabase.exec("INSERT INTO " + quote(aStore.mPrefix + "_objects") + " (name, size) VALUES (NULL, 0)");
+    mObjectId = aStore.mDatabase.getLastInsertRowid();
+    mBuffer.reserve(aStore.mMaxChunkSize * 2);
+}
+
+BlobStore::Writer::Writer(Writer&& aOther) noexcept :
+    mpStore(aOther.mpStore),
+    mName(std::move(aOther.mName)),
+    mpSavepoint(std::move(aOther.mpSavepoint)),
+    mObjectId(aOther.mObjectId),
+    mSize(aOther.mSize),
+    mNbChunks(aOther.mNbChunks),
+    mBuffer(std::move(aOther.mBuffer))
+{
+    aOther.mpStore = nullptr;
+}
+
+// Roll back the object if it has not been committed.
+BlobStore::Writer::~Writer()
+{
+    if (mpSavepoint)
+    {
+        mpSavepoint.reset();
+        mpStore->mbWriting = false;
+    }
+}
+
+// Append data to the object, storing the chunks already complete.
+void BlobStore::Writer::write(const void* apData, const size_t aSize)
+{
+    if (!mpSavepoint)
+    {
+        throw SQLite::Exception("Object already committed.");
+    }
+    const unsigned char* pData = static_cast<const unsigned char*>(apData);
+    mBuffer.insert(mBuffer.end(), pData, pData + aSize);
+    mSize += static_cast<int64_t>(aSize);
+    if (mBuffer.size() >= 2 * mpStore->mMaxChunkSize)
+    {
+        flush(false);
+    }
+}
+
+// Store the last chunk and the object, replacing any previous object of the same name.
+void BlobStore::Writer::commit()
+{
+    if (!mpSavepoint)
+    {
+        throw SQLite::Exception("Object already committed.");
+    }
+    flush(true);
+
+    Database& database = mpStore->mDatabase;
+    const std::string objects = quote(mpStore->mPrefix + "_objects");
+    Statement previous(database, "SELECT id FROM " + objects + " WHERE name = ?");
+    previous.bind(1, mName);
+    if (previous.executeStep())
+    {
+        const int64_t id = previous.getColumn(0).getInt64();
+        previous.reset();
+        mpStore->removeObject(id);
+    }
+    Statement name(database, "UPDATE " + objects + " SET name = ?, size = ? WHERE id = ?");
+    name.bind(1, mName);
+    name.bind(2, mSize);
+    name.bind(3, mObjectId);
+    name.exec();
+
+    mpSavepoint->release();
+    mpSavepoint.reset();
+    mpStore->mbWriting = false;
+}
+
+// Store the chunks of the buffer, including the last one only at the end of the data.
+void BlobStore::Writer::flush(const bool abEnd)
+{
+    // A cut point can only be decided with a full chunk of data ahead, or at the end
+    size_t offset = 0;
+    while ((mBuffer.size() - offset >= mpStore->mMaxChunkSize) || (abEnd && offset < mBuffer.size()))
+    {
+        const size_t cut = mpStore->findCut(mBuffer.data() + offset, mBuffer.size() - offset);
+        mpStore->storeChunk(mObjectId, mNbChunks, mBuffer.data() + offset, cut);
+        ++mNbChunks;
+        offset += cut;
+    }
+    mBuffer.erase(mBuffer.begin(), mBuffer.begin() + static_cast<std::ptrdiff_t>(offset));
+}
+
+BlobStore::Reader::Reader(Database& aDatabase, const std::string& aChunksTable, std::vector<int64_t>&& aChunks,
+                          const int64_t aSize) :
+    mpDatabase(&aDatabase),
+    mChunksTable(aChunksTable),
+    mChunks(std::move(aChunks)),
+    mSize(aSize)
+{
+}
+
+BlobStore::Reader::Reader(Reader&& aOther) noexcept :
+    mpDatabase(aOther.mpDatabase),
+    mChunksTable(std::move(aOther.mChunksTable)),
+    mChunks(std::move(aOther.mChunks)),
+    mSize(aOther.mSize),
+    mChunk(aOther.mChunk),
+    mChunkSize(aOther.mChunkSize),
+    mOffset(aOther.mOffset),
+    mpBlob(aOther.mpBlob)
+{
+    aOther.mpBlob = nullptr;
+}
+
+// Close the handle on the current chunk.
+BlobStore::Reader::~Reader()
+{
+    sqlite3_blob_close(mpBlob); // no-op on a null pointer
+}
+
+// Read the next bytes of the object.
+size_t BlobStore::Reader::read(void* apBuffer, const size_t aSize)
+{
+    unsigned char* pBuffer = static_cast<unsigned char*>(apBuffer);
+    size_t nbRead = 0;
+    while (nbRead < aSize && mChunk < mChunks.size())
+    {
+        if (nullptr == mpBlob)
+        {
+            const int ret = sqlite3_blob_open(mpDatabase->getHandle(), "main", mChunksTable.c_str(), "data",
+                                              mChunks[mChunk], 0, &mpBlob);
+            if (SQLITE_OK != ret)
+            {
+                sqlite3_blob_close(mpBlob);
+                mpBlob = nullptr;
+                throw SQLite::Exception(mpDatabase->getHandle(), ret);
+            }
+            mChunkSize = sqlite3_blob_bytes(mpBlob);
+            mOffset = 0;
+        }
+        else if (mOffset == mChunkSize)
+        {
+            // Move the handle to the next chunk, cheaper than closing it and opening a new one
+            if (++mChunk == mChunks.size())
+            {
+                break;
+            }
+            const int ret = sqlite3_blob_reopen(mpBlob, mChunks[mChunk]);
+            if (SQLITE_OK != ret)
+            {
+                throw SQLite::Exception(mpDatabase->getHandle(), ret);
+            }
+            mChunkSize = sqlite3_blob_bytes(mpBlob);
+            mOffset = 0;
+        }
+
+        const int size = static_cast<int>(std::min(aSize - nbRead, static_cast<size_t>(mChunkSize - mOffset)));
+        const int ret = sqlite3_blob_read(mpBlob, pBuffer + nbRead, size, mOffset);
+        if (SQLITE_OK != ret)
+        {
+            throw SQLite::Exception(mpDatabase->getHandle(), ret);
+        }
+        mOffset += size;
+        nbRead += static_cast<size_t>(size);
+    }
+    return nbRead;
+}
+
+}  // namespace SQLite
@@ -13,12 +13,32 @@
 #include <SQLiteCpp/Assertion.h>
 #include <SQLiteCpp/Backup.h>
 #include <SQLiteCpp/Exception.h>
+#include <SQLiteCpp/Quote.h>
+#include <SQLiteCpp/Savepoint.h>
 #include <SQLiteCpp/Statement.h>
+#include <SQLiteCpp/Transaction.h>
 
 #include <sqlite3.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <exception>
 #include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <string.h>
 
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
 #ifndef SQLITE_DETERMINISTIC
 #define SQLITE_DETERMINISTIC 0x800
 #endif // SQLITE_DETERMINISTIC
@@ -79,6 +99,38 @@ Database::Database(const char* apFilename,
     }
 }
 
+// Open a database owned by this process only, in a fast mode avoiding the file locking system calls.
+Database Database::openExclusive(const std::string& aFilename,
+                                 const int aFlags /* = SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE */)
+{
+    // "unix-excl" only exists on unix systems, where it keeps the WAL index in heap memory
+    const char* pVfs = (sqlite3_vfs_find("unix-excl") != nullptr) ? "unix-excl" : nullptr;
+    Database database(aFilename.c_str(), (aFlags & ~SQLITE_OPEN_FULLMUTEX) | SQLITE_OPEN_NOMUTEX, 0, pVfs);
+    database.exec("PRAGMA locking_mode = EXCLUSIVE");
+
+    // Take the lock at once; it is then never released, so the next transactions do not touch it anymore
+    try
+    {
+        if (aFlags & SQLITE_OPEN_READWRITE)
+        {
+            database.exec("BEGIN EXCLUSIVE; COMMIT");
+        }
+        else
+        {
+            database.execAndGet("SELECT count(*) FROM sqlite_schema");
+        }
+    }
+    catch (const SQLite::Exception& e)
+    {
+        if ((e.getErrorCode() & 0xff) == SQLITE_BUSY)
+        {
+            throw SQLite::Exception("Database " + aFilename + " is open by another connection", SQLITE_BUSY);
+        }
+        throw;
+    }
+    return database;
+}
+
 // Deleter functor to use with smart pointers to close the SQLite database connection in an RAII fashion.
 void Database::Deleter::operator()(sqlite3* apSQLite)
 {
@@ -420,6 +472,888 @@ Header Database::getHeaderInfo(const std::string& aFilename)
     return h;
 }
 
+namespace
+{
+
+// Return true if a payload of aPayload bytes fits in a cell of a page of aPageSize bytes, without overflow
+bool fitsInPage(const int64_t aPayload, const int64_t aPageSize, const bool abIndex)
+{
+    // Maximum local payload, see https://www.sqlite.org/fileformat.html#cell_payload_overflow_pages
+    const int64_t maxLocal = abIndex ? ((aPageSize - 12) * 64 / 255 - 23) : (aPageSize - 35);
+    return aPayload <= maxLocal;
+}
+
+// Thresholds of the recommendations of analyzeSpace()
+const double FREE_PAGES_RATIO = 0.25;
+const double FRAGMENTATION_RATIO = 0.5;
+const double INDEX_FILL_FACTOR = 0.6;
+const double OVERFLOW_PAGES_RATIO = 0.1;
+const int64_t MIN_LEAF_PAGES = 8;
+const int64_t MAX_PAGE_SIZE = 65536;
+
+// Return the integer value of a pragma
+int64_t getPragma(const Database& aDatabase, const std::string& aPragma)
+{
+    Statement query(aDatabase, "PRAGMA " + aPragma);
+    (void)query.executeStep();
+    return query.getColumn(0).getInt64();
+}
+
+// Return the names of the tables, indexes and other objects of a database
+std::set<std::string> getObjectNames(const Database& aDatabase, const std::string& aSchema)
+{
+    std::set<std::string> names;
+    Statement query(aDatabase, "SELECT name FROM " + aSchema + ".sqlite_schema");
+    while (query.executeStep())
+    {
+        names.insert(query.getColumn(0).getString());
+    }
+    return names;
+}
+
+// Name of the rebuilt database attached to the connection of the source database
+const char* const REBUILD_SCHEMA = "sqlitecpp_rebuild";
+
+// Copy the database to a new file with VACUUM INTO, with a new page size if not 0
+void vacuumInto(Database& aSource, const std::string& aFilename, const int aPageSize)
+{
+    const int64_t pageSize = getPragma(aSource, "main.page_size");
+    // The page size requested for the next VACUUM is also used by VACUUM INTO
+    if (aPageSize > 0)
+    {
+        aSource.exec("PRAGMA main.page_size = " + std::to_string(aPageSize));
+    }
+    try
+    {
+        Statement vacuum(aSource, "VACUUM main INTO ?");
+        vacuum.bind(1, aFilename);
+        vacuum.exec();
+    }
+    catch (...)
+    {
+        aSource.exec("PRAGMA main.page_size = " + std::to_string(pageSize));
+        throw;
+    }
+    aSource.exec("PRAGMA main.page_size = " + std::to_string(pageSize));
+}
+
+// Copy the database to a new file table by table, in primary key order, then create the indexes
+void rebuildClustered(Database& aSource, const std::string& aFilename, const int aPageSize)
+{
+    struct Table
+    {
+        std::string name;
+        std::string sql;
+    };
+    std::vector<Table> tables;
+    Statement tablesQuery(aSource, "SELECT name, sql FROM main.sqlite_schema "
+                                   "WHERE type = 'table' AND name NOT LIKE 'sqlite\\_%' ESCAPE '\\' ORDER BY rowid");
+    while (tablesQuery.executeStep())
+    {
+        tables.push_back({tablesQuery.getColumn(0).getString(), tablesQuery.getColumn(1).getString()});
+    }
+    // A virtual table fills its shadow tables itself, in a way specific to its module (FTS5, R*Tree...):
+    // they cannot be copied row by row, so the whole database is copied by VACUUM INTO instead
+    for (const Table& table : tables)
+    {
+        if (table.sql.compare(0, 20, "CREATE VIRTUAL TABLE") == 0)
+        {
+            vacuumInto(aSource, aFilename, aPageSize);
+            return;
+        }
+    }
+
+    // Create the tables in the new database, with the same header settings
+    {
+        Database target(aFilename, OPEN_READWRITE | OPEN_CREATE);
+        target.exec("PRAGMA page_size = " + std::to_string(aPageSize > 0 ? aPageSize :
+                                                             getPragma(aSource, "main.page_size")));
+        target.exec("PRAGMA auto_vacuum = " + std::to_string(getPragma(aSource, "main.auto_vacuum")));
+        target.exec("PRAGMA encoding = '" + aSource.execAndGet("PRAGMA main.encoding").getString() + "'");
+        target.exec("PRAGMA user_version = " + std::to_string(getPragma(aSource, "main.user_version")));
+        target.exec("PRAGMA application_id = " + std::to_string(getPragma(aSource, "main.application_id")));
+        Transaction transaction(target);
+        for (const Table& table : tables)
+        {
+            target.exec(table.sql);
+        }
+        transaction.commit();
+    }
+
+    // Copy the rows of the tables in primary key order
+    Statement attach(aSource, std::string("ATTACH ? AS ") + REBUILD_SCHEMA);
+    attach.bind(1, aFilename);
+    attach.exec();
+    try
+    {
+        Transaction transaction(aSource);
+        for (const Table& table : tables)
+        {
+            std::string columns;
+            std::vector<std::pair<int, std::string>> keys;
+            Statement columnsQuery(aSource, "SELECT name, pk, hidden FROM pragma_table_xinfo(?, 'main')");
+            columnsQuery.bind(1, table.name);
+            while (columnsQuery.executeStep())
+            {
+                // Generated columns are not copied
+                if (columnsQuery.getColumn(2).getInt() != 0)
+                {
+                    continue;
+                }
+                const std::string column = quote(columnsQuery.getColumn(0).getString());
+                columns += (columns.empty() ? "" : ", ") + column;
+                if (columnsQuery.getColumn(1).getInt() > 0)
+                {
+                    keys.emplace_back(columnsQuery.getColumn(1).getInt(), column);
+                }
+            }
+            std::sort(keys.begin(), keys.end());
+            std::string orderBy;
+            for (const auto& key : keys)
+            {
+                orderBy += (orderBy.empty() ? "" : ", ") + key.second;
+            }
+            aSource.exec(std::string("INSERT INTO ") + REBUILD_SCHEMA + "." + quote(table.name) + " (" + columns +
+                         ") SELECT " + columns + " FROM main." + quote(table.name) +
+                         " ORDER BY " + (orderBy.empty() ? "rowid" : orderBy));
+        }
+        if (getObjectNames(aSource, "main").count("sqlite_sequence") > 0)
+        {
+            aSource.exec(std::string("DELETE FROM ") + REBUILD_SCHEMA + ".sqlite_sequence");
+            aSource.exec(std::string("INSERT INTO ") + REBUILD_SCHEMA + ".sqlite_sequence "
+                         "SELECT * FROM main.sqlite_sequence");
+        }
+        transaction.commit();
+    }
+    catch (...)
+    {
+        aSource.tryExec(std::string("DETACH ") + REBUILD_SCHEMA);
+        throw;
+    }
+    aSource.exec(std::string("DETACH ") + REBUILD_SCHEMA);
+
+    // Create the indexes on the ordered rows, then the views and the triggers
+    std::vector<std::string> objects;
+    Statement objectsQuery(aSource, "SELECT name, sql FROM main.sqlite_schema "
+                                    "WHERE type IN ('index', 'view', 'trigger') AND sql IS NOT NULL "
+                                    "ORDER BY type = 'trigger', rowid");
+    Database target(aFilename, OPEN_READWRITE);
+    const std::set<std::string> existing = getObjectNames(target, "main");
+    while (objectsQuery.executeStep())
+    {
+        if (existing.count(objectsQuery.getColumn(0).getString()) == 0)
+        {
+            objects.push_back(objectsQuery.getColumn(1).getString());
+        }
+    }
+    Transaction transaction(target);
+    for (const std::string& sql : objects)
+    {
+        target.exec(sql);
+    }
+    transaction.commit();
+}
+
+// Analyze the new database and check its integrity, returning its page size
+int finalizeRebuilt(const std::string& aFilename, const bool abAnalyze)
+{
+    Database target(aFilename, OPEN_READWRITE);
+    if (abAnalyze)
+    {
+        target.exec("ANALYZE");
+    }
+    const std::string integrity = target.execAndGet("PRAGMA integrity_check").getString();
+    if (integrity != "ok")
+    {
+        throw SQLite::Exception("Integrity check of the rebuilt database failed: " + integrity);
+    }
+    return static_cast<int>(getPragma(target, "page_size"));
+}
+
+// Return the duration of the fastest run of the workload
+std::chrono::microseconds runWorkload(const std::string& aFilename, const std::vector<std::string>& aWorkload,
+                                      const int aRepeat)
+{
+    Database database(aFilename, OPEN_READONLY);
+    auto fastest = std::chrono::microseconds::max();
+    for (int run = 0; run < std::max(aRepeat, 1); ++run)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (const std::string& sql : aWorkload)
+        {
+            Statement query(database, sql);
+            while (query.executeStep())
+            {
+            }
+        }
+        const auto duration = std::chrono::steady_clock::now() - start;
+        fastest = std::min(fastest, std::chrono::duration_cast<std::chrono::microseconds>(duration));
+    }
+    return fastest;
+}
+
+// Return the size of a file in bytes
+int64_t sizeOfFile(const std::string& aFilename)
+{
+    std::ifstream file(aFilename, std::ios::binary | std::ios::ate);
+    return file ? static_cast<int64_t>(file.tellg()) : 0;
+}
+
+#ifdef __linux__
+// Clone or copy a file in the kernel; return false if none is supported between these files
+bool cloneFile(const std::string& aSource, const std::string& aDestination, Database::CloneMethod& aMethod)
+{
+    const int source = ::open(aSource.c_str(), O_RDONLY | O_CLOEXEC);
+    if (source < 0)
+    {
+        throw SQLite::Exception("Unable to open " + aSource + " for cloning");
+    }
+    const int destination = ::open(aDestination.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (destination < 0)
+    {
+        ::close(source);
+        throw SQLite::Exception("Unable to create " + aDestination);
+    }
+    bool bCopied = false;
+    int error = 0;
+#ifdef FICLONE
+    if (::ioctl(destination, FICLONE, source) == 0)
+    {
+        aMethod = Database::CloneMethod::Reflink;
+        bCopied = true;
+    }
+#endif
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+    struct stat status;
+    if (!bCopied && ::fstat(source, &status) == 0)
+    {
+        off_t remaining = status.st_size;
+        while (remaining > 0)
+        {
+            const ssize_t copied = ::copy_file_range(source, nullptr, destination, nullptr,
+                                                     static_cast<size_t>(remaining), 0);
+            if (copied <= 0)
+            {
+                error = (copied < 0) ? errno : EIO;
+                break;
+            }
+            remaining -= copied;
+        }
+        if (remaining == 0)
+        {
+            aMethod = Database::CloneMethod::CopyFileRange;
+            bCopied = true;
+        }
+        else if (remaining < status.st_size)
+        {
+            // Failed in the middle of the copy: this is not a lack of support
+            ::close(source);
+            ::close(destination);
+            throw SQLite::Exception("Unable to copy " + aSource + ": " + strerror(error));
+        }
+    }
+#endif
+    ::close(source);
+    if (::close(destination) != 0 && bCopied)
+    {
+        throw SQLite::Exception("Unable to write " + aDestination);
+    }
+    return bCopied;
+}
+#endif // __linux__
+
+// Size of the blocks read by warmUp()
+const int64_t WARM_UP_BLOCK = 1024 * 1024;
+
+// Read ranges of a file in parallel threads, within a time budget
+void readRanges(const std::string& aFilename, const std::vector<std::pair<int64_t, int64_t>>& aRanges,
+                const WarmUpOptions& aOptions, WarmUpResult& aResult)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const auto isOverBudget = [&aOptions, start]()
+    {
+        return aOptions.budget.count() > 0 && std::chrono::steady_clock::now() - start >= aOptions.budget;
+    };
+    std::atomic<size_t> next(0);
+    std::atomic<int64_t> bytesRead(0);
+    std::atomic<bool> bOverBudget(false);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    const auto worker = [&](const bool abReport)
+    {
+        std::ifstream file(aFilename, std::ios::binary);
+        if (!file)
+        {
+            throw SQLite::Exception("Unable to open " + aFilename + " for warm-up");
+        }
+        std::vector<char> buffer(static_cast<size_t>(WARM_UP_BLOCK));
+        for (size_t i = next.fetch_add(1); i < aRanges.size(); i = next.fetch_add(1))
+        {
+            if (isOverBudget())
+            {
+                bOverBudget = true;
+                break;
+            }
+            file.clear();
+            file.seekg(aRanges[i].first);
+            file.read(buffer.data(), aRanges[i].second);
+            bytesRead += file.gcount();
+            if (abReport && aOptions.progress)
+            {
+                aOptions.progress(bytesRead, aResult.bytesTotal);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    unsigned nbThreads = (aOptions.nbThreads > 0) ? aOptions.nbThreads : std::thread::hardware_concurrency();
+    nbThreads = static_cast<unsigned>(std::min<size_t>(std::max(nbThreads, 1u), std::max<size_t>(aRanges.size(), 1)));
+    for (unsigned i = 1; i < nbThreads; ++i)
+    {
+        threads.emplace_back([&worker, &error, &errorMutex]()
+        {
+            try
+            {
+                worker(false);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                error = std::current_exception();
+            }
+        });
+    }
+    // The calling thread also reads, and reports the progress
+    std::exception_ptr callerError;
+    try
+    {
+        worker(true);
+    }
+    catch (...)
+    {
+        callerError = std::current_exception();
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    if (callerError)
+    {
+        std::rethrow_exception(callerError);
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    aResult.bytesRead = bytesRead;
+    aResult.complete = !bOverBudget;
+}
+
+// Load the ranges of a hot set file, one "offset length" by line, within the size of the file
+std::vector<std::pair<int64_t, int64_t>> loadHotSet(const std::string& aHotSetFile, const int64_t aFileSize)
+{
+    std::ifstream hotSet(aHotSetFile);
+    if (!hotSet)
+    {
+        throw SQLite::Exception("Unable to open the hot set file " + aHotSetFile);
+    }
+    std::vector<std::pair<int64_t, int64_t>> ranges;
+    int64_t offset = 0;
+    int64_t length = 0;
+    while (hotSet >> offset >> length)
+    {
+        // Split in blocks, to spread the reads between the threads
+        length = std::min(offset + length, aFileSize) - offset;
+        for (int64_t block = 0; block < length; block += WARM_UP_BLOCK)
+        {
+            ranges.emplace_back(offset + block, std::min(WARM_UP_BLOCK, length - block));
+        }
+    }
+    if (!hotSet.eof())
+    {
+        throw SQLite::Exception("Invalid hot set file " + aHotSetFile);
+    }
+    return ranges;
+}
+
+// Format a ratio as a percentage
+std::string percent(const double aRatio)
+{
+    return std::to_string(static_cast<int>(aRatio * 100.0 + 0.5)) + "%";
+}
+
+} // namespace
+
+// Analyze the space used by the tables and indexes of a database, with the "dbstat" virtual table.
+SpaceReport Database::analyzeSpace(const char* apSchema /* = "main" */) const
+{
+    const std::string schema = quote(apSchema);
+    SpaceReport report;
+    report.pageSize = getPragma(*this, schema + ".page_size");
+    report.pageCount = getPragma(*this, schema + ".page_count");
+    report.freePages = getPragma(*this, schema + ".freelist_count");
+
+    // Table of each index
+    std::map<std::string, std::pair<std::string, bool>> tables;
+    Statement schemaQuery(*this, "SELECT name, tbl_name, type = 'index' FROM " + schema + ".sqlite_schema");
+    while (schemaQuery.executeStep())
+    {
+        tables[schemaQuery.getColumn(0).getString()] =
+            std::make_pair(schemaQuery.getColumn(1).getString(), schemaQuery.getColumn(2).getInt() != 0);
+    }
+
+    // The pages of each b-tree are listed in depth-first order, that is in the order of the keys for the leaves
+    struct BTree
+    {
+        ObjectSpace space;
+        int64_t     previousLeafPage = 0;
+        int64_t     gaps = 0;
+        int64_t     maxLeafPayload = 0;
+    };
+    std::map<std::string, BTree> btrees;
+    Statement pages(*this, "SELECT name, pagetype, pageno, ncell, payload, unused, mx_payload, pgsize FROM dbstat(?)");
+    pages.bind(1, apSchema);
+    while (pages.executeStep())
+    {
+        BTree& btree = btrees[pages.getColumn(0).getString()];
+        const std::string type = pages.getColumn(1).getString();
+        const int64_t pageNo = pages.getColumn(2).getInt64();
+        ++btree.space.pages;
+        if (type == "leaf")
+        {
+            ++btree.space.leafPages;
+            btree.space.cells += pages.getColumn(3).getInt64();
+            btree.maxLeafPayload = std::max(btree.maxLeafPayload, pages.getColumn(6).getInt64());
+            if (btree.previousLeafPage != 0 && pageNo != btree.previousLeafPage + 1)
+            {
+                ++btree.gaps;
+            }
+            btree.previousLeafPage = pageNo;
+        }
+        else if (type == "overflow")
+        {
+            ++btree.space.overflowPages;
+        }
+        else
+        {
+            ++btree.space.internalPages;
+        }
+        btree.space.payloadBytes += pages.getColumn(4).getInt64();
+        btree.space.unusedBytes += pages.getColumn(5).getInt64();
+    }
+
+    if (report.freePages > 0 && report.freePages > report.pageCount * FREE_PAGES_RATIO)
+    {
+        report.recommendations.push_back({SpaceRecommendation::Vacuum, "",
+            std::to_string(report.freePages) + " of " + std::to_string(report.pageCount) + " pages are free", 0});
+    }
+    for (auto& entry : btrees)
+    {
+        ObjectSpace& space = entry.second.space;
+        space.name = entry.first;
+        const auto table = tables.find(space.name);
+        space.tableName = (table != tables.end()) ? table->second.first : space.name;
+        space.isIndex = (table != tables.end()) && table->second.second;
+        const int64_t bytes = space.pages * report.pageSize;
+        space.fillFactor = (bytes > 0) ? static_cast<double>(bytes - space.unusedBytes) / bytes : 0.0;
+        space.fragmentation = (space.leafPages > 1) ?
+            static_cast<double>(entry.second.gaps) / (space.leafPages - 1) : 0.0;
+
+        const bool bLarge = (space.leafPages >= MIN_LEAF_PAGES);
+        const bool bFragmented = bLarge && (space.fragmentation > FRAGMENTATION_RATIO);
+        if (space.isIndex && ((bLarge && space.fillFactor < INDEX_FILL_FACTOR) || bFragmented))
+        {
+            report.recommendations.push_back({SpaceRecommendation::Reindex, space.name,
+                "index filled at " + percent(space.fillFactor) + ", fragmented at " + percent(space.fragmentation), 0});
+        }
+        else if (!space.isIndex && bFragmented)
+        {
+            report.recommendations.push_back({SpaceRecommendation::Vacuum, space.name,
+                "table fragmented at " + percent(space.fragmentation), 0});
+        }
+        if (space.overflowPages > 0 && space.overflowPages > space.pages * OVERFLOW_PAGES_RATIO)
+        {
+            // Smallest page size without overflow of the largest cell, if there is one
+            for (int64_t pageSize = report.pageSize * 2; pageSize <= MAX_PAGE_SIZE; pageSize *= 2)
+            {
+                if (fitsInPage(entry.second.maxLeafPayload, pageSize, space.isIndex))
+                {
+                    report.recommendations.push_back({SpaceRecommendation::PageSize, space.name,
+                        std::to_string(space.overflowPages) + " of " + std::to_string(space.pages) +
+                        " pages are overflow pages", static_cast<int>(pageSize)});
+                    break;
+                }
+            }
+        }
+        report.objects.push_back(space);
+    }
+    std::stable_sort(report.objects.begin(), report.objects.end(),
+                     [](const ObjectSpace& aLeft, const ObjectSpace& aRight) { return aLeft.pages > aRight.pages; });
+    return report;
+}
+
+// Propose indexes for a workload, from the full scans and temporary b-trees of its query plans.
+IndexAdvice Database::indexAdvice(const std::vector<std::string>& aWorkload,
+                                  const IndexAdviceOptions& aOptions /* = IndexAdviceOptions() */)
+{
+    return adviseIndexes(*this, aWorkload, aOptions);
+}
+
+// Export the statistics of the query planner, gathered by ANALYZE.
+PlannerStats Database::exportPlannerStats(const char* apSchema /* = "main" */) const
+{
+    const std::string schema = quote(apSchema);
+    const std::set<std::string> names = getObjectNames(*this, schema);
+    PlannerStats stats;
+    if (names.count("sqlite_stat1") > 0)
+    {
+        Statement query(*this, "SELECT tbl, idx, stat FROM " + schema + ".sqlite_stat1");
+        while (query.executeStep())
+        {
+            stats.stat1.push_back({query.getColumn(0).getString(), query.getColumn(1).getString(),
+                                   query.getColumn(2).getString()});
+        }
+    }
+    if (names.count("sqlite_stat4") > 0)
+    {
+        Statement query(*this, "SELECT tbl, idx, neq, nlt, ndlt, sample FROM " + schema + ".sqlite_stat4");
+        while (query.executeStep())
+        {
+            stats.stat4.push_back({query.getColumn(0).getString(), query.getColumn(1).getString(),
+                                   query.getColumn(2).getString(), query.getColumn(3).getString(),
+                                   query.getColumn(4).getString(), query.getColumn(5).getString()});
+        }
+    }
+    return stats;
+}
+
+// Replace the statistics of the query planner, and reload them so that they are used by the next queries.
+int Database::importPlannerStats(const PlannerStats& aStats, const char* apSchema /* = "main" */)
+{
+    const std::string schema = quote(apSchema);
+    int nbRows = 0;
+    {
+        Savepoint savepoint(*this, "sqlitecpp_import_planner_stats");
+        // Analyzing the schema table creates the sqlite_stat1 table (and sqlite_stat4 if enabled) if needed;
+        // the sqlite_stat4 table cannot be created otherwise
+        exec("ANALYZE " + schema + ".sqlite_schema");
+        const std::set<std::string> names = getObjectNames(*this, schema);
+
+        exec("DELETE FROM " + schema + ".sqlite_stat1");
+        Statement insert1(*this, "INSERT INTO " + schema + ".sqlite_stat1 (tbl, idx, stat) VALUES (?, ?, ?)");
+        for (const PlannerStats::Stat1& stat : aStats.stat1)
+        {
+            if (names.count(stat.table) > 0 && (stat.index.empty() || names.count(stat.index) > 0))
+            {
+                insert1.bind(1, stat.table);
+                if (stat.index.empty())
+                {
+                    insert1.bind(2);
+                }
+                else
+                {
+                    insert1.bind(2, stat.index);
+                }
+                insert1.bind(3, stat.stat);
+                nbRows += insert1.exec();
+                insert1.reset();
+            }
+        }
+
+        if (names.count("sqlite_stat4") > 0)
+        {
+            exec("DELETE FROM " + schema + ".sqlite_stat4");
+            Statement insert4(*this, "INSERT INTO " + schema + ".sqlite_stat4 (tbl, idx, neq, nlt, ndlt, sample) "
+                                     "VALUES (?, ?, ?, ?, ?, ?)");
+            for (const PlannerStats::Stat4& stat : aStats.stat4)
+            {
+                if (names.count(stat.table) > 0 && names.count(stat.index) > 0)
+                {
+                    insert4.bind(1, stat.table);
+                    insert4.bind(2, stat.index);
+                    insert4.bind(3, stat.neq);
+                    insert4.bind(4, stat.nlt);
+                    insert4.bind(5, stat.ndlt);
+                    insert4.bind(6, stat.sample.data(), static_cast<int>(stat.sample.size()));
+                    nbRows += insert4.exec();
+                    insert4.reset();
+                }
+            }
+        }
+        savepoint.release();
+    }
+    // Reload the statistics in the query planner
+    exec("ANALYZE " + schema + ".sqlite_schema");
+    return nbRows;
+}
+
+// Run "PRAGMA optimize" with a work limit, to update the statistics of the query planner if needed.
+void Database::optimize(const int aAnalysisLimit /* = 400 */, const bool abAllTables /* = false */,
+                        const char* apSchema /* = "main" */)
+{
+    const int64_t previousLimit = getPragma(*this, "analysis_limit");
+    exec("PRAGMA analysis_limit = " + std::to_string(aAnalysisLimit));
+    try
+    {
+        // 0x10002: check all the tables, not only the ones used by queries of this connection
+        exec("PRAGMA " + quote(apSchema) + (abAllTables ? ".optimize(0x10002)" : ".optimize"));
+    }
+    catch (...)
+    {
+        exec("PRAGMA analysis_limit = " + std::to_string(previousLimit));
+        throw;
+    }
+    exec("PRAGMA analysis_limit = " + std::to_string(previousLimit));
+}
+
+// Write an optimized copy of the database to a new file, replacing it atomically.
+RebuildResult Database::rebuildOptimized(const std::string& aFilename,
+                                         const RebuildOptions& aOptions /* = RebuildOptions() */)
+{
+    if (aFilename.empty() || aFilename == mFilename)
+    {
+        throw SQLite::Exception("The rebuilt database shall be written to another file");
+    }
+
+    // One temporary file by candidate page size
+    std::vector<int> pageSizes = aOptions.candidatePageSizes;
+    if (pageSizes.empty())
+    {
+        pageSizes.push_back(aOptions.pageSize);
+    }
+    std::vector<std::string> temporaryFiles;
+    for (const int pageSize : pageSizes)
+    {
+        temporaryFiles.push_back(aFilename + (pageSizes.size() > 1 ? "." + std::to_string(pageSize) : "") + ".tmp");
+    }
+    const auto removeTemporaryFiles = [&temporaryFiles]()
+    {
+        for (const std::string& temporaryFile : temporaryFiles)
+        {
+            std::remove(temporaryFile.c_str());
+        }
+    };
+
+    RebuildResult result;
+    size_t best = 0;
+    try
+    {
+        removeTemporaryFiles();
+        for (size_t i = 0; i < pageSizes.size(); ++i)
+        {
+            if (aOptions.clustered)
+            {
+                rebuildClustered(*this, temporaryFiles[i], pageSizes[i]);
+            }
+            else
+            {
+                vacuumInto(*this, temporaryFiles[i], pageSizes[i]);
+            }
+            const int pageSize = finalizeRebuilt(temporaryFiles[i], aOptions.analyze);
+            if (pageSizes.size() > 1)
+            {
+                result.timings.push_back({pageSize, runWorkload(temporaryFiles[i], aOptions.workload,
+                                                                aOptions.repeat)});
+                if (result.timings[i].duration < result.timings[best].duration)
+                {
+                    best = i;
+                }
+            }
+            else
+            {
+                result.pageSize = pageSize;
+            }
+        }
+        if (pageSizes.size() > 1)
+        {
+            result.pageSize = result.timings[best].pageSize;
+        }
+
+        // Replace the destination file atomically; some platforms like Windows do not replace an existing file
+        if (std::rename(temporaryFiles[best].c_str(), aFilename.c_str()) != 0)
+        {
+            std::remove(aFilename.c_str());
+            if (std::rename(temporaryFiles[best].c_str(), aFilename.c_str()) != 0)
+            {
+                throw SQLite::Exception("Unable to rename the rebuilt database to " + aFilename);
+            }
+        }
+    }
+    catch (...)
+    {
+        removeTemporaryFiles();
+        throw;
+    }
+    removeTemporaryFiles();
+    result.fileSize = sizeOfFile(aFilename);
+    return result;
+}
+
+// Copy the database to a new file, as fast as the file system allows.
+Database::CloneMethod Database::cloneTo(const std::string& aFilename)
+{
+    if (!sqlite3_get_autocommit(getHandle()))
+    {
+        throw SQLite::Exception("cloneTo() cannot be called in a transaction");
+    }
+    // Journal files of a previous database would be applied to the copy
+    for (const char* suffix : {"-wal", "-shm", "-journal"})
+    {
+        std::remove((aFilename + suffix).c_str());
+    }
+
+    CloneMethod method = CloneMethod::Backup;
+#ifdef __linux__
+    const char* filename = sqlite3_db_filename(getHandle(), "main");
+    if (filename != nullptr && filename[0] != '\0')
+    {
+        // Copy all the content of the WAL to the database file first
+        if (execAndGet("PRAGMA main.journal_mode").getString() == "wal")
+        {
+            exec("PRAGMA main.wal_checkpoint(TRUNCATE)");
+        }
+        // A read transaction prevents the writers and the checkpoints from modifying the database file
+        Transaction transaction(*this, TransactionBehavior::DEFERRED);
+        (void)execAndGet("SELECT count(*) FROM main.sqlite_schema");
+        if (cloneFile(filename, aFilename, method))
+        {
+            // Commits since the checkpoint are in the WAL: copied after the database file, the copy is consistent
+            // (the last transaction is ignored on recovery if it was being appended)
+            struct stat status;
+            const std::string wal = std::string(filename) + "-wal";
+            if (::stat(wal.c_str(), &status) != 0 || status.st_size == 0 ||
+                cloneFile(wal, aFilename + "-wal", method))
+            {
+                return method;
+            }
+        }
+    }
+#endif
+    backup(aFilename.c_str(), BackupType::Save);
+    return method;
+}
+
+// Load the database file in the page cache of the OS, to avoid the latency of a cold start.
+WarmUpResult Database::warmUp(const WarmUpOptions& aOptions /* = WarmUpOptions() */) const
+{
+    const auto start = std::chrono::steady_clock::now();
+    WarmUpResult result;
+    const char* filename = sqlite3_db_filename(getHandle(), "main");
+    if (filename == nullptr || filename[0] == '\0')
+    {
+        result.complete = true;
+        return result;
+    }
+    const int64_t fileSize = sizeOfFile(filename);
+
+    std::vector<std::pair<int64_t, int64_t>> ranges;
+    if (aOptions.strategy == WarmUpOptions::HotSet)
+    {
+        ranges = loadHotSet(aOptions.hotSetFile, fileSize);
+    }
+    else
+    {
+#if defined(__linux__)
+        if (aOptions.strategy == WarmUpOptions::Advise)
+        {
+            const int file = ::open(filename, O_RDONLY | O_CLOEXEC);
+            if (file < 0)
+            {
+                throw SQLite::Exception(std::string("Unable to open ") + filename + " for warm-up");
+            }
+            const int ret = ::posix_fadvise(file, 0, 0, POSIX_FADV_WILLNEED);
+            ::close(file);
+            if (ret != 0)
+            {
+                throw SQLite::Exception(std::string("posix_fadvise failed: ") + strerror(ret));
+            }
+            result.bytesTotal = result.bytesRead = fileSize;
+            result.complete = true;
+            result.duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start);
+            return result;
+        }
+#endif
+        for (int64_t offset = 0; offset < fileSize; offset += WARM_UP_BLOCK)
+        {
+            ranges.emplace_back(offset, std::min(WARM_UP_BLOCK, fileSize - offset));
+        }
+    }
+    for (const auto& range : ranges)
+    {
+        result.bytesTotal += range.second;
+    }
+    readRanges(filename, ranges, aOptions, result);
+    result.duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    return result;
+}
+
+// Set the size of the chunks by which the database file grows and shrinks.
+bool Database::setChunkSize(int aBytes, const char* apSchema /* = "main" */)
+{
+    return fileControl(apSchema, SQLITE_FCNTL_CHUNK_SIZE, &aBytes);
+}
+
+// Preallocate the database file up to a size, rounded up to the chunk size.
+bool Database::sizeHint(int64_t aBytes, const char* apSchema /* = "main" */)
+{
+    sqlite3_int64 bytes = aBytes;
+    return fileControl(apSchema, SQLITE_FCNTL_SIZE_HINT, &bytes);
+}
+
+// Keep the WAL file when the last connection closes.
+bool Database::setPersistWal(const bool abPersist, const char* apSchema /* = "main" */)
+{
+    int persist = abPersist ? 1 : 0;
+    return fileControl(apSchema, SQLITE_FCNTL_PERSIST_WAL, &persist);
+}
+
+// Return true if the WAL file is kept when the last connection closes.
+bool Database::getPersistWal(const char* apSchema /* = "main" */) const
+{
+    int persist = -1;
+    return fileControl(apSchema, SQLITE_FCNTL_PERSIST_WAL, &persist) && persist == 1;
+}
+
+// Declare that the file system does not corrupt unwritten bytes of a sector on power loss.
+bool Database::setPowersafeOverwrite(const bool abPowersafe, const char* apSchema /* = "main" */)
+{
+    int powersafe = abPowersafe ? 1 : 0;
+    return fileControl(apSchema, SQLITE_FCNTL_POWERSAFE_OVERWRITE, &powersafe);
+}
+
+// Return true if the file system is declared to be "powersafe overwrite".
+bool Database::getPowersafeOverwrite(const char* apSchema /* = "main" */) const
+{
+    int powersafe = -1;
+    return fileControl(apSchema, SQLITE_FCNTL_POWERSAFE_OVERWRITE, &powersafe) && powersafe == 1;
+}
+
+// Return the size of the database file in bytes, including the space preallocated at its end.
+int64_t Database::getFileSize(const char* apSchema /* = "main" */) const
+{
+    sqlite3_file* pFile = nullptr;
+    if (!fileControl(apSchema, SQLITE_FCNTL_FILE_POINTER, &pFile) || pFile == nullptr || pFile->pMethods == nullptr)
+    {
+        return 0;
+    }
+    sqlite3_int64 size = 0;
+    check(pFile->pMethods->xFileSize(pFile, &size));
+    return size;
+}
+
+// Call sqlite3_file_control(), returning false if the operation is not supported by the VFS.
+bool Database::fileControl(const char* apSchema, const int aOperation, void* apArg) const
+{
+    const int ret = sqlite3_file_control(getHandle(), apSchema, aOperation, apArg);
+    if (ret == SQLITE_NOTFOUND)
+    {
+        return false;
+    }
+    check(ret);
+    return true;
+}
+
 void Database::backup(const char* apFilename, BackupType aType)
 {
     // Open the database file identified by apFilename
@@ -0,0 +1,85 @@
+/**
+ * @file    FileGrowthPolicy.cpp
+ * @ingroup SQLiteCpp
+ * @brief   Preallocate the database file ahead of its fill rate.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/FileGrowthPolicy.h>
+
+#include <SQLiteCpp/Quote.h>
+#include <SQLiteCpp/Statement.h>
+
+#include <algorithm>
+
+namespace SQLite
+{
+
+namespace
+{
+
+// Weight of the last measure in the smoothed fill rate
+const double RATE_SMOOTHING = 0.5;
+
+// Chunk sizes are powers of two, up to the max of an int
+const int64_t MAX_CHUNK_SIZE = 1024 * 1024 * 1024;
+
+} // namespace
+
+// Attach an auto-extend policy to a database.
+FileGrowthPolicy::FileGrowthPolicy(Database& aDatabase, const int64_t aMinAhead, const int64_t aMaxAhead,
+                                   const std::chrono::seconds aHorizon, const std::string& aSchema) :
+    mDatabase(aDatabase),
+    mMinAhead(std::max<int64_t>(aMinAhead, 1)),
+    mMaxAhead(std::min(std::max(aMaxAhead, aMinAhead), MAX_CHUNK_SIZE)),
+    mHorizon(aHorizon),
+    mSchema(aSchema)
+{
+}
+
+// Measure the fill rate of the database, then resize the chunks and preallocate the file if needed.
+bool FileGrowthPolicy::update()
+{
+    const std::string schema = quote(mSchema);
+    const auto now = std::chrono::steady_clock::now();
+    const int64_t used = mDatabase.execAndGet("PRAGMA " + schema + ".page_count").getInt64() *
+                         mDatabase.execAndGet("PRAGMA " + schema + ".page_size").getInt64();
+    if (mLastUsed >= 0)
+    {
+        const double seconds = std::chrono::duration<double>(now - mLastUpdate).count();
+        const double rate = static_cast<double>(std::max<int64_t>(used - mLastUsed, 0)) / std::max(seconds, 1e-3);
+        mRate = RATE_SMOOTHING * rate + (1.0 - RATE_SMOOTHING) * mRate;
+    }
+    mLastUsed = used;
+    mLastUpdate = now;
+
+    // Smallest power of two covering the growth expected during the horizon
+    const double expected = mRate * static_cast<double>(mHorizon.count());
+    const int64_t ahead = std::min(std::max(static_cast<int64_t>(std::min(expected, 1e18)), mMinAhead), mMaxAhead);
+    int64_t chunkSize = 1;
+    while (chunkSize < ahead && chunkSize < MAX_CHUNK_SIZE)
+    {
+        chunkSize *= 2;
+    }
+    if (chunkSize != mChunkSize)
+    {
+        if (!mDatabase.setChunkSize(static_cast<int>(chunkSize), mSchema.c_str()))
+        {
+            return false;
+        }
+        mChunkSize = chunkSize;
+    }
+
+    const int64_t fileSize = mDatabase.getFileSize(mSchema.c_str());
+    if (fileSize - used >= mChunkSize / 2)
+    {
+        return false;
+    }
+    mDatabase.sizeHint(used + mChunkSize, mSchema.c_str());
+    return mDatabase.getFileSize(mSchema.c_str()) > fileSize;
+}
+
+}  // namespace SQLite
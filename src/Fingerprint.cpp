@@ -0,0 +1,374 @@
+/**
+ * @file    Fingerprint.cpp
+ * @ingroup SQLiteCpp
+ * @brief   Fingerprint of a SQL statement: its normalized text, without the values, and a hash of it.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/Fingerprint.h>
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace SQLite
+{
+
+namespace
+{
+
+// Token of a normalized SQL text
+struct Token
+{
+    enum Kind
+    {
+        Word,       ///< Keyword or identifier
+        Value,      ///< Literal or parameter, replaced by "?"
+        Operator    ///< Operator or punctuation
+    };
+
+    Kind        kind;
+    std::string text;
+};
+
+bool isIdentifierStart(const char aChar)
+{
+    const unsigned char c = static_cast<unsigned char>(aChar);
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c == '_') || (c >= 0x80);
+}
+
+bool isIdentifierChar(const char aChar)
+{
+    return isIdentifierStart(aChar) || (aChar >= '0' && aChar <= '9') || (aChar == '$');
+}
+
+bool isDigit(const char aChar)
+{
+    return (aChar >= '0' && aChar <= '9');
+}
+
+// Return the end of a quoted string or identifier starting at apBegin, a doubled quote escaping it
+const char* skipQuoted(const char* apBegin, const char aQuote)
+{
+    const char* pEnd = apBegin + 1;
+    while (*pEnd != '\0')
+    {
+        if (*pEnd == aQuote)
+        {
+            if (pEnd[1] != aQuote)
+            {
+                return pEnd + 1;
+            }
+            ++pEnd;
+        }
+        ++pEnd;
+    }
+    return pEnd;
+}
+
+// Return the end of a numeric literal starting at apBegin
+const char* skipNumber(const char* apBegin)
+{
+    const char* pEnd = apBegin;
+    if (pEnd[0] == '0' && (pEnd[1] == 'x' || pEnd[1] == 'X'))
+    {
+        pEnd += 2;
+        while (isIdentifierChar(*pEnd))
+        {
+            ++pEnd;
+        }
+        return pEnd;
+    }
+    while (isDigit(*pEnd) || *pEnd == '.' || *pEnd == '_')
+    {
+        ++pEnd;
+    }
+    if (*pEnd == 'e' || *pEnd == 'E')
+    {
+        ++pEnd;
+        if (*pEnd == '+' || *pEnd == '-')
+        {
+            ++pEnd;
+        }
+        while (isDigit(*pEnd))
+        {
+            ++pEnd;
+        }
+    }
+    return pEnd;
+}
+
+// Return true if a '+' or '-' before a number is a sign rather than an operator
+bool isSign(const std::vector<Token>& aTokens)
+{
+    return aTokens.empty() || ((aTokens.back().kind == Token::Operator) && (aTokens.back().text != ")"));
+}
+
+// Split a SQL text into tokens, without the comments, with the literals and parameters as values
+std::vector<Token> tokenize(const char* apSql)
+{
+    static const char* const OPERATORS[] = {"->>", "->", "||", "<=", ">=", "<>", "!=", "==", "<<", ">>"};
+    std::vector<Token> tokens;
+    const char* pSql = apSql;
+    while (*pSql != '\0')
+    {
+        const char c = *pSql;
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v')
+        {
+            ++pSql;
+        }
+        else if (c == '-' && pSql[1] == '-')
+        {
+            while (*pSql != '\0' && *pSql != '\n')
+            {
+                ++pSql;
+            }
+        }
+        else if (c == '/' && pSql[1] == '*')
+        {
+            const char* pEnd = std::strstr(pSql + 2, "*/");
+            pSql = (pEnd != nullptr) ? pEnd + 2 : pSql + std::strlen(pSql);
+        }
+        else if (c == '\'')
+        {
+            pSql = skipQuoted(pSql, '\'');
+            tokens.push_back({Token::Value, "?"});
+        }
+        else if ((c == 'x' || c == 'X') && pSql[1] == '\'')
+        {
+            pSql = skipQuoted(pSql + 1, '\'');
+            tokens.push_back({Token::Value, "?"});
+        }
+        else if (c == '"' || c == '`' || c == '[')
+        {
+            const char* pEnd = skipQuoted(pSql, (c == '[') ? ']' : c);
+            tokens.push_back({Token::Word, std::string(pSql, pEnd)});
+            pSql = pEnd;
+        }
+        else if (isDigit(c) || (c == '.' && isDigit(pSql[1])))
+        {
+            pSql = skipNumber(pSql);
+            tokens.push_back({Token::Value, "?"});
+        }
+        else if ((c == '-' || c == '+') && (isDigit(pSql[1]) || (pSql[1] == '.' && isDigit(pSql[2])))
+                 && isSign(tokens))
+        {
+            pSql = skipNumber(pSql + 1);
+            tokens.push_back({Token::Value, "?"});
+        }
+        else if (c == '?')
+        {
+            ++pSql;
+            while (isDigit(*pSql))
+            {
+                ++pSql;
+            }
+            tokens.push_back({Token::Value, "?"});
+        }
+        else if ((c == ':' || c == '@' || c == '$') && isIdentifierChar(pSql[1]))
+        {
+            ++pSql;
+            while (isIdentifierChar(*pSql))
+            {
+                ++pSql;
+            }
+            tokens.push_back({Token::Value, "?"});
+        }
+        else if (isIdentifierStart(c))
+        {
+            std::string word;
+            while (isIdentifierChar(*pSql))
+            {
+                const char l = *pSql;
+                word += (l >= 'A' && l <= 'Z') ? static_cast<char>(l - 'A' + 'a') : l;
+                ++pSql;
+            }
+            tokens.push_back({Token::Word, word});
+        }
+        else
+        {
+            size_t length = 1;
+            for (const char* pOperator : OPERATORS)
+            {
+                const size_t operatorLength = std::strlen(pOperator);
+                if (std::strncmp(pSql, pOperator, operatorLength) == 0)
+                {
+                    length = operatorLength;
+                    break;
+                }
+            }
+            tokens.push_back({Token::Operator, std::string(pSql, length)});
+            pSql += length;
+        }
+    }
+    while (!tokens.empty() && tokens.back().kind == Token::Operator && tokens.back().text == ";")
+    {
+        tokens.pop_back();
+    }
+    return tokens;
+}
+
+bool isOperator(const std::vector<Token>& aTokens, const size_t aIndex, const char* apText)
+{
+    return (aIndex < aTokens.size()) && (aTokens[aIndex].kind == Token::Operator) && (aTokens[aIndex].text == apText);
+}
+
+bool isWord(const std::vector<Token>& aTokens, const size_t aIndex, const char* apText)
+{
+    return (aIndex < aTokens.size()) && (aTokens[aIndex].kind == Token::Word) && (aTokens[aIndex].text == apText);
+}
+
+// Return the index past a list of values "(?, ?, ...)" starting at aIndex, or aIndex if there is none
+size_t skipValueList(const std::vector<Token>& aTokens, const size_t aIndex)
+{
+    if (!isOperator(aTokens, aIndex, "("))
+    {
+        return aIndex;
+    }
+    size_t index = aIndex + 1;
+    while (index < aTokens.size() && aTokens[index].kind == Token::Value)
+    {
+        if (isOperator(aTokens, index + 1, ")"))
+        {
+            return index + 2;
+        }
+        if (!isOperator(aTokens, index + 1, ","))
+        {
+            break;
+        }
+        index += 2;
+    }
+    return aIndex;
+}
+
+// Return the index past the parenthesized group starting at aIndex, or aIndex if there is none
+size_t skipGroup(const std::vector<Token>& aTokens, const size_t aIndex)
+{
+    if (!isOperator(aTokens, aIndex, "("))
+    {
+        return aIndex;
+    }
+    int depth = 0;
+    for (size_t index = aIndex; index < aTokens.size(); ++index)
+    {
+        if (isOperator(aTokens, index, "("))
+        {
+            ++depth;
+        }
+        else if (isOperator(aTokens, index, ")") && (--depth == 0))
+        {
+            return index + 1;
+        }
+    }
+    return aIndex;
+}
+
+bool isSameGroup(const std::vector<Token>& aTokens, size_t aFirst, size_t aSecond, const size_t aLength)
+{
+    for (size_t i = 0; i < aLength; ++i, ++aFirst, ++aSecond)
+    {
+        if (aTokens[aFirst].kind != aTokens[aSecond].kind || aTokens[aFirst].text != aTokens[aSecond].text)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Collapse the IN lists of values, and the repeated rows of the VALUES clauses
+std::vector<Token> collapse(const std::vector<Token>& aTokens)
+{
+    std::vector<Token> tokens;
+    tokens.reserve(aTokens.size());
+    size_t index = 0;
+    while (index < aTokens.size())
+    {
+        if (isWord(aTokens, index, "in"))
+        {
+            const size_t end = skipValueList(aTokens, index + 1);
+            if (end != index + 1)
+            {
+                tokens.push_back(aTokens[index]);
+                tokens.push_back({Token::Operator, "("});
+                tokens.push_back({Token::Operator, "..."});
+                tokens.push_back({Token::Operator, ")"});
+                index = end;
+                continue;
+            }
+        }
+        else if (isWord(aTokens, index, "values"))
+        {
+            const size_t first = index + 1;
+            const size_t length = skipGroup(aTokens, first) - first;
+            if (length > 0)
+            {
+                tokens.insert(tokens.end(), aTokens.begin() + static_cast<std::ptrdiff_t>(index),
+                              aTokens.begin() + static_cast<std::ptrdiff_t>(first + length));
+                index = first + length;
+                bool bRepeated = false;
+                while (isOperator(aTokens, index, ",") && (index + 1 + length <= aTokens.size())
+                       && isSameGroup(aTokens, first, index + 1, length))
+                {
+                    index += 1 + length;
+                    bRepeated = true;
+                }
+                if (bRepeated)
+                {
+                    tokens.push_back({Token::Operator, ","});
+                    tokens.push_back({Token::Operator, "..."});
+                }
+                continue;
+            }
+        }
+        tokens.push_back(aTokens[index]);
+        ++index;
+    }
+    return tokens;
+}
+
+} // namespace
+
+// Return the tokens of the normalized text of a SQL statement
+std::vector<std::string> getFingerprintTokens(const char* apSql)
+{
+    const std::vector<Token> tokens = collapse(tokenize(apSql));
+    std::vector<std::string> texts;
+    texts.reserve(tokens.size());
+    for (const Token& token : tokens)
+    {
+        texts.push_back(token.text);
+    }
+    return texts;
+}
+
+// Return the fingerprint of a SQL statement
+Fingerprint getFingerprint(const char* apSql)
+{
+    const std::vector<Token> tokens = collapse(tokenize(apSql));
+    Fingerprint fingerprint;
+    const std::string* pPrevious = nullptr;
+    for (const Token& token : tokens)
+    {
+        const bool bAttached = (token.kind == Token::Operator)
+                             && (token.text == ")" || token.text == "," || token.text == ".");
+        if (pPrevious != nullptr && !bAttached && *pPrevious != "(" && *pPrevious != ".")
+        {
+            fingerprint.normalized += ' ';
+        }
+        fingerprint.normalized += token.text;
+        pPrevious = &token.text;
+    }
+
+    fingerprint.hash = 0xcbf29ce484222325ULL;
+    for (const char c : fingerprint.normalized)
+    {
+        fingerprint.hash ^= static_cast<unsigned char>(c);
+        fingerprint.hash *= 0x100000001b3ULL;
+    }
+    return fingerprint;
+}
+
+}  // namespace SQLite
@@ -0,0 +1,457 @@
+/**
+ * @file    FullTextIndex.cpp
+ * @ingroup SQLiteCpp
+ * @brief   Full-text search index on the columns of a table, using the FTS5 extension.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/FullTextIndex.h>
+
+#include <SQLiteCpp/Quote.h>
+#include <SQLiteCpp/Savepoint.h>
+#include <SQLiteCpp/Statement.h>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+
+namespace SQLite
+{
+
+const char* const FullTextIndex::TRIGRAM = "trigram";
+
+namespace
+{
+
+// Return true if a FTS5 "tokenize" option is the trigram tokenizer, maybe with arguments
+bool isTrigram(const std::string& aTokenizer)
+{
+    std::string name;
+    for (const char c : aTokenizer)
+    {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_')
+        {
+            name += (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+        else if (!name.empty() || (c != ' ' && c != '\'' && c != '"'))
+        {
+            break;
+        }
+    }
+    return name == FullTextIndex::TRIGRAM;
+}
+
+// Return the "tokenize" option of the CREATE VIRTUAL TABLE statement of a FTS5 table, "unicode61" if none
+std::string getTokenizer(const std::string& aSql)
+{
+    std::string lower(aSql);
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](const char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; });
+    size_t position = lower.find("tokenize");
+    while (position != std::string::npos)
+    {
+        size_t value = lower.find_first_not_of(' ', position + 8);
+        if (value != std::string::npos && lower[value] == '=' && position > 0
+            && (lower[position - 1] == ' ' || lower[position - 1] == ',' || lower[position - 1] == '('))
+        {
+            value = lower.find_first_not_of(' ', value + 1);
+            if (value == std::string::npos)
+            {
+                break;
+            }
+            const char first = aSql[value];
+            if (first == '\'' || first == '"')
+            {
+                std::string tokenizer;
+                for (size_t i = value + 1; i < aSql.size(); ++i)
+                {
+                    if (aSql[i] == first)
+                    {
+                        if (i + 1 >= aSql.size() || aSql[i + 1] != first)
+                        {
+                            break;
+                        }
+                        ++i;
+                    }
+                    tokenizer += aSql[i];
+                }
+                return tokenizer;
+            }
+            return aSql.substr(value, aSql.find_first_of(",)", value) - value);
+        }
+        position = lower.find("tokenize", position + 8);
+    }
+    return "unicode61";
+}
+
+// Get the FTS5 API of a connection, see https://sqlite.org/fts5.html#extending_fts5
+fts5_api* getFts5Api(Database& aDatabase)
+{
+    fts5_api* pApi = nullptr;
+    sqlite3_stmt* pStmt = nullptr;
+    int ret = sqlite3_prepare_v2(aDatabase.getHandle(), "SELECT fts5(?1)", -1, &pStmt, nullptr);
+    if (SQLITE_OK == ret)
+    {
+        ret = sqlite3_bind_pointer(pStmt, 1, static_cast<void*>(&pApi), "fts5_api_ptr", nullptr);
+        if (SQLITE_OK == ret)
+        {
+            (void)sqlite3_step(pStmt);
+        }
+        ret = sqlite3_finalize(pStmt);
+    }
+    if (SQLITE_OK != ret || nullptr == pApi)
+    {
+        throw SQLite::Exception("FTS5 is not available (see the SQLITE_ENABLE_FTS5 option).");
+    }
+    return pApi;
+}
+
+// Adapters between the fts5_tokenizer C interface and the Tokenizer C++ interface
+struct TokenizerModule
+{
+    static int create(void* apFactory, const char** aazArgs, int aNbArgs, Fts5Tokenizer** appTokenizer)
+    {
+        try
+        {
+            const FullTextIndex::TokenizerFactory& factory =
+                *static_cast<const FullTextIndex::TokenizerFactory*>(apFactory);
+            const std::vector<std::string> args(aazArgs, aazArgs + aNbArgs);
+            std::unique_ptr<FullTextIndex::Tokenizer> tokenizer = factory(args);
+            if (!tokenizer)
+            {
+                return SQLITE_ERROR;
+            }
+            *appTokenizer = reinterpret_cast<Fts5Tokenizer*>(tokenizer.release());
+            return SQLITE_OK;
+        }
+        catch (...)
+        {
+            return SQLITE_ERROR;
+        }
+    }
+
+    static void destroy(Fts5Tokenizer* apTokenizer)
+    {
+        delete reinterpret_cast<FullTextIndex::Tokenizer*>(apTokenizer);
+    }
+
+    static int tokenize(Fts5Tokenizer* apTokenizer, void* apContext, int aFlags, const char* apText, int aSize,
+                        int (*apToken)(void*, int, const char*, int, int, int))
+    {
+        try
+        {
+            reinterpret_cast<FullTextIndex::Tokenizer*>(apTokenizer)->tokenize(apText, aSize, aFlags,
+                [=](const char* apTokenText, int aTokenSize, int aStart, int aEnd, bool abColocated)
+                {
+                    const int ret = apToken(apContext, abColocated ? FTS5_TOKEN_COLOCATED : 0,
+                                            apTokenText, aTokenSize, aStart, aEnd);
+                    if (SQLITE_OK != ret)
+                    {
+                        throw SQLite::Exception("Tokenization interrupted", ret);
+                    }
+                });
+            return SQLITE_OK;
+        }
+        catch (const SQLite::Exception& e)
+        {
+            return e.getErrorCode();
+        }
+        catch (...)
+        {
+            return SQLITE_ERROR;
+        }
+    }
+
+    static void destroyFactory(void* apFactory)
+    {
+        delete static_cast<FullTextIndex::TokenizerFactory*>(apFactory);
+    }
+};
+
+} // namespace
+
+// Open the index of a table, creating it, its triggers, and indexing the existing rows if needed.
+FullTextIndex::FullTextIndex(Database& aDatabase, const std::string& aName, const std::string& aContentTable,
+                             const std::vector<std::string>& aColumns,
+                             const std::string& aTokenizer /* = "unicode61" */,
+                             const std::string& aContentRowid /* = "rowid" */) :
+    mDatabase(aDatabase),
+    mName(aName),
+    mContentTable(aContentTable),
+    mColumns(aColumns),
+    mContentRowid(aContentRowid),
+    mWeights(aColumns.size(), 1.0)
+{
+    if (mColumns.empty())
+    {
+        throw SQLite::Exception("A full-text index needs at least one column.");
+    }
+    if (mDatabase.tableExists(mName))
+    {
+        // The tokenizer of an existing index is the one it was created with
+        Statement query(mDatabase, "SELECT sql FROM sqlite_schema WHERE type = 'table' AND name = ?");
+        query.bind(1, mName);
+        mbTrigram = query.executeStep() && isTrigram(getTokenizer(query.getColumn(0).getString()));
+        return;
+    }
+    mbTrigram = isTrigram(aTokenizer);
+
+    std::string columns;
+    for (const std::string& column : mColumns)
+    {
+        columns += quote(column) + ", ";
+    }
+    Savepoint savepoint(mDatabase, "fulltextindex_create");
+    mDatabase.exec("CREATE VIRTUAL TABLE " + quote(mName) + " USING fts5(" + columns +
+                   "content=" + quoteLiteral(mContentTable) + ", content_rowid=" + quoteLiteral(mContentRowid) +
+                   ", tokenize=" + quoteLiteral(aTokenizer) + ")");
+    createTriggers();
+    rebuild();
+    savepoint.release();
+}
+
+// Register a custom tokenizer on a connection, to be used by the indexes created or opened on it.
+void FullTextIndex::registerTokenizer(Database& aDatabase, const std::string& aName, TokenizerFactory aFactory)
+{
+    fts5_api* pApi = getFts5Api(aDatabase);
+    fts5_tokenizer module;
+    module.xCreate = &TokenizerModule::create;
+    module.xDelete = &TokenizerModule::destroy;
+    module.xTokenize = &TokenizerModule::tokenize;
+    // The factory is owned by FTS5 from here, even on error
+    const int ret = pApi->xCreateTokenizer(pApi, aName.c_str(), new TokenizerFactory(std::move(aFactory)), &module,
+                                           &TokenizerModule::destroyFactory);
+    if (SQLITE_OK != ret)
+    {
+        throw SQLite::Exception(aDatabase.getHandle(), ret);
+    }
+}
+
+// Search the index, ranking the results by bm25().
+std::vector<FullTextIndex::Hit> FullTextIndex::search(const std::string& aQuery, const int aLimit /* = 10 */,
+                                                      const int aSnippetColumn /* = -1 */,
+                                                      const int aSnippetTokens /* = 16 */) const
+{
+    std::string rank = "bm25(" + quote(mName);
+    for (const double weight : mWeights)
+    {
+        char buffer[32];
+        sqlite3_snprintf(sizeof(buffer), buffer, ", %.17g", weight); // independent of the locale
+        rank += buffer;
+    }
+    rank += ")";
+    Statement query(mDatabase, "SELECT rowid, " + rank + " AS score, snippet(" + quote(mName) + ", ?, ?, ?, ?, ?) "
+                               "FROM " + quote(mName) + " WHERE " + quote(mName) + " MATCH ? "
+                               "ORDER BY score LIMIT ?");
+    query.bind(1, aSnippetColumn);
+    query.bind(2, mSnippetOpen);
+    query.bind(3, mSnippetClose);
+    query.bind(4, mSnippetEllipsis);
+    query.bind(5, aSnippetTokens);
+    query.bind(6, aQuery);
+    query.bind(7, aLimit);
+
+    std::vector<Hit> hits;
+    while (query.executeStep())
+    {
+        Hit hit;
+        hit.rowid = query.getColumn(0).getInt64();
+        hit.score = query.getColumn(1).getDouble();
+        hit.snippet = query.getColumn(2).getString();
+        hits.push_back(std::move(hit));
+    }
+    return hits;
+}
+
+// Find the rows with a column containing a substring.
+std::vector<int64_t> FullTextIndex::containing(const std::string& aColumn, const std::string& aSubstring,
+                                               const int aLimit /* = -1 */) const
+{
+    // A phrase of 3 characters or more is found by the trigram index; else only a LIKE can find it, by a full scan,
+    // as the other tokenizers index whole words only
+    size_t nbChars = 0;
+    for (const char c : aSubstring)
+    {
+        nbChars += ((static_cast<unsigned char>(c) & 0xC0) != 0x80) ? 1 : 0; // not an UTF-8 continuation byte
+    }
+    const bool bUseLike = !mbTrigram || (nbChars < 3);
+    Statement query(mDatabase, "SELECT rowid FROM " + quote(mName) + " WHERE " +
+                               (bUseLike ? quote(aColumn) + " LIKE ?" : quote(mName) + " MATCH ?") +
+                               " ORDER BY rowid LIMIT ?");
+    if (bUseLike)
+    {
+        query.bind(1, "%" + aSubstring + "%");
+    }
+    else
+    {
+        // Column filter on a phrase, quoted as an identifier, see https://sqlite.org/fts5.html#fts5_column_filters
+        query.bind(1, "{" + quote(aColumn) + "} : " + quote(aSubstring));
+    }
+    query.bind(2, aLimit);
+
+    std::vector<int64_t> rowids;
+    while (query.executeStep())
+    {
+        rowids.push_back(query.getColumn(0).getInt64());
+    }
+    return rowids;
+}
+
+// Set the weights of the columns for the bm25() ranking of search().
+void FullTextIndex::setWeights(const std::vector<double>& aWeights)
+{
+    if (aWeights.size() != mColumns.size())
+    {
+        throw SQLite::Exception("There shall be one weight for each column.");
+    }
+    mWeights = aWeights;
+}
+
+// Set the snippet markers of search().
+void FullTextIndex::setSnippetMarkers(const std::string& aOpen, const std::string& aClose,
+                                      const std::string& aEllipsis)
+{
+    mSnippetOpen = aOpen;
+    mSnippetClose = aClose;
+    mSnippetEllipsis = aEllipsis;
+}
+
+// Set the "automerge" level.
+void FullTextIndex::setAutomerge(const int aSegments)
+{
+    configure("automerge", aSegments);
+}
+
+// Set the "crisismerge" level.
+void FullTextIndex::setCrisisMerge(const int aSegments)
+{
+    configure("crisismerge", aSegments);
+}
+
+// Rebuild the whole index from the content table.
+void FullTextIndex::rebuild()
+{
+    // Segments are only merged once, by optimize(), instead of repeatedly while the index grows
+    Savepoint savepoint(mDatabase, "fulltextindex_rebuild");
+    const int automerge = getConfiguration("automerge", 4);
+    const int crisisMerge = getConfiguration("crisismerge", 16);
+    configure("automerge", 0);
+    configure("crisismerge", 1 << 16);
+    mDatabase.exec("INSERT INTO " + quote(mName) + "(" + quote(mName) + ") VALUES ('rebuild')");
+    optimize();
+    configure("automerge", automerge);
+    configure("crisismerge", crisisMerge);
+    savepoint.release();
+}
+
+// Insert many rows in the content table without the cost of the incremental index updates.
+void FullTextIndex::bulkLoad(const std::function<void()>& aLoader)
+{
+    Savepoint savepoint(mDatabase, "fulltextindex_bulkload");
+    dropTriggers();
+    aLoader();
+    rebuild();
+    createTriggers();
+    savepoint.release();
+}
+
+// Merge all the segments of the index in one, for the fastest queries.
+void FullTextIndex::optimize()
+{
+    mDatabase.exec("INSERT INTO " + quote(mName) + "(" + quote(mName) + ") VALUES ('optimize')");
+}
+
+// Merge some segments of the index, within a time budget.
+bool FullTextIndex::maintain(const std::chrono::milliseconds aBudget, const int aPages /* = 64 */)
+{
+    const auto deadline = std::chrono::steady_clock::now() + aBudget;
+    Statement merge(mDatabase, "INSERT INTO " + quote(mName) + "(" + quote(mName) + ", rank) VALUES ('merge', ?)");
+    // A negative number of pages merges segments whatever their level, as optimize() does, but by steps
+    merge.bind(1, -aPages);
+    do
+    {
+        // Less than 2 changes means that there was nothing to merge (https://sqlite.org/fts5.html#the_merge_command)
+        const int before = mDatabase.getTotalChanges();
+        merge.exec();
+        merge.reset();
+        if (mDatabase.getTotalChanges() - before < 2)
+        {
+            return true;
+        }
+    } while (std::chrono::steady_clock::now() < deadline);
+    return false;
+}
+
+// Check that the index matches the content table.
+bool FullTextIndex::check()
+{
+    return SQLITE_OK == mDatabase.tryExec("INSERT INTO " + quote(mName) + "(" + quote(mName) +
+                                          ", rank) VALUES ('integrity-check', 1)");
+}
+
+// Drop the index and its triggers.
+void FullTextIndex::drop()
+{
+    Savepoint savepoint(mDatabase, "fulltextindex_drop");
+    dropTriggers();
+    mDatabase.exec("DROP TABLE IF EXISTS " + quote(mName));
+    savepoint.release();
+}
+
+// Create the triggers keeping the index in sync with the content table.
+// See https://sqlite.org/fts5.html#external_content_tables
+void FullTextIndex::createTriggers()
+{
+    std::string columns;
+    std::string newValues;
+    std::string oldValues;
+    for (const std::string& column : mColumns)
+    {
+        columns += ", " + quote(column);
+        newValues += ", NEW." + quote(column);
+        oldValues += ", OLD." + quote(column);
+    }
+    const std::string table = quote(mName);
+    const std::string rowid = quote(mContentRowid);
+    const std::string insertNew = "INSERT INTO " + table + "(rowid" + columns + ") VALUES (NEW." + rowid +
+                                  newValues + ");";
+    const std::string deleteOld = "INSERT INTO " + table + "(" + table + ", rowid" + columns +
+                                  ") VALUES ('delete', OLD." + rowid + oldValues + ");";
+    const std::string on = " ON " + quote(mContentTable) + " BEGIN ";
+    mDatabase.exec("CREATE TRIGGER IF NOT EXISTS " + quote(mName + "_insert") + " AFTER INSERT" + on +
+                   insertNew + " END");
+    mDatabase.exec("CREATE TRIGGER IF NOT EXISTS " + quote(mName + "_delete") + " AFTER DELETE" + on +
+                   deleteOld + " END");
+    mDatabase.exec("CREATE TRIGGER IF NOT EXISTS " + quote(mName + "_update") + " AFTER UPDATE" + on +
+                   deleteOld + " " + insertNew + " END");
+}
+
+// Drop the triggers keeping the index in sync with the content table.
+void FullTextIndex::dropTriggers()
+{
+    mDatabase.exec("DROP TRIGGER IF EXISTS " + quote(mName + "_insert"));
+    mDatabase.exec("DROP TRIGGER IF EXISTS " + quote(mName + "_delete"));
+    mDatabase.exec("DROP TRIGGER IF EXISTS " + quote(mName + "_update"));
+}
+
+// Set a configuration option of the index, see https://sqlite.org/fts5.html#fts5_configuration_options
+void FullTextIndex::configure(const char* apOption, const int aValue)
+{
+    Statement config(mDatabase, "INSERT INTO " + quote(mName) + "(" + quote(mName) + ", rank) VALUES (?, ?)");
+    config.bind(1, apOption);
+    config.bind(2, aValue);
+    config.exec();
+}
+
+// Return a configuration option of the index, as stored in its "_config" shadow table, or its default value
+int FullTextIndex::getConfiguration(const char* apOption, const int aDefault) const
+{
+    Statement query(mDatabase, "SELECT v FROM " + quote(mName + "_config") + " WHERE k = ?");
+    query.bind(1, apOption);
+    return query.executeStep() ? query.getColumn(0).getInt() : aDefault;
+}
+
+}  // namespace SQLite
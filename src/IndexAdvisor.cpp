@@ -0,0 +1,715 @@
+/**
+ * @file    IndexAdvisor.cpp
+ * @ingroup SQLiteCpp
+ * @brief   Propose indexes for a workload, from the full scans and temporary b-trees of its query plans.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/IndexAdvisor.h>
+
+#include <SQLiteCpp/Backup.h>
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Exception.h>
+#include <SQLiteCpp/Fingerprint.h>
+#include <SQLiteCpp/QueryPlan.h>
+#include <SQLiteCpp/Quote.h>
+#include <SQLiteCpp/Statement.h>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <set>
+
+namespace SQLite
+{
+
+namespace
+{
+
+// Keywords ending a table list, or that cannot be a column or an alias
+const std::set<std::string> SQL_KEYWORDS = {
+    "all", "and", "as", "asc", "between", "by", "case", "collate", "cross", "default", "delete", "desc", "distinct",
+    "else", "end", "except", "exists", "from", "full", "glob", "group", "having", "in", "indexed", "inner",
+    "insert", "intersect", "into", "is", "join", "left", "like", "limit", "match", "natural", "not", "null",
+    "nulls", "offset", "on", "or", "order", "outer", "regexp", "returning", "right", "select", "set", "then",
+    "union", "update", "using", "values", "when", "where", "window", "with"};
+
+// Return an identifier without its quotes, in lower case to compare it
+std::string unquoteLower(const std::string& aIdentifier)
+{
+    std::string identifier = aIdentifier;
+    if (!identifier.empty() && (identifier[0] == '"' || identifier[0] == '`' || identifier[0] == '['))
+    {
+        const char quote = (identifier[0] == '[') ? ']' : identifier[0];
+        std::string unquoted;
+        for (size_t i = 1; i + 1 < identifier.size(); ++i)
+        {
+            unquoted += identifier[i];
+            if (identifier[i] == quote && identifier[i + 1] == quote)
+            {
+                ++i;
+            }
+        }
+        identifier = unquoted;
+    }
+    std::transform(identifier.begin(), identifier.end(), identifier.begin(),
+                   [](const char c) { return static_cast<char>((c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c); });
+    return identifier;
+}
+
+// Return true if a token can be the name of a table, a column or an alias
+bool isName(const std::string& aToken)
+{
+    if (aToken.empty() || aToken == "?" || aToken == "...")
+    {
+        return false;
+    }
+    const unsigned char c = static_cast<unsigned char>(aToken[0]);
+    return ((c >= 'a' && c <= 'z') || c == '_' || c >= 0x80 || c == '"' || c == '`' || c == '[')
+        && (SQL_KEYWORDS.find(aToken) == SQL_KEYWORDS.end());
+}
+
+// Column of a table, with its actual case
+struct TableColumn
+{
+    std::string table;
+    std::string column;
+
+    bool operator==(const TableColumn& aOther) const
+    {
+        return (table == aOther.table) && (column == aOther.column);
+    }
+    std::string toString() const
+    {
+        return table + "." + column;
+    }
+};
+
+// Tables and indexes of the main database, to resolve the names found in the statements
+struct SchemaInfo
+{
+    struct Table
+    {
+        std::string                         name;           ///< Name, with its actual case
+        std::map<std::string, std::string>  columns;        ///< Actual name of each column, by lower case name
+        std::string                         primaryKey;     ///< First column of the primary key, in lower case
+        std::vector<std::vector<std::string>> indexes;      ///< Columns of each index, in lower case
+    };
+
+    std::map<std::string, Table>    tables;     ///< Ordinary tables, by lower case name
+
+    // Return the table of a lower case name, or nullptr
+    const Table* find(const std::string& aName) const
+    {
+        const auto iTable = tables.find(aName);
+        return (iTable != tables.end()) ? &iTable->second : nullptr;
+    }
+};
+
+// Load the tables of the main database, their columns and their indexes
+SchemaInfo loadSchema(const Database& aDatabase)
+{
+    SchemaInfo schema;
+    Statement tables(aDatabase, "SELECT name FROM main.sqlite_schema WHERE type = 'table' "
+                                "AND name NOT LIKE 'sqlite_%' AND sql NOT LIKE 'CREATE VIRTUAL TABLE%'");
+    while (tables.executeStep())
+    {
+        SchemaInfo::Table table;
+        table.name = tables.getColumn(0).getString();
+        Statement columns(aDatabase, "SELECT name, pk FROM pragma_table_info(?) ORDER BY pk");
+        columns.bind(1, table.name);
+        while (columns.executeStep())
+        {
+            const std::string column = columns.getColumn(0).getString();
+            table.columns[unquoteLower(column)] = column;
+            if (columns.getColumn(1).getInt() == 1)
+            {
+                table.primaryKey = unquoteLower(column);
+            }
+        }
+        Statement indexes(aDatabase, "SELECT l.name, i.name FROM pragma_index_list(?) AS l, "
+                                     "pragma_index_info(l.name) AS i ORDER BY l.seq, i.seqno");
+        indexes.bind(1, table.name);
+        std::string previous;
+        while (indexes.executeStep())
+        {
+            const std::string index = indexes.getColumn(0).getString();
+            if (index != previous || table.indexes.empty())
+            {
+                table.indexes.emplace_back();
+                previous = index;
+            }
+            table.indexes.back().push_back(unquoteLower(indexes.getColumn(1).getString()));
+        }
+        schema.tables[unquoteLower(table.name)] = table;
+    }
+    return schema;
+}
+
+// Columns and tables of a statement, found from its normalized SQL text
+struct StatementColumns
+{
+    std::map<std::string, std::string>  aliases;    ///< Lower case name of the table of each alias (or table name)
+    std::vector<TableColumn>            equalities; ///< Columns compared for equality, or joined
+    std::vector<TableColumn>            ranges;     ///< Columns compared by range
+    std::vector<TableColumn>            orderBy;    ///< Columns of the top-level ORDER BY, empty if not all columns
+};
+
+// Resolve a column reference of a statement to a column of a table of the schema
+bool resolveColumn(const SchemaInfo& aSchema, const StatementColumns& aStatement, const std::string& aQualifier,
+                   const std::string& aColumn, TableColumn& aResolved)
+{
+    const std::string column = unquoteLower(aColumn);
+    std::vector<const SchemaInfo::Table*> candidates;
+    if (!aQualifier.empty())
+    {
+        const auto iAlias = aStatement.aliases.find(unquoteLower(aQualifier));
+        candidates.push_back(aSchema.find((iAlias != aStatement.aliases.end()) ? iAlias->second
+                                                                                : unquoteLower(aQualifier)));
+    }
+    else
+    {
+        std::set<std::string> tables;
+        for (const auto& alias : aStatement.aliases)
+        {
+            if (tables.insert(alias.second).second)
+            {
+                candidates.push_back(aSchema.find(alias.second));
+            }
+        }
+    }
+    const SchemaInfo::Table* pFound = nullptr;
+    for (const SchemaInfo::Table* pTable : candidates)
+    {
+        if (pTable != nullptr && pTable->columns.count(column) > 0)
+        {
+            if (pFound != nullptr)
+            {
+                return false; // ambiguous
+            }
+            pFound = pTable;
+        }
+    }
+    if (pFound == nullptr)
+    {
+        return false;
+    }
+    aResolved.table = pFound->name;
+    aResolved.column = pFound->columns.at(column);
+    return true;
+}
+
+// Add a column to a list, if not already in it
+void addColumn(std::vector<TableColumn>& aColumns, const TableColumn& aColumn)
+{
+    if (std::find(aColumns.begin(), aColumns.end(), aColumn) == aColumns.end())
+    {
+        aColumns.push_back(aColumn);
+    }
+}
+
+// Parse a column reference "column" or "qualifier.column" at aIndex, returning the index past it or aIndex
+size_t parseColumnRef(const std::vector<std::string>& aTokens, const size_t aIndex,
+                      std::string& aQualifier, std::string& aColumn)
+{
+    if (aIndex >= aTokens.size() || !isName(aTokens[aIndex]) || (aIndex > 0 && aTokens[aIndex - 1] == "."))
+    {
+        return aIndex;
+    }
+    size_t end = aIndex + 1;
+    aQualifier.clear();
+    aColumn = aTokens[aIndex];
+    if (end + 1 < aTokens.size() && aTokens[end] == "." && isName(aTokens[end + 1]))
+    {
+        aQualifier = aColumn;
+        aColumn = aTokens[end + 1];
+        end += 2;
+    }
+    if (end < aTokens.size() && aTokens[end] == "(")
+    {
+        return aIndex; // function call
+    }
+    return end;
+}
+
+// Find the tables, and the columns of the WHERE, ON and ORDER BY clauses, from the tokens of a normalized statement
+StatementColumns parseStatement(const SchemaInfo& aSchema, const std::vector<std::string>& aTokens)
+{
+    static const std::set<std::string> TABLE_LISTS = {"from", "join", "update", "into"};
+    static const std::set<std::string> CLAUSES = {"select", "from", "where", "on", "group", "having", "order",
+                                                  "limit", "set", "values", "returning", "window", "using"};
+    static const std::set<std::string> EQUALITIES = {"=", "==", "is", "in"};
+    static const std::set<std::string> RANGES = {"<", ">", "<=", ">=", "between"};
+
+    const std::vector<std::string>& tokens = aTokens;
+    StatementColumns statement;
+
+    // Tables and their aliases
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        if (TABLE_LISTS.count(tokens[i]) == 0)
+        {
+            continue;
+        }
+        size_t j = i + 1;
+        while (j < tokens.size() && isName(tokens[j]))
+        {
+            std::string table = tokens[j];
+            ++j;
+            if (j + 1 < tokens.size() && tokens[j] == "." && isName(tokens[j + 1]))
+            {
+                table = tokens[j + 1]; // schema.table
+                j += 2;
+            }
+            std::string alias = table;
+            if (j + 1 < tokens.size() && tokens[j] == "as" && isName(tokens[j + 1]))
+            {
+                alias = tokens[j + 1];
+                j += 2;
+            }
+            else if (j < tokens.size() && isName(tokens[j]))
+            {
+                alias = tokens[j];
+                ++j;
+            }
+            statement.aliases[unquoteLower(alias)] = unquoteLower(table);
+            statement.aliases[unquoteLower(table)] = unquoteLower(table);
+            if (tokens[i] != "from" || j + 1 >= tokens.size() || tokens[j] != ",")
+            {
+                break;
+            }
+            ++j;
+        }
+    }
+
+    // Comparisons of the WHERE and ON clauses, in each level of parentheses
+    std::vector<std::string> clauses(1);
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        const std::string& token = tokens[i];
+        if (token == "(")
+        {
+            clauses.push_back(clauses.back());
+            continue;
+        }
+        if (token == ")")
+        {
+            if (clauses.size() > 1)
+            {
+                clauses.pop_back();
+            }
+            continue;
+        }
+        if (CLAUSES.count(token) > 0)
+        {
+            clauses.back() = token;
+            if (token == "order" && clauses.size() == 1 && i + 1 < tokens.size() && tokens[i + 1] == "by")
+            {
+                // Top-level ORDER BY: only plain columns can be served by an index
+                statement.orderBy.clear();
+                size_t j = i + 2;
+                bool bColumns = true;
+                while (bColumns)
+                {
+                    std::string qualifier;
+                    std::string column;
+                    const size_t end = parseColumnRef(tokens, j, qualifier, column);
+                    TableColumn resolved;
+                    bColumns = (end != j) && resolveColumn(aSchema, statement, qualifier, column, resolved);
+                    if (!bColumns)
+                    {
+                        statement.orderBy.clear();
+                        break;
+                    }
+                    addColumn(statement.orderBy, resolved);
+                    j = end;
+                    while (j < tokens.size() && (tokens[j] == "asc" || tokens[j] == "desc" || tokens[j] == "nulls"
+                                                 || tokens[j] == "first" || tokens[j] == "last"))
+                    {
+                        ++j;
+                    }
+                    bColumns = (j < tokens.size() && tokens[j] == ",");
+                    ++j;
+                }
+            }
+            continue;
+        }
+        if (clauses.back() != "where" && clauses.back() != "on")
+        {
+            continue;
+        }
+        std::string qualifier;
+        std::string column;
+        const size_t end = parseColumnRef(tokens, i, qualifier, column);
+        if (end == i)
+        {
+            continue;
+        }
+        TableColumn resolved;
+        if (resolveColumn(aSchema, statement, qualifier, column, resolved))
+        {
+            const std::string& next = (end < tokens.size()) ? tokens[end] : std::string();
+            const std::string& previous = (i > 0) ? tokens[i - 1] : std::string();
+            if (EQUALITIES.count(next) > 0 || previous == "=" || previous == "==")
+            {
+                addColumn(statement.equalities, resolved);
+            }
+            else if (RANGES.count(next) > 0 || RANGES.count(previous) > 0)
+            {
+                addColumn(statement.ranges, resolved);
+            }
+        }
+        i = end - 1;
+    }
+    return statement;
+}
+
+// Counters of an execution of a statement
+struct StatementCounters
+{
+    int64_t fullScanSteps = 0;
+    int64_t autoIndexRows = 0;
+    int64_t sorts = 0;
+    int64_t vmSteps = 0;
+};
+
+// Name of the candidate index created on the scratch copy
+const char* const ADVICE_INDEX = "sqlitecpp_advice_index";
+
+// Maximum size of a database copied in memory, for want of IndexAdviceOptions::scratchFilename
+const int64_t MAX_MEMORY_SCRATCH_SIZE = 64 * 1024 * 1024;
+
+// Return the integer value of a pragma
+int64_t getPragma(const Database& aDatabase, const std::string& aPragma)
+{
+    Statement query(aDatabase, "PRAGMA " + aPragma);
+    (void)query.executeStep();
+    return query.getColumn(0).getInt64();
+}
+
+// Run a statement to its end in a savepoint rolled back, and return its counters
+StatementCounters measure(Database& aScratch, const std::string& aSql)
+{
+    aScratch.exec("SAVEPOINT sqlitecpp_advice");
+    StatementCounters counters;
+    sqlite3_stmt* pStmt = nullptr;
+    int ret = sqlite3_prepare_v2(aScratch.getHandle(), aSql.c_str(), static_cast<int>(aSql.size()), &pStmt, nullptr);
+    if (ret == SQLITE_OK)
+    {
+        do
+        {
+            ret = sqlite3_step(pStmt);
+        } while (ret == SQLITE_ROW);
+        counters.fullScanSteps = sqlite3_stmt_status(pStmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 0);
+        counters.autoIndexRows = sqlite3_stmt_status(pStmt, SQLITE_STMTSTATUS_AUTOINDEX, 0);
+        counters.sorts = sqlite3_stmt_status(pStmt, SQLITE_STMTSTATUS_SORT, 0);
+        counters.vmSteps = sqlite3_stmt_status(pStmt, SQLITE_STMTSTATUS_VM_STEP, 0);
+        ret = (ret == SQLITE_DONE) ? SQLITE_OK : ret;
+    }
+    const std::string message = (ret != SQLITE_OK) ? sqlite3_errmsg(aScratch.getHandle()) : "";
+    sqlite3_finalize(pStmt);
+    aScratch.exec("ROLLBACK TO sqlitecpp_advice; RELEASE sqlitecpp_advice");
+    if (ret != SQLITE_OK)
+    {
+        throw SQLite::Exception(message, ret);
+    }
+    return counters;
+}
+
+// Return true for the statements analyzed by indexAdvice(), reading or writing rows
+bool isAdvisable(const std::string& aNormalizedSql)
+{
+    static const char* const KEYWORDS[] = {"select ", "with ", "insert ", "replace ", "update ", "delete "};
+    for (const char* pKeyword : KEYWORDS)
+    {
+        if (aNormalizedSql.compare(0, std::strlen(pKeyword), pKeyword) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+// Propose indexes for a workload, from the full scans and temporary b-trees of its query plans.
+IndexAdvice adviseIndexes(Database& aDatabase, const std::vector<std::string>& aWorkload,
+                          const IndexAdviceOptions& aOptions /* = IndexAdviceOptions() */)
+{
+    IndexAdvice advice;
+    const SchemaInfo schema = loadSchema(aDatabase);
+
+    // Group the statements by fingerprint
+    std::map<uint64_t, size_t> queryIndexes;
+    for (const std::string& sql : aWorkload)
+    {
+        Fingerprint fingerprint = getFingerprint(sql);
+        if (!isAdvisable(fingerprint.normalized))
+        {
+            continue;
+        }
+        const auto iQuery = queryIndexes.insert(std::make_pair(fingerprint.hash, advice.queries.size()));
+        if (iQuery.second)
+        {
+            QueryAdvice query;
+            query.fingerprint = std::move(fingerprint.normalized);
+            query.sql = sql;
+            advice.queries.push_back(std::move(query));
+        }
+        ++advice.queries[iQuery.first->second].executions;
+    }
+    std::stable_sort(advice.queries.begin(), advice.queries.end(),
+                     [](const QueryAdvice& aLeft, const QueryAdvice& aRight)
+                     {
+                         return aLeft.executions > aRight.executions;
+                     });
+
+    // Plans, tables scanned and columns involved, and the candidate index of each table scanned
+    std::set<std::string> usedIndexes;
+    std::vector<IndexCandidate> candidates;
+    for (QueryAdvice& query : advice.queries)
+    {
+        QueryPlan plan;
+        try
+        {
+            plan = explainQueryPlan(aDatabase, query.sql);
+        }
+        catch (const Exception& e)
+        {
+            query.error = e.what();
+            continue;
+        }
+        const StatementColumns columns = parseStatement(schema, getFingerprintTokens(query.sql));
+        bool bSortedByTempBTree = false;
+        for (const QueryPlan::Step& step : plan.steps)
+        {
+            query.plan.push_back(step.detail);
+            bSortedByTempBTree |= (step.detail.find("TEMP B-TREE FOR ORDER BY") != std::string::npos)
+                               || (step.detail.find("TEMP B-TREE FOR RIGHT PART OF ORDER BY") != std::string::npos);
+        }
+        for (const std::string& index : plan.getIndexes())
+        {
+            usedIndexes.insert(unquoteLower(index));
+        }
+        std::vector<std::string> tables;
+        for (const QueryPlan::Access& access : plan.getAccesses())
+        {
+            const std::string name = unquoteLower(access.table);
+            const auto iAlias = columns.aliases.find(name);
+            const SchemaInfo::Table* pTable = schema.find((iAlias != columns.aliases.end()) ? iAlias->second : name);
+            if (pTable != nullptr && (access.bFullScan || access.bAutomatic)
+                && std::find(tables.begin(), tables.end(), pTable->name) == tables.end())
+            {
+                tables.push_back(pTable->name);
+            }
+        }
+        if (bSortedByTempBTree && !columns.orderBy.empty())
+        {
+            const std::string& table = columns.orderBy.front().table;
+            const bool bOneTable = std::all_of(columns.orderBy.begin(), columns.orderBy.end(),
+                                               [&table](const TableColumn& aColumn) { return aColumn.table == table; });
+            if (bOneTable && std::find(tables.begin(), tables.end(), table) == tables.end())
+            {
+                tables.push_back(table);
+            }
+        }
+        query.scannedTables = tables;
+        for (const TableColumn& column : columns.equalities)
+        {
+            query.whereColumns.push_back(column.toString());
+        }
+        for (const TableColumn& column : columns.ranges)
+        {
+            query.whereColumns.push_back(column.toString());
+        }
+        for (const TableColumn& column : columns.orderBy)
+        {
+            query.orderByColumns.push_back(column.toString());
+        }
+
+        for (const std::string& table : tables)
+        {
+            // Columns compared for equality, then the ORDER BY columns to avoid the sort, or else a range
+            std::vector<std::string> indexColumns;
+            for (const TableColumn& column : columns.equalities)
+            {
+                if (column.table == table)
+                {
+                    indexColumns.push_back(column.column);
+                }
+            }
+            const bool bOrderBy = bSortedByTempBTree && !columns.orderBy.empty()
+                && std::all_of(columns.orderBy.begin(), columns.orderBy.end(),
+                               [&table](const TableColumn& aColumn) { return aColumn.table == table; });
+            if (bOrderBy)
+            {
+                for (const TableColumn& column : columns.orderBy)
+                {
+                    if (std::find(indexColumns.begin(), indexColumns.end(), column.column) == indexColumns.end())
+                    {
+                        indexColumns.push_back(column.column);
+                    }
+                }
+            }
+            else
+            {
+                for (const TableColumn& column : columns.ranges)
+                {
+                    if (column.table == table
+                        && std::find(indexColumns.begin(), indexColumns.end(), column.column) == indexColumns.end())
+                    {
+                        indexColumns.push_back(column.column);
+                        break;
+                    }
+                }
+            }
+            if (indexColumns.empty())
+            {
+                continue;
+            }
+
+            // Not already indexed by the primary key or by an index starting with the same columns
+            const SchemaInfo::Table& info = *schema.find(unquoteLower(table));
+            std::vector<std::string> lowerColumns;
+            for (const std::string& column : indexColumns)
+            {
+                lowerColumns.push_back(unquoteLower(column));
+            }
+            bool bIndexed = (lowerColumns.front() == info.primaryKey);
+            for (const std::vector<std::string>& index : info.indexes)
+            {
+                bIndexed |= (index.size() >= lowerColumns.size())
+                         && std::equal(lowerColumns.begin(), lowerColumns.end(), index.begin());
+            }
+            if (bIndexed)
+            {
+                continue;
+            }
+
+            auto iCandidate = std::find_if(candidates.begin(), candidates.end(),
+                                           [&](const IndexCandidate& aCandidate)
+                                           {
+                                               return aCandidate.table == table && aCandidate.columns == indexColumns;
+                                           });
+            if (iCandidate == candidates.end())
+            {
+                IndexCandidate candidate;
+                candidate.table = table;
+                candidate.columns = indexColumns;
+                std::string name = "idx_" + table;
+                std::string columnList;
+                for (const std::string& column : indexColumns)
+                {
+                    name += "_" + column;
+                    columnList += (columnList.empty() ? "" : ", ") + quote(column);
+                }
+                candidate.sql = "CREATE INDEX " + quote(name) + " ON " + quote(table) + " (" + columnList + ")";
+                iCandidate = candidates.insert(candidates.end(), candidate);
+            }
+            iCandidate->queries.push_back(query.fingerprint);
+        }
+    }
+
+    // Indexes used by no plan, but the ones enforcing a UNIQUE constraint
+    Statement indexes(aDatabase, "SELECT s.name FROM main.sqlite_schema AS s, pragma_index_list(s.tbl_name) AS l "
+                             "WHERE s.type = 'index' AND s.sql IS NOT NULL AND l.name = s.name AND l.\"unique\" = 0 "
+                             "ORDER BY s.name");
+    while (indexes.executeStep())
+    {
+        const std::string index = indexes.getColumn(0).getString();
+        if (usedIndexes.count(unquoteLower(index)) == 0)
+        {
+            advice.unusedIndexes.push_back(index);
+        }
+    }
+
+    if (aOptions.bEstimate && !advice.queries.empty())
+    {
+        // Measure the statements on a scratch copy, without and then with each candidate index
+        std::unique_ptr<Database> pScratch;
+        if (aOptions.scratchFilename.empty())
+        {
+            const int64_t size = getPragma(aDatabase, "main.page_count") * getPragma(aDatabase, "main.page_size");
+            if (size > MAX_MEMORY_SCRATCH_SIZE)
+            {
+                throw SQLite::Exception("Database too large to be copied in memory, set a scratch filename");
+            }
+            pScratch.reset(new Database(":memory:", OPEN_READWRITE | OPEN_CREATE));
+            Backup backup(*pScratch, aDatabase);
+            backup.executeStep();
+        }
+        else
+        {
+            aDatabase.cloneTo(aOptions.scratchFilename);
+            pScratch.reset(new Database(aOptions.scratchFilename, OPEN_READWRITE));
+        }
+        std::map<std::string, const QueryAdvice*> queries;
+        for (QueryAdvice& query : advice.queries)
+        {
+            if (query.error.empty())
+            {
+                try
+                {
+                    const StatementCounters counters = measure(*pScratch, query.sql);
+                    query.fullScanSteps = counters.fullScanSteps;
+                    query.autoIndexRows = counters.autoIndexRows;
+                    query.sorts = counters.sorts;
+                    query.vmSteps = counters.vmSteps;
+                    queries[query.fingerprint] = &query;
+                }
+                catch (const Exception& e)
+                {
+                    query.error = e.what();
+                }
+            }
+        }
+        std::vector<IndexCandidate> estimated;
+        for (IndexCandidate& candidate : candidates)
+        {
+            std::string columnList;
+            for (const std::string& column : candidate.columns)
+            {
+                columnList += (columnList.empty() ? "" : ", ") + quote(column);
+            }
+            pScratch->exec(std::string("CREATE INDEX ") + ADVICE_INDEX + " ON " + quote(candidate.table) +
+                           " (" + columnList + ")");
+            bool bUsed = false;
+            for (const std::string& fingerprint : candidate.queries)
+            {
+                const auto iQuery = queries.find(fingerprint);
+                if (iQuery == queries.end())
+                {
+                    continue;
+                }
+                const QueryAdvice& query = *iQuery->second;
+                const StatementCounters counters = measure(*pScratch, query.sql);
+                bUsed |= explainQueryPlan(*pScratch, query.sql).usesIndex(ADVICE_INDEX);
+                candidate.stepsBefore += query.vmSteps * query.executions;
+                candidate.stepsAfter += counters.vmSteps * query.executions;
+            }
+            pScratch->exec(std::string("DROP INDEX ") + ADVICE_INDEX);
+            if (bUsed && candidate.stepsAfter < candidate.stepsBefore)
+            {
+                candidate.benefit = static_cast<double>(candidate.stepsBefore - candidate.stepsAfter) /
+                                    candidate.stepsBefore;
+                estimated.push_back(candidate);
+            }
+        }
+        candidates = estimated;
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [](const IndexCandidate& aLeft, const IndexCandidate& aRight)
+                         {
+                             return (aLeft.stepsBefore - aLeft.stepsAfter) > (aRight.stepsBefore - aRight.stepsAfter);
+                         });
+    }
+    advice.candidates = candidates;
+    return advice;
+}
+
+}  // namespace SQLite
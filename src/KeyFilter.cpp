@@ -0,0 +1,635 @@
+/**
+ * @file    KeyFilter.cpp
+ * @ingroup SQLiteCpp
+ * @brief   In-memory blocked Bloom filter on a key column, to skip lookups of keys that do not exist.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/KeyFilter.h>
+
+#include <SQLiteCpp/Quote.h>
+#include <SQLiteCpp/Statement.h>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <thread>
+
+namespace SQLite
+{
+
+namespace
+{
+
+const uint64_t BLOCK_WORDS = 8;   // 512 bits blocks, the size of a cache line
+
+// Finalization of MurmurHash3, to spread all the input bits over all the output bits
+uint64_t mix64(uint64_t aValue) noexcept
+{
+    aValue ^= aValue >> 33;
+    aValue *= 0xff51afd7ed558ccdULL;
+    aValue ^= aValue >> 33;
+    aValue *= 0xc4ceb9fe1a85ec53ULL;
+    aValue ^= aValue >> 33;
+    return aValue;
+}
+
+uint64_t hashInteger(const int64_t aValue) noexcept
+{
+    return mix64(static_cast<uint64_t>(aValue) + 0x9e3779b97f4a7c15ULL);
+}
+
+// FNV-1a, finalized by mix64()
+uint64_t hashBytes(const void* apData, const size_t aSize) noexcept
+{
+    const unsigned char* pData = static_cast<const unsigned char*>(apData);
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < aSize; ++i)
+    {
+        hash = (hash ^ pData[i]) * 0x100000001b3ULL;
+    }
+    return mix64(hash);
+}
+
+// A real value equal to an integer is equal to this integer in SQL, so it shall have the same hash
+uint64_t hashReal(const double aValue) noexcept
+{
+    if (aValue >= -9.2e18 && aValue <= 9.2e18 && std::floor(aValue) == aValue)
+    {
+        return hashInteger(static_cast<int64_t>(aValue));
+    }
+    return hashBytes(&aValue, sizeof(aValue));
+}
+
+unsigned popCount(uint64_t aWord) noexcept
+{
+    aWord = aWord - ((aWord >> 1) & 0x5555555555555555ULL);
+    aWord = (aWord & 0x3333333333333333ULL) + ((aWord >> 2) & 0x3333333333333333ULL);
+    aWord = (aWord + (aWord >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return static_cast<unsigned>((aWord * 0x0101010101010101ULL) >> 56);
+}
+
+// The block of a key is chosen with the high bits of its hash, and its bits in the block with the low bits
+size_t findBlock(const uint64_t aNbBlocks, const uint64_t aHash) noexcept
+{
+    return static_cast<size_t>(((aHash >> 32) * aNbBlocks >> 32) * BLOCK_WORDS);
+}
+
+void orWord(uint64_t& aWord, const uint64_t aMask) noexcept
+{
+    aWord |= aMask;
+}
+
+// Words shared by the threads of a parallel build
+void orWord(std::atomic<uint64_t>& aWord, const uint64_t aMask) noexcept
+{
+    aWord.fetch_or(aMask, std::memory_order_relaxed);
+}
+
+template<typename Word>
+void setBits(Word* apBits, const uint64_t aNbBlocks, const int aNbHashes, const uint64_t aHash) noexcept
+{
+    Word* pBlock = apBits + findBlock(aNbBlocks, aHash);
+    const uint32_t h1 = static_cast<uint32_t>(aHash);
+    const uint32_t h2 = static_cast<uint32_t>((aHash * 0x9e3779b97f4a7c15ULL) >> 32) | 1;
+    for (int i = 0; i < aNbHashes; ++i)
+    {
+        const uint32_t bit = (h1 + static_cast<uint32_t>(i) * h2) & 511;
+        orWord(pBlock[bit >> 6], 1ULL << (bit & 63));
+    }
+}
+
+bool testBits(const std::vector<uint64_t>& aBits, const uint64_t aNbBlocks, const int aNbHashes,
+              const uint64_t aHash) noexcept
+{
+    const uint64_t* pBlock = &aBits[findBlock(aNbBlocks, aHash)];
+    const uint32_t h1 = static_cast<uint32_t>(aHash);
+    const uint32_t h2 = static_cast<uint32_t>((aHash * 0x9e3779b97f4a7c15ULL) >> 32) | 1;
+    for (int i = 0; i < aNbHashes; ++i)
+    {
+        const uint32_t bit = (h1 + static_cast<uint32_t>(i) * h2) & 511;
+        if (0 == (pBlock[bit >> 6] & (1ULL << (bit & 63))))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Call a function with the hash of the key column of all the rows of a query, skipping the NULL keys
+template<typename Function>
+void forEachKey(Statement& aQuery, Function aFunction)
+{
+    while (aQuery.executeStep())
+    {
+        const Column key = aQuery.getColumn(0);
+        switch (key.getType())
+        {
+        case SQLITE_INTEGER: aFunction(hashInteger(key.getInt64()));               break;
+        case SQLITE_FLOAT:   aFunction(hashReal(key.getDouble()));                 break;
+        case SQLITE_NULL:    break; // NULL is never equal to any key
+        default:             aFunction(hashBytes(key.getBlob(), key.getBytes())); break;
+        }
+    }
+}
+
+bool equalsNoCase(const std::string& aLeft, const char* apRight)
+{
+    return sqlite3_stricmp(aLeft.c_str(), apRight) == 0;
+}
+
+// Test if a text is a well-formed decimal integer or real literal, that SQLite converts to a number
+// when stored into a column with a numeric affinity (see https://www.sqlite.org/datatype3.html)
+bool isNumeric(const std::string& aText, bool& abIsInteger) noexcept
+{
+    size_t i = 0;
+    while (i < aText.size() && std::isspace(static_cast<unsigned char>(aText[i])))
+    {
+        ++i;
+    }
+    if (i < aText.size() && (aText[i] == '+' || aText[i] == '-'))
+    {
+        ++i;
+    }
+    size_t nbDigits = 0;
+    for (; i < aText.size() && std::isdigit(static_cast<unsigned char>(aText[i])); ++i)
+    {
+        ++nbDigits;
+    }
+    abIsInteger = true;
+    if (i < aText.size() && aText[i] == '.')
+    {
+        abIsInteger = false;
+        for (++i; i < aText.size() && std::isdigit(static_cast<unsigned char>(aText[i])); ++i)
+        {
+            ++nbDigits;
+        }
+    }
+    if (0 == nbDigits)
+    {
+        return false;
+    }
+    if (i < aText.size() && (aText[i] == 'e' || aText[i] == 'E'))
+    {
+        abIsInteger = false;
+        ++i;
+        if (i < aText.size() && (aText[i] == '+' || aText[i] == '-'))
+        {
+            ++i;
+        }
+        if (i >= aText.size() || !std::isdigit(static_cast<unsigned char>(aText[i])))
+        {
+            return false;
+        }
+        while (i < aText.size() && std::isdigit(static_cast<unsigned char>(aText[i])))
+        {
+            ++i;
+        }
+    }
+    while (i < aText.size() && std::isspace(static_cast<unsigned char>(aText[i])))
+    {
+        ++i;
+    }
+    return i == aText.size();
+}
+
+} // namespace
+
+// Attach a filter to the key column of a table, loading it if saved before, else building it.
+KeyFilter::KeyFilter(Database& aDatabase, const std::string& aTable, const std::string& aColumn,
+                     const double aFalsePositiveRate /* = 0.01 */, const unsigned aNbThreads /* = 0 */) :
+    mDatabase(aDatabase),
+    mTable(aTable),
+    mColumn(aColumn),
+    mFalsePositiveRate(aFalsePositiveRate)
+{
+    if (!(aFalsePositiveRate > 0.0 && aFalsePositiveRate < 1.0))
+    {
+        throw SQLite::Exception("False positive rate shall be in the ]0, 1[ range.");
+    }
+
+    // Apply the affinity rules of https://www.sqlite.org/datatype3.html#determination_of_column_affinity
+    mbIsRowid = equalsNoCase(mColumn, "rowid") || equalsNoCase(mColumn, "oid") || equalsNoCase(mColumn, "_rowid_");
+    if (mbIsRowid)
+    {
+        mAffinity = Affinity::Numeric;
+    }
+    else
+    {
+        Statement columns(mDatabase, "SELECT upper(type) FROM pragma_table_info(?) WHERE name = ? COLLATE NOCASE");
+        columns.bind(1, mTable);
+        columns.bind(2, mColumn);
+        if (!columns.executeStep())
+        {
+            throw SQLite::Exception("No such column " + mTable + "." + mColumn);
+        }
+        const std::string type = columns.getColumn(0).getString();
+        if (type.find("INT") != std::string::npos)
+        {
+            mAffinity = Affinity::Numeric;
+        }
+        else if (type.find("CHAR") != std::string::npos || type.find("CLOB") != std::string::npos ||
+                 type.find("TEXT") != std::string::npos)
+        {
+            mAffinity = Affinity::Text;
+        }
+        else if (type.empty() || type.find("BLOB") != std::string::npos)
+        {
+            mAffinity = Affinity::None;
+        }
+        else
+        {
+            mAffinity = Affinity::Numeric;
+        }
+    }
+    {
+        // A WITHOUT ROWID table fails to prepare a query on its rowid
+        sqlite3_stmt* pStmt = nullptr;
+        mbHasRowid = mbIsRowid || (SQLITE_OK == sqlite3_prepare_v2(mDatabase.getHandle(),
+                                                                  ("SELECT rowid FROM " + quote(mTable)).c_str(),
+                                                                  -1, &pStmt, nullptr));
+        sqlite3_finalize(pStmt);
+    }
+
+    if (!load())
+    {
+        build(aNbThreads);
+    }
+
+    // Keep the filter current with the keys inserted or updated through this connection
+    char name[64];
+    sqlite3_snprintf(sizeof(name), name, "sqlitecpp_keyfilter_%p", static_cast<void*>(this));
+    mFunctionName = name;
+    mDatabase.createFunction(mFunctionName.c_str(), 1, false, this, &KeyFilter::addFunction);
+    const std::string call = " BEGIN SELECT " + mFunctionName + "(NEW." + quote(mColumn) + "); END";
+    mDatabase.exec("CREATE TEMP TRIGGER " + quote(mFunctionName + "_insert") +
+                   " AFTER INSERT ON main." + quote(mTable) + call);
+    mDatabase.exec("CREATE TEMP TRIGGER " + quote(mFunctionName + "_update") +
+                   (mbIsRowid ? " AFTER UPDATE ON main." : " AFTER UPDATE OF " + quote(mColumn) + " ON main.") +
+                   quote(mTable) + call);
+}
+
+// Detach the filter from the connection (drop its triggers and SQL function).
+KeyFilter::~KeyFilter()
+{
+    if (!mFunctionName.empty())
+    {
+        mpLookup.reset();
+        mDatabase.tryExec("DROP TRIGGER IF EXISTS temp." + quote(mFunctionName + "_insert"));
+        mDatabase.tryExec("DROP TRIGGER IF EXISTS temp." + quote(mFunctionName + "_update"));
+        sqlite3_create_function_v2(mDatabase.getHandle(), mFunctionName.c_str(), 1, SQLITE_UTF8,
+                                   nullptr, nullptr, nullptr, nullptr, nullptr);
+    }
+}
+
+// Return false if the integer key is definitely not in the table.
+bool KeyFilter::mayContain(const int64_t aKey) const noexcept
+{
+    if (mAffinity == Affinity::Text)
+    {
+        const std::string text = std::to_string(aKey);
+        return test(hashBytes(text.data(), text.size()));
+    }
+    return test(hashInteger(aKey));
+}
+
+// Return false if the text key is definitely not in the table.
+bool KeyFilter::mayContain(const std::string& aKey) const noexcept
+{
+    bool bIsInteger = false;
+    if (mAffinity == Affinity::Numeric && isNumeric(aKey, bIsInteger))
+    {
+        // A text looking like a number is compared as an integer, or else as a real, to a column with
+        // a numeric affinity, the integers too large for 64 bits being converted to reals
+        if (bIsInteger)
+        {
+            errno = 0;
+            const long long value = std::strtoll(aKey.c_str(), nullptr, 10);
+            if (errno == 0)
+            {
+                return test(hashInteger(value));
+            }
+        }
+        return test(hashReal(std::strtod(aKey.c_str(), nullptr)));
+    }
+    return test(hashBytes(aKey.data(), aKey.size()));
+}
+
+// Return false if the blob key is definitely not in the table.
+bool KeyFilter::mayContain(const void* apKey, const size_t aSize) const noexcept
+{
+    return test(hashBytes(apKey, aSize));
+}
+
+// Test if a key exists in the table, querying the table only if mayContain() returns true.
+bool KeyFilter::contains(const int64_t aKey)
+{
+    if (!mayContain(aKey))
+    {
+        ++mNbFiltered;
+        return false;
+    }
+    if (!mpLookup)
+    {
+        mpLookup.reset(new Statement(mDatabase, "SELECT 1 FROM " + quote(mTable) +
+                                                " WHERE " + quote(mColumn) + " = ? LIMIT 1"));
+    }
+    mpLookup->bind(1, aKey);
+    return lookup();
+}
+
+// Test if a key exists in the table, querying the table only if mayContain() returns true.
+bool KeyFilter::contains(const std::string& aKey)
+{
+    if (!mayContain(aKey))
+    {
+        ++mNbFiltered;
+        return false;
+    }
+    if (!mpLookup)
+    {
+        mpLookup.reset(new Statement(mDatabase, "SELECT 1 FROM " + quote(mTable) +
+                                                " WHERE " + quote(mColumn) + " = ? LIMIT 1"));
+    }
+    mpLookup->bind(1, aKey);
+    return lookup();
+}
+
+// Query the table for the key bound to the lookup statement, and update the statistics.
+bool KeyFilter::lookup()
+{
+    const bool bExists = mpLookup->executeStep();
+    mpLookup->reset();
+    if (!bExists)
+    {
+        ++mNbFalsePositives;
+    }
+    return bExists;
+}
+
+// (Re)build the filter from a full scan of the table.
+void KeyFilter::build(unsigned aNbThreads /* = 0 */)
+{
+    if (0 == aNbThreads)
+    {
+        aNbThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    reset(static_cast<uint64_t>(mDatabase.execAndGet("SELECT count(*) FROM " + quote(mTable)).getInt64()));
+
+    const std::string select = "SELECT " + quote(mColumn) + " FROM " + quote(mTable);
+    const char* pFilename = sqlite3_db_filename(mDatabase.getHandle(), "main");
+    const bool bParallel = (aNbThreads > 1) && mbHasRowid && (nullptr != pFilename) && ('\0' != pFilename[0]) &&
+                           (0 != sqlite3_get_autocommit(mDatabase.getHandle()));
+    if (!bParallel)
+    {
+        Statement query(mDatabase, select);
+        forEachKey(query, [this](const uint64_t aHash) { add(aHash); });
+        return;
+    }
+
+    // Partition the rowid range, and scan each partition with its own read-only connection
+    Statement range(mDatabase, "SELECT min(rowid), max(rowid) FROM " + quote(mTable));
+    (void)range.executeStep();
+    if (range.isColumnNull(0))
+    {
+        return; // empty table
+    }
+    const int64_t first = range.getColumn(0).getInt64();
+    const int64_t last = range.getColumn(1).getInt64();
+    range.reset();
+    // Offsets from the first rowid are unsigned, as the rowid range can span the whole int64 range
+    const uint64_t span = static_cast<uint64_t>(last) - static_cast<uint64_t>(first);
+    const uint64_t width = (span / aNbThreads) + 1;
+
+    // All the threads set the bits of a single shared copy of the filter
+    const std::string filename(pFilename);
+    std::vector<std::atomic<uint64_t>> shared(mBits.size());
+    std::vector<uint64_t> counts(aNbThreads, 0);
+    std::vector<std::exception_ptr> errors(aNbThreads);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < aNbThreads; ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            try
+            {
+                if (t > span / width)
+                {
+                    return; // no more rows
+                }
+                const uint64_t offset = width * t;
+                const int64_t begin = static_cast<int64_t>(static_cast<uint64_t>(first) + offset);
+                const int64_t end = (span - offset < width) ? last
+                                  : static_cast<int64_t>(static_cast<uint64_t>(begin) + (width - 1));
+                Database connection(filename, SQLite::OPEN_READONLY);
+                Statement query(connection, select + " WHERE rowid BETWEEN ? AND ?");
+                query.bind(1, begin);
+                query.bind(2, end);
+                forEachKey(query, [&](const uint64_t aHash)
+                {
+                    setBits(shared.data(), mNbBlocks, mNbHashes, aHash);
+                    ++counts[t];
+                });
+            }
+            catch (...)
+            {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    for (unsigned t = 0; t < aNbThreads; ++t)
+    {
+        if (errors[t])
+        {
+            std::rethrow_exception(errors[t]);
+        }
+        mNbKeys += counts[t];
+    }
+    for (size_t i = 0; i < mBits.size(); ++i)
+    {
+        mBits[i] = shared[i].load(std::memory_order_relaxed);
+    }
+}
+
+// Persist the filter to the side table "sqlitecpp_keyfilter", for a fast startup.
+void KeyFilter::save()
+{
+    mDatabase.exec("CREATE TABLE IF NOT EXISTS sqlitecpp_keyfilter (name TEXT PRIMARY KEY, "
+                   "nb_hashes INTEGER NOT NULL, nb_keys INTEGER NOT NULL, stale INTEGER NOT NULL, "
+                   "bits BLOB NOT NULL)");
+
+    // Persistent triggers flag the saved filter as stale on the first key added by any connection
+    // (a deleted key is only a false positive), so that load() does not have to read the key column
+    const std::string flag = " BEGIN UPDATE sqlitecpp_keyfilter SET stale = 1 WHERE name = " +
+                             quoteLiteral(getSavedName()) + " AND stale = 0; END";
+    mDatabase.exec("CREATE TRIGGER IF NOT EXISTS " + quote(getTriggerName("insert")) +
+                   " AFTER INSERT ON " + quote(mTable) + flag);
+    mDatabase.exec("CREATE TRIGGER IF NOT EXISTS " + quote(getTriggerName("update")) +
+                   (mbIsRowid ? " AFTER UPDATE ON " : " AFTER UPDATE OF " + quote(mColumn) + " ON ") +
+                   quote(mTable) + flag);
+
+    // Serialize the words in little endian order, to be portable
+    std::vector<unsigned char> bytes(mBits.size() * sizeof(uint64_t));
+    for (size_t i = 0; i < mBits.size(); ++i)
+    {
+        for (size_t b = 0; b < sizeof(uint64_t); ++b)
+        {
+            bytes[i * sizeof(uint64_t) + b] = static_cast<unsigned char>(mBits[i] >> (8 * b));
+        }
+    }
+
+    Statement insert(mDatabase, "INSERT OR REPLACE INTO sqlitecpp_keyfilter VALUES (?, ?, ?, ?, ?)");
+    insert.bind(1, getSavedName());
+    insert.bind(2, mNbHashes);
+    insert.bind(3, static_cast<int64_t>(mNbKeys));
+    insert.bind(4, 0);
+    insert.bindNoCopy(5, bytes.data(), static_cast<int>(bytes.size()));
+    insert.exec();
+}
+
+// Load the filter persisted by save(), if it is still current.
+bool KeyFilter::load()
+{
+    if (!mDatabase.tableExists("sqlitecpp_keyfilter"))
+    {
+        return false;
+    }
+    // The triggers flagging the saved filter as stale are dropped with the table, if it was recreated since save()
+    Statement triggers(mDatabase, "SELECT count(*) FROM sqlite_master WHERE type = 'trigger' AND name IN (?, ?)");
+    triggers.bind(1, getTriggerName("insert"));
+    triggers.bind(2, getTriggerName("update"));
+    (void)triggers.executeStep(); // Cannot return false, as the above query always return a result
+    if (2 != triggers.getColumn(0).getInt())
+    {
+        return false;
+    }
+    Statement select(mDatabase, "SELECT nb_hashes, nb_keys, bits FROM sqlitecpp_keyfilter "
+                                "WHERE name = ? AND stale = 0");
+    select.bind(1, getSavedName());
+    if (!select.executeStep())
+    {
+        return false;
+    }
+    const Column bits = select.getColumn(2);
+    const size_t size = static_cast<size_t>(bits.getBytes());
+    if ((0 == size) || (0 != size % (BLOCK_WORDS * sizeof(uint64_t))))
+    {
+        return false;
+    }
+
+    const unsigned char* pBytes = static_cast<const unsigned char*>(bits.getBlob());
+    mBits.assign(size / sizeof(uint64_t), 0);
+    for (size_t i = 0; i < mBits.size(); ++i)
+    {
+        for (size_t b = 0; b < sizeof(uint64_t); ++b)
+        {
+            mBits[i] |= static_cast<uint64_t>(pBytes[i * sizeof(uint64_t) + b]) << (8 * b);
+        }
+    }
+    mNbBlocks = mBits.size() / BLOCK_WORDS;
+    mNbHashes = select.getColumn(0).getInt();
+    mNbKeys = static_cast<uint64_t>(select.getColumn(1).getInt64());
+    return true;
+}
+
+// Return the false positive rate expected from the current fill ratio of the filter.
+double KeyFilter::getEstimatedFalsePositiveRate() const noexcept
+{
+    // A key is tested in a single block, so this is the mean over the blocks of the probability of a false positive
+    double sum = 0.0;
+    for (uint64_t block = 0; block < mNbBlocks; ++block)
+    {
+        unsigned nbSet = 0;
+        for (uint64_t w = 0; w < BLOCK_WORDS; ++w)
+        {
+            nbSet += popCount(mBits[block * BLOCK_WORDS + w]);
+        }
+        sum += std::pow(nbSet / 512.0, mNbHashes);
+    }
+    return (mNbBlocks > 0) ? (sum / static_cast<double>(mNbBlocks)) : 0.0;
+}
+
+// Return the measured rate of contains() calls for absent keys that were not filtered out.
+double KeyFilter::getObservedFalsePositiveRate() const noexcept
+{
+    const uint64_t nbAbsent = mNbFiltered + mNbFalsePositives;
+    return (nbAbsent > 0) ? (static_cast<double>(mNbFalsePositives) / static_cast<double>(nbAbsent)) : 0.0;
+}
+
+// Size the filter for the given number of keys, clearing all its bits.
+void KeyFilter::reset(const uint64_t aNbKeys)
+{
+    // Optimal number of bits per key and of hashes of a standard Bloom filter,
+    // plus 20% of bits to compensate for the uneven load of the blocks
+    const double ln2 = std::log(2.0);
+    const double bitsPerKey = -std::log(mFalsePositiveRate) / (ln2 * ln2);
+    mNbHashes = std::max(1, std::min(16, static_cast<int>(std::lround(bitsPerKey * ln2))));
+    const double nbBits = static_cast<double>(std::max<uint64_t>(aNbKeys, 1024)) * bitsPerKey * 1.2;
+    mNbBlocks = static_cast<uint64_t>(std::ceil(nbBits / 512.0));
+    mBits.assign(mNbBlocks * BLOCK_WORDS, 0);
+    mNbKeys = 0;
+}
+
+// Set the bits of a key hash.
+void KeyFilter::add(const uint64_t aHash) noexcept
+{
+    setBits(mBits.data(), mNbBlocks, mNbHashes, aHash);
+    ++mNbKeys;
+}
+
+// Test the bits of a key hash.
+bool KeyFilter::test(const uint64_t aHash) const noexcept
+{
+    return testBits(mBits, mNbBlocks, mNbHashes, aHash);
+}
+
+// Name of the side table row of the filter.
+std::string KeyFilter::getSavedName() const
+{
+    return mTable + "." + mColumn;
+}
+
+// Name of a persistent trigger flagging the saved filter as stale.
+std::string KeyFilter::getTriggerName(const char* apEvent) const
+{
+    return "sqlitecpp_keyfilter_" + std::string(apEvent) + " " + getSavedName();
+}
+
+// SQL function called by the triggers to add a new key.
+void KeyFilter::addFunction(sqlite3_context* apContext, int aNbArgs, sqlite3_value** apArgs)
+{
+    (void)aNbArgs;
+    KeyFilter* pFilter = static_cast<KeyFilter*>(sqlite3_user_data(apContext));
+    sqlite3_value* pKey = apArgs[0];
+    switch (sqlite3_value_type(pKey))
+    {
+    case SQLITE_INTEGER:
+        pFilter->add(hashInteger(sqlite3_value_int64(pKey)));
+        break;
+    case SQLITE_FLOAT:
+        pFilter->add(hashReal(sqlite3_value_double(pKey)));
+        break;
+    case SQLITE_NULL:
+        break;
+    default:
+        // Call sqlite3_value_blob() before sqlite3_value_bytes(), as recommended by the documentation
+        pFilter->add(hashBytes(sqlite3_value_blob(pKey), static_cast<size_t>(sqlite3_value_bytes(pKey))));
+        break;
+    }
+    sqlite3_result_null(apContext);
+}
+
+}  // namespace SQLite
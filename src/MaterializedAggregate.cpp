@@ -0,0 +1,526 @@
+/**
+ * @file    MaterializedAggregate.cpp
+ * @ingroup SQLiteCpp
+ * @brief   A summary table of a GROUP BY query, kept current by generated triggers.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/MaterializedAggregate.h>
+
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Quote.h>
+#include <SQLiteCpp/Savepoint.h>
+#include <SQLiteCpp/Statement.h>
+
+#include <cctype>
+
+namespace SQLite
+{
+
+namespace
+{
+
+// A token of the aggregation query: an identifier (possibly quoted) or a punctuation character
+struct Token
+{
+    std::string text;       // Identifier (unquoted) or punctuation character
+    size_t      begin;      // Offset of the first character of the token in the query
+    size_t      end;        // Offset past the last character of the token in the query
+    bool        bIdent;     // true for an identifier
+    bool        bQuoted;    // true for a quoted identifier (never a keyword)
+};
+
+// Case insensitive comparison of ASCII strings
+bool equalsNoCase(const std::string& aLeft, const char* apRight)
+{
+    size_t i = 0;
+    for (; i < aLeft.size() && apRight[i] != '\0'; ++i)
+    {
+        if (std::tolower(static_cast<unsigned char>(aLeft[i])) != std::tolower(static_cast<unsigned char>(apRight[i])))
+        {
+            return false;
+        }
+    }
+    return (i == aLeft.size()) && (apRight[i] == '\0');
+}
+
+// Split the aggregation query into tokens, rejecting anything that cannot be part of a supported query
+std::vector<Token> tokenize(const std::string& aQuery)
+{
+    std::vector<Token> tokens;
+    size_t i = 0;
+    while (i < aQuery.size())
+    {
+        const char c = aQuery[i];
+        if (std::isspace(static_cast<unsigned char>(c)))
+        {
+            ++i;
+        }
+        else if (c == '-' && i + 1 < aQuery.size() && aQuery[i + 1] == '-')
+        {
+            i = aQuery.find('\n', i);
+        }
+        else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
+        {
+            const size_t begin = i;
+            while (i < aQuery.size() && (std::isalnum(static_cast<unsigned char>(aQuery[i])) || aQuery[i] == '_'))
+            {
+                ++i;
+            }
+            tokens.push_back(Token{aQuery.substr(begin, i - begin), begin, i, true, false});
+        }
+        else if (c == '"' || c == '`' || c == '[')
+        {
+            const char close = (c == '[') ? ']' : c;
+            const size_t begin = i;
+            ++i;
+            std::string text;
+            for (;;)
+            {
+                if (i >= aQuery.size())
+                {
+                    throw SQLite::Exception("Unterminated quoted identifier in aggregation query.");
+                }
+                if (aQuery[i] == close)
+                {
+                    // A doubled quote character is an escaped quote inside the identifier
+                    if (close != ']' && i + 1 < aQuery.size() && aQuery[i + 1] == close)
+                    {
+                        text += close;
+                        i += 2;
+                        continue;
+                    }
+                    ++i;
+                    break;
+                }
+                text += aQuery[i];
+                ++i;
+            }
+            tokens.push_back(Token{text, begin, i, true, true});
+        }
+        else if (c == '(' || c == ')' || c == ',' || c == '*' || c == ';')
+        {
+            tokens.push_back(Token{std::string(1, c), i, i + 1, false, false});
+            ++i;
+        }
+        else
+        {
+            throw SQLite::Exception(std::string("Unsupported character '") + c + "' in aggregation query.");
+        }
+    }
+    return tokens;
+}
+
+// Return true if the token is the given (unquoted) keyword
+bool isKeyword(const Token& aToken, const char* apKeyword)
+{
+    return aToken.bIdent && !aToken.bQuoted && equalsNoCase(aToken.text, apKeyword);
+}
+
+// Return true if the token is the given punctuation character
+bool isPunct(const Token& aToken, const char aChar)
+{
+    return !aToken.bIdent && aToken.text[0] == aChar;
+}
+
+// Name of the hidden column counting the non NULL values of the sum() at the given index
+std::string nonNullCountName(const size_t aIndex)
+{
+    return "__count" + std::to_string(aIndex);
+}
+
+// Cursor over the tokens of the aggregation query
+class Parser
+{
+public:
+    explicit Parser(const std::string& aQuery) :
+        mTokens(tokenize(aQuery))
+    {
+    }
+
+    bool atEnd() const
+    {
+        return mPos >= mTokens.size();
+    }
+
+    const Token& peek() const
+    {
+        if (atEnd())
+        {
+            throw SQLite::Exception("Unexpected end of aggregation query.");
+        }
+        return mTokens[mPos];
+    }
+
+    const Token& next()
+    {
+        const Token& token = peek();
+        ++mPos;
+        return token;
+    }
+
+    void expectKeyword(const char* apKeyword)
+    {
+        if (!isKeyword(next(), apKeyword))
+        {
+            throw SQLite::Exception(std::string("Expected ") + apKeyword + " in aggregation query.");
+        }
+    }
+
+    void expectPunct(const char aChar)
+    {
+        if (!isPunct(next(), aChar))
+        {
+            throw SQLite::Exception(std::string("Expected '") + aChar + "' in aggregation query.");
+        }
+    }
+
+    const Token& expectIdent()
+    {
+        const Token& token = next();
+        if (!token.bIdent)
+        {
+            throw SQLite::Exception("Expected an identifier in aggregation query, got '" + token.text + "'.");
+        }
+        return token;
+    }
+
+private:
+    std::vector<Token>  mTokens;
+    size_t              mPos = 0;
+};
+
+} // namespace
+
+// Parse the aggregation query, then create and backfill the summary table if it does not exist yet.
+MaterializedAggregate::MaterializedAggregate(Database& aDatabase, const std::string& aName, const std::string& aQuery) :
+    mDatabase(aDatabase),
+    mName(aName),
+    mQuery(aQuery)
+{
+    Parser parser(mQuery);
+
+    // SELECT list: plain GROUP BY columns, or count/sum/total of a plain column
+    parser.expectKeyword("SELECT");
+    for (;;)
+    {
+        const Token& first = parser.expectIdent();
+        Aggregate aggregate{Kind::Key, first.text, ""};
+        size_t end = first.end;
+        if (!parser.atEnd() && isPunct(parser.peek(), '('))
+        {
+            parser.next();
+            const Token& argument = parser.next();
+            if (isPunct(argument, '*'))
+            {
+                aggregate.column.clear();
+            }
+            else if (argument.bIdent && !isKeyword(argument, "DISTINCT"))
+            {
+                aggregate.column = argument.text;
+            }
+            else
+            {
+                throw SQLite::Exception("Aggregates of expressions are not supported, use a plain column.");
+            }
+            end = parser.peek().end;
+            parser.expectPunct(')');
+
+            if (equalsNoCase(first.text, "count"))
+            {
+                aggregate.kind = aggregate.column.empty() ? Kind::CountAll : Kind::Count;
+            }
+            else if (equalsNoCase(first.text, "sum") && !aggregate.column.empty())
+            {
+                aggregate.kind = Kind::Sum;
+            }
+            else if (equalsNoCase(first.text, "total") && !aggregate.column.empty())
+            {
+                aggregate.kind = Kind::Total;
+            }
+            else
+            {
+                throw SQLite::Exception("Aggregate " + first.text + "() cannot be maintained incrementally.");
+            }
+        }
+
+        // Optional alias, else the result column is named after its text, as SQLite does
+        if (!parser.atEnd() && isKeyword(parser.peek(), "AS"))
+        {
+            parser.next();
+            aggregate.name = parser.expectIdent().text;
+        }
+        else
+        {
+            aggregate.name = mQuery.substr(first.begin, end - first.begin);
+        }
+        for (const Aggregate& other : mAggregates)
+        {
+            if (equalsNoCase(other.name, aggregate.name.c_str()))
+            {
+                throw SQLite::Exception("Duplicate column name '" + aggregate.name + "' in aggregation query.");
+            }
+        }
+        mAggregates.push_back(aggregate);
+
+        if (parser.atEnd() || !isPunct(parser.peek(), ','))
+        {
+            break;
+        }
+        parser.next();
+    }
+
+    parser.expectKeyword("FROM");
+    mSourceTable = parser.expectIdent().text;
+
+    parser.expectKeyword("GROUP");
+    parser.expectKeyword("BY");
+    for (;;)
+    {
+        mKeys.push_back(parser.expectIdent().text);
+        if (parser.atEnd() || !isPunct(parser.peek(), ','))
+        {
+            break;
+        }
+        parser.next();
+    }
+    if (!parser.atEnd() && isPunct(parser.peek(), ';'))
+    {
+        parser.next();
+        mQuery.resize(mQuery.find_last_of(';'));
+    }
+    if (!parser.atEnd())
+    {
+        throw SQLite::Exception("Unsupported clause '" + parser.peek().text + "' in aggregation query.");
+    }
+
+    // Every GROUP BY column is the key of the summary table, so it must be selected, and vice versa
+    for (const std::string& key : mKeys)
+    {
+        bool bSelected = false;
+        for (const Aggregate& aggregate : mAggregates)
+        {
+            bSelected = bSelected || (aggregate.kind == Kind::Key && equalsNoCase(aggregate.column, key.c_str()));
+        }
+        if (!bSelected)
+        {
+            throw SQLite::Exception("GROUP BY column '" + key + "' must be selected by the aggregation query.");
+        }
+    }
+    for (const Aggregate& aggregate : mAggregates)
+    {
+        bool bGrouped = (aggregate.kind != Kind::Key);
+        for (const std::string& key : mKeys)
+        {
+            bGrouped = bGrouped || equalsNoCase(aggregate.column, key.c_str());
+        }
+        if (!bGrouped)
+        {
+            throw SQLite::Exception("Column '" + aggregate.column + "' must be part of the GROUP BY clause.");
+        }
+    }
+
+    if (!mDatabase.tableExists(mName))
+    {
+        Savepoint savepoint(mDatabase, "MaterializedAggregate");
+        create();
+        backfill();
+        savepoint.release();
+    }
+}
+
+// Check that the summary table matches the result of the aggregation query.
+bool MaterializedAggregate::verify() const
+{
+    std::string columns;
+    for (const Aggregate& aggregate : mAggregates)
+    {
+        columns += (columns.empty() ? "" : ", ") + quote(aggregate.name);
+    }
+    const std::string summary = "SELECT " + columns + " FROM " + quote(mName);
+    const std::string query = "SELECT * FROM (" + mQuery + "\n)";
+
+    Statement check(mDatabase, "SELECT (SELECT count(*) FROM (" + query + " EXCEPT " + summary + "))"
+                               " + (SELECT count(*) FROM (" + summary + " EXCEPT " + query + "))");
+    (void)check.executeStep(); // Cannot return false, as the above query always return a result
+    return (0 == check.getColumn(0).getInt64());
+}
+
+// Rebuild the content of the summary table from the source table.
+void MaterializedAggregate::refresh()
+{
+    Savepoint savepoint(mDatabase, "MaterializedAggregate");
+    mDatabase.exec("DELETE FROM " + quote(mName));
+    backfill();
+    savepoint.release();
+}
+
+// Drop the triggers and the summary table.
+void MaterializedAggregate::drop()
+{
+    Savepoint savepoint(mDatabase, "MaterializedAggregate");
+    mDatabase.exec("DROP TRIGGER IF EXISTS " + quote(mName + "_insert"));
+    mDatabase.exec("DROP TRIGGER IF EXISTS " + quote(mName + "_update"));
+    mDatabase.exec("DROP TRIGGER IF EXISTS " + quote(mName + "_delete"));
+    mDatabase.exec("DROP TABLE IF EXISTS " + quote(mName));
+    savepoint.release();
+}
+
+// Create the summary table, its index and its triggers.
+void MaterializedAggregate::create()
+{
+    std::string columns;
+    std::string keys;
+    std::string sourceColumns;
+    for (size_t i = 0; i < mAggregates.size(); ++i)
+    {
+        const Aggregate& aggregate = mAggregates[i];
+        columns += quote(aggregate.name) + ", ";
+        if (aggregate.kind == Kind::Key)
+        {
+            keys += (keys.empty() ? "" : ", ") + quote(aggregate.name);
+        }
+        if (aggregate.kind == Kind::Sum)
+        {
+            columns += nonNullCountName(i) + " INTEGER NOT NULL, ";
+        }
+        if (!aggregate.column.empty())
+        {
+            sourceColumns += (sourceColumns.empty() ? "" : ", ") + quote(aggregate.column);
+        }
+    }
+    mDatabase.exec("CREATE TABLE " + quote(mName) + " (" + columns + "__rows INTEGER NOT NULL)");
+    mDatabase.exec("CREATE UNIQUE INDEX " + quote(mName + "_keys") + " ON " + quote(mName) + " (" + keys + ")");
+
+    // An UPDATE is the removal of the old row followed by the insertion of the new one,
+    // and it is only of interest if one of the aggregated columns is modified.
+    const std::string table = quote(mSourceTable);
+    mDatabase.exec("CREATE TRIGGER " + quote(mName + "_insert") + " AFTER INSERT ON " + table +
+                   " BEGIN " + applyRow("NEW", +1) + " END");
+    mDatabase.exec("CREATE TRIGGER " + quote(mName + "_update") + " AFTER UPDATE OF " + sourceColumns +
+                   " ON " + table + " BEGIN " + applyRow("OLD", -1) + applyRow("NEW", +1) + " END");
+    mDatabase.exec("CREATE TRIGGER " + quote(mName + "_delete") + " AFTER DELETE ON " + table +
+                   " BEGIN " + applyRow("OLD", -1) + " END");
+}
+
+// Fill the (empty) summary table from the source table.
+void MaterializedAggregate::backfill()
+{
+    std::string columns;
+    std::string values;
+    for (size_t i = 0; i < mAggregates.size(); ++i)
+    {
+        const Aggregate& aggregate = mAggregates[i];
+        const std::string column = quote(aggregate.column);
+        columns += quote(aggregate.name) + ", ";
+        switch (aggregate.kind)
+        {
+        case Kind::Key:      values += column + ", ";                break;
+        case Kind::CountAll: values += "count(*), ";                 break;
+        case Kind::Count:    values += "count(" + column + "), ";    break;
+        case Kind::Total:    values += "total(" + column + "), ";    break;
+        case Kind::Sum:
+            columns += nonNullCountName(i) + ", ";
+            values += "sum(" + column + "), count(" + column + "), ";
+            break;
+        }
+    }
+    std::string keys;
+    for (const std::string& key : mKeys)
+    {
+        keys += (keys.empty() ? "" : ", ") + quote(key);
+    }
+    mDatabase.exec("INSERT INTO " + quote(mName) + " (" + columns + "__rows) SELECT " + values + "count(*) FROM " +
+                   quote(mSourceTable) + " GROUP BY " + keys);
+}
+
+// Build the body of a trigger adding (aSign = +1) or removing (aSign = -1) the row aRow ("NEW" or "OLD").
+std::string MaterializedAggregate::applyRow(const char* apRow, const int aSign) const
+{
+    const std::string table = quote(mName);
+    const std::string match = matchRow(apRow);
+    const std::string op = (aSign > 0) ? " + " : " - ";
+
+    std::string columns;
+    std::string initial;
+    std::string updates = "__rows = __rows" + op + "1";
+    for (size_t i = 0; i < mAggregates.size(); ++i)
+    {
+        const Aggregate& aggregate = mAggregates[i];
+        const std::string name = quote(aggregate.name);
+        const std::string value = std::string(apRow) + "." + quote(aggregate.column);
+        const std::string notNull = "(" + value + " IS NOT NULL)";
+        columns += name + ", ";
+        switch (aggregate.kind)
+        {
+        case Kind::Key:
+            initial += value + ", ";
+            break;
+        case Kind::CountAll:
+            initial += "0, ";
+            updates += ", " + name + " = " + name + op + "1";
+            break;
+        case Kind::Count:
+            initial += "0, ";
+            updates += ", " + name + " = " + name + op + notNull;
+            break;
+        case Kind::Total:
+            initial += "0.0, ";
+            updates += ", " + name + " = " + name + op + "coalesce(" + value + ", 0)";
+            break;
+        case Kind::Sum:
+        {
+            // sum() is NULL when there is no non NULL value in the group, so count them in a hidden column
+            const std::string count = nonNullCountName(i);
+            columns += count + ", ";
+            initial += "NULL, 0, ";
+            if (aSign > 0)
+            {
+                updates += ", " + name + " = CASE WHEN " + value + " IS NULL THEN " + name +
+                           " ELSE coalesce(" + name + ", 0) + " + value + " END";
+            }
+            else
+            {
+                updates += ", " + name + " = CASE WHEN " + value + " IS NULL THEN " + name +
+                           " WHEN " + count + " = 1 THEN NULL ELSE " + name + " - " + value + " END";
+            }
+            updates += ", " + count + " = " + count + op + notNull;
+            break;
+        }
+        }
+    }
+
+    std::string body;
+    if (aSign > 0)
+    {
+        body += "INSERT INTO " + table + " (" + columns + "__rows) SELECT " + initial + "0"
+                " WHERE NOT EXISTS (SELECT 1 FROM " + table + " WHERE " + match + "); ";
+    }
+    body += "UPDATE " + table + " SET " + updates + " WHERE " + match + "; ";
+    if (aSign < 0)
+    {
+        body += "DELETE FROM " + table + " WHERE " + match + " AND __rows = 0; ";
+    }
+    return body;
+}
+
+// Build the condition matching the summary row of the source row aRow ("NEW" or "OLD").
+std::string MaterializedAggregate::matchRow(const char* apRow) const
+{
+    // "IS" instead of "=" so that NULL keys are grouped together, as GROUP BY does
+    std::string match;
+    for (const Aggregate& aggregate : mAggregates)
+    {
+        if (aggregate.kind == Kind::Key)
+        {
+            match += (match.empty() ? "" : " AND ") + quote(aggregate.name) + " IS " +
+                     apRow + "." + quote(aggregate.column);
+        }
+    }
+    return match;
+}
+
+}  // namespace SQLite
@@ -0,0 +1,368 @@
+/**
+ * @file    PageAccessRecorder.cpp
+ * @ingroup SQLiteCpp
+ * @brief   Instrumented VFS recording the ranges read from the database files, to warm up their hot set later.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/PageAccessRecorder.h>
+
+#include <SQLiteCpp/Exception.h>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <fstream>
+
+namespace SQLite
+{
+
+namespace
+{
+
+// File opened by the recording VFS, followed in memory by the file of the root VFS
+struct RecorderFile
+{
+    sqlite3_file        base;       // Base class, shall be first
+    PageAccessRecorder* pRecorder;  // Recorder of the VFS
+    const char*         zName;      // Name of a main database file, nullptr for the other files
+    sqlite3_file*       pReal;      // File of the root VFS
+};
+
+PageAccessRecorder* getRecorder(sqlite3_vfs* apVfs)
+{
+    return static_cast<PageAccessRecorder*>(apVfs->pAppData);
+}
+
+sqlite3_vfs* getRoot(sqlite3_vfs* apVfs)
+{
+    return getRecorder(apVfs)->getRootVfs();
+}
+
+sqlite3_file* getReal(sqlite3_file* apFile)
+{
+    return reinterpret_cast<RecorderFile*>(apFile)->pReal;
+}
+
+// I/O methods, recording the reads and forwarding all the calls to the file of the root VFS
+
+int fileClose(sqlite3_file* apFile)
+{
+    return getReal(apFile)->pMethods->xClose(getReal(apFile));
+}
+
+int fileRead(sqlite3_file* apFile, void* apBuffer, int aAmount, sqlite3_int64 aOffset)
+{
+    RecorderFile* pFile = reinterpret_cast<RecorderFile*>(apFile);
+    if (pFile->zName != nullptr)
+    {
+        pFile->pRecorder->record(pFile->zName, aOffset, aAmount);
+    }
+    return pFile->pReal->pMethods->xRead(pFile->pReal, apBuffer, aAmount, aOffset);
+}
+
+int fileWrite(sqlite3_file* apFile, const void* apBuffer, int aAmount, sqlite3_int64 aOffset)
+{
+    return getReal(apFile)->pMethods->xWrite(getReal(apFile), apBuffer, aAmount, aOffset);
+}
+
+int fileTruncate(sqlite3_file* apFile, sqlite3_int64 aSize)
+{
+    return getReal(apFile)->pMethods->xTruncate(getReal(apFile), aSize);
+}
+
+int fileSync(sqlite3_file* apFile, int aFlags)
+{
+    return getReal(apFile)->pMethods->xSync(getReal(apFile), aFlags);
+}
+
+int fileFileSize(sqlite3_file* apFile, sqlite3_int64* apSize)
+{
+    return getReal(apFile)->pMethods->xFileSize(getReal(apFile), apSize);
+}
+
+int fileLock(sqlite3_file* apFile, int aLock)
+{
+    return getReal(apFile)->pMethods->xLock(getReal(apFile), aLock);
+}
+
+int fileUnlock(sqlite3_file* apFile, int aLock)
+{
+    return getReal(apFile)->pMethods->xUnlock(getReal(apFile), aLock);
+}
+
+int fileCheckReservedLock(sqlite3_file* apFile, int* apResOut)
+{
+    return getReal(apFile)->pMethods->xCheckReservedLock(getReal(apFile), apResOut);
+}
+
+int fileFileControl(sqlite3_file* apFile, int aOp, void* apArg)
+{
+    return getReal(apFile)->pMethods->xFileControl(getReal(apFile), aOp, apArg);
+}
+
+int fileSectorSize(sqlite3_file* apFile)
+{
+    return getReal(apFile)->pMethods->xSectorSize(getReal(apFile));
+}
+
+int fileDeviceCharacteristics(sqlite3_file* apFile)
+{
+    return getReal(apFile)->pMethods->xDeviceCharacteristics(getReal(apFile));
+}
+
+int fileShmMap(sqlite3_file* apFile, int aPage, int aPageSize, int aExtend, void volatile** app)
+{
+    sqlite3_file* pReal = getReal(apFile);
+    return (pReal->pMethods->iVersion >= 2) ?
+        pReal->pMethods->xShmMap(pReal, aPage, aPageSize, aExtend, app) : SQLITE_IOERR_SHMMAP;
+}
+
+int fileShmLock(sqlite3_file* apFile, int aOffset, int aN, int aFlags)
+{
+    sqlite3_file* pReal = getReal(apFile);
+    return (pReal->pMethods->iVersion >= 2) ?
+        pReal->pMethods->xShmLock(pReal, aOffset, aN, aFlags) : SQLITE_IOERR_SHMLOCK;
+}
+
+void fileShmBarrier(sqlite3_file* apFile)
+{
+    sqlite3_file* pReal = getReal(apFile);
+    if (pReal->pMethods->iVersion >= 2)
+    {
+        pReal->pMethods->xShmBarrier(pReal);
+    }
+}
+
+int fileShmUnmap(sqlite3_file* apFile, int aDeleteFlag)
+{
+    sqlite3_file* pReal = getReal(apFile);
+    return (pReal->pMethods->iVersion >= 2) ? pReal->pMethods->xShmUnmap(pReal, aDeleteFlag) : SQLITE_OK;
+}
+
+int fileFetch(sqlite3_file* apFile, sqlite3_int64 aOffset, int aAmount, void** app)
+{
+    RecorderFile* pFile = reinterpret_cast<RecorderFile*>(apFile);
+    if (pFile->pReal->pMethods->iVersion < 3)
+    {
+        *app = nullptr;
+        return SQLITE_OK;
+    }
+    // Pages read through the memory mapping
+    if (pFile->zName != nullptr)
+    {
+        pFile->pRecorder->record(pFile->zName, aOffset, aAmount);
+    }
+    return pFile->pReal->pMethods->xFetch(pFile->pReal, aOffset, aAmount, app);
+}
+
+int fileUnfetch(sqlite3_file* apFile, sqlite3_int64 aOffset, void* apPage)
+{
+    sqlite3_file* pReal = getReal(apFile);
+    return (pReal->pMethods->iVersion >= 3) ? pReal->pMethods->xUnfetch(pReal, aOffset, apPage) : SQLITE_OK;
+}
+
+const sqlite3_io_methods RECORDER_IO_METHODS =
+{
+    3,
+    fileClose,
+    fileRead,
+    fileWrite,
+    fileTruncate,
+    fileSync,
+    fileFileSize,
+    fileLock,
+    fileUnlock,
+    fileCheckReservedLock,
+    fileFileControl,
+    fileSectorSize,
+    fileDeviceCharacteristics,
+    fileShmMap,
+    fileShmLock,
+    fileShmBarrier,
+    fileShmUnmap,
+    fileFetch,
+    fileUnfetch
+};
+
+// VFS methods, forwarding all the calls to the root VFS
+
+int vfsOpen(sqlite3_vfs* apVfs, const char* apName, sqlite3_file* apFile, int aFlags, int* apOutFlags)
+{
+    RecorderFile* pFile = reinterpret_cast<RecorderFile*>(apFile);
+    pFile->pRecorder = getRecorder(apVfs);
+    pFile->zName = (apName != nullptr && (aFlags & SQLITE_OPEN_MAIN_DB) != 0) ? apName : nullptr;
+    pFile->pReal = reinterpret_cast<sqlite3_file*>(pFile + 1);
+    const int ret = getRoot(apVfs)->xOpen(getRoot(apVfs), apName, pFile->pReal, aFlags, apOutFlags);
+    pFile->base.pMethods = (pFile->pReal->pMethods != nullptr) ? &RECORDER_IO_METHODS : nullptr;
+    return ret;
+}
+
+int vfsDelete(sqlite3_vfs* apVfs, const char* apName, int aSyncDir)
+{
+    return getRoot(apVfs)->xDelete(getRoot(apVfs), apName, aSyncDir);
+}
+
+int vfsAccess(sqlite3_vfs* apVfs, const char* apName, int aFlags, int* apResOut)
+{
+    return getRoot(apVfs)->xAccess(getRoot(apVfs), apName, aFlags, apResOut);
+}
+
+int vfsFullPathname(sqlite3_vfs* apVfs, const char* apName, int aOut, char* apOut)
+{
+    return getRoot(apVfs)->xFullPathname(getRoot(apVfs), apName, aOut, apOut);
+}
+
+void* vfsDlOpen(sqlite3_vfs* apVfs, const char* apFilename)
+{
+    return getRoot(apVfs)->xDlOpen(getRoot(apVfs), apFilename);
+}
+
+void vfsDlError(sqlite3_vfs* apVfs, int aBytes, char* apErrMsg)
+{
+    getRoot(apVfs)->xDlError(getRoot(apVfs), aBytes, apErrMsg);
+}
+
+// Symbol of a dynamic library, as returned by xDlSym
+using DlSymbol = void (*)(void);
+
+DlSymbol vfsDlSym(sqlite3_vfs* apVfs, void* apHandle, const char* apSymbol)
+{
+    return getRoot(apVfs)->xDlSym(getRoot(apVfs), apHandle, apSymbol);
+}
+
+void vfsDlClose(sqlite3_vfs* apVfs, void* apHandle)
+{
+    getRoot(apVfs)->xDlClose(getRoot(apVfs), apHandle);
+}
+
+int vfsRandomness(sqlite3_vfs* apVfs, int aBytes, char* apOut)
+{
+    return getRoot(apVfs)->xRandomness(getRoot(apVfs), aBytes, apOut);
+}
+
+int vfsSleep(sqlite3_vfs* apVfs, int aMicroseconds)
+{
+    return getRoot(apVfs)->xSleep(getRoot(apVfs), aMicroseconds);
+}
+
+int vfsCurrentTime(sqlite3_vfs* apVfs, double* apTime)
+{
+    return getRoot(apVfs)->xCurrentTime(getRoot(apVfs), apTime);
+}
+
+int vfsGetLastError(sqlite3_vfs* apVfs, int aBytes, char* apOut)
+{
+    return getRoot(apVfs)->xGetLastError(getRoot(apVfs), aBytes, apOut);
+}
+
+int vfsCurrentTimeInt64(sqlite3_vfs* apVfs, sqlite3_int64* apTime)
+{
+    return getRoot(apVfs)->xCurrentTimeInt64(getRoot(apVfs), apTime);
+}
+
+} // namespace
+
+// Register the recording VFS, on top of the default VFS.
+PageAccessRecorder::PageAccessRecorder(const std::string& aVfsName /* = "sqlitecpp_recorder" */) :
+    mVfsName(aVfsName),
+    mpVfs(new sqlite3_vfs()),
+    mpRootVfs(sqlite3_vfs_find(nullptr))
+{
+    if (mpRootVfs == nullptr)
+    {
+        throw SQLite::Exception("No default VFS to record");
+    }
+    mpVfs->iVersion = (mpRootVfs->iVersion >= 2) ? 2 : 1;
+    mpVfs->szOsFile = static_cast<int>(sizeof(RecorderFile)) + mpRootVfs->szOsFile;
+    mpVfs->mxPathname = mpRootVfs->mxPathname;
+    mpVfs->zName = mVfsName.c_str();
+    mpVfs->pAppData = this;
+    mpVfs->xOpen = vfsOpen;
+    mpVfs->xDelete = vfsDelete;
+    mpVfs->xAccess = vfsAccess;
+    mpVfs->xFullPathname = vfsFullPathname;
+    mpVfs->xDlOpen = vfsDlOpen;
+    mpVfs->xDlError = vfsDlError;
+    mpVfs->xDlSym = vfsDlSym;
+    mpVfs->xDlClose = vfsDlClose;
+    mpVfs->xRandomness = vfsRandomness;
+    mpVfs->xSleep = vfsSleep;
+    mpVfs->xCurrentTime = vfsCurrentTime;
+    mpVfs->xGetLastError = vfsGetLastError;
+    mpVfs->xCurrentTimeInt64 = (mpVfs->iVersion >= 2) ? vfsCurrentTimeInt64 : nullptr;
+    const int ret = sqlite3_vfs_register(mpVfs.get(), 0);
+    if (ret != SQLITE_OK)
+    {
+        throw SQLite::Exception("Unable to register the VFS " + mVfsName, ret);
+    }
+}
+
+// Unregister the recording VFS.
+PageAccessRecorder::~PageAccessRecorder()
+{
+    sqlite3_vfs_unregister(mpVfs.get());
+}
+
+// Record a range read from a file (called by the VFS).
+void PageAccessRecorder::record(const char* apFilename, const int64_t aOffset, const int64_t aLength)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    int64_t& length = mRanges[apFilename][aOffset];
+    length = std::max(length, aLength);
+}
+
+// Return the ranges read from the main file of a database, sorted and merged.
+std::vector<PageAccessRecorder::Range> PageAccessRecorder::getRanges(const Database& aDatabase) const
+{
+    std::vector<Range> ranges;
+    const char* filename = sqlite3_db_filename(aDatabase.getHandle(), "main");
+    if (filename == nullptr)
+    {
+        return ranges;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    const auto file = mRanges.find(filename);
+    if (file == mRanges.end())
+    {
+        return ranges;
+    }
+    for (const auto& range : file->second)
+    {
+        if (!ranges.empty() && range.first <= ranges.back().first + ranges.back().second)
+        {
+            ranges.back().second = std::max(ranges.back().second, range.first + range.second - ranges.back().first);
+        }
+        else
+        {
+            ranges.emplace_back(range.first, range.second);
+        }
+    }
+    return ranges;
+}
+
+// Save the ranges read from the main file of a database, for WarmUpOptions::HotSet.
+void PageAccessRecorder::save(const Database& aDatabase, const std::string& aHotSetFile) const
+{
+    std::ofstream hotSet(aHotSetFile, std::ios::trunc);
+    for (const Range& range : getRanges(aDatabase))
+    {
+        hotSet << range.first << ' ' << range.second << '\n';
+    }
+    if (!hotSet)
+    {
+        throw SQLite::Exception("Unable to write the hot set file " + aHotSetFile);
+    }
+}
+
+// Forget the ranges recorded so far.
+void PageAccessRecorder::clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRanges.clear();
+}
+
+}  // namespace SQLite
@@ -0,0 +1,509 @@
+/**
+ * @file    PlanRegressionDetector.cpp
+ * @ingroup SQLiteCpp
+ * @brief   Detect the changes of the query plans of the statements, after a schema change or an ANALYZE.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/PlanRegressionDetector.h>
+
+#include <SQLiteCpp/Exception.h>
+#include <SQLiteCpp/Statement.h>
+#include <SQLiteCpp/TraceListener.h>
+#include <SQLiteCpp/Transaction.h>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <regex>
+#include <sstream>
+#include <utility>
+
+namespace SQLite
+{
+
+/// Attached connection, listening to its trace events
+struct PlanRegressionDetector::Connection : public TraceListener
+{
+    Connection(PlanRegressionDetector* apDetector, sqlite3* apSQLite) :
+        pDetector(apDetector), pSQLite(apSQLite)
+    {
+    }
+
+    void onTrace(unsigned aEvent, void* apP, void* apX) override
+    {
+        if (aEvent == SQLITE_TRACE_CLOSE)
+        {
+            pDetector->forget(*this);
+        }
+        else if (aEvent == SQLITE_TRACE_PROFILE)
+        {
+            pDetector->complete(*this, static_cast<sqlite3_stmt*>(apP));
+        }
+        else if (!isTrigger(apP, apX))
+        {
+            pDetector->execute(*this, static_cast<sqlite3_stmt*>(apP));
+        }
+    }
+
+    PlanRegressionDetector* pDetector;  ///< Detector of the connection
+    sqlite3*                pSQLite;    ///< Connection handle, nullptr once detached or closed
+};
+
+namespace
+{
+
+// Number of SQL texts whose fingerprint is cached, before the cache is cleared
+const size_t MAX_FINGERPRINTS = 10000;
+
+bool startsWith(const std::string& aText, const char* apPrefix)
+{
+    return aText.compare(0, std::strlen(apPrefix), apPrefix) == 0;
+}
+
+// Return true if the plan of a statement, from its normalized SQL text, is captured
+bool isTracked(const std::string& aNormalizedSql)
+{
+    return startsWith(aNormalizedSql, "select") || startsWith(aNormalizedSql, "with")
+        || startsWith(aNormalizedSql, "insert") || startsWith(aNormalizedSql, "replace")
+        || startsWith(aNormalizedSql, "update") || startsWith(aNormalizedSql, "delete");
+}
+
+// Return true if a statement, from its normalized SQL text, may change the plans of the others
+bool isSchemaChange(const std::string& aNormalizedSql)
+{
+    if (startsWith(aNormalizedSql, "create") || startsWith(aNormalizedSql, "drop")
+        || startsWith(aNormalizedSql, "alter") || startsWith(aNormalizedSql, "analyze")
+        || startsWith(aNormalizedSql, "reindex") || startsWith(aNormalizedSql, "pragma optimize"))
+    {
+        return true;
+    }
+    // Writing the statistics of the query planner, like Database::importPlannerStats() does, changes the plans too
+    if (isTracked(aNormalizedSql) && !startsWith(aNormalizedSql, "select") && !startsWith(aNormalizedSql, "with"))
+    {
+        std::string lower(aNormalizedSql);
+        std::transform(lower.begin(), lower.end(), lower.begin(),
+                       [](const char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+        return lower.find("sqlite_stat") != std::string::npos;
+    }
+    return false;
+}
+
+// Return the shape of a plan, as an indented tree without the row estimates of the old versions of SQLite
+std::string toShape(const QueryPlan& aPlan)
+{
+    static const std::regex ESTIMATE(R"( \(~[0-9]+ rows?\))");
+    return std::regex_replace(aPlan.toString(), ESTIMATE, "");
+}
+
+// Return the plan of a shape, the parents of the steps given by their indentation
+QueryPlan fromShape(const std::string& aShape)
+{
+    QueryPlan plan;
+    std::vector<int> parents; // Identifier of the last step at each depth
+    std::istringstream lines(aShape);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        const size_t indent = line.find_first_not_of(' ');
+        if (indent == std::string::npos)
+        {
+            continue;
+        }
+        const size_t depth = std::min(indent / 2, parents.size());
+        QueryPlan::Step step;
+        step.id = static_cast<int>(plan.steps.size()) + 1;
+        step.parent = (depth > 0) ? parents[depth - 1] : 0;
+        step.detail = line.substr(indent);
+        parents.resize(depth);
+        parents.push_back(step.id);
+        plan.steps.push_back(step);
+    }
+    return plan;
+}
+
+// Return the number of full scans, temp b-trees and automatic indexes of a plan
+int countCosts(const QueryPlan& aPlan, int& aTempBTrees, int& aAutomaticIndexes)
+{
+    int fullScans = 0;
+    aTempBTrees = 0;
+    aAutomaticIndexes = 0;
+    for (const QueryPlan::Access& access : aPlan.getAccesses())
+    {
+        fullScans += access.bFullScan ? 1 : 0;
+        aAutomaticIndexes += access.bAutomatic ? 1 : 0;
+    }
+    for (const QueryPlan::Step& step : aPlan.steps)
+    {
+        aTempBTrees += (step.detail.find("TEMP B-TREE") != std::string::npos) ? 1 : 0;
+    }
+    return fullScans;
+}
+
+// Return true if the new plan adds a full scan, a temp b-tree or an automatic index
+bool isRegression(const QueryPlan& aOldPlan, const QueryPlan& aNewPlan)
+{
+    int oldTempBTrees = 0;
+    int oldAutomaticIndexes = 0;
+    const int oldFullScans = countCosts(aOldPlan, oldTempBTrees, oldAutomaticIndexes);
+    int newTempBTrees = 0;
+    int newAutomaticIndexes = 0;
+    const int newFullScans = countCosts(aNewPlan, newTempBTrees, newAutomaticIndexes);
+    return (newFullScans > oldFullScans) || (newTempBTrees > oldTempBTrees)
+        || (newAutomaticIndexes > oldAutomaticIndexes);
+}
+
+// Return the name of the database file of a connection, or an empty string for an in-memory database
+std::string getDatabaseFile(sqlite3* apSQLite)
+{
+    const char* pFilename = sqlite3_db_filename(apSQLite, "main");
+    return (pFilename != nullptr) ? pFilename : "";
+}
+
+} // namespace
+
+// Open or create the sidecar database of the plans, and load the plans captured before
+PlanRegressionDetector::PlanRegressionDetector(const std::string& aSidecarFilename, PlanRegressionOptions aOptions) :
+    mOptions(std::move(aOptions)),
+    mSidecar(aSidecarFilename, OPEN_READWRITE | OPEN_CREATE)
+{
+    mSidecar.exec("CREATE TABLE IF NOT EXISTS sqlitecpp_plans ("
+                  " fingerprint INTEGER PRIMARY KEY, normalized TEXT NOT NULL, sql TEXT NOT NULL,"
+                  " plan TEXT NOT NULL, captured TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP);"
+                  "CREATE TABLE IF NOT EXISTS sqlitecpp_plan_changes ("
+                  " id INTEGER PRIMARY KEY, fingerprint INTEGER NOT NULL, old_plan TEXT NOT NULL,"
+                  " new_plan TEXT NOT NULL, regression INTEGER NOT NULL,"
+                  " changed TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP)");
+
+    Statement query(mSidecar, "SELECT fingerprint, normalized, sql, plan FROM sqlitecpp_plans");
+    while (query.executeStep())
+    {
+        Entry entry;
+        entry.fingerprint.hash = static_cast<uint64_t>(query.getColumn(0).getInt64());
+        entry.fingerprint.normalized = query.getColumn(1).getString();
+        entry.sql = query.getColumn(2).getString();
+        entry.plan = query.getColumn(3).getString();
+        mEntries[entry.fingerprint.hash] = std::move(entry);
+    }
+}
+
+// Detach all the connections
+PlanRegressionDetector::~PlanRegressionDetector()
+{
+    for (const auto& pConnection : mConnections)
+    {
+        if (pConnection->pSQLite != nullptr)
+        {
+            TraceListener::unsubscribe(pConnection->pSQLite, *pConnection);
+            forget(*pConnection);
+        }
+    }
+}
+
+// Start capturing the plans of the statements executed on a database connection
+void PlanRegressionDetector::attach(const Database& aDatabase)
+{
+    sqlite3* const pSQLite = aDatabase.getHandle();
+    const std::string filename = getDatabaseFile(pSQLite);
+    if (filename.empty())
+    {
+        throw SQLite::Exception("The plans can only be captured for a database file");
+    }
+    Connection* pConnection = nullptr;
+    {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        for (const auto& pAttached : mConnections)
+        {
+            if (pAttached->pSQLite == pSQLite)
+            {
+                throw SQLite::Exception("The connection is already attached");
+            }
+        }
+        if (mpExplainer && filename != mFilename)
+        {
+            throw SQLite::Exception("The connection is not to the database file of the connections attached");
+        }
+        if (!mpExplainer)
+        {
+            mpExplainer.reset(new Database(filename, OPEN_READONLY));
+            mFilename = filename;
+        }
+        mConnections.emplace_back(new Connection(this, pSQLite));
+        pConnection = mConnections.back().get();
+    }
+    TraceListener::subscribe(pSQLite, *pConnection, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE | SQLITE_TRACE_CLOSE);
+}
+
+// Stop capturing the plans of the statements executed on a database connection
+void PlanRegressionDetector::detach(const Database& aDatabase)
+{
+    sqlite3* const pSQLite = aDatabase.getHandle();
+    for (const auto& pConnection : mConnections)
+    {
+        if (pConnection->pSQLite == pSQLite)
+        {
+            TraceListener::unsubscribe(pSQLite, *pConnection);
+            forget(*pConnection);
+        }
+    }
+}
+
+// Re-check now all the plans captured, reporting and returning the ones that changed
+std::vector<PlanChange> PlanRegressionDetector::check()
+{
+    std::vector<PlanChange> changes;
+    {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        if (!mpExplainer)
+        {
+            throw SQLite::Exception("No connection is attached to the detector");
+        }
+        for (auto& entry : mEntries)
+        {
+            entry.second.bStale = true;
+        }
+        recheckStale(changes);
+    }
+    report(changes);
+    return changes;
+}
+
+// Re-check the plans marked as stale by the schema changes committed, reporting and returning the changes
+std::vector<PlanChange> PlanRegressionDetector::checkStale()
+{
+    std::vector<PlanChange> changes;
+    {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        if (!mpExplainer)
+        {
+            throw SQLite::Exception("No connection is attached to the detector");
+        }
+        recheckStale(changes);
+    }
+    report(changes);
+    return changes;
+}
+
+// Return true if some plans are marked as stale by a schema change committed since their last check
+bool PlanRegressionDetector::isStale() const
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto& entry : mEntries)
+    {
+        if (entry.second.bStale)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Return the number of statement fingerprints whose plan is captured
+size_t PlanRegressionDetector::getPlanCount() const
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    size_t count = 0;
+    for (const auto& entry : mEntries)
+    {
+        count += entry.second.plan.empty() ? 0 : 1;
+    }
+    return count;
+}
+
+// Capture the plan of a statement starting on an attached connection, if it is executed for the first time
+void PlanRegressionDetector::execute(const Connection& aConnection, sqlite3_stmt* apStmt)
+{
+    (void)aConnection;
+    std::vector<PlanChange> changes;
+    {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        // The errors of the detection are ignored, not to fail the statements of the application;
+        // a plan that could not be captured, like on a busy database, is captured at the next execution
+        try
+        {
+            const Fingerprint& fingerprint = fingerprintOf(apStmt);
+            if (isTracked(fingerprint.normalized))
+            {
+                Entry& entry = mEntries[fingerprint.hash];
+                if (!entry.bExecuted)
+                {
+                    if (entry.sql.empty())
+                    {
+                        entry.fingerprint = fingerprint;
+                        const char* pSql = sqlite3_sql(apStmt);
+                        entry.sql = pSql ? pSql : "";
+                    }
+                    std::string shape;
+                    if (explainShape(entry.sql, shape) && (shape != entry.plan))
+                    {
+                        Transaction transaction(mSidecar);
+                        persist(entry, shape, changes);
+                        transaction.commit();
+                        entry.plan = std::move(shape);
+                    }
+                    entry.bExecuted = true;
+                    entry.bStale = false;
+                }
+            }
+        }
+        catch (const std::exception&)
+        {
+        }
+    }
+    report(changes);
+}
+
+// Mark the plans as stale if a statement completed on an attached connection committed a schema change
+void PlanRegressionDetector::complete(const Connection& aConnection, sqlite3_stmt* apStmt)
+{
+    const bool bAutocommit = (sqlite3_get_autocommit(aConnection.pSQLite) != 0);
+    const std::lock_guard<std::mutex> lock(mMutex);
+    try
+    {
+        if (mOptions.bRecheckOnSchemaChange && isSchemaChange(fingerprintOf(apStmt).normalized))
+        {
+            mbSchemaChanged = true;
+        }
+        // The plans are re-checked out of the trace callback, not to delay the statements of the application
+        if (mbSchemaChanged && bAutocommit)
+        {
+            mbSchemaChanged = false;
+            for (auto& entry : mEntries)
+            {
+                entry.second.bStale = true;
+            }
+        }
+    }
+    catch (const std::exception&)
+    {
+    }
+}
+
+// Forget a connection detached or closed
+void PlanRegressionDetector::forget(Connection& aConnection)
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    aConnection.pSQLite = nullptr;
+}
+
+// Return the fingerprint of a statement, cached by SQL text
+const Fingerprint& PlanRegressionDetector::fingerprintOf(sqlite3_stmt* apStmt)
+{
+    const char* pSql = sqlite3_sql(apStmt);
+    std::string sql(pSql ? pSql : "");
+    auto iFingerprint = mFingerprints.find(sql);
+    if (iFingerprint == mFingerprints.end())
+    {
+        if (mFingerprints.size() >= MAX_FINGERPRINTS)
+        {
+            mFingerprints.clear();
+        }
+        Fingerprint fingerprint = getFingerprint(sql);
+        iFingerprint = mFingerprints.insert(std::make_pair(std::move(sql), std::move(fingerprint))).first;
+    }
+    return iFingerprint->second;
+}
+
+// Return the shape of the current plan of a statement, false if it cannot be explained
+bool PlanRegressionDetector::explainShape(const std::string& aSql, std::string& aShape)
+{
+    try
+    {
+        aShape = toShape(explainQueryPlan(*mpExplainer, aSql));
+        return true;
+    }
+    catch (const SQLite::Exception& e)
+    {
+        // A busy or locked database is a transient error, to retry later
+        if ((e.getErrorCode() == SQLITE_BUSY) || (e.getErrorCode() == SQLITE_LOCKED))
+        {
+            throw;
+        }
+        // Not explained on the database file, like a statement on a temporary table, or a table not yet committed
+        return false;
+    }
+}
+
+// Persist the new plan of a fingerprint, and the change from the one captured
+void PlanRegressionDetector::persist(const Entry& aEntry, const std::string& aShape, std::vector<PlanChange>& aChanges)
+{
+    if (!aEntry.plan.empty())
+    {
+        PlanChange change;
+        change.fingerprint = aEntry.fingerprint;
+        change.sql = aEntry.sql;
+        change.oldPlan = fromShape(aEntry.plan);
+        change.newPlan = fromShape(aShape);
+        change.bRegression = isRegression(change.oldPlan, change.newPlan);
+
+        Statement insert(mSidecar, "INSERT INTO sqlitecpp_plan_changes (fingerprint, old_plan, new_plan, regression)"
+                                   " VALUES (?, ?, ?, ?)");
+        insert.bind(1, static_cast<int64_t>(aEntry.fingerprint.hash));
+        insert.bind(2, aEntry.plan);
+        insert.bind(3, aShape);
+        insert.bind(4, change.bRegression ? 1 : 0);
+        insert.exec();
+        aChanges.push_back(std::move(change));
+    }
+
+    Statement replace(mSidecar, "INSERT OR REPLACE INTO sqlitecpp_plans (fingerprint, normalized, sql, plan)"
+                                " VALUES (?, ?, ?, ?)");
+    replace.bind(1, static_cast<int64_t>(aEntry.fingerprint.hash));
+    replace.bind(2, aEntry.fingerprint.normalized);
+    replace.bind(3, aEntry.sql);
+    replace.bind(4, aShape);
+    replace.exec();
+}
+
+// Re-check the stale plans, with the statistics reloaded
+void PlanRegressionDetector::recheckStale(std::vector<PlanChange>& aChanges)
+{
+    // A connection loads the statistics of ANALYZE with the schema: reopen it to see the new ones
+    mpExplainer.reset(new Database(mFilename, OPEN_READONLY));
+
+    // The plans are only updated and no longer stale once all of them are persisted, so that they are re-checked
+    // again if any error occurs, like a busy database
+    std::vector<PlanChange> changes;
+    std::vector<std::pair<Entry*, std::string>> shapes;
+    Transaction transaction(mSidecar);
+    for (auto& entry : mEntries)
+    {
+        std::string shape;
+        if (entry.second.bStale && !entry.second.sql.empty() && explainShape(entry.second.sql, shape)
+            && (shape != entry.second.plan))
+        {
+            persist(entry.second, shape, changes);
+            shapes.emplace_back(&entry.second, std::move(shape));
+        }
+    }
+    transaction.commit();
+
+    for (auto& shape : shapes)
+    {
+        shape.first->plan = std::move(shape.second);
+    }
+    for (auto& entry : mEntries)
+    {
+        entry.second.bStale = false;
+    }
+    aChanges.insert(aChanges.end(), changes.begin(), changes.end());
+}
+
+// Call the callback with the changes of plans
+void PlanRegressionDetector::report(const std::vector<PlanChange>& aChanges) const
+{
+    if (mOptions.callback)
+    {
+        for (const PlanChange& change : aChanges)
+        {
+            mOptions.callback(change);
+        }
+    }
+}
+
+}  // namespace SQLite
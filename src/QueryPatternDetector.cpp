@@ -0,0 +1,370 @@
+/**
+ * @file    QueryPatternDetector.cpp
+ * @ingroup SQLiteCpp
+ * @brief   Detect the N+1 query pattern: bursts of executions of the same statement fingerprint in a scope.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/QueryPatternDetector.h>
+
+#include <SQLiteCpp/Exception.h>
+#include <SQLiteCpp/TraceListener.h>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <cstring>
+#include <regex>
+
+namespace SQLite
+{
+
+/// Attached connection, listening to its trace events
+struct QueryPatternDetector::Connection : public TraceListener
+{
+    Connection(QueryPatternDetector* apDetector, sqlite3* apSQLite) :
+        pDetector(apDetector), pSQLite(apSQLite)
+    {
+    }
+
+    void onTrace(unsigned aEvent, void* apP, void* apX) override
+    {
+        if (aEvent == SQLITE_TRACE_CLOSE)
+        {
+            pDetector->forget(*this);
+        }
+        else if (!isTrigger(apP, apX))
+        {
+            pDetector->execute(*this, static_cast<sqlite3_stmt*>(apP));
+        }
+    }
+
+    QueryPatternDetector*   pDetector;  ///< Detector of the connection
+    sqlite3*                pSQLite;    ///< Connection handle, nullptr once detached or closed
+};
+
+namespace
+{
+
+// Number of SQL texts whose fingerprint is cached, before the cache is cleared
+const size_t MAX_FINGERPRINTS = 10000;
+
+bool startsWith(const std::string& aText, const char* apPrefix)
+{
+    return aText.compare(0, std::strlen(apPrefix), apPrefix) == 0;
+}
+
+// Return true if a normalized SQL text ends the transaction in progress
+bool isTransactionEnd(const std::string& aNormalizedSql)
+{
+    return startsWith(aNormalizedSql, "commit") || startsWith(aNormalizedSql, "end")
+        || (startsWith(aNormalizedSql, "rollback") && aNormalizedSql.find(" to ") == std::string::npos);
+}
+
+} // namespace
+
+// Detect the bursts with the given options
+QueryPatternDetector::QueryPatternDetector(QueryPatternOptions aOptions) :
+    mOptions(std::move(aOptions))
+{
+}
+
+// Detach all the connections, reporting the bursts of their transactions in progress
+QueryPatternDetector::~QueryPatternDetector()
+{
+    for (const auto& pConnection : mConnections)
+    {
+        if (pConnection->pSQLite != nullptr)
+        {
+            TraceListener::unsubscribe(pConnection->pSQLite, *pConnection);
+            forget(*pConnection);
+        }
+    }
+}
+
+// Start counting the statements executed on a database connection
+void QueryPatternDetector::attach(const Database& aDatabase)
+{
+    sqlite3* const pSQLite = aDatabase.getHandle();
+    Connection* pConnection = nullptr;
+    {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        for (const auto& pAttached : mConnections)
+        {
+            if (pAttached->pSQLite == pSQLite)
+            {
+                throw SQLite::Exception("The connection is already attached");
+            }
+        }
+        mConnections.emplace_back(new Connection(this, pSQLite));
+        pConnection = mConnections.back().get();
+    }
+    TraceListener::subscribe(pSQLite, *pConnection, SQLITE_TRACE_STMT | SQLITE_TRACE_CLOSE);
+}
+
+// Stop counting the statements executed on a database connection, reporting its transaction in progress
+void QueryPatternDetector::detach(const Database& aDatabase)
+{
+    sqlite3* const pSQLite = aDatabase.getHandle();
+    for (const auto& pConnection : mConnections)
+    {
+        if (pConnection->pSQLite == pSQLite)
+        {
+            TraceListener::unsubscribe(pSQLite, *pConnection);
+            forget(*pConnection);
+        }
+    }
+}
+
+// Open a scope on the current thread
+QueryPatternDetector::Scope::Scope(QueryPatternDetector& aDetector, std::string aName) :
+    mDetector(aDetector)
+{
+    ScopeState scope;
+    scope.name = std::move(aName);
+    const std::lock_guard<std::mutex> lock(mDetector.mMutex);
+    mDetector.mThreads[std::this_thread::get_id()].scopes.push_back(std::move(scope));
+}
+
+// Close the scope, reporting its bursts
+QueryPatternDetector::Scope::~Scope()
+{
+    std::vector<QueryBurst> bursts;
+    {
+        const std::lock_guard<std::mutex> lock(mDetector.mMutex);
+        const auto iThread = mDetector.mThreads.find(std::this_thread::get_id());
+        if (iThread == mDetector.mThreads.end() || iThread->second.scopes.empty())
+        {
+            return;
+        }
+        bursts = mDetector.close(iThread->second.scopes.back());
+        iThread->second.scopes.pop_back();
+        if (iThread->second.scopes.empty() && iThread->second.tags.empty())
+        {
+            mDetector.mThreads.erase(iThread);
+        }
+    }
+    mDetector.report(bursts);
+}
+
+// Tag the executions of the current thread, until the destruction
+QueryPatternDetector::Tag::Tag(QueryPatternDetector& aDetector, std::string aTag) :
+    mDetector(aDetector)
+{
+    const std::lock_guard<std::mutex> lock(mDetector.mMutex);
+    mDetector.mThreads[std::this_thread::get_id()].tags.push_back(std::move(aTag));
+}
+
+// Restore the previous tag of the current thread
+QueryPatternDetector::Tag::~Tag()
+{
+    const std::lock_guard<std::mutex> lock(mDetector.mMutex);
+    const auto iThread = mDetector.mThreads.find(std::this_thread::get_id());
+    if (iThread == mDetector.mThreads.end() || iThread->second.tags.empty())
+    {
+        return;
+    }
+    iThread->second.tags.pop_back();
+    if (iThread->second.scopes.empty() && iThread->second.tags.empty())
+    {
+        mDetector.mThreads.erase(iThread);
+    }
+}
+
+// Return the last bursts reported, the oldest first
+std::vector<QueryBurst> QueryPatternDetector::getBursts() const
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    return std::vector<QueryBurst>(mBursts.begin(), mBursts.end());
+}
+
+// Forget the bursts reported so far
+void QueryPatternDetector::clearBursts()
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    mBursts.clear();
+}
+
+// Return how to batch the executions of a statement, from its normalized SQL text
+std::string QueryPatternDetector::suggestBatching(const std::string& aNormalizedSql)
+{
+    if (startsWith(aNormalizedSql, "insert") || startsWith(aNormalizedSql, "replace"))
+    {
+        return "insert the rows in one transaction with a single prepared statement (SQLite::executeMany()), "
+               "or several rows at once with a multi-row VALUES";
+    }
+
+    // A column, maybe qualified or quoted, compared for equality to a value in the WHERE clause
+    static const std::regex KEY(R"(((?:[a-z_][a-z0-9_$]*|"[^"]*")(?:\.(?:[a-z_][a-z0-9_$]*|"[^"]*"))*) = \?)");
+    const size_t where = aNormalizedSql.find(" where ");
+    std::smatch match;
+    if (where != std::string::npos
+        && std::regex_search(aNormalizedSql.begin() + static_cast<std::ptrdiff_t>(where), aNormalizedSql.end(),
+                             match, KEY))
+    {
+        const size_t position = where + static_cast<size_t>(match.position(0));
+        return "bind all the keys at once as a JSON array: " + aNormalizedSql.substr(0, position)
+             + match.str(1) + " in (select value from json_each(?))"
+             + aNormalizedSql.substr(position + static_cast<size_t>(match.length(0)));
+    }
+    return "merge the executions into one query with a join or an IN list, or run them in one transaction";
+}
+
+// Count an execution of a statement on an attached connection
+void QueryPatternDetector::execute(const Connection& aConnection, sqlite3_stmt* apStmt)
+{
+    const bool bAutocommit = (sqlite3_get_autocommit(aConnection.pSQLite) != 0);
+    std::vector<QueryBurst> bursts;
+    {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        ScopeState* pScope = nullptr;
+        const std::string* pTag = nullptr;
+        const auto iThread = mThreads.find(std::this_thread::get_id());
+        if (iThread != mThreads.end())
+        {
+            pScope = iThread->second.scopes.empty() ? nullptr : &iThread->second.scopes.back();
+            pTag = iThread->second.tags.empty() ? nullptr : &iThread->second.tags.back();
+        }
+
+        auto iTransaction = mTransactions.end();
+        if (mOptions.bTransactionScopes)
+        {
+            iTransaction = mTransactions.find(aConnection.pSQLite);
+            if (iTransaction != mTransactions.end() && bAutocommit)
+            {
+                // The end of the transaction was not seen, like an automatic rollback on error
+                bursts = close(iTransaction->second);
+                mTransactions.erase(iTransaction);
+                iTransaction = mTransactions.end();
+            }
+            if (iTransaction == mTransactions.end() && !bAutocommit)
+            {
+                ScopeState transaction;
+                transaction.name = "transaction";
+                iTransaction = mTransactions.insert(std::make_pair(aConnection.pSQLite, std::move(transaction))).first;
+            }
+        }
+        if (pScope == nullptr && iTransaction != mTransactions.end())
+        {
+            pScope = &iTransaction->second;
+        }
+        if (pScope == nullptr)
+        {
+            return;
+        }
+
+        const Fingerprint& fingerprint = fingerprintOf(apStmt);
+        const bool bTransactionEnd = isTransactionEnd(fingerprint.normalized);
+        Counter& counter = pScope->counters[fingerprint.hash];
+        if (counter.count == 0)
+        {
+            counter.fingerprint = fingerprint;
+            const char* pSql = sqlite3_sql(apStmt);
+            counter.sql = pSql ? pSql : "";
+        }
+        ++counter.count;
+        if (pTag != nullptr)
+        {
+            ++counter.tags[*pTag];
+        }
+
+        if (bTransactionEnd && iTransaction != mTransactions.end())
+        {
+            const std::vector<QueryBurst> transactionBursts = close(iTransaction->second);
+            bursts.insert(bursts.end(), transactionBursts.begin(), transactionBursts.end());
+            mTransactions.erase(iTransaction);
+        }
+    }
+    report(bursts);
+}
+
+// Report the bursts of the transaction in progress on a connection, detached or closed
+void QueryPatternDetector::forget(Connection& aConnection)
+{
+    std::vector<QueryBurst> bursts;
+    {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        const auto iTransaction = mTransactions.find(aConnection.pSQLite);
+        if (iTransaction != mTransactions.end())
+        {
+            bursts = close(iTransaction->second);
+            mTransactions.erase(iTransaction);
+        }
+        aConnection.pSQLite = nullptr;
+    }
+    report(bursts);
+}
+
+// Return the fingerprint of a statement, cached by SQL text
+const Fingerprint& QueryPatternDetector::fingerprintOf(sqlite3_stmt* apStmt)
+{
+    const char* pSql = sqlite3_sql(apStmt);
+    std::string sql(pSql ? pSql : "");
+    auto iFingerprint = mFingerprints.find(sql);
+    if (iFingerprint == mFingerprints.end())
+    {
+        if (mFingerprints.size() >= MAX_FINGERPRINTS)
+        {
+            mFingerprints.clear();
+        }
+        Fingerprint fingerprint = getFingerprint(sql);
+        iFingerprint = mFingerprints.insert(std::make_pair(std::move(sql), std::move(fingerprint))).first;
+    }
+    return iFingerprint->second;
+}
+
+// Return the bursts of a scope closed, and keep them for getBursts()
+std::vector<QueryBurst> QueryPatternDetector::close(ScopeState& aScope)
+{
+    std::vector<QueryBurst> bursts;
+    for (auto& counter : aScope.counters)
+    {
+        if (counter.second.count < mOptions.threshold)
+        {
+            continue;
+        }
+        QueryBurst burst;
+        burst.scope = aScope.name;
+        burst.fingerprint = std::move(counter.second.fingerprint);
+        burst.sql = std::move(counter.second.sql);
+        burst.count = counter.second.count;
+        burst.tags.assign(counter.second.tags.begin(), counter.second.tags.end());
+        std::stable_sort(burst.tags.begin(), burst.tags.end(),
+                         [](const std::pair<std::string, int64_t>& aLeft, const std::pair<std::string, int64_t>& aRight)
+                         {
+                             return aLeft.second > aRight.second;
+                         });
+        burst.suggestion = suggestBatching(burst.fingerprint.normalized);
+        bursts.push_back(std::move(burst));
+    }
+    std::stable_sort(bursts.begin(), bursts.end(), [](const QueryBurst& aLeft, const QueryBurst& aRight)
+                     {
+                         return aLeft.count > aRight.count;
+                     });
+    for (const QueryBurst& burst : bursts)
+    {
+        mBursts.push_back(burst);
+        if (mBursts.size() > mOptions.maxBursts)
+        {
+            mBursts.pop_front();
+        }
+    }
+    return bursts;
+}
+
+// Call the callback with the bursts of a scope closed
+void QueryPatternDetector::report(const std::vector<QueryBurst>& aBursts) const
+{
+    if (mOptions.callback)
+    {
+        for (const QueryBurst& burst : aBursts)
+        {
+            mOptions.callback(burst);
+        }
+    }
+}
+
+}  // namespace SQLite
@@ -0,0 +1,234 @@
+/**
+ * @file    QueryPlan.cpp
+ * @ingroup SQLiteCpp
+ * @brief   Query plan of a statement, from EXPLAIN QUERY PLAN, with the tables scanned and the indexes used.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/QueryPlan.h>
+
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Exception.h>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+
+namespace SQLite
+{
+
+namespace
+{
+
+// Remove a prefix from a text, returning true if it was there
+bool consume(std::string& aText, const char* apPrefix)
+{
+    const std::string prefix(apPrefix);
+    if (aText.compare(0, prefix.size(), prefix) != 0)
+    {
+        return false;
+    }
+    aText.erase(0, prefix.size());
+    return true;
+}
+
+// Remove the first word of a text and return it
+std::string consumeWord(std::string& aText)
+{
+    const size_t end = std::min(aText.find(' '), aText.size());
+    const std::string word = aText.substr(0, end);
+    aText.erase(0, std::min(end + 1, aText.size()));
+    return word;
+}
+
+// Parse the detail of a SCAN or SEARCH step, returning false for the other steps
+bool parseAccess(const std::string& aDetail, QueryPlan::Access& aAccess)
+{
+    std::string detail = aDetail;
+    if (consume(detail, "SCAN "))
+    {
+        aAccess.bFullScan = true;
+    }
+    else if (!consume(detail, "SEARCH "))
+    {
+        return false;
+    }
+    (void)consume(detail, "TABLE ");
+    aAccess.table = consumeWord(detail);
+    if (aAccess.table.empty() || aAccess.table[0] == '(' || aAccess.table == "CONSTANT" || aAccess.table == "SUBQUERY")
+    {
+        return false;
+    }
+    if (consume(detail, "AS "))
+    {
+        aAccess.table = consumeWord(detail);
+    }
+    if (consume(detail, "VIRTUAL TABLE"))
+    {
+        // The virtual table module chooses how to find the rows
+        aAccess.bFullScan = false;
+        return true;
+    }
+    if (consume(detail, "USING "))
+    {
+        if (consume(detail, "INTEGER PRIMARY KEY") || consume(detail, "PRIMARY KEY") || consume(detail, "ROWID"))
+        {
+            aAccess.index = "PRIMARY KEY";
+        }
+        else
+        {
+            aAccess.bAutomatic = consume(detail, "AUTOMATIC ");
+            (void)consume(detail, "PARTIAL ");
+            aAccess.bCovering = consume(detail, "COVERING ");
+            if (consume(detail, "INDEX") && !aAccess.bAutomatic)
+            {
+                (void)consume(detail, " ");
+                aAccess.index = consumeWord(detail);
+            }
+        }
+    }
+    const size_t open = detail.find('(');
+    const size_t close = detail.rfind(')');
+    if (open != std::string::npos && close != std::string::npos && close > open)
+    {
+        aAccess.constraints = detail.substr(open + 1, close - open - 1);
+    }
+    return true;
+}
+
+} // namespace
+
+// Return the accesses to the tables, in the order of the steps
+std::vector<QueryPlan::Access> QueryPlan::getAccesses() const
+{
+    std::vector<Access> accesses;
+    for (const Step& step : steps)
+    {
+        Access access;
+        if (parseAccess(step.detail, access))
+        {
+            accesses.push_back(access);
+        }
+    }
+    return accesses;
+}
+
+// Return the names of the indexes used, without the automatic indexes and the primary keys
+std::vector<std::string> QueryPlan::getIndexes() const
+{
+    std::vector<std::string> indexes;
+    for (const Access& access : getAccesses())
+    {
+        if (!access.index.empty() && access.index != "PRIMARY KEY"
+            && std::find(indexes.begin(), indexes.end(), access.index) == indexes.end())
+        {
+            indexes.push_back(access.index);
+        }
+    }
+    return indexes;
+}
+
+// Return true if the plan uses an index of the given name
+bool QueryPlan::usesIndex(const std::string& aIndex) const
+{
+    const std::vector<std::string> indexes = getIndexes();
+    return std::find(indexes.begin(), indexes.end(), aIndex) != indexes.end();
+}
+
+// Return true if a table is read by a full scan
+bool QueryPlan::hasFullScan() const
+{
+    for (const Access& access : getAccesses())
+    {
+        if (access.bFullScan)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Return true if a temporary b-tree is used
+bool QueryPlan::hasTempBTree() const
+{
+    for (const Step& step : steps)
+    {
+        if (step.detail.find("TEMP B-TREE") != std::string::npos)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Return true if an automatic index is created for the statement
+bool QueryPlan::hasAutomaticIndex() const
+{
+    for (const Access& access : getAccesses())
+    {
+        if (access.bAutomatic)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Return the plan as an indented tree, one step by line
+std::string QueryPlan::toString() const
+{
+    std::map<int, int> depths;
+    std::string text;
+    for (const Step& step : steps)
+    {
+        const auto iParent = depths.find(step.parent);
+        const int depth = (iParent != depths.end()) ? iParent->second + 1 : 0;
+        depths[step.id] = depth;
+        text += std::string(static_cast<size_t>(depth) * 2, ' ') + step.detail + "\n";
+    }
+    return text;
+}
+
+// Return the query plan of a SQL statement, without executing it
+QueryPlan explainQueryPlan(const Database& aDatabase, const std::string& aSql)
+{
+    return explainQueryPlan(aDatabase.getHandle(), aSql);
+}
+
+// Return the query plan of a SQL statement on a raw connection handle, without executing it
+QueryPlan explainQueryPlan(sqlite3* apSQLite, const std::string& aSql)
+{
+    const std::string explain = "EXPLAIN QUERY PLAN " + aSql;
+    sqlite3_stmt* pExplain = nullptr;
+    const int prepared = sqlite3_prepare_v2(apSQLite, explain.c_str(), static_cast<int>(explain.size()),
+                                            &pExplain, nullptr);
+    if (SQLITE_OK != prepared)
+    {
+        throw SQLite::Exception(apSQLite, prepared);
+    }
+    const std::unique_ptr<sqlite3_stmt, int (*)(sqlite3_stmt*)> explainPtr(pExplain, sqlite3_finalize);
+
+    QueryPlan plan;
+    int ret = SQLITE_ROW;
+    while ((ret = sqlite3_step(pExplain)) == SQLITE_ROW)
+    {
+        QueryPlan::Step step;
+        step.id = sqlite3_column_int(pExplain, 0);
+        step.parent = sqlite3_column_int(pExplain, 1);
+        const unsigned char* pDetail = sqlite3_column_text(pExplain, 3);
+        step.detail = pDetail ? reinterpret_cast<const char*>(pDetail) : "";
+        plan.steps.push_back(step);
+    }
+    if (ret != SQLITE_DONE)
+    {
+        throw SQLite::Exception(apSQLite, ret);
+    }
+    return plan;
+}
+
+}  // namespace SQLite
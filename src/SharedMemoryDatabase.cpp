@@ -0,0 +1,176 @@
+/**
+ * @file    SharedMemoryDatabase.cpp
+ * @ingroup SQLiteCpp
+ * @brief   In-memory database shared by all the connections of the process, with the "memdb" VFS.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/SharedMemoryDatabase.h>
+
+#include <SQLiteCpp/Backup.h>
+#include <SQLiteCpp/Exception.h>
+
+#include <sqlite3.h>
+
+#include <fstream>
+
+namespace SQLite
+{
+
+namespace
+{
+
+// Build the URI of a shared memdb database, escaping the characters with a meaning in an URI
+std::string getMemdbUri(const std::string& aName)
+{
+    static const char* const HEX = "0123456789ABCDEF";
+    std::string uri = "file:/";
+    for (const char c : aName)
+    {
+        if (c == '%' || c == '?' || c == '#')
+        {
+            uri += '%';
+            uri += HEX[(c >> 4) & 0xF];
+            uri += HEX[c & 0xF];
+        }
+        else
+        {
+            uri += c;
+        }
+    }
+    return uri + "?vfs=memdb";
+}
+
+} // namespace
+
+// Create, or open if it already exists in the process, the shared in-memory database named aName.
+SharedMemoryDatabase::SharedMemoryDatabase(const std::string& aName, const int aBusyTimeoutMs /* = 1000 */) :
+    mName(aName),
+    mUri(getMemdbUri(aName)),
+    mBusyTimeoutMs(aBusyTimeoutMs),
+    mDatabase(mUri, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE | SQLite::OPEN_URI | SQLite::OPEN_FULLMUTEX,
+              aBusyTimeoutMs)
+{
+}
+
+// Stop the automatic persistence, and release the database if there is no other connection to it.
+SharedMemoryDatabase::~SharedMemoryDatabase()
+{
+    stopAutoSave();
+}
+
+// Open a new connection to the shared database.
+Database SharedMemoryDatabase::connect(const int aFlags /* = SQLite::OPEN_READWRITE */) const
+{
+    return Database(mUri, aFlags | SQLite::OPEN_URI, mBusyTimeoutMs);
+}
+
+// Replace the content of the shared database with a snapshot file, read at once in memory.
+void SharedMemoryDatabase::load(const std::string& aSnapshotFile)
+{
+    std::ifstream file(aSnapshotFile.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+    {
+        throw SQLite::Exception("Error opening file: " + aSnapshotFile);
+    }
+    const std::streamoff size = file.tellg();
+    unsigned char* pData = static_cast<unsigned char*>(sqlite3_malloc64(static_cast<sqlite3_uint64>(size)));
+    if (pData == nullptr && size > 0)
+    {
+        throw SQLite::Exception("Not enough memory to load " + aSnapshotFile, SQLITE_NOMEM);
+    }
+    file.seekg(0, std::ios::beg);
+    file.read(reinterpret_cast<char*>(pData), size);
+    if (file.gcount() != size)
+    {
+        sqlite3_free(pData);
+        throw SQLite::Exception("Error reading file: " + aSnapshotFile);
+    }
+
+    // The buffer is owned by the private connection from now on, even in case of error
+    Database snapshot(":memory:", SQLite::OPEN_READWRITE);
+    const int ret = sqlite3_deserialize(snapshot.getHandle(), "main", pData, size, size,
+                                        SQLITE_DESERIALIZE_FREEONCLOSE | SQLITE_DESERIALIZE_READONLY);
+    snapshot.check(ret);
+
+    Backup backup(mDatabase, snapshot);
+    backup.executeStep(); // Execute all steps at once, in one transaction
+}
+
+// Save the content of the shared database to a file, with the online backup API.
+void SharedMemoryDatabase::save(const std::string& aSnapshotFile)
+{
+    mDatabase.backup(aSnapshotFile.c_str(), Database::Save);
+}
+
+// Save the shared database to a file periodically, from a background thread.
+void SharedMemoryDatabase::startAutoSave(const std::string& aSnapshotFile, const std::chrono::milliseconds aPeriod)
+{
+    stopAutoSave();
+    mbStopAutoSave = false;
+    mAutoSaveThread = std::thread(&SharedMemoryDatabase::autoSave, this, aSnapshotFile, aPeriod);
+}
+
+// Stop the automatic persistence started by startAutoSave(), saving a last time.
+bool SharedMemoryDatabase::stopAutoSave()
+{
+    if (!mAutoSaveThread.joinable())
+    {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mAutoSaveMutex);
+        mbStopAutoSave = true;
+    }
+    mAutoSaveCondition.notify_all();
+    mAutoSaveThread.join();
+    std::lock_guard<std::mutex> lock(mAutoSaveMutex);
+    return mbAutoSaveOk;
+}
+
+// Return the number of times the automatic persistence has saved the database.
+int64_t SharedMemoryDatabase::getAutoSaveCount() const
+{
+    std::lock_guard<std::mutex> lock(mAutoSaveMutex);
+    return mAutoSaveCount;
+}
+
+// Return the memory used by the content of the shared database, in bytes.
+int64_t SharedMemoryDatabase::getMemoryUsed() const
+{
+    // The memdb VFS keeps the whole database file in one buffer
+    return mDatabase.getFileSize();
+}
+
+// Background thread of the automatic persistence
+void SharedMemoryDatabase::autoSave(std::string aSnapshotFile, const std::chrono::milliseconds aPeriod)
+{
+    bool bStop = false;
+    while (!bStop)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mAutoSaveMutex);
+            bStop = mAutoSaveCondition.wait_for(lock, aPeriod, [this] { return mbStopAutoSave; });
+        }
+        bool bOk = true;
+        try
+        {
+            save(aSnapshotFile);
+        }
+        catch (const SQLite::Exception&)
+        {
+            bOk = false; // Try again at the next period
+        }
+        std::lock_guard<std::mutex> lock(mAutoSaveMutex);
+        mbAutoSaveOk = bOk;
+        if (bOk)
+        {
+            ++mAutoSaveCount;
+        }
+    }
+}
+
+}  // namespace SQLite
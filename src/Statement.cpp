@@ -14,9 +14,13 @@
 #include <SQLiteCpp/Column.h>
 #include <SQLiteCpp/Assertion.h>
 #include <SQLiteCpp/Exception.h>
+#include <SQLiteCpp/WorkloadRecorder.h>
 
 #include <sqlite3.h>
 
+#include <algorithm>
+#include <cstring>
+
 // check for if SQLite3 version >= 3.14.0
 #if SQLITE_VERSION_NUMBER < 3014000
     #warning "SQLite3 version is less than 3.14.0, so expanded SQL is not available"
@@ -71,8 +75,10 @@ int Statement::tryReset() noexcept
 // Clears away all the bindings of a prepared statement (can be associated with #reset() above).
 void Statement::clearBindings()
 {
-    const int ret = sqlite3_clear_bindings(getPreparedStatement());
+    sqlite3_stmt* const pStmt = getPreparedStatement();
+    const int ret = sqlite3_clear_bindings(pStmt);
     check(ret);
+    WorkloadRecorder::recordClearBindings(pStmt);
 }
 
 int Statement::getIndex(const char * const apName) const
@@ -83,80 +89,104 @@ int Statement::getIndex(const char * const apName) const
 // Bind an 32bits int value to a parameter "?", "?NNN", ":VVV", "@VVV" or "$VVV" in the SQL prepared statement
 void Statement::bind(const int aIndex, const int32_t aValue)
 {
-    const int ret = sqlite3_bind_int(getPreparedStatement(), aIndex, aValue);
+    sqlite3_stmt* const pStmt = getPreparedStatement();
+    const int ret = sqlite3_bind_int(pStmt, aIndex, aValue);
     check(ret);
+    WorkloadRecorder::recordBind(pStmt, aIndex, static_cast<int64_t>(aValue));
 }
 
 // Bind a 32bits unsigned int value to a parameter "?", "?NNN", ":VVV", "@VVV" or "$VVV" in the SQL prepared statement
 void Statement::bind(const int aIndex, const uint32_t aValue)
 {
-    const int ret = sqlite3_bind_int64(getPreparedStatement(), aIndex, aValue);
+    sqlite3_stmt* const pStmt = getPreparedStatement();
+    const int ret = sqlite3_bind_int64(pStmt, aIndex, aValue);
     check(ret);
+    WorkloadRecorder::recordBind(pStmt, aIndex, static_cast<int64_t>(aValue));
 }
 
 // Bind a 64bits int value to a parameter "?", "?NNN", ":VVV", "@VVV" or "$VVV" in the SQL prepared statement
 void Statement::bind(const int aIndex, const int64_t aValue)
 {
-    const int ret = sqlite3_bind_int64(getPreparedStatement(), aIndex, aValue);
+    sqlite3_stmt* const pStmt = getPreparedStatement();
+    const int ret = sqlite3_bind_int64(pStmt, aIndex, aValue);
     check(ret);
+    WorkloadRecorder::recordBind(pStmt, aIndex, aValue);
 }
 
 // Bind a double (64bits float) value to a parameter "?", "?NNN", ":VVV", "@VVV" or "$VVV" in the SQL prepared statement
 void Statement::bind(const int aIndex, const double aValue)
 {
-    const int ret = sqlite3_bind_double(getPreparedStatement(), aIndex, aValue);
+    sqlite3_stmt* const pStmt = getPreparedStatement();
+    const int ret = sqlite3_bind_double(pStmt, aIndex, aValue);
     check(ret);
+    WorkloadRecorder::recordBind(pStmt, aIndex, aValue);
 }
 
 // Bind a string value to a parameter "?", "?NNN", ":VVV", "@VVV" or "$VVV" in the SQL prepared statement
 void Statement::bind(const int aIndex, const std::string& aValue)
 {
-    const int ret = sqlite3_bind_text(getPreparedStatement(), aIndex, aValue.c_str(),
+    sqlite3_stmt* const pStmt = getPreparedStatement();
+    const int ret = sqlite3_bind_text(pStmt, aIndex, aValue.c_str(),
                                       static_cast<int>(aValue.size()), SQLITE_TRANSIENT);
     check(ret);
+    WorkloadRecorder::recordBind(pStmt, aIndex, SQLite::TEXT, aValue.c_str(),
+                                 static_cast<int>(aValue.size()));
 }
 
 // Bind a text value to a parameter "?", "?NNN", ":VVV", "@VVV" or "$VVV" in the SQL prepared statement
 void Statement::bind(const int aIndex, const char* apValue)
 {
-    const int ret = sqlite3_bind_text(getPreparedStatement(), aIndex, apValue, -1, SQLITE_TRANSIENT);
+    sqlite3_stmt* const pStmt = getPreparedStatement();
+    const int ret = sqlite3_bind_text(pStmt, aIndex, apValue, -1, SQLITE_TRANSIENT);
     check(ret);
+    WorkloadRecorder::recordBind(pStmt, aIndex, SQLite::TEXT, apValue, -1);
 }
 
 // Bind a binary blob value to a parameter "?", "?NNN", ":VVV", "@VVV" or "$VVV" in the SQL prepared statement
 void Statement::bind(const int aIndex, const void* apValue, const int aSize)
 {
-    const int ret = sqlite3_bind_blob(getPreparedStatement(), aIndex, apValue, aSize, SQLITE_TRANSIENT);
+    sqlite3_stmt* const pStmt = getPreparedStatement();
+    const int ret = sqlite3_bind_blob(pStmt, aIndex, apValue, aSize, SQLITE_TRANSIENT);
     check(ret);
+    WorkloadRecorder::recordBind(pStmt, aIndex, SQLite::BLOB, apValue, aSize);
 }
 
 // Bind a string value to a parameter "?", "?NNN", ":VVV", "@VVV" or "$VVV" in the SQL prepared statement
 void Statement::bindNoCopy(const int aIndex, const std::string& aValue)
 {
-    const int ret = sqlite3_bind_text(getPreparedStatement(), aIndex, aValue.c_str(),
+    sqlite3_stmt* const pStmt = getPreparedStatement();
+    const int ret = sqlite3_bind_text(pStmt, aIndex, aValue.c_str(),
                                       static_cast<int>(aValue.size()), SQLITE_STATIC);
     check(ret);
+    WorkloadRecorder::recordBind(pStmt, aIndex, SQLite::TEXT, aValue.c_str(),
+                                 static_cast<int>(aValue.size()));
 }
 
 // Bind a text value to a parameter "?", "?NNN", ":VVV", "@VVV" or "$VVV" in the SQL prepared statement
 void Statement::bindNoCopy(const int aIndex, const char* apValue)
 {
-    const int ret = sqlite3_bind_text(getPreparedStatement(), aIndex, apValue, -1, SQLITE_STATIC);
+    sqlite3_stmt* const pStmt = getPreparedStatement();
+    const int ret = sqlite3_bind_text(pStmt, aIndex, apValue, -1, SQLITE_STATIC);
     check(ret);
+    WorkloadRecorder::recordBind(pStmt, aIndex, SQLite::TEXT, apValue, -1);
 }
 
 // Bind a binary blob value to a parameter "?", "?NNN", ":VVV", "@VVV" or "$VVV" in the SQL prepared statement
 void Statement::bindNoCopy(const int aIndex, const void* apValue, const int aSize)
 {
-    const int ret = sqlite3_bind_blob(getPreparedStatement(), aIndex, apValue, aSize, SQLITE_STATIC);
+    sqlite3_stmt* const pStmt = getPreparedStatement();
+    const int ret = sqlite3_bind_blob(pStmt, aIndex, apValue, aSize, SQLITE_STATIC);
     check(ret);
+    WorkloadRecorder::recordBind(pStmt, aIndex, SQLite::BLOB, apValue, aSize);
 }
 
 // Bind a NULL value to a parameter "?", "?NNN", ":VVV", "@VVV" or "$VVV" in the SQL prepared statement
 void Statement::bind(const int aIndex)
 {
-    const int ret = sqlite3_bind_null(getPreparedStatement(), aIndex);
+    sqlite3_stmt* const pStmt = getPreparedStatement();
+    const int ret = sqlite3_bind_null(pStmt, aIndex);
     check(ret);
+    WorkloadRecorder::recordBind(pStmt, aIndex);
 }
 
 
@@ -280,18 +310,31 @@ const char* Statement::getColumnOriginName(const int aIndex) const
 // Return the index of the specified (potentially aliased) column name
 int Statement::getColumnIndex(const char* apName) const
 {
-    // Build the map of column index by name on first call
+    // Build the sorted vector of column index by name on first call
     if (mColumnNames.empty())
     {
+        mColumnNames.reserve(static_cast<size_t>(mColumnCount));
         for (int i = 0; i < mColumnCount; ++i)
         {
             const char* pName = sqlite3_column_name(getPreparedStatement(), i);
-            mColumnNames[pName] = i;
+            mColumnNames.emplace_back(pName, i);
         }
+        // On duplicated names, the last column comes first, as it used to be found
+        std::sort(mColumnNames.begin(), mColumnNames.end(),
+                  [](const std::pair<std::string, int>& aLeft, const std::pair<std::string, int>& aRight)
+                  {
+                      return (aLeft.first < aRight.first) ||
+                             ((aLeft.first == aRight.first) && (aLeft.second > aRight.second));
+                  });
     }
 
-    const auto iIndex = mColumnNames.find(apName);
-    if (iIndex == mColumnNames.end())
+    // Compare the names directly to the C string, without building a temporary std::string
+    const auto iIndex = std::lower_bound(mColumnNames.begin(), mColumnNames.end(), apName,
+                                         [](const std::pair<std::string, int>& aColumn, const char* apColumnName)
+                                         {
+                                             return strcmp(aColumn.first.c_str(), apColumnName) < 0;
+                                         });
+    if ((iIndex == mColumnNames.end()) || (strcmp(iIndex->first.c_str(), apName) != 0))
     {
         throw SQLite::Exception("Unknown column name.");
     }
@@ -355,6 +398,12 @@ std::string Statement::getExpandedSQL() const {
     #endif
 }
 
+// Return the query plan of the statement, from EXPLAIN QUERY PLAN, without executing it
+QueryPlan Statement::getQueryPlan() const
+{
+    return explainQueryPlan(mpSQLite, mQuery);
+}
+
 
 // Prepare SQLite statement object and return shared pointer to this object
 Statement::TStatementPtr Statement::prepareStatement()
@@ -367,6 +416,7 @@ Statement::TStatementPtr Statement::prepareStatement()
     }
     return Statement::TStatementPtr(statement, [](sqlite3_stmt* stmt)
         {
+            WorkloadRecorder::recordClearBindings(stmt);
             sqlite3_finalize(stmt);
         });
 }
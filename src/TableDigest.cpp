@@ -0,0 +1,519 @@
+/**
+ * @file    TableDigest.cpp
+ * @ingroup SQLiteCpp
+ * @brief   Merkle tree of the rowid ranges of a table, to compare replicas by the size of their differences.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/TableDigest.h>
+
+#include <SQLiteCpp/Quote.h>
+#include <SQLiteCpp/Statement.h>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <thread>
+
+namespace SQLite
+{
+
+namespace
+{
+
+// All the bucket indexes are -1 or 0 after 63 halvings, so the tree never has more levels
+const size_t MAX_LEVELS = 64;
+
+// Finalization of MurmurHash3, to spread all the input bits over all the output bits
+uint64_t mix64(uint64_t aValue) noexcept
+{
+    aValue ^= aValue >> 33;
+    aValue *= 0xff51afd7ed558ccdULL;
+    aValue ^= aValue >> 33;
+    aValue *= 0xc4ceb9fe1a85ec53ULL;
+    aValue ^= aValue >> 33;
+    return aValue;
+}
+
+// Order dependent hash of a sequence of 64 bits words
+class Hasher
+{
+public:
+    void add(const uint64_t aWord) noexcept
+    {
+        mState = mix64(mState ^ aWord) + 0x9e3779b97f4a7c15ULL;
+        ++mNbWords;
+    }
+
+    // Bytes are read as little endian words, so that the hash does not depend on the platform
+    void add(const void* apData, const size_t aSize) noexcept
+    {
+        const unsigned char* pData = static_cast<const unsigned char*>(apData);
+        add(static_cast<uint64_t>(aSize));
+        for (size_t i = 0; i < aSize; i += 8)
+        {
+            uint64_t word = 0;
+            for (size_t b = 0; b < 8 && i + b < aSize; ++b)
+            {
+                word |= static_cast<uint64_t>(pData[i + b]) << (8 * b);
+            }
+            add(word);
+        }
+    }
+
+    uint64_t get() const noexcept
+    {
+        return mix64(mState ^ mNbWords) | 1; // never 0, the hash of an empty table
+    }
+
+private:
+    uint64_t mState = 0x243f6a8885a308d3ULL;
+    uint64_t mNbWords = 0;
+};
+
+// Hash of two sibling nodes; a node with a single child has the hash of this child, as the leaves hash their rowids
+uint64_t combine(const bool abHasLeft, const uint64_t aLeft, const bool abHasRight, const uint64_t aRight) noexcept
+{
+    if (!abHasLeft)
+    {
+        return aRight;
+    }
+    if (!abHasRight)
+    {
+        return aLeft;
+    }
+    return mix64(aLeft ^ mix64(aRight + 0x9e3779b97f4a7c15ULL)) | 1;
+}
+
+// Index of the ancestor of a node, aNbLevels levels above it: a division by 2^aNbLevels rounded down
+int64_t ancestor(const int64_t aIndex, const size_t aNbLevels) noexcept
+{
+    if (aNbLevels >= 63)
+    {
+        return (aIndex < 0) ? -1 : 0;
+    }
+    return (aIndex >= 0) ? (aIndex >> aNbLevels) : ~((~aIndex) >> aNbLevels);
+}
+
+// Index of the leaf of a rowid: a division rounded down
+int64_t leafOf(const int64_t aRowid, const int64_t aLeafWidth) noexcept
+{
+    int64_t leaf = aRowid / aLeafWidth;
+    if ((aRowid % aLeafWidth != 0) && (aRowid < 0))
+    {
+        --leaf;
+    }
+    return leaf;
+}
+
+// Hash the rows of a query on "rowid, *" ordered by rowid into the leaves of their rowids
+void scan(Statement& aQuery, const int64_t aLeafWidth, std::map<int64_t, uint64_t>& aLeaves)
+{
+    const int nbColumns = aQuery.getColumnCount();
+    bool bHasLeaf = false;
+    int64_t leaf = 0;
+    Hasher hasher;
+    while (aQuery.executeStep())
+    {
+        const int64_t rowid = aQuery.getColumn(0).getInt64();
+        const int64_t rowLeaf = leafOf(rowid, aLeafWidth);
+        if (!bHasLeaf || rowLeaf != leaf)
+        {
+            if (bHasLeaf)
+            {
+                aLeaves[leaf] = hasher.get();
+            }
+            bHasLeaf = true;
+            leaf = rowLeaf;
+            hasher = Hasher();
+        }
+        hasher.add(static_cast<uint64_t>(rowid));
+        for (int i = 1; i < nbColumns; ++i)
+        {
+            const Column value = aQuery.getColumn(i);
+            const int type = value.getType();
+            hasher.add(static_cast<uint64_t>(type));
+            switch (type)
+            {
+            case SQLITE_INTEGER:
+                hasher.add(static_cast<uint64_t>(value.getInt64()));
+                break;
+            case SQLITE_FLOAT:
+            {
+                const double real = value.getDouble();
+                uint64_t bits;
+                std::memcpy(&bits, &real, sizeof(bits));
+                hasher.add(bits);
+                break;
+            }
+            case SQLITE_NULL:
+                break;
+            default:
+                // getBlob() before getBytes(), as recommended by the documentation of sqlite3_column_bytes()
+                const void* pData = value.getBlob();
+                hasher.add(pData, static_cast<size_t>(value.getBytes()));
+                break;
+            }
+        }
+    }
+    if (bHasLeaf)
+    {
+        aLeaves[leaf] = hasher.get();
+    }
+}
+
+} // namespace
+
+// Compute the digest of a table, and track its changes made through the connection.
+TableDigest::TableDigest(Database& aDatabase, const std::string& aTable, const int64_t aLeafWidth /* = 4096 */,
+                         const unsigned aNbThreads /* = 0 */) :
+    mDatabase(aDatabase),
+    mTable(aTable),
+    mLeafWidth(aLeafWidth)
+{
+    if (aLeafWidth < 1)
+    {
+        throw SQLite::Exception("Leaf width shall be at least 1.");
+    }
+    compute(aNbThreads);
+
+    // Mark the leaves of the rows changed through this connection as dirty
+    char name[64];
+    sqlite3_snprintf(sizeof(name), name, "sqlitecpp_tabledigest_%p", static_cast<void*>(this));
+    mFunctionName = name;
+    mDatabase.createFunction(mFunctionName.c_str(), 1, false, this, &TableDigest::markFunction);
+    const std::string on = " ON main." + quote(mTable) + " BEGIN SELECT ";
+    mDatabase.exec("CREATE TEMP TRIGGER " + quote(mFunctionName + "_insert") + " AFTER INSERT" + on +
+                   mFunctionName + "(NEW.rowid); END");
+    mDatabase.exec("CREATE TEMP TRIGGER " + quote(mFunctionName + "_update") + " AFTER UPDATE" + on +
+                   mFunctionName + "(OLD.rowid), " + mFunctionName + "(NEW.rowid); END");
+    mDatabase.exec("CREATE TEMP TRIGGER " + quote(mFunctionName + "_delete") + " AFTER DELETE" + on +
+                   mFunctionName + "(OLD.rowid); END");
+}
+
+// Detach the digest from the connection (drop its triggers and SQL function).
+TableDigest::~TableDigest()
+{
+    if (!mFunctionName.empty())
+    {
+        mDatabase.tryExec("DROP TRIGGER IF EXISTS temp." + quote(mFunctionName + "_insert"));
+        mDatabase.tryExec("DROP TRIGGER IF EXISTS temp." + quote(mFunctionName + "_update"));
+        mDatabase.tryExec("DROP TRIGGER IF EXISTS temp." + quote(mFunctionName + "_delete"));
+        sqlite3_create_function_v2(mDatabase.getHandle(), mFunctionName.c_str(), 1, SQLITE_UTF8,
+                                   nullptr, nullptr, nullptr, nullptr, nullptr);
+    }
+}
+
+// Recompute the whole digest from a full scan of the table.
+void TableDigest::compute(unsigned aNbThreads /* = 0 */)
+{
+    if (0 == aNbThreads)
+    {
+        aNbThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Also fails on a WITHOUT ROWID table
+    const std::string select = "SELECT rowid, * FROM " + quote(mTable);
+    Statement range(mDatabase, "SELECT min(rowid), max(rowid) FROM " + quote(mTable));
+    (void)range.executeStep(); // Cannot return false, as the above query always return a result
+
+    Level leaves;
+    if (!range.isColumnNull(0))
+    {
+        const int64_t firstLeaf = leafOf(range.getColumn(0).getInt64(), mLeafWidth);
+        const int64_t lastLeaf = leafOf(range.getColumn(1).getInt64(), mLeafWidth);
+        range.reset();
+        const uint64_t nbLeaves = static_cast<uint64_t>(lastLeaf - firstLeaf) + 1;
+        const char* pFilename = sqlite3_db_filename(mDatabase.getHandle(), "main");
+        if (nbLeaves < aNbThreads)
+        {
+            aNbThreads = static_cast<unsigned>(nbLeaves);
+        }
+        const bool bParallel = (aNbThreads > 1) && (nullptr != pFilename) && ('\0' != pFilename[0]) &&
+                               (0 != sqlite3_get_autocommit(mDatabase.getHandle()));
+        if (!bParallel)
+        {
+            Statement query(mDatabase, select + " ORDER BY rowid");
+            scan(query, mLeafWidth, leaves);
+        }
+        else
+        {
+            // Partition the leaves, and scan each partition with its own read-only connection
+            const uint64_t leavesPerThread = (nbLeaves - 1) / aNbThreads + 1;
+            const std::string filename(pFilename);
+            std::vector<Level> partials(aNbThreads);
+            std::vector<std::exception_ptr> errors(aNbThreads);
+            std::vector<std::thread> threads;
+            for (unsigned t = 0; t < aNbThreads; ++t)
+            {
+                threads.emplace_back([&, t]()
+                {
+                    try
+                    {
+                        if (leavesPerThread * t >= nbLeaves)
+                        {
+                            return;
+                        }
+                        const int64_t begin = firstLeaf + static_cast<int64_t>(leavesPerThread * t);
+                        const int64_t end = (static_cast<uint64_t>(lastLeaf - begin) < leavesPerThread) ? lastLeaf
+                                          : begin + static_cast<int64_t>(leavesPerThread) - 1;
+                        Database connection(filename, SQLite::OPEN_READONLY);
+                        Statement query(connection, select + " WHERE rowid BETWEEN ? AND ? ORDER BY rowid");
+                        query.bind(1, getLeafRange(begin).first);
+                        query.bind(2, getLeafRange(end).last);
+                        scan(query, mLeafWidth, partials[t]);
+                    }
+                    catch (...)
+                    {
+                        errors[t] = std::current_exception();
+                    }
+                });
+            }
+            for (std::thread& thread : threads)
+            {
+                thread.join();
+            }
+            for (unsigned t = 0; t < aNbThreads; ++t)
+            {
+                if (errors[t])
+                {
+                    std::rethrow_exception(errors[t]);
+                }
+                leaves.insert(partials[t].begin(), partials[t].end());
+            }
+        }
+    }
+
+    std::set<int64_t> changed;
+    for (const auto& leaf : leaves)
+    {
+        changed.insert(leaf.first);
+    }
+    mLevels.assign(1, std::move(leaves));
+    mDirty.clear();
+    propagate(std::move(changed));
+}
+
+// Mark the leaf of a rowid as dirty, for a row changed by another connection.
+void TableDigest::markDirty(const int64_t aRowid)
+{
+    mDirty.insert(leafOf(aRowid, mLeafWidth));
+}
+
+// Mark the leaves of a range of rowids as dirty, for rows changed by another connection.
+void TableDigest::markDirty(const Range& aRange)
+{
+    const int64_t lastLeaf = leafOf(aRange.last, mLeafWidth);
+    for (int64_t leaf = leafOf(aRange.first, mLeafWidth); leaf <= lastLeaf; ++leaf)
+    {
+        mDirty.insert(leaf);
+        if (leaf == std::numeric_limits<int64_t>::max())
+        {
+            break;
+        }
+    }
+}
+
+// Rescan the dirty leaves and update their ancestors, up to the root.
+void TableDigest::refresh()
+{
+    if (mDirty.empty())
+    {
+        return;
+    }
+    Statement query(mDatabase, "SELECT rowid, * FROM " + quote(mTable) +
+                               " WHERE rowid BETWEEN ? AND ? ORDER BY rowid");
+    Level& leaves = mLevels[0];
+    for (const int64_t leaf : mDirty)
+    {
+        const Range range = getLeafRange(leaf);
+        query.bind(1, range.first);
+        query.bind(2, range.last);
+        leaves.erase(leaf);
+        scan(query, mLeafWidth, leaves);
+        query.reset();
+    }
+    std::set<int64_t> changed;
+    changed.swap(mDirty);
+    propagate(std::move(changed));
+}
+
+// Return the hash of the whole table (0 for an empty table).
+uint64_t TableDigest::getRootHash()
+{
+    refresh();
+    // The top level has a single node, or two (-1 and 0) when there are both negative and positive rowids
+    uint64_t hash = 0;
+    bool bHasHash = false;
+    for (const auto& node : mLevels.back())
+    {
+        hash = combine(bHasHash, hash, true, node.second);
+        bHasHash = true;
+    }
+    return hash;
+}
+
+// Return the ranges of rowids differing between two digests of copies of the same table.
+std::vector<TableDigest::Range> TableDigest::diff(TableDigest& aLeft, TableDigest& aRight)
+{
+    if (aLeft.mLeafWidth != aRight.mLeafWidth)
+    {
+        throw SQLite::Exception("Cannot compare digests with different leaf widths.");
+    }
+    aLeft.refresh();
+    aRight.refresh();
+
+    // Start from the top level of the highest tree
+    const size_t top = std::max(aLeft.mLevels.size(), aRight.mLevels.size()) - 1;
+    std::set<int64_t> roots;
+    for (const TableDigest* pDigest : {&aLeft, &aRight})
+    {
+        const Level& level = pDigest->mLevels.back();
+        for (const auto& node : level)
+        {
+            roots.insert(ancestor(node.first, top + 1 - pDigest->mLevels.size()));
+        }
+    }
+    std::vector<Range> ranges;
+    for (const int64_t root : roots)
+    {
+        diffNode(aLeft, aRight, top, root, ranges);
+    }
+    return ranges;
+}
+
+// Return the range of rowids of a leaf.
+TableDigest::Range TableDigest::getLeafRange(const int64_t aLeaf) const noexcept
+{
+    Range range;
+    range.first = aLeaf * mLeafWidth;
+    range.last = (range.first > std::numeric_limits<int64_t>::max() - (mLeafWidth - 1))
+               ? std::numeric_limits<int64_t>::max() : range.first + (mLeafWidth - 1);
+    return range;
+}
+
+// Update the parents of the given changed nodes of the lowest level, up to the root.
+void TableDigest::propagate(std::set<int64_t> aChanged)
+{
+    for (size_t level = 1; level < MAX_LEVELS; ++level)
+    {
+        if (level == mLevels.size())
+        {
+            if (mLevels[level - 1].size() <= 1)
+            {
+                break; // the root is reached
+            }
+            // A new level depends on all the nodes of the level below
+            mLevels.emplace_back();
+            aChanged.clear();
+            for (const auto& child : mLevels[level - 1])
+            {
+                aChanged.insert(child.first);
+            }
+        }
+        const Level& children = mLevels[level - 1];
+
+        std::set<int64_t> parents;
+        for (const int64_t child : aChanged)
+        {
+            parents.insert(ancestor(child, 1));
+        }
+        Level& nodes = mLevels[level];
+        for (const int64_t parent : parents)
+        {
+            const auto left = children.find(parent * 2);
+            const auto right = children.find(parent * 2 + 1);
+            const bool bHasLeft = (left != children.end());
+            const bool bHasRight = (right != children.end());
+            if (bHasLeft || bHasRight)
+            {
+                nodes[parent] = combine(bHasLeft, bHasLeft ? left->second : 0,
+                                        bHasRight, bHasRight ? right->second : 0);
+            }
+            else
+            {
+                nodes.erase(parent);
+            }
+        }
+        aChanged.swap(parents);
+    }
+
+    // Remove the levels above the root, if the tree got smaller
+    size_t nbLevels = 1;
+    while (nbLevels < mLevels.size() && mLevels[nbLevels - 1].size() > 1)
+    {
+        ++nbLevels;
+    }
+    mLevels.resize(nbLevels);
+}
+
+// Find the hash of a node, including above the top level of the tree. Return false for an empty node.
+bool TableDigest::findNode(const size_t aLevel, const int64_t aIndex, uint64_t& aHash) const
+{
+    if (aLevel < mLevels.size())
+    {
+        const auto node = mLevels[aLevel].find(aIndex);
+        if (node == mLevels[aLevel].end())
+        {
+            return false;
+        }
+        aHash = node->second;
+        return true;
+    }
+    // Above the top level, which has a single node, all the ancestors of this node have its hash
+    const Level& top = mLevels.back();
+    if (top.empty() || ancestor(top.begin()->first, aLevel + 1 - mLevels.size()) != aIndex)
+    {
+        return false;
+    }
+    aHash = top.begin()->second;
+    return true;
+}
+
+// Descend in the subtrees differing between two digests, appending the differing leaves.
+void TableDigest::diffNode(const TableDigest& aLeft, const TableDigest& aRight, const size_t aLevel,
+                          const int64_t aIndex, std::vector<Range>& aRanges)
+{
+    uint64_t leftHash = 0;
+    uint64_t rightHash = 0;
+    const bool bHasLeft = aLeft.findNode(aLevel, aIndex, leftHash);
+    const bool bHasRight = aRight.findNode(aLevel, aIndex, rightHash);
+    if ((bHasLeft == bHasRight) && (leftHash == rightHash))
+    {
+        return;
+    }
+    if (aLevel > 0)
+    {
+        diffNode(aLeft, aRight, aLevel - 1, aIndex * 2, aRanges);
+        diffNode(aLeft, aRight, aLevel - 1, aIndex * 2 + 1, aRanges);
+        return;
+    }
+    // Merge adjacent leaves, which are visited in increasing order
+    const Range range = aLeft.getLeafRange(aIndex);
+    if (!aRanges.empty() && aRanges.back().last != std::numeric_limits<int64_t>::max() &&
+        aRanges.back().last + 1 == range.first)
+    {
+        aRanges.back().last = range.last;
+    }
+    else
+    {
+        aRanges.push_back(range);
+    }
+}
+
+// SQL function called by the triggers to mark the leaf of a rowid as dirty.
+void TableDigest::markFunction(sqlite3_context* apContext, int aNbArgs, sqlite3_value** apArgs)
+{
+    (void)aNbArgs;
+    TableDigest* pDigest = static_cast<TableDigest*>(sqlite3_user_data(apContext));
+    pDigest->markDirty(sqlite3_value_int64(apArgs[0]));
+    sqlite3_result_null(apContext);
+}
+
+}  // namespace SQLite
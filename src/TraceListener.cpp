@@ -0,0 +1,156 @@
+/**
+ * @file    TraceListener.cpp
+ * @ingroup SQLiteCpp
+ * @brief   Listener of the sqlite3_trace_v2() events of connections, shared by the instrumentation classes.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/TraceListener.h>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace SQLite
+{
+
+namespace
+{
+
+// Listeners of a connection, with the events they listen to
+using Listeners = std::vector<std::pair<TraceListener*, unsigned>>;
+
+// Listeners of each connection; modified under the mutex of the connection, then of the registry
+std::mutex                      gListenersMutex;
+std::map<sqlite3*, Listeners>   gListeners;
+
+// Lock the mutex of a connection, if it has one (in serialized mode)
+class ConnectionLock
+{
+public:
+    explicit ConnectionLock(sqlite3* apSQLite) :
+        mpMutex(sqlite3_db_mutex(apSQLite))
+    {
+        sqlite3_mutex_enter(mpMutex);
+    }
+
+    ~ConnectionLock()
+    {
+        sqlite3_mutex_leave(mpMutex);
+    }
+
+    ConnectionLock(const ConnectionLock&) = delete;
+    ConnectionLock& operator=(const ConnectionLock&) = delete;
+
+private:
+    sqlite3_mutex* mpMutex;
+};
+
+// Callback of sqlite3_trace_v2(), dispatching the events to the listeners of the connection
+int dispatch(unsigned aEvent, void* apContext, void* apP, void* apX)
+{
+    Listeners* pListeners = static_cast<Listeners*>(apContext);
+    if (aEvent == SQLITE_TRACE_CLOSE)
+    {
+        // The listeners can unsubscribe on close: work on a copy, then forget the connection
+        const Listeners listeners = *pListeners;
+        for (const auto& listener : listeners)
+        {
+            if (listener.second & SQLITE_TRACE_CLOSE)
+            {
+                listener.first->onTrace(aEvent, apP, apX);
+            }
+        }
+        const std::lock_guard<std::mutex> lock(gListenersMutex);
+        gListeners.erase(static_cast<sqlite3*>(apP));
+        return 0;
+    }
+    for (const auto& listener : *pListeners)
+    {
+        if (listener.second & aEvent)
+        {
+            listener.first->onTrace(aEvent, apP, apX);
+        }
+    }
+    return 0;
+}
+
+// Install the trace callback of a connection for the events of all its listeners, or remove it
+void install(sqlite3* apSQLite, Listeners& aListeners)
+{
+    unsigned mask = 0;
+    for (const auto& listener : aListeners)
+    {
+        mask |= listener.second;
+    }
+    if (mask != 0)
+    {
+        // The close event is always needed, to forget the connection
+        sqlite3_trace_v2(apSQLite, mask | SQLITE_TRACE_CLOSE, &dispatch, &aListeners);
+    }
+    else
+    {
+        sqlite3_trace_v2(apSQLite, 0, nullptr, nullptr);
+    }
+}
+
+} // namespace
+
+// Subscribe a listener to the trace events of a connection
+void TraceListener::subscribe(sqlite3* apSQLite, TraceListener& aListener, const unsigned aMask)
+{
+    const ConnectionLock connectionLock(apSQLite);
+    const std::lock_guard<std::mutex> lock(gListenersMutex);
+    Listeners& listeners = gListeners[apSQLite];
+    listeners.emplace_back(&aListener, aMask);
+    install(apSQLite, listeners);
+}
+
+// Unsubscribe a listener from the trace events of a connection
+void TraceListener::unsubscribe(sqlite3* apSQLite, TraceListener& aListener)
+{
+    const ConnectionLock connectionLock(apSQLite);
+    const std::lock_guard<std::mutex> lock(gListenersMutex);
+    const auto iListeners = gListeners.find(apSQLite);
+    if (iListeners == gListeners.end())
+    {
+        return;
+    }
+    Listeners& listeners = iListeners->second;
+    listeners.erase(std::remove_if(listeners.begin(), listeners.end(),
+                                   [&aListener](const std::pair<TraceListener*, unsigned>& aSubscribed)
+                                   {
+                                       return aSubscribed.first == &aListener;
+                                   }),
+                    listeners.end());
+    install(apSQLite, listeners);
+    if (listeners.empty())
+    {
+        gListeners.erase(iListeners);
+    }
+}
+
+// Tell if a SQLITE_TRACE_STMT event starts a trigger of a running statement, rather than the statement
+bool TraceListener::isTrigger(void* apP, void* apX)
+{
+    // The text is the SQL of the statement, prefixed by "-- " if run from within another statement,
+    // or a comment "-- TRIGGER name" at the start of a trigger
+    const char* pSql = sqlite3_sql(static_cast<sqlite3_stmt*>(apP));
+    const char* pText = static_cast<const char*>(apX);
+    if (pText == pSql || pText == nullptr || pSql == nullptr)
+    {
+        return false;
+    }
+    return (std::strcmp(pText, pSql) != 0) &&
+           ((std::strncmp(pText, "-- ", 3) != 0) || (std::strcmp(pText + 3, pSql) != 0));
+}
+
+}  // namespace SQLite
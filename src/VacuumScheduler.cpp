@@ -0,0 +1,130 @@
+/**
+ * @file    VacuumScheduler.cpp
+ * @ingroup SQLiteCpp
+ * @brief   Release the free pages of a database in small time-sliced batches, with incremental vacuum.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/VacuumScheduler.h>
+
+#include <SQLiteCpp/Exception.h>
+#include <SQLiteCpp/Quote.h>
+#include <SQLiteCpp/Statement.h>
+
+#include <sqlite3.h>
+
+namespace SQLite
+{
+
+namespace
+{
+
+// Value of "PRAGMA auto_vacuum" in INCREMENTAL mode
+const int AUTO_VACUUM_INCREMENTAL = 2;
+
+} // namespace
+
+// Schedule the incremental vacuum of a database.
+VacuumScheduler::VacuumScheduler(Database& aDatabase, const std::string& aSchema /* = "main" */) :
+    mDatabase(aDatabase),
+    mSchema(quote(aSchema))
+{
+}
+
+// Return true if the database is in "auto_vacuum = INCREMENTAL" mode.
+bool VacuumScheduler::isIncremental() const
+{
+    return mDatabase.execAndGet("PRAGMA " + mSchema + ".auto_vacuum").getInt() == AUTO_VACUUM_INCREMENTAL;
+}
+
+// Convert the database to "auto_vacuum = INCREMENTAL", as a one-time operation.
+bool VacuumScheduler::convert()
+{
+    const int mode = mDatabase.execAndGet("PRAGMA " + mSchema + ".auto_vacuum").getInt();
+    if (mode == AUTO_VACUUM_INCREMENTAL)
+    {
+        return false;
+    }
+    mDatabase.exec("PRAGMA " + mSchema + ".auto_vacuum = INCREMENTAL");
+    // Switching from FULL to INCREMENTAL only changes the header, but a database without auto_vacuum
+    // lacks the pointer-map pages, that are only built by a VACUUM
+    if (mode == 0)
+    {
+        mDatabase.exec("VACUUM " + mSchema);
+    }
+    if (!isIncremental())
+    {
+        throw SQLite::Exception("Unable to convert the database to auto_vacuum = INCREMENTAL");
+    }
+    return true;
+}
+
+// Return the number of free pages of the database.
+int64_t VacuumScheduler::getFreePages() const
+{
+    return mDatabase.execAndGet("PRAGMA " + mSchema + ".freelist_count").getInt64();
+}
+
+// Return true if there are enough free pages for a run to do some work.
+bool VacuumScheduler::isNeeded() const
+{
+    const int64_t freePages = getFreePages();
+    return freePages > 0 && freePages >= mMinFreePages;
+}
+
+// Release free pages by batches, until there is none left or the time budget is exhausted.
+int64_t VacuumScheduler::run(const std::chrono::milliseconds aBudget)
+{
+    const auto start = std::chrono::steady_clock::now();
+    int64_t freePages = getFreePages();
+    mMetrics.freePages = freePages;
+    if (freePages == 0 || freePages < mMinFreePages)
+    {
+        return 0;
+    }
+    if (!isIncremental())
+    {
+        throw SQLite::Exception("The database is not in auto_vacuum = INCREMENTAL mode");
+    }
+
+    ++mMetrics.runs;
+    const std::string batch = "PRAGMA " + mSchema + ".incremental_vacuum(" + std::to_string(mBatchPages) + ")";
+    int64_t released = 0;
+    do
+    {
+        try
+        {
+            mDatabase.exec(batch);
+        }
+        catch (const SQLite::Exception& e)
+        {
+            // Another connection is writing: yield to it, the next run will continue
+            const int errorCode = e.getErrorCode() & 0xff;
+            if (errorCode != SQLITE_BUSY && errorCode != SQLITE_LOCKED)
+            {
+                throw;
+            }
+            ++mMetrics.busy;
+            break;
+        }
+        ++mMetrics.batches;
+        const int64_t remaining = getFreePages();
+        if (remaining >= freePages)
+        {
+            break; // No progress, do not loop until the end of the budget
+        }
+        released += freePages - remaining;
+        freePages = remaining;
+    } while (freePages > 0 && std::chrono::steady_clock::now() - start < aBudget);
+
+    mMetrics.pagesReleased += released;
+    mMetrics.freePages = freePages;
+    const auto duration = std::chrono::steady_clock::now() - start;
+    mMetrics.duration += std::chrono::duration_cast<std::chrono::microseconds>(duration);
+    return released;
+}
+
+}  // namespace SQLite
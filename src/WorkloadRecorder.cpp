@@ -0,0 +1,591 @@
+/**
+ * @file    WorkloadRecorder.cpp
+ * @ingroup SQLiteCpp
+ * @brief   Record the statements executed on database connections to a compact binary log, to replay them later.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/WorkloadRecorder.h>
+
+#include <SQLiteCpp/Column.h>
+#include <SQLiteCpp/Exception.h>
+#include <SQLiteCpp/TraceListener.h>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+
+namespace SQLite
+{
+
+// Log format: the magic string and the version, then a sequence of records starting with their tag.
+// The integers are written as LEB128 varints, the signed ones zigzag encoded, and the strings prefixed by their size.
+//  'C' connection: index, filename
+//  'S' SQL text:   index, text
+//  'E' execution:  connection, thread, SQL index, start, duration, rows, done byte, number of parameters,
+//                  then each parameter: index, type byte, zigzag integer, 8 bytes little-endian double, or bytes
+
+/// State of a recorded connection, listening to its trace events
+struct WorkloadRecorder::Connection : public TraceListener
+{
+    Connection(WorkloadRecorder* apRecorder, sqlite3* apSQLite, uint32_t aIndex) :
+        pRecorder(apRecorder), pSQLite(apSQLite), index(aIndex)
+    {
+    }
+
+    void onTrace(unsigned aEvent, void* apP, void* apX) override
+    {
+        (void)apX;
+        pRecorder->trace(*this, aEvent, apP);
+    }
+
+    WorkloadRecorder*   pRecorder;  ///< Recorder of the connection
+    sqlite3*            pSQLite;    ///< Connection handle, nullptr once detached or closed
+    uint32_t            index;      ///< Index of the connection in the log
+};
+
+namespace
+{
+
+const char      LOG_MAGIC[] = "SQLCPPWL";
+const uint64_t  LOG_VERSION = 1;
+
+// Recorded connections, to find the recorder of the statements bound
+std::mutex                                      gRegistryMutex;
+std::map<sqlite3*, WorkloadRecorder::Connection*> gRegistry;
+std::atomic<int>                                gRecordedCount(0);
+
+// Remove a connection from the registry, if still registered
+void unregister(WorkloadRecorder::Connection& aConnection)
+{
+    const std::lock_guard<std::mutex> lock(gRegistryMutex);
+    const auto iConnection = gRegistry.find(aConnection.pSQLite);
+    if (iConnection != gRegistry.end() && iConnection->second == &aConnection)
+    {
+        gRegistry.erase(iConnection);
+        --gRecordedCount;
+    }
+}
+
+// Forward a value bound to the recorder of the connection of the statement, if any
+template <typename Operation>
+void dispatch(sqlite3_stmt* apStmt, Operation&& aOperation)
+{
+    const std::lock_guard<std::mutex> lock(gRegistryMutex);
+    const auto iConnection = gRegistry.find(sqlite3_db_handle(apStmt));
+    if (iConnection != gRegistry.end())
+    {
+        aOperation(*iConnection->second);
+    }
+}
+
+void writeVarint(std::ostream& aStream, uint64_t aValue)
+{
+    while (aValue >= 0x80)
+    {
+        aStream.put(static_cast<char>((aValue & 0x7F) | 0x80));
+        aValue >>= 7;
+    }
+    aStream.put(static_cast<char>(aValue));
+}
+
+void writeZigzag(std::ostream& aStream, const int64_t aValue)
+{
+    writeVarint(aStream, (static_cast<uint64_t>(aValue) << 1) ^ static_cast<uint64_t>(aValue >> 63));
+}
+
+void writeString(std::ostream& aStream, const std::string& aString)
+{
+    writeVarint(aStream, aString.size());
+    aStream.write(aString.data(), static_cast<std::streamsize>(aString.size()));
+}
+
+// Sequential reader of the log content, throwing on truncation
+class Reader
+{
+public:
+    explicit Reader(const std::string& aContent) :
+        mContent(aContent)
+    {
+    }
+
+    bool atEnd() const
+    {
+        return mPosition >= mContent.size();
+    }
+
+    uint8_t readByte()
+    {
+        if (atEnd())
+        {
+            throw SQLite::Exception("Truncated workload log");
+        }
+        const uint8_t byte = static_cast<uint8_t>(mContent[mPosition]);
+        ++mPosition;
+        return byte;
+    }
+
+    uint64_t readVarint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            const uint8_t byte = readByte();
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return value;
+            }
+        }
+        throw SQLite::Exception("Invalid varint in workload log");
+    }
+
+    int64_t readZigzag()
+    {
+        const uint64_t value = readVarint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    std::string readString()
+    {
+        const uint64_t size = readVarint();
+        if (size > mContent.size() - mPosition)
+        {
+            throw SQLite::Exception("Truncated workload log");
+        }
+        std::string string = mContent.substr(mPosition, static_cast<size_t>(size));
+        mPosition += static_cast<size_t>(size);
+        return string;
+    }
+
+private:
+    const std::string&  mContent;
+    size_t              mPosition = 0;
+};
+
+} // namespace
+
+WorkloadLog WorkloadLog::read(const std::string& aFilename)
+{
+    std::ifstream file(aFilename.c_str(), std::ios::binary);
+    if (!file.is_open())
+    {
+        throw SQLite::Exception("Unable to read the workload log " + aFilename);
+    }
+    const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (content.compare(0, sizeof(LOG_MAGIC) - 1, LOG_MAGIC) != 0)
+    {
+        throw SQLite::Exception(aFilename + " is not a workload log");
+    }
+
+    WorkloadLog log;
+    Reader reader(content);
+    for (size_t i = 0; i < sizeof(LOG_MAGIC) - 1; ++i)
+    {
+        reader.readByte();
+    }
+    if (reader.readVarint() != LOG_VERSION)
+    {
+        throw SQLite::Exception("Unsupported version of the workload log " + aFilename);
+    }
+    while (!reader.atEnd())
+    {
+        const char tag = static_cast<char>(reader.readByte());
+        if (tag == 'C' || tag == 'S')
+        {
+            std::vector<std::string>& strings = (tag == 'C') ? log.connections : log.sql;
+            const uint64_t index = reader.readVarint();
+            if (index != strings.size())
+            {
+                throw SQLite::Exception("Invalid index in workload log");
+            }
+            strings.push_back(reader.readString());
+        }
+        else if (tag == 'E')
+        {
+            Execution execution;
+            execution.connection = static_cast<uint32_t>(reader.readVarint());
+            execution.thread = static_cast<uint32_t>(reader.readVarint());
+            execution.sql = static_cast<uint32_t>(reader.readVarint());
+            execution.start = static_cast<int64_t>(reader.readVarint());
+            execution.duration = static_cast<int64_t>(reader.readVarint());
+            execution.rows = static_cast<int64_t>(reader.readVarint());
+            execution.bDone = reader.readByte() != 0;
+            if (execution.connection >= log.connections.size() || execution.sql >= log.sql.size())
+            {
+                throw SQLite::Exception("Invalid execution in workload log");
+            }
+            const uint64_t nbParameters = reader.readVarint();
+            for (uint64_t i = 0; i < nbParameters; ++i)
+            {
+                Parameter parameter;
+                parameter.index = static_cast<int>(reader.readVarint());
+                parameter.type = reader.readByte();
+                if (parameter.type == SQLite::INTEGER)
+                {
+                    parameter.integer = reader.readZigzag();
+                }
+                else if (parameter.type == SQLite::FLOAT)
+                {
+                    uint64_t bits = 0;
+                    for (int shift = 0; shift < 64; shift += 8)
+                    {
+                        bits |= static_cast<uint64_t>(reader.readByte()) << shift;
+                    }
+                    std::memcpy(&parameter.real, &bits, sizeof(bits));
+                }
+                else if (parameter.type == SQLite::TEXT || parameter.type == SQLite::BLOB)
+                {
+                    parameter.bytes = reader.readString();
+                }
+                execution.parameters.push_back(std::move(parameter));
+            }
+            log.executions.push_back(std::move(execution));
+        }
+        else
+        {
+            throw SQLite::Exception("Invalid record in workload log");
+        }
+    }
+
+    // The executions are written when they end: sort them by start time
+    std::stable_sort(log.executions.begin(), log.executions.end(),
+                     [](const Execution& aLeft, const Execution& aRight)
+                     {
+                         return aLeft.start < aRight.start;
+                     });
+    return log;
+}
+
+// Create the log file
+WorkloadRecorder::WorkloadRecorder(const std::string& aFilename) :
+    mFile(aFilename.c_str(), std::ios::binary | std::ios::trunc),
+    mStart(std::chrono::steady_clock::now())
+{
+    if (!mFile.is_open())
+    {
+        throw SQLite::Exception("Unable to create the workload log " + aFilename);
+    }
+    mFile.write(LOG_MAGIC, sizeof(LOG_MAGIC) - 1);
+    writeVarint(mFile, LOG_VERSION);
+}
+
+// Detach all the connections, and close the log file
+WorkloadRecorder::~WorkloadRecorder()
+{
+    for (const auto& pConnection : mConnections)
+    {
+        if (pConnection->pSQLite != nullptr)
+        {
+            unregister(*pConnection);
+            TraceListener::unsubscribe(pConnection->pSQLite, *pConnection);
+        }
+    }
+}
+
+// Start recording the statements executed on a database connection
+void WorkloadRecorder::attach(const Database& aDatabase)
+{
+    sqlite3* const pSQLite = aDatabase.getHandle();
+    Connection* pConnection = nullptr;
+    {
+        const std::lock_guard<std::mutex> lock(gRegistryMutex);
+        if (gRegistry.find(pSQLite) != gRegistry.end())
+        {
+            throw SQLite::Exception("The connection is already recorded");
+        }
+        {
+            const std::lock_guard<std::mutex> recorderLock(mMutex);
+            const uint32_t index = static_cast<uint32_t>(mConnections.size());
+            mConnections.emplace_back(new Connection(this, pSQLite, index));
+            pConnection = mConnections.back().get();
+            mFile.put('C');
+            writeVarint(mFile, index);
+            writeString(mFile, aDatabase.getFilename());
+        }
+        gRegistry[pSQLite] = pConnection;
+        ++gRecordedCount;
+    }
+    TraceListener::subscribe(pSQLite, *pConnection,
+                             SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW | SQLITE_TRACE_CLOSE);
+}
+
+// Stop recording the statements executed on a database connection
+void WorkloadRecorder::detach(const Database& aDatabase)
+{
+    sqlite3* const pSQLite = aDatabase.getHandle();
+    for (const auto& pConnection : mConnections)
+    {
+        if (pConnection->pSQLite == pSQLite)
+        {
+            unregister(*pConnection);
+            TraceListener::unsubscribe(pSQLite, *pConnection);
+            const std::lock_guard<std::mutex> lock(mMutex);
+            forget(*pConnection);
+            pConnection->pSQLite = nullptr;
+        }
+    }
+}
+
+// Write the buffered records to the log file
+void WorkloadRecorder::flush()
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    mFile.flush();
+}
+
+// Return the number of executions recorded so far
+int64_t WorkloadRecorder::getExecutionCount() const
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    return mExecutions;
+}
+
+// Record a value bound to a statement parameter
+void WorkloadRecorder::recordBind(sqlite3_stmt* apStmt, const int aIndex, const int64_t aValue)
+{
+    if (gRecordedCount.load(std::memory_order_relaxed) > 0)
+    {
+        WorkloadLog::Parameter parameter;
+        parameter.index = aIndex;
+        parameter.type = SQLite::INTEGER;
+        parameter.integer = aValue;
+        dispatch(apStmt, [&](Connection& aConnection)
+        {
+            aConnection.pRecorder->bind(aConnection, apStmt, parameter);
+        });
+    }
+}
+
+void WorkloadRecorder::recordBind(sqlite3_stmt* apStmt, const int aIndex, const double aValue)
+{
+    if (gRecordedCount.load(std::memory_order_relaxed) > 0)
+    {
+        WorkloadLog::Parameter parameter;
+        parameter.index = aIndex;
+        parameter.type = SQLite::FLOAT;
+        parameter.real = aValue;
+        dispatch(apStmt, [&](Connection& aConnection)
+        {
+            aConnection.pRecorder->bind(aConnection, apStmt, parameter);
+        });
+    }
+}
+
+void WorkloadRecorder::recordBind(sqlite3_stmt* apStmt, const int aIndex, const int aType, const void* apValue,
+                                  const int aSize)
+{
+    if (gRecordedCount.load(std::memory_order_relaxed) > 0)
+    {
+        WorkloadLog::Parameter parameter;
+        parameter.index = aIndex;
+        parameter.type = aType;
+        if (apValue == nullptr)
+        {
+            parameter.type = SQLite::Null;
+        }
+        else if (aSize < 0)
+        {
+            parameter.bytes = static_cast<const char*>(apValue);
+        }
+        else
+        {
+            parameter.bytes.assign(static_cast<const char*>(apValue), static_cast<size_t>(aSize));
+        }
+        dispatch(apStmt, [&](Connection& aConnection)
+        {
+            aConnection.pRecorder->bind(aConnection, apStmt, parameter);
+        });
+    }
+}
+
+void WorkloadRecorder::recordBind(sqlite3_stmt* apStmt, const int aIndex)
+{
+    if (gRecordedCount.load(std::memory_order_relaxed) > 0)
+    {
+        WorkloadLog::Parameter parameter;
+        parameter.index = aIndex;
+        parameter.type = SQLite::Null;
+        dispatch(apStmt, [&](Connection& aConnection)
+        {
+            aConnection.pRecorder->bind(aConnection, apStmt, parameter);
+        });
+    }
+}
+
+// Forget the values bound to a statement
+void WorkloadRecorder::recordClearBindings(sqlite3_stmt* apStmt)
+{
+    if (gRecordedCount.load(std::memory_order_relaxed) > 0)
+    {
+        dispatch(apStmt, [&](Connection& aConnection)
+        {
+            aConnection.pRecorder->clearBindings(apStmt);
+        });
+    }
+}
+
+// Handle an event of sqlite3_trace_v2() on a recorded connection
+void WorkloadRecorder::trace(Connection& aConnection, const unsigned aEvent, void* apP)
+{
+    if (aEvent == SQLITE_TRACE_CLOSE)
+    {
+        unregister(aConnection);
+        const std::lock_guard<std::mutex> lock(mMutex);
+        forget(aConnection);
+        aConnection.pSQLite = nullptr;
+        return;
+    }
+
+    sqlite3_stmt* const pStmt = static_cast<sqlite3_stmt*>(apP);
+    const auto now = std::chrono::steady_clock::now();
+    const std::lock_guard<std::mutex> lock(mMutex);
+    auto iRunning = mRunning.find(pStmt);
+    if (aEvent == SQLITE_TRACE_STMT)
+    {
+        // A statement already running is starting a trigger
+        if (iRunning == mRunning.end())
+        {
+            Running& running = mRunning[pStmt];
+            running.start = now;
+            running.execution.connection = aConnection.index;
+            running.execution.thread = getThread();
+            running.execution.sql = getSql(sqlite3_sql(pStmt));
+            running.execution.start = std::chrono::duration_cast<std::chrono::nanoseconds>(now - mStart).count();
+            const auto iBindings = mBindings.find(pStmt);
+            if (iBindings != mBindings.end())
+            {
+                running.execution.parameters = iBindings->second.parameters;
+            }
+        }
+    }
+    else if (iRunning != mRunning.end())
+    {
+        if (aEvent == SQLITE_TRACE_ROW)
+        {
+            ++iRunning->second.execution.rows;
+        }
+        else if (aEvent == SQLITE_TRACE_PROFILE)
+        {
+            WorkloadLog::Execution& execution = iRunning->second.execution;
+            execution.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                now - iRunning->second.start).count();
+            execution.bDone = (sqlite3_stmt_busy(pStmt) == 0);
+            writeExecution(execution);
+            mRunning.erase(iRunning);
+        }
+    }
+}
+
+// Return the number of the current thread
+uint32_t WorkloadRecorder::getThread()
+{
+    const auto iThread = mThreads.insert(std::make_pair(std::this_thread::get_id(),
+                                                        static_cast<uint32_t>(mThreads.size())));
+    return iThread.first->second;
+}
+
+// Return the index of a SQL text, writing it to the log on first use
+uint32_t WorkloadRecorder::getSql(const char* apSql)
+{
+    const auto iSql = mSql.insert(std::make_pair(std::string(apSql ? apSql : ""),
+                                                 static_cast<uint32_t>(mSql.size())));
+    if (iSql.second)
+    {
+        mFile.put('S');
+        writeVarint(mFile, iSql.first->second);
+        writeString(mFile, iSql.first->first);
+    }
+    return iSql.first->second;
+}
+
+// Record a value bound to a parameter of a statement of a recorded connection
+void WorkloadRecorder::bind(const Connection& aConnection, sqlite3_stmt* apStmt,
+                            const WorkloadLog::Parameter& aParameter)
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    Bindings& bindings = mBindings[apStmt];
+    bindings.connection = aConnection.index;
+    const auto iParameter = std::lower_bound(bindings.parameters.begin(), bindings.parameters.end(),
+                                             aParameter.index,
+                                             [](const WorkloadLog::Parameter& aBound, const int aIndex)
+                                             {
+                                                 return aBound.index < aIndex;
+                                             });
+    if (iParameter != bindings.parameters.end() && iParameter->index == aParameter.index)
+    {
+        *iParameter = aParameter;
+    }
+    else
+    {
+        bindings.parameters.insert(iParameter, aParameter);
+    }
+}
+
+// Forget the values bound to a statement
+void WorkloadRecorder::clearBindings(sqlite3_stmt* apStmt)
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    mBindings.erase(apStmt);
+}
+
+// Forget the state of the statements of a connection no longer recorded
+void WorkloadRecorder::forget(const Connection& aConnection)
+{
+    for (auto iBindings = mBindings.begin(); iBindings != mBindings.end();)
+    {
+        iBindings = (iBindings->second.connection == aConnection.index) ? mBindings.erase(iBindings)
+                                                                         : std::next(iBindings);
+    }
+    for (auto iRunning = mRunning.begin(); iRunning != mRunning.end();)
+    {
+        iRunning = (iRunning->second.execution.connection == aConnection.index) ? mRunning.erase(iRunning)
+                                                                                 : std::next(iRunning);
+    }
+}
+
+// Write a record of an execution to the log
+void WorkloadRecorder::writeExecution(const WorkloadLog::Execution& aExecution)
+{
+    mFile.put('E');
+    writeVarint(mFile, aExecution.connection);
+    writeVarint(mFile, aExecution.thread);
+    writeVarint(mFile, aExecution.sql);
+    writeVarint(mFile, static_cast<uint64_t>(aExecution.start));
+    writeVarint(mFile, static_cast<uint64_t>(aExecution.duration));
+    writeVarint(mFile, static_cast<uint64_t>(aExecution.rows));
+    mFile.put(aExecution.bDone ? 1 : 0);
+    writeVarint(mFile, aExecution.parameters.size());
+    for (const WorkloadLog::Parameter& parameter : aExecution.parameters)
+    {
+        writeVarint(mFile, static_cast<uint64_t>(parameter.index));
+        mFile.put(static_cast<char>(parameter.type));
+        if (parameter.type == SQLite::INTEGER)
+        {
+            writeZigzag(mFile, parameter.integer);
+        }
+        else if (parameter.type == SQLite::FLOAT)
+        {
+            uint64_t bits = 0;
+            std::memcpy(&bits, &parameter.real, sizeof(bits));
+            for (int shift = 0; shift < 64; shift += 8)
+            {
+                mFile.put(static_cast<char>((bits >> shift) & 0xFF));
+            }
+        }
+        else if (parameter.type == SQLite::TEXT || parameter.type == SQLite::BLOB)
+        {
+            writeString(mFile, parameter.bytes);
+        }
+    }
+    ++mExecutions;
+}
+
+}  // namespace SQLite
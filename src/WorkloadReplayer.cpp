@@ -0,0 +1,328 @@
+/**
+ * @file    WorkloadReplayer.cpp
+ * @ingroup SQLiteCpp
+ * @brief   Replay a workload log recorded by a WorkloadRecorder against a copy of the database.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#include <SQLiteCpp/WorkloadReplayer.h>
+
+#include <SQLiteCpp/Column.h>
+#include <SQLiteCpp/Exception.h>
+#include <SQLiteCpp/Statement.h>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <exception>
+#include <map>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace SQLite
+{
+
+namespace
+{
+
+// Maximum number of distinct error messages reported
+const size_t MAX_ERROR_MESSAGES = 16;
+
+// Bind the recorded values to the parameters of a statement
+void bindParameters(Statement& aStatement, const std::vector<WorkloadLog::Parameter>& aParameters)
+{
+    for (const WorkloadLog::Parameter& parameter : aParameters)
+    {
+        if (parameter.type == SQLite::INTEGER)
+        {
+            aStatement.bind(parameter.index, parameter.integer);
+        }
+        else if (parameter.type == SQLite::FLOAT)
+        {
+            aStatement.bind(parameter.index, parameter.real);
+        }
+        else if (parameter.type == SQLite::TEXT)
+        {
+            aStatement.bind(parameter.index, parameter.bytes);
+        }
+        else if (parameter.type == SQLite::BLOB)
+        {
+            aStatement.bind(parameter.index, parameter.bytes.data(), static_cast<int>(parameter.bytes.size()));
+        }
+        else
+        {
+            aStatement.bind(parameter.index);
+        }
+    }
+}
+
+// Return the uppercase words of a SQL text, up to a maximum number, skipping the comments
+std::vector<std::string> getWords(const std::string& aSql, const size_t aMaxWords)
+{
+    std::vector<std::string> words;
+    size_t i = 0;
+    while (i < aSql.size() && words.size() < aMaxWords)
+    {
+        const char c = aSql[i];
+        if (0 == aSql.compare(i, 2, "--"))
+        {
+            i = aSql.find('\n', i);
+        }
+        else if (0 == aSql.compare(i, 2, "/*"))
+        {
+            i = aSql.find("*/", i + 2);
+            i = (i == std::string::npos) ? i : i + 2;
+        }
+        else if (std::isalnum(static_cast<unsigned char>(c)) || c == '_')
+        {
+            std::string word;
+            for (; i < aSql.size() && (std::isalnum(static_cast<unsigned char>(aSql[i])) || aSql[i] == '_'); ++i)
+            {
+                word += static_cast<char>(std::toupper(static_cast<unsigned char>(aSql[i])));
+            }
+            words.push_back(word);
+        }
+        else if (c == '"' || c == '\'' || c == '`' || c == '[')
+        {
+            // Quoted name of a savepoint
+            const char end = (c == '[') ? ']' : c;
+            const size_t last = aSql.find(end, i + 1);
+            words.push_back(aSql.substr(i + 1, last - i - 1));
+            i = (last == std::string::npos) ? last : last + 1;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    return words;
+}
+
+// Transaction of a recorded connection, followed from the SQL text of its executions
+struct Transaction
+{
+    bool                                        bBegin = false; ///< true after a BEGIN
+    std::vector<std::string>                    savepoints;     ///< Names of the savepoints open
+    std::vector<const WorkloadLog::Execution*>  executions;     ///< Executions held until the end of the transaction
+
+    bool isOpen() const noexcept
+    {
+        return bBegin || !savepoints.empty();
+    }
+
+    // Update the state of the transaction with a statement executed
+    void execute(const std::string& aSql)
+    {
+        const std::vector<std::string> words = getWords(aSql, 3);
+        if (words.empty())
+        {
+            return;
+        }
+        if (words[0] == "BEGIN")
+        {
+            bBegin = true;
+        }
+        else if (words[0] == "COMMIT" || words[0] == "END" ||
+                 (words[0] == "ROLLBACK" && std::find(words.begin(), words.end(), "TO") == words.end()))
+        {
+            bBegin = false;
+            savepoints.clear();
+        }
+        else if (words[0] == "SAVEPOINT" && words.size() > 1)
+        {
+            savepoints.push_back(words[1]);
+        }
+        else if (words[0] == "RELEASE" && words.size() > 1)
+        {
+            // Release the savepoint and all the ones opened after it
+            const std::string& name = (words[1] == "SAVEPOINT" && words.size() > 2) ? words[2] : words[1];
+            for (size_t i = savepoints.size(); i > 0; --i)
+            {
+                if (0 == sqlite3_stricmp(savepoints[i - 1].c_str(), name.c_str()))
+                {
+                    savepoints.resize(i - 1);
+                    break;
+                }
+            }
+        }
+    }
+};
+
+// Replay the executions of the recorded connections of one connection, in order of start time
+void replayConnection(const WorkloadLog& aLog, const std::vector<const WorkloadLog::Execution*>& aExecutions,
+                      const std::string& aFilename, const ReplayOptions& aOptions,
+                      const std::chrono::steady_clock::time_point aStart, ReplayReport& aReport)
+{
+    Database db(aFilename, OPEN_READWRITE, aOptions.busyTimeoutMs);
+    for (const std::string& setup : aOptions.setup)
+    {
+        db.exec(setup);
+    }
+
+    const int64_t firstStart = aLog.executions.empty() ? 0 : aLog.executions.front().start;
+    std::map<uint32_t, std::unique_ptr<Statement>> statements;
+    for (const WorkloadLog::Execution* pExecution : aExecutions)
+    {
+        if (aOptions.speed > 0.0)
+        {
+            const double delay = static_cast<double>(pExecution->start - firstStart) / aOptions.speed;
+            std::this_thread::sleep_until(aStart + std::chrono::nanoseconds(static_cast<int64_t>(delay)));
+        }
+
+        ReplayReport::Query& statistics = aReport.queries[pExecution->sql];
+        ++statistics.executions;
+        statistics.recordedNs += pExecution->duration;
+        const auto start = std::chrono::steady_clock::now();
+        try
+        {
+            std::unique_ptr<Statement>& pStatement = statements[pExecution->sql];
+            if (!pStatement)
+            {
+                pStatement.reset(new Statement(db, aLog.sql[pExecution->sql]));
+            }
+            pStatement->clearBindings();
+            bindParameters(*pStatement, pExecution->parameters);
+            int64_t rows = 0;
+            while ((pExecution->bDone || rows < pExecution->rows) && pStatement->executeStep())
+            {
+                ++rows;
+            }
+            pStatement->reset();
+        }
+        catch (const std::exception& e)
+        {
+            ++statistics.errors;
+            const auto iStatement = statements.find(pExecution->sql);
+            if (iStatement != statements.end() && iStatement->second)
+            {
+                iStatement->second->tryReset();
+            }
+            if (aReport.errorMessages.size() < MAX_ERROR_MESSAGES &&
+                std::find(aReport.errorMessages.begin(), aReport.errorMessages.end(), e.what()) ==
+                    aReport.errorMessages.end())
+            {
+                aReport.errorMessages.push_back(e.what());
+            }
+        }
+        statistics.replayedNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+} // namespace
+
+// Replay a workload log
+WorkloadReplayer::WorkloadReplayer(WorkloadLog aLog) :
+    mLog(std::move(aLog))
+{
+}
+
+// Replay the workload against a database
+ReplayReport WorkloadReplayer::replay(const std::string& aFilename, const ReplayOptions& aOptions) const
+{
+    // Sessions: executions of a recorded connection, in order of first execution
+    std::map<uint32_t, size_t> sessions;
+    for (const WorkloadLog::Execution& execution : mLog.executions)
+    {
+        sessions.insert(std::make_pair(execution.connection, sessions.size()));
+    }
+    size_t nbConnections = sessions.size();
+    if (aOptions.concurrency > 0)
+    {
+        nbConnections = std::min<size_t>(aOptions.concurrency, std::max<size_t>(nbConnections, 1));
+    }
+
+    // The executions of a transaction are held until its end, so that the transactions of the sessions
+    // sharing a connection are replayed as a whole, in the order of their ends, and never interleave
+    typedef std::vector<const WorkloadLog::Execution*> Executions;
+    std::vector<Executions> executions(nbConnections);
+    std::map<uint32_t, Transaction> transactions;
+    for (const WorkloadLog::Execution& execution : mLog.executions)
+    {
+        Transaction& transaction = transactions[execution.connection];
+        transaction.executions.push_back(&execution);
+        transaction.execute(mLog.sql[execution.sql]);
+        if (!transaction.isOpen())
+        {
+            Executions& connection = executions[sessions[execution.connection] % nbConnections];
+            connection.insert(connection.end(), transaction.executions.begin(), transaction.executions.end());
+            transaction.executions.clear();
+        }
+    }
+    // Transactions still open at the end of the recording
+    for (const std::pair<const uint32_t, Transaction>& transaction : transactions)
+    {
+        Executions& connection = executions[sessions[transaction.first] % nbConnections];
+        connection.insert(connection.end(), transaction.second.executions.begin(), transaction.second.executions.end());
+    }
+
+    ReplayReport empty;
+    for (const std::string& sql : mLog.sql)
+    {
+        ReplayReport::Query statistics;
+        statistics.sql = sql;
+        empty.queries.push_back(statistics);
+    }
+    std::vector<ReplayReport> reports(nbConnections, empty);
+    std::vector<std::exception_ptr> exceptions(nbConnections);
+    std::vector<std::thread> threads;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < nbConnections; ++i)
+    {
+        threads.emplace_back([&, i]
+        {
+            try
+            {
+                replayConnection(mLog, executions[i], aFilename, aOptions, start, reports[i]);
+            }
+            catch (...)
+            {
+                exceptions[i] = std::current_exception();
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    ReplayReport report = empty;
+    report.durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    report.connections = static_cast<unsigned>(nbConnections);
+    for (size_t i = 0; i < nbConnections; ++i)
+    {
+        if (exceptions[i])
+        {
+            std::rethrow_exception(exceptions[i]);
+        }
+        for (size_t sql = 0; sql < report.queries.size(); ++sql)
+        {
+            const ReplayReport::Query& statistics = reports[i].queries[sql];
+            report.queries[sql].executions += statistics.executions;
+            report.queries[sql].errors += statistics.errors;
+            report.queries[sql].recordedNs += statistics.recordedNs;
+            report.queries[sql].replayedNs += statistics.replayedNs;
+            report.executions += statistics.executions;
+            report.errors += statistics.errors;
+        }
+        for (const std::string& message : reports[i].errorMessages)
+        {
+            if (report.errorMessages.size() < MAX_ERROR_MESSAGES &&
+                std::find(report.errorMessages.begin(), report.errorMessages.end(), message) ==
+                    report.errorMessages.end())
+            {
+                report.errorMessages.push_back(message);
+            }
+        }
+    }
+    return report;
+}
+
+}  // namespace SQLite
@@ -0,0 +1,261 @@
+/**
+ * @file    Allocations_test.cpp
+ * @ingroup tests
+ * @brief   Count the heap allocations of the hot paths, to keep them out of the steady-state loops.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Statement.h>
+#include <SQLiteCpp/Column.h>
+
+#include <sqlite3.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+
+// This test program replaces the global operator new, so it is built as its own executable.
+
+namespace
+{
+
+std::atomic<int64_t> gNewCount(0);          // Number of calls to operator new
+std::atomic<int64_t> gSQLiteMallocCount(0); // Number of heap allocations of SQLite (not from its lookaside memory)
+sqlite3_mem_methods gDefaultMethods;        // Allocator of SQLite, called by the counting one
+
+// Counting allocator of SQLite
+void* countingMalloc(int aSize)
+{
+    ++gSQLiteMallocCount;
+    return gDefaultMethods.xMalloc(aSize);
+}
+
+void* countingRealloc(void* apMemory, int aSize)
+{
+    ++gSQLiteMallocCount;
+    return gDefaultMethods.xRealloc(apMemory, aSize);
+}
+
+// Install the counting allocator, before SQLite is initialized
+int installCountingAllocator()
+{
+    int ret = sqlite3_config(SQLITE_CONFIG_GETMALLOC, &gDefaultMethods);
+    if (ret == SQLITE_OK)
+    {
+        sqlite3_mem_methods methods = gDefaultMethods;
+        methods.xMalloc = &countingMalloc;
+        methods.xRealloc = &countingRealloc;
+        ret = sqlite3_config(SQLITE_CONFIG_MALLOC, &methods);
+    }
+    return ret;
+}
+const int gInstallResult = installCountingAllocator();
+
+/// Count the allocations done during its lifetime
+class AllocationCounter
+{
+public:
+    AllocationCounter() :
+        mNewCount(gNewCount),
+        mSQLiteMallocCount(gSQLiteMallocCount)
+    {
+    }
+
+    // Return the number of calls to operator new since the construction
+    int64_t getNew() const
+    {
+        return gNewCount - mNewCount;
+    }
+
+    // Return the number of heap allocations of SQLite since the construction
+    int64_t getSQLite() const
+    {
+        return gSQLiteMallocCount - mSQLiteMallocCount;
+    }
+
+private:
+    int64_t mNewCount;
+    int64_t mSQLiteMallocCount;
+};
+
+// Number of rows of the test table
+const int NB_ROWS = 10;
+
+// Create a table with long column names and values, that do not fit in a small string buffer
+void createTable(SQLite::Database& aDb)
+{
+    aDb.exec("CREATE TABLE test (identifier_of_the_row INTEGER PRIMARY KEY, a_rather_long_column_name TEXT)");
+    aDb.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 10) "
+             "INSERT INTO test SELECT i, printf('%064d', i) FROM n");
+}
+
+} // namespace
+
+void* operator new(std::size_t aSize)
+{
+    ++gNewCount;
+    void* pMemory = std::malloc(aSize ? aSize : 1);
+    if (pMemory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return pMemory;
+}
+
+void* operator new[](std::size_t aSize)
+{
+    return operator new(aSize);
+}
+
+void operator delete(void* apMemory) noexcept
+{
+    std::free(apMemory);
+}
+
+void operator delete[](void* apMemory) noexcept
+{
+    std::free(apMemory);
+}
+
+void operator delete(void* apMemory, std::size_t) noexcept
+{
+    std::free(apMemory);
+}
+
+void operator delete[](void* apMemory, std::size_t) noexcept
+{
+    std::free(apMemory);
+}
+
+TEST(Allocations, counters)
+{
+    ASSERT_EQ(SQLITE_OK, gInstallResult);
+    {
+        const AllocationCounter counter;
+        std::unique_ptr<std::string> pString(new std::string("a string too long for a small string buffer"));
+        EXPECT_EQ(2, counter.getNew());
+    }
+    {
+        const AllocationCounter counter;
+        SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+        EXPECT_GT(counter.getSQLite(), 0);
+    }
+}
+
+TEST(Allocations, stepByIndex)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    createTable(db);
+    SQLite::Statement query(db, "SELECT identifier_of_the_row, a_rather_long_column_name FROM test WHERE "
+                                "identifier_of_the_row >= ?");
+    int64_t sum = 0;
+    const auto loop = [&]
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            query.reset();
+            query.bind(1, i % NB_ROWS);
+            while (query.executeStep())
+            {
+                sum += query.getColumn(0).getInt64();
+                sum += query.getColumn(1).getBytes();
+            }
+        }
+    };
+    loop(); // Warm up
+
+    const AllocationCounter counter;
+    loop();
+    EXPECT_EQ(0, counter.getNew());
+    EXPECT_EQ(0, counter.getSQLite());
+    EXPECT_GT(sum, 0);
+}
+
+TEST(Allocations, stepByName)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    createTable(db);
+    SQLite::Statement query(db, "SELECT * FROM test WHERE identifier_of_the_row >= :min");
+    int64_t sum = 0;
+    const auto loop = [&]
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            query.reset();
+            query.bind(":min", i % NB_ROWS);
+            while (query.executeStep())
+            {
+                sum += query.getColumn("identifier_of_the_row").getInt64();
+                sum += query.isColumnNull("a_rather_long_column_name") ? 0 : 1;
+            }
+        }
+    };
+    loop(); // Warm up, building the index of the column names
+
+    const AllocationCounter counter;
+    loop();
+    EXPECT_EQ(0, counter.getNew());
+    EXPECT_EQ(0, counter.getSQLite());
+    EXPECT_GT(sum, 0);
+}
+
+TEST(Allocations, bindNoCopy)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    createTable(db);
+    SQLite::Statement query(db, "SELECT count(*) FROM test WHERE a_rather_long_column_name > ?");
+    const std::string value(64, '0');
+    int64_t sum = 0;
+    const auto loop = [&]
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            query.reset();
+            query.bindNoCopy(1, value);
+            while (query.executeStep())
+            {
+                sum += query.getColumn(0).getInt64();
+            }
+        }
+    };
+    loop(); // Warm up
+
+    const AllocationCounter counter;
+    loop();
+    EXPECT_EQ(0, counter.getNew());
+    EXPECT_EQ(0, counter.getSQLite());
+    EXPECT_GT(sum, 0);
+}
+
+TEST(Allocations, getString)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    createTable(db);
+    SQLite::Statement query(db, "SELECT a_rather_long_column_name FROM test");
+    size_t size = 0;
+    const auto loop = [&]
+    {
+        query.reset();
+        while (query.executeStep())
+        {
+            size += query.getColumn(0).getString().size();
+        }
+    };
+    loop(); // Warm up
+
+    // The only allocation is the std::string returned, too long for its small string buffer
+    const AllocationCounter counter;
+    loop();
+    EXPECT_EQ(NB_ROWS, counter.getNew());
+    EXPECT_EQ(0, counter.getSQLite());
+    EXPECT_EQ(2u * NB_ROWS * 64u, size);
+}
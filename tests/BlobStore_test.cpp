@@ -0,0 +1,200 @@
+/**
+ * @file    BlobStore_test.cpp
+ * @ingroup tests
+ * @brief   Test of the deduplicating blob store.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/BlobStore.h>
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Statement.h>
+#include <SQLiteCpp/Exception.h>
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <utility>
+
+namespace
+{
+
+// Pseudo-random content, reproducible
+std::string randomData(const size_t aSize, uint32_t aSeed)
+{
+    std::string data(aSize, '\0');
+    for (char& c : data)
+    {
+        aSeed = aSeed * 1103515245u + 12345u;
+        c = static_cast<char>(aSeed >> 16);
+    }
+    return data;
+}
+
+} // namespace
+
+TEST(BlobStore, putGet)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    SQLite::BlobStore store(db);
+    EXPECT_TRUE(db.tableExists("blobstore_index"));
+    EXPECT_TRUE(db.tableExists("blobstore_chunks"));
+
+    const std::string data = randomData(200000, 1);
+    store.put("a", data.data(), data.size());
+    EXPECT_TRUE(store.exists("a"));
+    EXPECT_FALSE(store.exists("b"));
+    EXPECT_EQ(data, store.get("a"));
+
+    // The chunks are within the bounds, and cover the data
+    const std::vector<size_t> sizes = store.split(data.data(), data.size());
+    size_t total = 0;
+    for (size_t i = 0; i < sizes.size(); ++i)
+    {
+        if (i + 1 < sizes.size())
+        {
+            EXPECT_GT(sizes[i], 2048u);
+        }
+        EXPECT_LE(sizes[i], 65536u);
+        total += sizes[i];
+    }
+    EXPECT_EQ(data.size(), total);
+
+    const SQLite::BlobStore::Stats stats = store.getStats();
+    EXPECT_EQ(1, stats.nbObjects);
+    EXPECT_EQ(200000, stats.logicalBytes);
+    EXPECT_EQ(static_cast<int64_t>(sizes.size()), stats.nbChunks);
+    EXPECT_EQ(200000, stats.storedBytes);
+
+    // Streaming read, by small pieces crossing the chunk boundaries
+    SQLite::BlobStore::Reader reader = store.open("a");
+    EXPECT_EQ(200000, reader.getSize());
+    std::string read;
+    char buffer[1000];
+    while (const size_t size = reader.read(buffer, sizeof(buffer)))
+    {
+        read.append(buffer, size);
+    }
+    EXPECT_EQ(data, read);
+
+    // Chunks are identified by their SHA-256
+    store.put("abc", "abc", 3);
+    EXPECT_EQ("BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD",
+              db.execAndGet("SELECT hex(hash) FROM blobstore_index WHERE size = 3").getString());
+    const std::string twoBlocks = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    store.put("twoBlocks", twoBlocks.data(), twoBlocks.size());
+    EXPECT_EQ("248D6A61D20638B8E5C026930C3E6039A33CE45964FF2167F6ECEDD419DB06C1",
+              db.execAndGet("SELECT hex(hash) FROM blobstore_index WHERE size = 56").getString());
+
+    // Empty object, and errors
+    store.put("empty", "", 0);
+    EXPECT_EQ("", store.get("empty"));
+    EXPECT_THROW(store.open("unknown"), SQLite::Exception);
+    EXPECT_THROW(SQLite::BlobStore(db, "bad", 4096, 4096, 8192), SQLite::Exception);
+}
+
+TEST(BlobStore, deduplication)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    SQLite::BlobStore store(db, "attachments");
+
+    // The same attachment twice is stored once
+    const std::string data = randomData(300000, 2);
+    store.put("first", data.data(), data.size());
+    const SQLite::BlobStore::Stats once = store.getStats();
+    store.put("second", data.data(), data.size());
+    SQLite::BlobStore::Stats stats = store.getStats();
+    EXPECT_EQ(2, stats.nbObjects);
+    EXPECT_EQ(600000, stats.logicalBytes);
+    EXPECT_EQ(once.nbChunks, stats.nbChunks);
+    EXPECT_EQ(300000, stats.storedBytes);
+
+    // An insertion only adds the chunks around it, thanks to the content-defined boundaries
+    std::string edited = data;
+    edited.insert(150000, "a few inserted bytes");
+    std::istringstream stream(edited);
+    store.put("edited", stream);
+    EXPECT_EQ(edited, store.get("edited"));
+    stats = store.getStats();
+    EXPECT_LE(stats.nbChunks, once.nbChunks + 2);
+    EXPECT_LT(stats.storedBytes, 300000 + 2 * 65536);
+
+    // Chunks are released with their last reference
+    EXPECT_TRUE(store.remove("first"));
+    EXPECT_FALSE(store.remove("first"));
+    EXPECT_EQ(stats.nbChunks, store.getStats().nbChunks);
+    EXPECT_TRUE(store.remove("second"));
+    EXPECT_EQ(data, std::string(edited).erase(150000, 20));
+    stats = store.getStats();
+    EXPECT_EQ(1, stats.nbObjects);
+    EXPECT_EQ(static_cast<int64_t>(edited.size()), stats.storedBytes);
+    EXPECT_EQ(stats.nbChunks, db.execAndGet("SELECT count(*) FROM attachments_chunks").getInt64());
+
+    // Replacing an object releases its previous chunks
+    store.put("edited", "small", 5);
+    EXPECT_EQ("small", store.get("edited"));
+    stats = store.getStats();
+    EXPECT_EQ(1, stats.nbChunks);
+    EXPECT_EQ(5, stats.storedBytes);
+}
+
+TEST(BlobStore, writer)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    SQLite::BlobStore store(db);
+    const std::string data = randomData(100000, 3);
+    {
+        // Not committed: rolled back
+        SQLite::BlobStore::Writer writer = store.create("partial");
+        writer.write(data.data(), data.size());
+    }
+    EXPECT_FALSE(store.exists("partial"));
+    EXPECT_EQ(0, store.getStats().nbChunks);
+    EXPECT_EQ(0, db.execAndGet("SELECT count(*) FROM blobstore_objects").getInt());
+
+    // Same chunks, whatever the sizes of the writes
+    SQLite::BlobStore::Writer writer = store.create("streamed");
+    for (size_t i = 0; i < data.size(); i += 777)
+    {
+        writer.write(data.data() + i, std::min<size_t>(777, data.size() - i));
+    }
+    writer.commit();
+    EXPECT_THROW(writer.write("x", 1), SQLite::Exception);
+    store.put("whole", data.data(), data.size());
+    EXPECT_EQ(data, store.get("streamed"));
+    EXPECT_EQ(static_cast<int64_t>(store.split(data.data(), data.size()).size()), store.getStats().nbChunks);
+}
+
+TEST(BlobStore, interleavedWriters)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    SQLite::BlobStore store(db);
+    const std::string first = randomData(50000, 4);
+    const std::string second = randomData(50000, 5);
+    {
+        // The savepoint of a second writer would be released or rolled back with the first one
+        SQLite::BlobStore::Writer writer = store.create("first");
+        writer.write(first.data(), first.size());
+        EXPECT_THROW(store.create("second"), SQLite::Exception);
+        EXPECT_THROW(store.put("second", second.data(), second.size()), SQLite::Exception);
+        writer.write(first.data(), first.size());
+    }
+    EXPECT_FALSE(store.exists("first"));
+
+    // One writer after the other
+    SQLite::BlobStore::Writer writer1 = store.create("first");
+    writer1.write(first.data(), first.size());
+    writer1.commit();
+    SQLite::BlobStore::Writer writer2 = store.create("second");
+    writer2.write(second.data(), second.size());
+    SQLite::BlobStore::Writer moved = std::move(writer2);
+    EXPECT_THROW(store.create("third"), SQLite::Exception);
+    moved.commit();
+    store.put("third", second.data(), second.size());
+    EXPECT_EQ(first, store.get("first"));
+    EXPECT_EQ(second, store.get("second"));
+    EXPECT_EQ(second, store.get("third"));
+}
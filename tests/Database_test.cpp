@@ -10,6 +10,8 @@
  */
 
 #include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Statement.h>
+#include <SQLiteCpp/Transaction.h>
 
 #include <sqlite3.h> // for SQLITE_ERROR and SQLITE_VERSION_NUMBER
 
@@ -19,8 +21,10 @@
 #include  <filesystem>
 #endif // c++17
 
+#include <algorithm>
 #include <cstdio>
 #include <fstream>
+#include <thread>
 
 #ifdef SQLITECPP_ENABLE_ASSERT_HANDLER
 namespace SQLite
@@ -568,6 +572,558 @@ TEST(Database, getHeaderInfo)
     remove("test.db3");
 }
 
+#ifdef SQLITE_ENABLE_DBSTAT_VTAB
+TEST(Database, analyzeSpace)
+{
+    remove("test.db3");
+    {
+        SQLite::Database db("test.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        db.exec("PRAGMA page_size = 4096");
+        db.exec("CREATE TABLE test (id INTEGER PRIMARY KEY, key TEXT, value BLOB)");
+        db.exec("CREATE INDEX test_key ON test(key)");
+        db.exec("CREATE TABLE blobs (data BLOB)");
+        db.exec("CREATE TABLE temporary (data BLOB)");
+        {
+            SQLite::Transaction transaction(db);
+            // Random keys fill the index out of order
+            db.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 20000) "
+                    "INSERT INTO test SELECT i, hex(randomblob(16)), zeroblob(10) FROM n");
+            // Rows larger than a page of 4096 bytes, but smaller than 8192
+            db.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 50) "
+                    "INSERT INTO blobs SELECT zeroblob(6000) FROM n");
+            db.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 1000) "
+                    "INSERT INTO temporary SELECT zeroblob(1000) FROM n");
+            transaction.commit();
+        }
+        db.exec("DELETE FROM temporary");
+
+        SQLite::SpaceReport report = db.analyzeSpace();
+        EXPECT_EQ(4096, report.pageSize);
+        EXPECT_GT(report.freePages, report.pageCount / 4);
+        const auto find = [&report](const std::string& aName)
+        {
+            return *std::find_if(report.objects.begin(), report.objects.end(),
+                                 [&aName](const SQLite::ObjectSpace& aSpace) { return aSpace.name == aName; });
+        };
+        const SQLite::ObjectSpace test = find("test");
+        EXPECT_FALSE(test.isIndex);
+        EXPECT_EQ(20000, test.cells);
+        EXPECT_EQ(test.pages, test.leafPages + test.internalPages + test.overflowPages);
+        // The pages of the table and its index are interleaved
+        EXPECT_GT(test.fragmentation, 0.5);
+        const SQLite::ObjectSpace index = find("test_key");
+        EXPECT_TRUE(index.isIndex);
+        EXPECT_EQ("test", index.tableName);
+        EXPECT_GT(index.fragmentation, 0.5);
+        // About 0.9 for random keys, against 0.98 for the same index packed by a VACUUM
+        EXPECT_GT(index.fillFactor, 0.5);
+        EXPECT_LT(index.fillFactor, 0.95);
+        const SQLite::ObjectSpace blobs = find("blobs");
+        EXPECT_EQ(50, blobs.overflowPages);
+        EXPECT_GE(blobs.payloadBytes, 50 * 6000);
+        // The gaps are counted between consecutive leaves, whatever the overflow pages listed in between
+        const int64_t blobsGaps = db.execAndGet("SELECT count(*) FROM (SELECT pageno - lag(pageno) OVER (ORDER BY path)"
+                                                " AS step FROM dbstat WHERE name = 'blobs' AND pagetype = 'leaf')"
+                                                " WHERE step <> 1").getInt64();
+        ASSERT_GT(blobs.leafPages, 1);
+        EXPECT_GT(blobsGaps, 0);
+        EXPECT_DOUBLE_EQ(static_cast<double>(blobsGaps) / (blobs.leafPages - 1), blobs.fragmentation);
+        EXPECT_GE(report.objects.front().pages, report.objects.back().pages);
+
+        using Action = SQLite::SpaceRecommendation::Action;
+        const auto recommended = [&report](const Action aAction, const std::string& aObject)
+        {
+            return std::find_if(report.recommendations.begin(), report.recommendations.end(),
+                                [&](const SQLite::SpaceRecommendation& aRecommendation)
+                                {
+                                    return aRecommendation.action == aAction && aRecommendation.object == aObject;
+                                });
+        };
+        EXPECT_NE(report.recommendations.end(), recommended(SQLite::SpaceRecommendation::Vacuum, ""));
+        EXPECT_NE(report.recommendations.end(), recommended(SQLite::SpaceRecommendation::Reindex, "test_key"));
+        const auto pageSize = recommended(SQLite::SpaceRecommendation::PageSize, "blobs");
+        ASSERT_NE(report.recommendations.end(), pageSize);
+        EXPECT_EQ(8192, pageSize->pageSize);
+        EXPECT_NE(report.recommendations.end(), recommended(SQLite::SpaceRecommendation::Vacuum, "test"));
+        EXPECT_EQ(report.recommendations.end(), recommended(SQLite::SpaceRecommendation::Reindex, "test"));
+
+        // Following the recommendations
+        db.exec("PRAGMA page_size = 8192");
+        db.exec("VACUUM");
+        report = db.analyzeSpace();
+        EXPECT_EQ(8192, report.pageSize);
+        EXPECT_EQ(0, report.freePages);
+        EXPECT_EQ(0, find("blobs").overflowPages);
+        EXPECT_LT(find("test").fragmentation, 0.1);
+        EXPECT_LT(find("test_key").fragmentation, 0.1);
+        EXPECT_TRUE(report.recommendations.empty());
+
+        EXPECT_THROW(db.analyzeSpace("unknown"), SQLite::Exception);
+    } // Close DB test.db3
+    remove("test.db3");
+}
+#endif // SQLITE_ENABLE_DBSTAT_VTAB
+
+// Return the detail of the query plan of a query
+static std::string getQueryPlan(SQLite::Database& aDb, const std::string& aQuery)
+{
+    SQLite::Statement query(aDb, "EXPLAIN QUERY PLAN " + aQuery);
+    std::string plan;
+    while (query.executeStep())
+    {
+        plan += query.getColumn(3).getString() + "\n";
+    }
+    return plan;
+}
+
+TEST(Database, indexAdvice)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    db.exec("CREATE TABLE customers (id INTEGER PRIMARY KEY, name TEXT, country TEXT);"
+            "CREATE TABLE orders (id INTEGER PRIMARY KEY, customer_id INTEGER, state TEXT, created INTEGER,"
+            "                     amount REAL);"
+            "CREATE INDEX orders_amount ON orders(amount);"
+            "CREATE UNIQUE INDEX customers_name ON customers(name)");
+    {
+        SQLite::Transaction transaction(db);
+        db.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 200) "
+                "INSERT INTO customers SELECT i, 'customer' || i, 'FR' FROM n");
+        db.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 5000) "
+                "INSERT INTO orders SELECT i, i % 200 + 1, 'new', i, i * 1.5 FROM n");
+        transaction.commit();
+    }
+
+    std::vector<std::string> workload;
+    for (int customer = 1; customer <= 20; ++customer)
+    {
+        workload.push_back("SELECT * FROM orders WHERE customer_id = " + std::to_string(customer) +
+                           " ORDER BY created");
+    }
+    for (int i = 0; i < 5; ++i)
+    {
+        workload.push_back("SELECT o.id FROM customers AS c JOIN orders AS o ON o.customer_id = c.id "
+                           "WHERE c.id = " + std::to_string(i + 1) + " AND o.state = 'new'");
+        workload.push_back("SELECT * FROM customers WHERE id = ?");
+    }
+    workload.push_back("UPDATE orders SET state = 'paid' WHERE created > 4990");
+    workload.push_back("BEGIN");
+    workload.push_back("SELECT * FROM missing");
+
+    SQLite::IndexAdviceOptions options;
+    options.bEstimate = true;
+    const SQLite::IndexAdvice advice = db.indexAdvice(workload, options);
+
+    // The statements, by fingerprint
+    ASSERT_EQ(5u, advice.queries.size());
+    const SQLite::QueryAdvice& byCustomer = advice.queries[0];
+    EXPECT_EQ("select * from orders where customer_id = ? order by created", byCustomer.fingerprint);
+    EXPECT_EQ(workload[0], byCustomer.sql);
+    EXPECT_EQ(20, byCustomer.executions);
+    EXPECT_EQ(std::vector<std::string>{"orders"}, byCustomer.scannedTables);
+    EXPECT_EQ(std::vector<std::string>{"orders.customer_id"}, byCustomer.whereColumns);
+    EXPECT_EQ(std::vector<std::string>{"orders.created"}, byCustomer.orderByColumns);
+    EXPECT_EQ(4999, byCustomer.fullScanSteps);
+    EXPECT_EQ(1, byCustomer.sorts);
+    EXPECT_GT(byCustomer.vmSteps, 5000);
+    EXPECT_TRUE(byCustomer.error.empty());
+    const SQLite::QueryAdvice& join = advice.queries[1];
+    EXPECT_EQ(5, join.executions);
+    EXPECT_EQ((std::vector<std::string>{"orders.customer_id", "customers.id", "orders.state"}), join.whereColumns);
+    EXPECT_TRUE(advice.queries[2].scannedTables.empty());
+    EXPECT_EQ(std::vector<std::string>{"orders.created"}, advice.queries[3].whereColumns);
+    EXPECT_FALSE(advice.queries[4].error.empty());
+
+    // The candidate indexes, with their benefit measured on a scratch copy
+    ASSERT_EQ(3u, advice.candidates.size());
+    const SQLite::IndexCandidate& best = advice.candidates[0];
+    EXPECT_EQ("orders", best.table);
+    EXPECT_EQ((std::vector<std::string>{"customer_id", "created"}), best.columns);
+    EXPECT_EQ("CREATE INDEX \"idx_orders_customer_id_created\" ON \"orders\" (\"customer_id\", \"created\")",
+              best.sql);
+    EXPECT_EQ(std::vector<std::string>{byCustomer.fingerprint}, best.queries);
+    EXPECT_GT(best.benefit, 0.9);
+    EXPECT_GT(best.stepsBefore, 20 * 5000);
+    EXPECT_EQ((std::vector<std::string>{"customer_id", "state"}), advice.candidates[1].columns);
+    EXPECT_EQ(std::vector<std::string>{"created"}, advice.candidates[2].columns);
+    for (const SQLite::IndexCandidate& candidate : advice.candidates)
+    {
+        db.exec(candidate.sql);
+    }
+
+    // The unused indexes, but the UNIQUE ones
+    EXPECT_EQ(std::vector<std::string>{"orders_amount"}, advice.unusedIndexes);
+
+    // With the indexes created, nothing more to advise
+    const SQLite::IndexAdvice after = db.indexAdvice(workload, options);
+    EXPECT_TRUE(after.candidates.empty());
+    EXPECT_TRUE(after.queries[0].scannedTables.empty());
+    EXPECT_EQ(0, after.queries[0].fullScanSteps);
+    EXPECT_EQ(0, after.queries[0].sorts);
+
+    // Without the estimation, the default, nothing is run
+    db.exec("DROP INDEX idx_orders_customer_id_created");
+    const SQLite::IndexAdvice planOnly = db.indexAdvice(workload);
+    ASSERT_EQ(1u, planOnly.candidates.size());
+    EXPECT_EQ(0, planOnly.candidates[0].stepsBefore);
+    EXPECT_EQ(0, planOnly.queries[0].vmSteps);
+
+    // A large database is not copied in memory
+    SQLite::Database large(":memory:", SQLite::OPEN_READWRITE);
+    large.exec("CREATE TABLE data (id INTEGER, content BLOB)");
+    large.exec("INSERT INTO data VALUES (1, zeroblob(65 * 1024 * 1024))");
+    EXPECT_THROW(large.indexAdvice({"SELECT content FROM data WHERE id = 1"}, options), SQLite::Exception);
+    EXPECT_EQ(1u, large.indexAdvice({"SELECT content FROM data WHERE id = 1"}).candidates.size());
+}
+
+TEST(Database, plannerStats)
+{
+    const char* schema = "CREATE TABLE test (a INTEGER, b INTEGER);"
+                         "CREATE INDEX test_a ON test(a);"
+                         "CREATE INDEX test_b ON test(b)";
+    const char* query = "SELECT * FROM test WHERE a = 1 AND b = 1";
+
+    SQLite::Database source(":memory:", SQLite::OPEN_READWRITE);
+    EXPECT_TRUE(source.exportPlannerStats().stat1.empty());
+    source.exec(schema);
+    source.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 1000) "
+                "INSERT INTO test SELECT i, i % 2 FROM n");
+    source.exec("ANALYZE");
+    SQLite::PlannerStats stats = source.exportPlannerStats();
+    ASSERT_EQ(2u, stats.stat1.size());
+    for (const SQLite::PlannerStats::Stat1& stat : stats.stat1)
+    {
+        EXPECT_EQ("test", stat.table);
+        EXPECT_EQ((stat.index == "test_a") ? "1000 1" : "1000 500", stat.stat);
+    }
+#ifdef SQLITE_ENABLE_STAT4
+    EXPECT_FALSE(stats.stat4.empty());
+#else
+    EXPECT_TRUE(stats.stat4.empty());
+#endif
+
+    // A new empty database gets the plan of the source database
+    SQLite::Database target(":memory:", SQLite::OPEN_READWRITE);
+    target.exec(schema);
+    stats.stat1.push_back({"unknown", "", "10"});
+    EXPECT_EQ(static_cast<int>(stats.stat1.size() - 1 + stats.stat4.size()), target.importPlannerStats(stats));
+    EXPECT_NE(std::string::npos, getQueryPlan(target, query).find("INDEX test_a"));
+    EXPECT_EQ(2u, target.exportPlannerStats().stat1.size());
+
+    // Replacing the statistics changes the plan immediately
+    stats.stat4.clear();
+    for (SQLite::PlannerStats::Stat1& stat : stats.stat1)
+    {
+        stat.stat = (stat.index == "test_a") ? "1000 500" : "1000 1";
+    }
+    target.importPlannerStats(stats);
+    EXPECT_NE(std::string::npos, getQueryPlan(target, query).find("INDEX test_b"));
+
+    EXPECT_THROW(target.importPlannerStats(stats, "unknown"), SQLite::Exception);
+}
+
+TEST(Database, optimize)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    db.exec("CREATE TABLE test (a INTEGER, b INTEGER)");
+    db.exec("CREATE INDEX test_a ON test(a)");
+    db.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 1000) "
+            "INSERT INTO test SELECT i % 10, i FROM n");
+    db.optimize(100, true);
+    const SQLite::PlannerStats stats = db.exportPlannerStats();
+    ASSERT_EQ(1u, stats.stat1.size());
+    EXPECT_EQ("test_a", stats.stat1[0].index);
+    EXPECT_EQ(0, db.execAndGet("PRAGMA analysis_limit").getInt());
+
+    db.optimize();
+    EXPECT_THROW(db.optimize(100, false, "unknown"), SQLite::Exception);
+    EXPECT_EQ(0, db.execAndGet("PRAGMA analysis_limit").getInt());
+}
+
+TEST(Database, rebuildOptimized)
+{
+    remove("test.db3");
+    remove("rebuilt.db3");
+    {
+        SQLite::Database db("test.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        db.exec("PRAGMA page_size = 4096");
+        db.exec("PRAGMA user_version = 7");
+        db.exec("CREATE TABLE log (id INTEGER PRIMARY KEY AUTOINCREMENT, message TEXT)");
+        db.exec("CREATE TABLE keys (key TEXT PRIMARY KEY, value INTEGER, twice INTEGER AS (value * 2))");
+        db.exec("CREATE TABLE pairs (a INTEGER, b INTEGER, PRIMARY KEY (a, b)) WITHOUT ROWID");
+        db.exec("CREATE INDEX keys_value ON keys(value)");
+        db.exec("CREATE VIEW big_keys AS SELECT key FROM keys WHERE value > 500");
+        db.exec("CREATE TRIGGER keys_log AFTER INSERT ON keys BEGIN INSERT INTO log (message) VALUES (new.key); END");
+        db.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 1000) "
+                "INSERT INTO keys (key, value) SELECT hex(randomblob(8)), i FROM n");
+        db.exec("INSERT INTO pairs SELECT value % 10, value FROM keys");
+        db.exec("DELETE FROM log WHERE id > 10");
+
+        EXPECT_THROW(db.rebuildOptimized("test.db3"), SQLite::Exception);
+
+        // VACUUM INTO with a new page size
+        SQLite::RebuildOptions options;
+        options.pageSize = 8192;
+        SQLite::RebuildResult result = db.rebuildOptimized("rebuilt.db3", options);
+        EXPECT_EQ(8192, result.pageSize);
+        EXPECT_GT(result.fileSize, 0);
+        EXPECT_TRUE(result.timings.empty());
+        EXPECT_EQ(4096, db.execAndGet("PRAGMA page_size").getInt());
+        {
+            SQLite::Database rebuilt("rebuilt.db3");
+            EXPECT_EQ(8192, rebuilt.execAndGet("PRAGMA page_size").getInt());
+            EXPECT_EQ(1000, rebuilt.execAndGet("SELECT count(*) FROM keys").getInt());
+            EXPECT_TRUE(rebuilt.tableExists("sqlite_stat1"));
+        }
+
+        // Clustered rebuild replacing the previous file
+        options.clustered = true;
+        options.pageSize = 0;
+        result = db.rebuildOptimized("rebuilt.db3", options);
+        EXPECT_EQ(4096, result.pageSize);
+        {
+            SQLite::Database rebuilt("rebuilt.db3", SQLite::OPEN_READWRITE);
+            EXPECT_EQ(7, rebuilt.execAndGet("PRAGMA user_version").getInt());
+            EXPECT_EQ(1000, rebuilt.execAndGet("SELECT count(*) FROM keys").getInt());
+            EXPECT_EQ(1000, rebuilt.execAndGet("SELECT count(*) FROM pairs").getInt());
+            EXPECT_EQ(10, rebuilt.execAndGet("SELECT count(*) FROM log").getInt());
+            EXPECT_EQ(1000, rebuilt.execAndGet("SELECT seq FROM sqlite_sequence WHERE name = 'log'").getInt());
+            EXPECT_EQ(500, rebuilt.execAndGet("SELECT count(*) FROM big_keys").getInt());
+            EXPECT_EQ(84, rebuilt.execAndGet("SELECT twice FROM keys WHERE value = 42").getInt());
+            // The rows are stored in key order
+            EXPECT_EQ(1, rebuilt.execAndGet("SELECT count(*) = 0 FROM (SELECT key, lag(key) OVER (ORDER BY rowid) AS "
+                                            "previous FROM keys) WHERE key < previous").getInt());
+            EXPECT_EQ(1, rebuilt.execAndGet("SELECT count(*) FROM sqlite_schema WHERE name = 'keys_value'").getInt());
+            rebuilt.exec("INSERT INTO keys (key, value) VALUES ('new', 0)");
+            EXPECT_EQ(1001, rebuilt.execAndGet("SELECT max(id) FROM log").getInt());
+        }
+
+        // Benchmark of page sizes
+        options.clustered = false;
+        options.candidatePageSizes = {1024, 4096, 16384};
+        options.workload = {"SELECT count(*) FROM keys WHERE value > 100", "SELECT * FROM pairs WHERE a = 3"};
+        result = db.rebuildOptimized("rebuilt.db3", options);
+        ASSERT_EQ(3u, result.timings.size());
+        EXPECT_EQ(1024, result.timings[0].pageSize);
+        EXPECT_EQ(16384, result.timings[2].pageSize);
+        EXPECT_NE(options.candidatePageSizes.end(),
+                  std::find(options.candidatePageSizes.begin(), options.candidatePageSizes.end(), result.pageSize));
+        EXPECT_EQ(result.pageSize, SQLite::Database("rebuilt.db3").execAndGet("PRAGMA page_size").getInt());
+
+        // A failure leaves the destination file untouched
+        options.workload = {"SELECT * FROM unknown"};
+        EXPECT_THROW(db.rebuildOptimized("rebuilt.db3", options), SQLite::Exception);
+        EXPECT_EQ(result.pageSize, SQLite::Database("rebuilt.db3").execAndGet("PRAGMA page_size").getInt());
+        EXPECT_FALSE(std::ifstream("rebuilt.db3.1024.tmp").good());
+    } // Close DB test.db3
+    remove("test.db3");
+    remove("rebuilt.db3");
+}
+
+#if defined(SQLITE_ENABLE_FTS5) && defined(SQLITE_ENABLE_RTREE)
+TEST(Database, rebuildOptimizedVirtualTables)
+{
+    remove("test.db3");
+    remove("rebuilt.db3");
+    {
+        SQLite::Database db("test.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        db.exec("CREATE TABLE notes (id INTEGER PRIMARY KEY, body TEXT)");
+        db.exec("CREATE VIRTUAL TABLE notes_fts USING fts5(body)");
+        db.exec("CREATE VIRTUAL TABLE boxes USING rtree(id, min_x, max_x, min_y, max_y)");
+        db.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 100) "
+                "INSERT INTO notes (body) SELECT 'note number ' || i FROM n");
+        db.exec("INSERT INTO notes_fts (body) SELECT body FROM notes");
+        db.exec("INSERT INTO boxes SELECT id, id, id + 1, id, id + 1 FROM notes");
+
+        // The shadow tables of the virtual tables are not copied row by row
+        SQLite::RebuildOptions options;
+        options.clustered = true;
+        EXPECT_NO_THROW(db.rebuildOptimized("rebuilt.db3", options));
+        {
+            SQLite::Database rebuilt("rebuilt.db3", SQLite::OPEN_READWRITE);
+            EXPECT_EQ(100, rebuilt.execAndGet("SELECT count(*) FROM notes").getInt());
+            EXPECT_EQ(1, rebuilt.execAndGet("SELECT count(*) FROM notes_fts WHERE notes_fts MATCH '42'").getInt());
+            EXPECT_EQ(2, rebuilt.execAndGet("SELECT count(*) FROM boxes WHERE min_x <= 42 AND max_x >= 42").getInt());
+            EXPECT_EQ("ok", rebuilt.execAndGet("PRAGMA integrity_check").getString());
+            rebuilt.exec("INSERT INTO notes_fts (body) VALUES ('another note')");
+            EXPECT_EQ(101, rebuilt.execAndGet("SELECT count(*) FROM notes_fts WHERE notes_fts MATCH 'note'").getInt());
+        }
+    } // Close DB test.db3
+    remove("test.db3");
+    remove("rebuilt.db3");
+}
+#endif // SQLITE_ENABLE_FTS5 && SQLITE_ENABLE_RTREE
+
+TEST(Database, cloneTo)
+{
+    remove("test.db3");
+    remove("clone.db3");
+    {
+        SQLite::Database db("test.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        db.exec("CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT)");
+        db.exec("INSERT INTO test (value) VALUES ('first'), ('second')");
+        const SQLite::Database::CloneMethod method = db.cloneTo("clone.db3");
+#ifndef __linux__
+        EXPECT_EQ(SQLite::Database::CloneMethod::Backup, method);
+#else
+        (void)method;
+#endif
+        {
+            SQLite::Database clone("clone.db3");
+            EXPECT_EQ(2, clone.execAndGet("SELECT count(*) FROM test").getInt());
+        }
+
+        // Commits kept in the WAL by a reader are copied too
+        db.exec("PRAGMA journal_mode = WAL");
+        SQLite::Database reader("test.db3");
+        SQLite::Transaction transaction(reader, SQLite::TransactionBehavior::DEFERRED);
+        EXPECT_EQ(2, reader.execAndGet("SELECT count(*) FROM test").getInt());
+        db.exec("INSERT INTO test (value) VALUES ('third')");
+        db.cloneTo("clone.db3");
+        {
+            SQLite::Database clone("clone.db3");
+            EXPECT_EQ(3, clone.execAndGet("SELECT count(*) FROM test").getInt());
+            EXPECT_EQ("ok", clone.execAndGet("PRAGMA integrity_check").getString());
+        }
+
+        // Not in a transaction of this connection
+        {
+            SQLite::Transaction write(db);
+            EXPECT_THROW(db.cloneTo("clone.db3"), SQLite::Exception);
+        }
+    } // Close DB test.db3
+    remove("test.db3");
+    remove("clone.db3");
+
+    // An in-memory database is copied with the Backup API
+    SQLite::Database memory(":memory:", SQLite::OPEN_READWRITE);
+    memory.exec("CREATE TABLE test (value TEXT)");
+    memory.exec("INSERT INTO test VALUES ('in memory')");
+    EXPECT_EQ(SQLite::Database::CloneMethod::Backup, memory.cloneTo("clone.db3"));
+    {
+        SQLite::Database clone("clone.db3");
+        EXPECT_EQ("in memory", clone.execAndGet("SELECT value FROM test").getString());
+    }
+    remove("clone.db3");
+}
+
+TEST(Database, fileControl)
+{
+    remove("test.db3");
+    {
+        SQLite::Database db("test.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        db.exec("CREATE TABLE test (value BLOB)");
+        EXPECT_GT(db.getFileSize(), 0);
+
+        // The file grows by chunks
+        EXPECT_TRUE(db.setChunkSize(1024 * 1024));
+        db.exec("INSERT INTO test VALUES (zeroblob(10000))");
+        EXPECT_EQ(1024 * 1024, db.getFileSize());
+        EXPECT_TRUE(db.sizeHint(3 * 1024 * 1024 + 1));
+        EXPECT_EQ(4 * 1024 * 1024, db.getFileSize());
+        EXPECT_EQ(1, db.execAndGet("SELECT count(*) FROM test").getInt());
+
+        EXPECT_FALSE(db.getPersistWal());
+        EXPECT_TRUE(db.setPersistWal(true));
+        EXPECT_TRUE(db.getPersistWal());
+        EXPECT_TRUE(db.setPowersafeOverwrite(false));
+        EXPECT_FALSE(db.getPowersafeOverwrite());
+        EXPECT_TRUE(db.setPowersafeOverwrite(true));
+        EXPECT_TRUE(db.getPowersafeOverwrite());
+
+        EXPECT_THROW(db.setChunkSize(1024, "unknown"), SQLite::Exception);
+    } // Close DB test.db3
+    remove("test.db3");
+
+    // Not supported for an in-memory database
+    SQLite::Database memory(":memory:", SQLite::OPEN_READWRITE);
+    EXPECT_FALSE(memory.setChunkSize(1024 * 1024));
+    EXPECT_FALSE(memory.sizeHint(1024 * 1024));
+    EXPECT_EQ(0, memory.getFileSize());
+}
+
+TEST(Database, warmUp)
+{
+    remove("test.db3");
+    {
+        SQLite::Database db("test.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        db.exec("CREATE TABLE test (value BLOB)");
+        db.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 300) "
+                "INSERT INTO test SELECT zeroblob(10000) FROM n");
+        const int64_t fileSize = db.getFileSize();
+
+        SQLite::WarmUpOptions options;
+        int64_t progress = 0;
+        options.progress = [&progress](const int64_t aBytesRead, const int64_t aBytesTotal)
+        {
+            EXPECT_LE(aBytesRead, aBytesTotal);
+            progress = aBytesRead;
+        };
+        SQLite::WarmUpResult result = db.warmUp(options);
+        EXPECT_TRUE(result.complete);
+        EXPECT_EQ(fileSize, result.bytesTotal);
+        EXPECT_EQ(fileSize, result.bytesRead);
+        EXPECT_GT(progress, 0);
+
+        options.strategy = SQLite::WarmUpOptions::Advise;
+        result = db.warmUp(options);
+        EXPECT_TRUE(result.complete);
+        EXPECT_EQ(fileSize, result.bytesRead);
+
+        // Time budget exhausted after the first block
+        options.strategy = SQLite::WarmUpOptions::Read;
+        options.nbThreads = 1;
+        options.budget = std::chrono::milliseconds(50);
+        options.progress = [](int64_t, int64_t)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        };
+        result = db.warmUp(options);
+        EXPECT_FALSE(result.complete);
+        EXPECT_EQ(1024 * 1024, result.bytesRead);
+
+        options.strategy = SQLite::WarmUpOptions::HotSet;
+        options.hotSetFile = "unknown.hotset";
+        EXPECT_THROW(db.warmUp(options), SQLite::Exception);
+    } // Close DB test.db3
+    remove("test.db3");
+
+    SQLite::Database memory(":memory:", SQLite::OPEN_READWRITE);
+    const SQLite::WarmUpResult result = memory.warmUp();
+    EXPECT_TRUE(result.complete);
+    EXPECT_EQ(0, result.bytesTotal);
+}
+
+TEST(Database, openExclusive)
+{
+    remove("test.db3");
+    {
+        SQLite::Database db = SQLite::Database::openExclusive("test.db3");
+        EXPECT_EQ("exclusive", db.execAndGet("PRAGMA locking_mode").getString());
+        db.exec("PRAGMA journal_mode = WAL");
+        db.exec("CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT)");
+        EXPECT_EQ(1, db.exec("INSERT INTO test VALUES (NULL, 'first')"));
+        // The WAL index is in heap memory
+        EXPECT_FALSE(std::ifstream("test.db3-shm").good());
+
+        // The lock is held by the connection, even between its transactions
+        SQLite::Database other("test.db3", SQLite::OPEN_READONLY);
+        EXPECT_THROW(other.execAndGet("SELECT count(*) FROM test"), SQLite::Exception);
+        EXPECT_THROW(SQLite::Database::openExclusive("test.db3"), SQLite::Exception);
+        db.exec("PRAGMA journal_mode = DELETE");
+    } // Close DB test.db3
+    {
+        // Refused while another connection holds a lock on the database
+        SQLite::Database db("test.db3", SQLite::OPEN_READWRITE);
+        SQLite::Transaction transaction(db, SQLite::TransactionBehavior::IMMEDIATE);
+        EXPECT_THROW(SQLite::Database::openExclusive("test.db3"), SQLite::Exception);
+    }
+    {
+        SQLite::Database db = SQLite::Database::openExclusive("test.db3", SQLite::OPEN_READONLY);
+        EXPECT_EQ("first", db.execAndGet("SELECT value FROM test").getString());
+    }
+    remove("test.db3");
+}
+
 #ifdef SQLITE_HAS_CODEC
 TEST(Database, encryptAndDecrypt)
 {
@@ -0,0 +1,60 @@
+/**
+ * @file    FileGrowthPolicy_test.cpp
+ * @ingroup tests
+ * @brief   Test of the auto-extend policy of the database file.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/FileGrowthPolicy.h>
+#include <SQLiteCpp/Database.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+TEST(FileGrowthPolicy, update)
+{
+    remove("test.db3");
+    {
+        SQLite::Database db("test.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        db.exec("CREATE TABLE test (value BLOB)");
+        const int64_t min = 64 * 1024;
+        const int64_t max = 1024 * 1024;
+        SQLite::FileGrowthPolicy growth(db, min, max, std::chrono::seconds(10));
+        EXPECT_EQ(0, growth.getChunkSize());
+
+        // No fill rate measured yet: minimum preallocation
+        EXPECT_TRUE(growth.update());
+        EXPECT_EQ(min, growth.getChunkSize());
+        EXPECT_GE(db.getFileSize(), 2 * 4096 + min / 2);
+        EXPECT_EQ(0, db.getFileSize() % min);
+        EXPECT_FALSE(growth.update());
+
+        // Fast growth: maximum preallocation
+        db.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 100) "
+                "INSERT INTO test SELECT zeroblob(10000) FROM n");
+        EXPECT_TRUE(growth.update());
+        EXPECT_GT(growth.getRate(), 0.0);
+        EXPECT_EQ(max, growth.getChunkSize());
+        const int64_t used = db.execAndGet("PRAGMA page_count").getInt64() * 4096;
+        EXPECT_GE(db.getFileSize(), used + max / 2);
+        EXPECT_EQ(0, db.getFileSize() % max);
+
+        // The preallocated space is used by the next writes
+        const int64_t fileSize = db.getFileSize();
+        db.exec("INSERT INTO test VALUES (zeroblob(10000))");
+        EXPECT_EQ(fileSize, db.getFileSize());
+        EXPECT_EQ(101, db.execAndGet("SELECT count(*) FROM test").getInt());
+    } // Close DB test.db3
+    remove("test.db3");
+
+    // Not supported for an in-memory database
+    SQLite::Database memory(":memory:", SQLite::OPEN_READWRITE);
+    SQLite::FileGrowthPolicy growth(memory);
+    EXPECT_FALSE(growth.update());
+    EXPECT_EQ(0, growth.getChunkSize());
+}
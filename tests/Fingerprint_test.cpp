@@ -0,0 +1,75 @@
+/**
+ * @file    Fingerprint_test.cpp
+ * @ingroup tests
+ * @brief   Test of the fingerprints of SQL statements.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/Fingerprint.h>
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+TEST(Fingerprint, normalize)
+{
+    // Literals and parameters are replaced, keywords and identifiers lower-cased, whitespace and comments dropped
+    EXPECT_EQ("select * from orders where customer_id = ?",
+              SQLite::getFingerprint("SELECT *\n  FROM Orders -- all of them\n WHERE customer_id=42;").normalized);
+    EXPECT_EQ("select * from orders where customer_id = ?",
+              SQLite::getFingerprint("select * from orders /* by key */ where customer_id = :id").normalized);
+    EXPECT_EQ("select a, b from t where x = ? and y > ? and z <> ? or w = ?",
+              SQLite::getFingerprint("SELECT a,b FROM t WHERE x='it''s' AND y>-1.5e3 AND z<>X'00ff' OR w=?12")
+                  .normalized);
+    EXPECT_EQ("select a - ? from t", SQLite::getFingerprint("SELECT a - 1 FROM t").normalized);
+    EXPECT_EQ("update t set v = v + ? where id = ?",
+              SQLite::getFingerprint("UPDATE t SET v = v + 1 WHERE id = @id").normalized);
+    EXPECT_EQ("select count (*) from \"My Table\" as m where m.key = ?",
+              SQLite::getFingerprint("SELECT COUNT(*) FROM \"My Table\" AS M WHERE M.key = $key").normalized);
+    EXPECT_EQ("select data ->> ? from t where data -> ? is not null",
+              SQLite::getFingerprint("SELECT data->>'$.a' FROM t WHERE data->'$.b' IS NOT NULL").normalized);
+}
+
+TEST(Fingerprint, collapseLists)
+{
+    // IN lists of any length share the same fingerprint
+    const SQLite::Fingerprint one = SQLite::getFingerprint("SELECT * FROM t WHERE id IN (1)");
+    const SQLite::Fingerprint three = SQLite::getFingerprint("SELECT * FROM t WHERE id IN (?, ?, ?)");
+    EXPECT_EQ("select * from t where id in (...)", one.normalized);
+    EXPECT_EQ(one, three);
+    EXPECT_EQ(one.hash, three.hash);
+    // But not the subqueries
+    EXPECT_EQ("select * from t where id in (select id from u)",
+              SQLite::getFingerprint("SELECT * FROM t WHERE id IN (SELECT id FROM u)").normalized);
+
+    // Nor the rows of a multi-row VALUES
+    EXPECT_EQ("insert into t (a, b) values (?, ?)",
+              SQLite::getFingerprint("INSERT INTO t(a, b) VALUES (1, 'one')").normalized);
+    EXPECT_EQ("insert into t (a, b) values (?, ?), ...",
+              SQLite::getFingerprint("INSERT INTO t(a, b) VALUES (1, 'one'), (2, 'two'), (?, ?)").normalized);
+
+    // Tokens of the normalized text
+    const std::vector<std::string> tokens = {"select", "\"A\"", ",", "b", "from", "t", "where", "id", "in",
+                                             "(", "...", ")", "and", "b", ">=", "?"};
+    EXPECT_EQ(tokens, SQLite::getFingerprintTokens("SELECT \"A\", B FROM t -- comment\nWHERE id IN (1, 2) AND b >= 3"));
+}
+
+TEST(Fingerprint, hash)
+{
+    const SQLite::Fingerprint first = SQLite::getFingerprint("SELECT * FROM t WHERE id = 1");
+    const SQLite::Fingerprint second = SQLite::getFingerprint(std::string("select * from t where id = 2"));
+    const SQLite::Fingerprint other = SQLite::getFingerprint("SELECT * FROM t WHERE key = 1");
+    EXPECT_EQ(first, second);
+    EXPECT_NE(first, other);
+    EXPECT_NE(first.hash, other.hash);
+    EXPECT_NE(0u, first.hash);
+
+    // 64-bit FNV-1a of the empty string
+    EXPECT_EQ("", SQLite::getFingerprint("  ;").normalized);
+    EXPECT_EQ(0xcbf29ce484222325ULL, SQLite::getFingerprint("").hash);
+}
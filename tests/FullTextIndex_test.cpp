@@ -0,0 +1,240 @@
+/**
+ * @file    FullTextIndex_test.cpp
+ * @ingroup tests
+ * @brief   Test of the FTS5 full-text index.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/FullTextIndex.h>
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Statement.h>
+#include <SQLiteCpp/Exception.h>
+
+#include <gtest/gtest.h>
+
+#include <cctype>
+
+#ifdef SQLITE_ENABLE_FTS5
+
+TEST(FullTextIndex, search)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    db.exec("CREATE TABLE docs (id INTEGER PRIMARY KEY, title TEXT, body TEXT, other INTEGER)");
+    db.exec("INSERT INTO docs VALUES (1, 'SQLite', 'A small and fast SQL database engine', 0),"
+            "(2, 'C++ wrapper', 'SQLiteC++ is a smart and easy to use C++ wrapper of SQLite', 0),"
+            "(3, 'Unrelated', 'Nothing to see here', 0)");
+
+    // Existing rows are indexed on creation
+    SQLite::FullTextIndex index(db, "docs_fts", "docs", {"title", "body"}, "unicode61", "id");
+    EXPECT_EQ("docs_fts", index.getName());
+    std::vector<SQLite::FullTextIndex::Hit> hits = index.search("sqlite");
+    ASSERT_EQ(2u, hits.size());
+    EXPECT_LE(hits[0].score, hits[1].score);
+    hits = index.search("wrapper", 10, 1);
+    ASSERT_EQ(1u, hits.size());
+    EXPECT_EQ(2, hits[0].rowid);
+    EXPECT_NE(std::string::npos, hits[0].snippet.find("[wrapper]"));
+
+    // Weights change the ranking
+    index.setWeights({10.0, 1.0});
+    hits = index.search("sqlite");
+    ASSERT_EQ(2u, hits.size());
+    EXPECT_EQ(1, hits[0].rowid);
+    EXPECT_THROW(index.setWeights({1.0}), SQLite::Exception);
+
+    // Kept in sync by triggers
+    db.exec("INSERT INTO docs VALUES (4, 'Engines', 'The database engine of choice', 0)");
+    db.exec("UPDATE docs SET body = 'Nothing but a wrapper' WHERE id = 3");
+    db.exec("DELETE FROM docs WHERE id = 1");
+    index.setSnippetMarkers("<b>", "</b>", "…");
+    hits = index.search("engine");
+    ASSERT_EQ(1u, hits.size());
+    EXPECT_EQ(4, hits[0].rowid);
+    EXPECT_NE(std::string::npos, hits[0].snippet.find("<b>engine</b>"));
+    EXPECT_EQ(2u, index.search("wrapper").size());
+    EXPECT_TRUE(index.check());
+
+    // The index is reopened as is
+    SQLite::FullTextIndex same(db, "docs_fts", "docs", {"title", "body"}, "unicode61", "id");
+    EXPECT_EQ(1u, same.search("choice").size());
+
+    EXPECT_THROW(index.search("AND AND"), SQLite::Exception);
+    same.drop();
+    EXPECT_FALSE(db.tableExists("docs_fts"));
+    EXPECT_EQ(1, db.exec("INSERT INTO docs VALUES (5, 'x', 'y', 0)"));
+}
+
+TEST(FullTextIndex, bulkAndMaintenance)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    db.exec("CREATE TABLE notes (text TEXT)");
+    SQLite::FullTextIndex index(db, "notes_fts", "notes", {"text"});
+
+    // Many small transactions create many segments
+    for (int i = 0; i < 50; ++i)
+    {
+        db.exec("INSERT INTO notes VALUES ('note number " + std::to_string(i) + "')");
+    }
+    index.setAutomerge(0);
+    EXPECT_TRUE(index.maintain(std::chrono::milliseconds(1000)));
+    EXPECT_EQ(50u, index.search("note", 100).size());
+    index.setAutomerge(8);
+    index.setCrisisMerge(32);
+
+    // The levels set by an earlier session are kept by a rebuild of the index reopened
+    {
+        SQLite::FullTextIndex reopened(db, "notes_fts", "notes", {"text"});
+        reopened.rebuild();
+    }
+    EXPECT_EQ(8, db.execAndGet("SELECT v FROM notes_fts_config WHERE k = 'automerge'").getInt());
+    EXPECT_EQ(32, db.execAndGet("SELECT v FROM notes_fts_config WHERE k = 'crisismerge'").getInt());
+
+    index.bulkLoad([&db]()
+    {
+        SQLite::Statement insert(db, "INSERT INTO notes VALUES (?)");
+        for (int i = 0; i < 1000; ++i)
+        {
+            insert.bind(1, "bulk entry " + std::to_string(i));
+            insert.exec();
+            insert.reset();
+        }
+    });
+    EXPECT_EQ(1000u, index.search("bulk", 2000).size());
+    EXPECT_EQ(1u, index.search("\"entry 999\"").size());
+    EXPECT_TRUE(index.check());
+
+    // The triggers are restored, and a failed load is rolled back
+    db.exec("INSERT INTO notes VALUES ('after the bulk')");
+    EXPECT_EQ(1u, index.search("after").size());
+    EXPECT_THROW(index.bulkLoad([&db]()
+    {
+        db.exec("INSERT INTO notes VALUES ('lost')");
+        throw SQLite::Exception("Loading failed");
+    }), SQLite::Exception);
+    EXPECT_EQ(0, db.execAndGet("SELECT count(*) FROM notes WHERE text = 'lost'").getInt());
+    db.exec("INSERT INTO notes VALUES ('still indexed')");
+    EXPECT_EQ(1u, index.search("still").size());
+
+    index.optimize();
+    EXPECT_TRUE(index.maintain(std::chrono::milliseconds(0)));
+}
+
+TEST(FullTextIndex, trigram)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    db.exec("CREATE TABLE files (path TEXT)");
+    db.exec("INSERT INTO files VALUES ('/usr/lib/libsqlite3.so'), ('/home/user/SQLiteCpp/src/Database.cpp'),"
+            "('/tmp/x'), ('/home/user/notes.txt')");
+
+    SQLite::FullTextIndex index(db, "files_fts", "files", {"path"}, SQLite::FullTextIndex::TRIGRAM);
+    std::vector<int64_t> rowids = index.containing("path", "sqlite");
+    ASSERT_EQ(2u, rowids.size());
+    EXPECT_EQ(1, rowids[0]);
+    EXPECT_EQ(2, rowids[1]);
+    EXPECT_EQ(1u, index.containing("path", "e/user/n").size());
+    EXPECT_TRUE(index.containing("path", "\"quoted\"").empty());
+    // Too short for a trigram: full scan
+    EXPECT_EQ(1u, index.containing("path", "/x").size());
+    EXPECT_EQ(1u, index.containing("path", "sqlite", 1).size());
+
+    // LIKE on the index table is also accelerated
+    EXPECT_EQ(2, db.execAndGet("SELECT count(*) FROM files_fts WHERE path LIKE '%home%'").getInt());
+
+    // The tokenizer of an index reopened is read from its schema
+    SQLite::FullTextIndex reopened(db, "files_fts", "files", {"path"});
+    EXPECT_EQ(2u, reopened.containing("path", "sqlite").size());
+    EXPECT_EQ(1u, reopened.containing("path", "e/user/n").size());
+}
+
+TEST(FullTextIndex, containingWithoutTrigram)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    db.exec("CREATE TABLE notes (body TEXT)");
+    db.exec("INSERT INTO notes VALUES ('hello world'), ('say helloworld'), ('a yellow dog')");
+
+    // The word tokenizers do not index the substrings of the words
+    SQLite::FullTextIndex index(db, "notes_fts", "notes", {"body"});
+    EXPECT_EQ(3u, index.containing("body", "ell").size());
+    EXPECT_EQ(2u, index.containing("body", "hello").size());
+    EXPECT_EQ(1u, index.containing("body", "ow dog").size());
+    SQLite::FullTextIndex porter(db, "notes_porter", "notes", {"body"}, "porter unicode61");
+    EXPECT_EQ(2u, porter.containing("body", "hello").size());
+    SQLite::FullTextIndex reopened(db, "notes_porter", "notes", {"body"}, SQLite::FullTextIndex::TRIGRAM);
+    EXPECT_EQ(3u, reopened.containing("body", "ell").size());
+}
+
+namespace
+{
+
+// Lower case words of ASCII letters, with a synonym for "db"
+class WordTokenizer : public SQLite::FullTextIndex::Tokenizer
+{
+public:
+    explicit WordTokenizer(const bool abSynonyms) : mbSynonyms(abSynonyms)
+    {
+    }
+
+    void tokenize(const char* apText, int aSize, int aReason, const SQLite::FullTextIndex::TokenSink& aSink) override
+    {
+        (void)aReason;
+        int start = 0;
+        while (start < aSize)
+        {
+            while (start < aSize && !std::isalpha(static_cast<unsigned char>(apText[start])))
+            {
+                ++start;
+            }
+            int end = start;
+            std::string token;
+            while (end < aSize && std::isalpha(static_cast<unsigned char>(apText[end])))
+            {
+                token += static_cast<char>(std::tolower(static_cast<unsigned char>(apText[end])));
+                ++end;
+            }
+            if (!token.empty())
+            {
+                aSink(token.data(), static_cast<int>(token.size()), start, end, false);
+                if (mbSynonyms && token == "db")
+                {
+                    aSink("database", 8, start, end, true);
+                }
+            }
+            start = end;
+        }
+    }
+
+private:
+    bool mbSynonyms;
+};
+
+} // namespace
+
+TEST(FullTextIndex, customTokenizer)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    int nbCreated = 0;
+    SQLite::FullTextIndex::registerTokenizer(db, "words",
+        [&nbCreated](const std::vector<std::string>& aArgs) -> std::unique_ptr<SQLite::FullTextIndex::Tokenizer>
+        {
+            ++nbCreated;
+            const bool bSynonyms = !aArgs.empty() && aArgs[0] == "synonyms";
+            return std::unique_ptr<SQLite::FullTextIndex::Tokenizer>(new WordTokenizer(bSynonyms));
+        });
+
+    db.exec("CREATE TABLE t (body TEXT)");
+    db.exec("INSERT INTO t VALUES ('An embedded DB'), ('A database server'), ('x1y2z')");
+    SQLite::FullTextIndex index(db, "t_fts", "t", {"body"}, "words synonyms");
+    EXPECT_GE(nbCreated, 1);
+    EXPECT_EQ(2u, index.search("database").size());
+    EXPECT_EQ(1u, index.search("server").size());
+    EXPECT_EQ(1u, index.search("y").size());
+    EXPECT_EQ("An embedded [DB]", index.search("db")[0].snippet);
+
+    EXPECT_THROW(SQLite::FullTextIndex(db, "bad_fts", "t", {"body"}, "unknown_tokenizer"), SQLite::Exception);
+}
+
+#endif // SQLITE_ENABLE_FTS5
@@ -0,0 +1,236 @@
+/**
+ * @file    KeyFilter_test.cpp
+ * @ingroup tests
+ * @brief   Test of the blocked Bloom filter on a key column.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/KeyFilter.h>
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Statement.h>
+#include <SQLiteCpp/Transaction.h>
+#include <SQLiteCpp/Exception.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+
+namespace
+{
+
+void insertKeys(SQLite::Database& aDb, const int aFirst, const int aLast)
+{
+    SQLite::Transaction transaction(aDb);
+    SQLite::Statement insert(aDb, "INSERT INTO users (id, email) VALUES (?, ?)");
+    for (int i = aFirst; i <= aLast; ++i)
+    {
+        insert.bind(1, i * 2);
+        insert.bind(2, "user" + std::to_string(i) + "@example.com");
+        insert.exec();
+        insert.reset();
+    }
+    transaction.commit();
+}
+
+// Return the bits of a filter saved to the side table
+std::string savedBits(SQLite::Database& aDb, const std::string& aName)
+{
+    SQLite::Statement select(aDb, "SELECT bits FROM sqlitecpp_keyfilter WHERE name = ?");
+    select.bind(1, aName);
+    return select.executeStep() ? select.getColumn(0).getString() : std::string();
+}
+
+} // namespace
+
+TEST(KeyFilter, memory)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    db.exec("CREATE TABLE users (id INTEGER PRIMARY KEY, email TEXT)");
+    insertKeys(db, 1, 1000);
+
+    SQLite::KeyFilter filter(db, "users", "id");
+    EXPECT_EQ(1000u, filter.getKeyCount());
+    EXPECT_GT(filter.getSizeBytes(), 0u);
+    EXPECT_GT(filter.getHashCount(), 1);
+    EXPECT_LT(filter.getEstimatedFalsePositiveRate(), 0.02);
+
+    // No false negative
+    for (int i = 1; i <= 1000; ++i)
+    {
+        EXPECT_TRUE(filter.mayContain(static_cast<int64_t>(i * 2)));
+    }
+    // Few false positives
+    int nbFalsePositives = 0;
+    for (int i = 1; i <= 1000; ++i)
+    {
+        nbFalsePositives += filter.contains(static_cast<int64_t>(i * 2 + 1)) ? 1 : 0;
+    }
+    EXPECT_EQ(0, nbFalsePositives);
+    EXPECT_LT(filter.getObservedFalsePositiveRate(), 0.05);
+    EXPECT_TRUE(filter.contains(static_cast<int64_t>(42)));
+
+    // Kept current by inserts and updates
+    EXPECT_FALSE(filter.mayContain(static_cast<int64_t>(100001)));
+    db.exec("INSERT INTO users (id, email) VALUES (100001, 'new@example.com')");
+    EXPECT_TRUE(filter.mayContain(static_cast<int64_t>(100001)));
+    EXPECT_TRUE(filter.contains(static_cast<int64_t>(100001)));
+    db.exec("UPDATE users SET id = 100003 WHERE id = 100001");
+    EXPECT_TRUE(filter.mayContain(static_cast<int64_t>(100003)));
+    EXPECT_EQ(1002u, filter.getKeyCount());
+
+    // A text key looking like an integer is compared as an integer to an INTEGER column
+    EXPECT_TRUE(filter.mayContain(std::string("100003")));
+    EXPECT_TRUE(filter.mayContain(std::string(" 100003.0 ")));
+
+    EXPECT_THROW(SQLite::KeyFilter(db, "users", "unknown"), SQLite::Exception);
+    EXPECT_THROW(SQLite::KeyFilter(db, "users", "id", 1.5), SQLite::Exception);
+}
+
+TEST(KeyFilter, textColumn)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    db.exec("CREATE TABLE users (id INTEGER PRIMARY KEY, email TEXT)");
+    insertKeys(db, 1, 100);
+    db.exec("INSERT INTO users (email) VALUES (123)"); // stored as text '123'
+
+    SQLite::KeyFilter filter(db, "users", "email", 0.001);
+    EXPECT_EQ(101u, filter.getKeyCount());
+    EXPECT_TRUE(filter.mayContain(std::string("user7@example.com")));
+    EXPECT_TRUE(filter.contains(std::string("user7@example.com")));
+    EXPECT_FALSE(filter.contains(std::string("nobody@example.com")));
+    EXPECT_TRUE(filter.mayContain(static_cast<int64_t>(123)));
+
+    // Triggers and SQL function are removed with the filter
+    {
+        SQLite::KeyFilter other(db, "users", "id");
+        EXPECT_EQ(4, db.execAndGet("SELECT count(*) FROM sqlite_temp_master WHERE type = 'trigger'").getInt());
+    }
+    EXPECT_EQ(2, db.execAndGet("SELECT count(*) FROM sqlite_temp_master WHERE type = 'trigger'").getInt());
+}
+
+TEST(KeyFilter, realColumn)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    db.exec("CREATE TABLE prices (price REAL, amount NUMERIC)");
+    db.exec("INSERT INTO prices VALUES ('1.5', '2.25'), (3, '4'), ('1e3', '12345678901234567890')");
+
+    // A text key looking like a real is compared as a real to a column with a numeric affinity
+    SQLite::KeyFilter price(db, "prices", "price");
+    EXPECT_TRUE(price.mayContain(std::string("1.5")));
+    EXPECT_TRUE(price.contains(std::string("1.50")));
+    EXPECT_TRUE(price.mayContain(std::string("3.0")));
+    EXPECT_TRUE(price.mayContain(static_cast<int64_t>(1000)));
+    EXPECT_TRUE(price.contains(std::string("1000")));
+    SQLite::KeyFilter amount(db, "prices", "amount");
+    EXPECT_TRUE(amount.contains(std::string("2.25")));
+    EXPECT_TRUE(amount.contains(std::string("4.0")));
+    EXPECT_TRUE(amount.contains(std::string("12345678901234567890")));
+    EXPECT_FALSE(amount.contains(std::string("2.5")));
+}
+
+TEST(KeyFilter, parallelBuildAndSave)
+{
+    remove("keyfilter_test.db3");
+    {
+        SQLite::Database db("keyfilter_test.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        db.exec("CREATE TABLE users (id INTEGER PRIMARY KEY, email TEXT)");
+        insertKeys(db, 1, 5000);
+
+        SQLite::KeyFilter filter(db, "users", "email", 0.01, 4);
+        EXPECT_EQ(5000u, filter.getKeyCount());
+        for (int i = 1; i <= 5000; i += 7)
+        {
+            EXPECT_TRUE(filter.mayContain("user" + std::to_string(i) + "@example.com"));
+        }
+        filter.save();
+        const std::string parallel = savedBits(db, "users.email");
+
+        // Same bits with a single thread
+        filter.build(1);
+        EXPECT_EQ(5000u, filter.getKeyCount());
+        filter.save();
+        EXPECT_EQ(parallel, savedBits(db, "users.email"));
+    }
+    {
+        // Reloaded from the side table
+        SQLite::Database db("keyfilter_test.db3", SQLite::OPEN_READWRITE);
+        SQLite::KeyFilter filter(db, "users", "email");
+        EXPECT_EQ(5000u, filter.getKeyCount());
+        EXPECT_TRUE(filter.mayContain(std::string("user4999@example.com")));
+
+        // Stale once rows are appended without the filter
+        db.exec("INSERT INTO users (id, email) VALUES (20000, 'late@example.com')");
+        EXPECT_FALSE(filter.load());
+        filter.build();
+        EXPECT_TRUE(filter.mayContain(std::string("late@example.com")));
+        EXPECT_EQ(5001u, filter.getKeyCount());
+        filter.save();
+    }
+    {
+        // Reloaded without reading the key column, and flagged as stale by other connections
+        SQLite::Database db("keyfilter_test.db3", SQLite::OPEN_READWRITE);
+        SQLite::KeyFilter filter(db, "users", "email");
+        EXPECT_EQ(0, db.execAndGet("SELECT stale FROM sqlitecpp_keyfilter").getInt());
+        SQLite::Database other("keyfilter_test.db3", SQLite::OPEN_READWRITE);
+        other.exec("INSERT INTO users (id, email) VALUES (20002, 'other@example.com')");
+        EXPECT_EQ(1, db.execAndGet("SELECT stale FROM sqlitecpp_keyfilter").getInt());
+        EXPECT_FALSE(filter.load());
+        other.exec("DELETE FROM users WHERE id = 20002");
+        filter.build();
+        filter.save();
+        EXPECT_TRUE(filter.load());
+    }
+    {
+        // Stale once a key is updated without the filter, even if the rowids do not change
+        SQLite::Database db("keyfilter_test.db3", SQLite::OPEN_READWRITE);
+        db.exec("UPDATE users SET email = 'renamed@example.com' WHERE id = 2");
+        SQLite::KeyFilter filter(db, "users", "email");
+        EXPECT_TRUE(filter.mayContain(std::string("renamed@example.com")));
+        EXPECT_EQ(5001u, filter.getKeyCount());
+    }
+    remove("keyfilter_test.db3");
+}
+
+TEST(KeyFilter, withoutRowid)
+{
+    remove("keyfilter_test.db3");
+    {
+        SQLite::Database db("keyfilter_test.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        db.exec("CREATE TABLE users (id INTEGER PRIMARY KEY, email TEXT) WITHOUT ROWID");
+        insertKeys(db, 1, 100);
+        {
+            SQLite::KeyFilter filter(db, "users", "email");
+            filter.save();
+            EXPECT_TRUE(filter.load());
+        }
+
+        // Stale once a row is replaced without the filter
+        db.exec("DELETE FROM users WHERE id = 2; INSERT INTO users (id, email) VALUES (2, 'other@example.com')");
+        SQLite::KeyFilter filter(db, "users", "email");
+        EXPECT_TRUE(filter.mayContain(std::string("other@example.com")));
+    }
+    remove("keyfilter_test.db3");
+}
+
+TEST(KeyFilter, parallelBuildFullRange)
+{
+    remove("keyfilter_test.db3");
+    {
+        // The rowid range spans the whole int64 range
+        SQLite::Database db("keyfilter_test.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        db.exec("CREATE TABLE users (id INTEGER PRIMARY KEY, email TEXT)");
+        db.exec("INSERT INTO users VALUES (-9223372036854775808, 'min'), (0, 'zero'), "
+                "(9223372036854775807, 'max')");
+        SQLite::KeyFilter filter(db, "users", "email", 0.01, 4);
+        EXPECT_EQ(3u, filter.getKeyCount());
+        EXPECT_TRUE(filter.mayContain(std::string("min")));
+        EXPECT_TRUE(filter.mayContain(std::string("zero")));
+        EXPECT_TRUE(filter.mayContain(std::string("max")));
+    }
+    remove("keyfilter_test.db3");
+}
@@ -0,0 +1,141 @@
+/**
+ * @file    MaterializedAggregate_test.cpp
+ * @ingroup tests
+ * @brief   Test of an incrementally maintained summary table.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/MaterializedAggregate.h>
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Statement.h>
+#include <SQLiteCpp/Exception.h>
+
+#include <gtest/gtest.h>
+
+TEST(MaterializedAggregate, parse)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    db.exec("CREATE TABLE t (k TEXT, v INTEGER)");
+
+    SQLite::MaterializedAggregate agg(db, "t_summary",
+                                      "SELECT k, count(*), sum(v) AS s, total(\"v\"), count(v) FROM t GROUP BY k;");
+    EXPECT_EQ("t_summary", agg.getName());
+    EXPECT_EQ("t", agg.getSourceTable());
+    ASSERT_EQ(5u, agg.getAggregates().size());
+    EXPECT_EQ(SQLite::MaterializedAggregate::Kind::Key, agg.getAggregates()[0].kind);
+    EXPECT_EQ("k", agg.getAggregates()[0].name);
+    EXPECT_EQ(SQLite::MaterializedAggregate::Kind::CountAll, agg.getAggregates()[1].kind);
+    EXPECT_EQ("count(*)", agg.getAggregates()[1].name);
+    EXPECT_EQ(SQLite::MaterializedAggregate::Kind::Sum, agg.getAggregates()[2].kind);
+    EXPECT_EQ("s", agg.getAggregates()[2].name);
+    EXPECT_EQ(SQLite::MaterializedAggregate::Kind::Total, agg.getAggregates()[3].kind);
+    EXPECT_EQ("v", agg.getAggregates()[3].column);
+    EXPECT_EQ(SQLite::MaterializedAggregate::Kind::Count, agg.getAggregates()[4].kind);
+    EXPECT_TRUE(db.tableExists("t_summary"));
+    EXPECT_TRUE(agg.verify());
+
+    // Not decomposable, or not supported
+    EXPECT_THROW(SQLite::MaterializedAggregate(db, "bad", "SELECT k, max(v) FROM t GROUP BY k"), SQLite::Exception);
+    EXPECT_THROW(SQLite::MaterializedAggregate(db, "bad", "SELECT k, avg(v) FROM t GROUP BY k"), SQLite::Exception);
+    EXPECT_THROW(SQLite::MaterializedAggregate(db, "bad", "SELECT k, sum(v+1) FROM t GROUP BY k"), SQLite::Exception);
+    EXPECT_THROW(SQLite::MaterializedAggregate(db, "bad", "SELECT k, count(v) FROM t"), SQLite::Exception);
+    EXPECT_THROW(SQLite::MaterializedAggregate(db, "bad", "SELECT k, v, count(*) FROM t GROUP BY k"),
+                 SQLite::Exception);
+    EXPECT_THROW(SQLite::MaterializedAggregate(db, "bad", "SELECT count(*) FROM t GROUP BY k"), SQLite::Exception);
+    EXPECT_THROW(SQLite::MaterializedAggregate(db, "bad", "SELECT k, count(*) FROM t WHERE v > 0 GROUP BY k"),
+                 SQLite::Exception);
+    EXPECT_FALSE(db.tableExists("bad"));
+}
+
+TEST(MaterializedAggregate, maintain)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    db.exec("CREATE TABLE t (id INTEGER PRIMARY KEY, k TEXT, v INTEGER, other TEXT)");
+    db.exec("INSERT INTO t (k, v) VALUES ('a', 1), ('a', 2), ('b', 10), ('b', NULL), (NULL, 5)");
+
+    // Initial backfill
+    SQLite::MaterializedAggregate agg(db, "summary",
+        "SELECT k, count(*) AS n, count(v) AS nv, sum(v) AS s, total(v) AS t FROM t GROUP BY k");
+    EXPECT_TRUE(agg.verify());
+    EXPECT_EQ(3, db.execAndGet("SELECT count(*) FROM summary").getInt());
+    EXPECT_EQ(3, db.execAndGet("SELECT s FROM summary WHERE k = 'a'").getInt());
+    EXPECT_EQ(2, db.execAndGet("SELECT n FROM summary WHERE k = 'b'").getInt());
+    EXPECT_EQ(1, db.execAndGet("SELECT nv FROM summary WHERE k = 'b'").getInt());
+    EXPECT_EQ(5, db.execAndGet("SELECT s FROM summary WHERE k IS NULL").getInt());
+
+    // Inserts, including a new group and NULL values
+    db.exec("INSERT INTO t (k, v) VALUES ('a', 3), ('c', NULL), ('c', NULL)");
+    EXPECT_TRUE(agg.verify());
+    EXPECT_EQ(6, db.execAndGet("SELECT s FROM summary WHERE k = 'a'").getInt());
+    EXPECT_TRUE(db.execAndGet("SELECT s FROM summary WHERE k = 'c'").isNull());
+    EXPECT_EQ(0.0, db.execAndGet("SELECT t FROM summary WHERE k = 'c'").getDouble());
+
+    // Updates moving rows between groups, or changing values
+    db.exec("UPDATE t SET k = 'c' WHERE k = 'b' AND v = 10");
+    db.exec("UPDATE t SET v = v * 2 WHERE k = 'a'");
+    db.exec("UPDATE t SET other = 'ignored'");
+    EXPECT_TRUE(agg.verify());
+    EXPECT_EQ(12, db.execAndGet("SELECT s FROM summary WHERE k = 'a'").getInt());
+    EXPECT_EQ(10, db.execAndGet("SELECT s FROM summary WHERE k = 'c'").getInt());
+
+    // Deletes, emptying groups and making sums NULL again
+    db.exec("DELETE FROM t WHERE k = 'b'");
+    db.exec("DELETE FROM t WHERE k = 'c' AND v IS NOT NULL");
+    EXPECT_TRUE(agg.verify());
+    EXPECT_EQ(0, db.execAndGet("SELECT count(*) FROM summary WHERE k = 'b'").getInt());
+    EXPECT_TRUE(db.execAndGet("SELECT s FROM summary WHERE k = 'c'").isNull());
+
+    // Tampering with the summary is detected, and repaired by a refresh
+    db.exec("UPDATE summary SET n = 42 WHERE k = 'a'");
+    EXPECT_FALSE(agg.verify());
+    agg.refresh();
+    EXPECT_TRUE(agg.verify());
+
+    // An existing summary table is reused as is
+    SQLite::MaterializedAggregate same(db, "summary",
+        "SELECT k, count(*) AS n, count(v) AS nv, sum(v) AS s, total(v) AS t FROM t GROUP BY k");
+    db.exec("INSERT INTO t (k, v) VALUES ('d', 7)");
+    EXPECT_TRUE(same.verify());
+    EXPECT_EQ(1, db.execAndGet("SELECT count(*) FROM summary WHERE k = 'd'").getInt());
+
+    same.drop();
+    EXPECT_FALSE(db.tableExists("summary"));
+    EXPECT_EQ(1, db.exec("INSERT INTO t (k, v) VALUES ('e', 8)"));
+}
+
+TEST(MaterializedAggregate, multipleKeys)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    db.exec("CREATE TABLE sales (region TEXT, product TEXT, amount REAL)");
+    db.exec("INSERT INTO sales VALUES ('eu', 'x', 1.5), ('eu', 'y', 2.5), ('us', 'x', 4.0), ('eu', 'x', 0.5)");
+
+    SQLite::MaterializedAggregate agg(db, "sales_by_region_product",
+        "SELECT region, product AS p, count(*), sum(amount) FROM sales GROUP BY region, product");
+    EXPECT_TRUE(agg.verify());
+    EXPECT_EQ(2.0, db.execAndGet("SELECT \"sum(amount)\" FROM sales_by_region_product "
+                                 "WHERE region = 'eu' AND p = 'x'").getDouble());
+
+    db.exec("DELETE FROM sales WHERE amount = 0.5");
+    db.exec("UPDATE sales SET region = 'us' WHERE product = 'y'");
+    EXPECT_TRUE(agg.verify());
+    EXPECT_EQ(1, db.execAndGet("SELECT \"count(*)\" FROM sales_by_region_product "
+                               "WHERE region = 'eu' AND p = 'x'").getInt());
+}
+
+TEST(MaterializedAggregate, trailingComment)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    db.exec("CREATE TABLE t (k TEXT, v INTEGER)");
+    db.exec("INSERT INTO t VALUES ('a', 1), ('a', 2), ('b', 3)");
+
+    // The query is embedded in verify(), so a trailing comment shall not hide the rest of its SQL
+    SQLite::MaterializedAggregate agg(db, "t_summary", "SELECT k, sum(v) FROM t GROUP BY k -- per key");
+    EXPECT_TRUE(agg.verify());
+
+    // The group keys identify one row each
+    EXPECT_THROW(db.exec("INSERT INTO t_summary (k, __rows) VALUES ('a', 1)"), SQLite::Exception);
+}
@@ -0,0 +1,68 @@
+/**
+ * @file    PageAccessRecorder_test.cpp
+ * @ingroup tests
+ * @brief   Test of the VFS recording the ranges read from the database files.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/PageAccessRecorder.h>
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Exception.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+TEST(PageAccessRecorder, hotSet)
+{
+    remove("test.db3");
+    remove("test.hotset");
+    {
+        SQLite::Database db("test.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        db.exec("CREATE TABLE test (id INTEGER PRIMARY KEY, value BLOB)");
+        db.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 1000) "
+                "INSERT INTO test SELECT i, zeroblob(1000) FROM n");
+    }
+    {
+        SQLite::PageAccessRecorder recorder;
+        EXPECT_EQ("sqlitecpp_recorder", recorder.getVfsName());
+        SQLite::Database db("test.db3", SQLite::OPEN_READONLY, 0, recorder.getVfsName().c_str());
+        // The header is read on opening
+        EXPECT_FALSE(recorder.getRanges(db).empty());
+        recorder.clear();
+        EXPECT_TRUE(recorder.getRanges(db).empty());
+
+        // A lookup reads the header, the root page and a few pages of the table
+        EXPECT_EQ(1000, db.execAndGet("SELECT length(value) FROM test WHERE id = 500").getInt());
+        const std::vector<SQLite::PageAccessRecorder::Range> ranges = recorder.getRanges(db);
+        ASSERT_FALSE(ranges.empty());
+        EXPECT_EQ(0, ranges.front().first);
+        int64_t bytes = 0;
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            EXPECT_GT(ranges[i].second, 0);
+            if (i > 0)
+            {
+                EXPECT_GT(ranges[i].first, ranges[i - 1].first + ranges[i - 1].second);
+            }
+            bytes += ranges[i].second;
+        }
+        EXPECT_LT(bytes, db.getFileSize() / 10);
+
+        // Warm up only the pages read
+        recorder.save(db, "test.hotset");
+        SQLite::WarmUpOptions options;
+        options.strategy = SQLite::WarmUpOptions::HotSet;
+        options.hotSetFile = "test.hotset";
+        const SQLite::WarmUpResult result = db.warmUp(options);
+        EXPECT_TRUE(result.complete);
+        EXPECT_EQ(bytes, result.bytesTotal);
+        EXPECT_EQ(bytes, result.bytesRead);
+    }
+    remove("test.db3");
+    remove("test.hotset");
+}
@@ -0,0 +1,251 @@
+/**
+ * @file    PlanRegressionDetector_test.cpp
+ * @ingroup tests
+ * @brief   Test of the detection of the changes of the query plans.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/PlanRegressionDetector.h>
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Exception.h>
+#include <SQLiteCpp/Statement.h>
+#include <SQLiteCpp/Transaction.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const char* const DATABASE = "test_plans.db3";
+const char* const SIDECAR = "test_plans.db3-plans";
+
+// Create the table of the tests, with 1000 rows of the same category, and the indexes of both columns
+void createItems(SQLite::Database& aDb)
+{
+    aDb.exec("CREATE TABLE items (id INTEGER PRIMARY KEY, category INTEGER, price INTEGER);"
+             "CREATE INDEX items_category ON items (category);"
+             "CREATE INDEX items_price ON items (price)");
+    SQLite::Transaction transaction(aDb);
+    SQLite::Statement insert(aDb, "INSERT INTO items (category, price) VALUES (1, ?)");
+    for (int price = 0; price < 1000; ++price)
+    {
+        insert.bind(1, price);
+        insert.exec();
+        insert.reset();
+    }
+    transaction.commit();
+}
+
+// Execute the query of the tests, looking up the items of a category by price
+int countItems(SQLite::Database& aDb, const int aCategory, const int aPrice)
+{
+    SQLite::Statement query(aDb, "-- Items of a category by price\n"
+                                 "SELECT count(*) FROM items WHERE category = ? AND price = ?");
+    query.bind(1, aCategory);
+    query.bind(2, aPrice);
+    (void)query.executeStep();
+    return query.getColumn(0).getInt();
+}
+
+} // namespace
+
+TEST(PlanRegressionDetector, dropIndex)
+{
+    remove(DATABASE);
+    remove(SIDECAR);
+    {
+        SQLite::Database db(DATABASE, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        createItems(db);
+        db.exec("DROP INDEX items_price");
+
+        std::vector<SQLite::PlanChange> changes;
+        SQLite::PlanRegressionOptions options;
+        options.callback = [&changes](const SQLite::PlanChange& aChange) { changes.push_back(aChange); };
+        SQLite::PlanRegressionDetector detector(SIDECAR, options);
+        EXPECT_THROW(detector.check(), SQLite::Exception);
+        detector.attach(db);
+        EXPECT_THROW(detector.attach(db), SQLite::Exception);
+
+        // The plan is captured at the first execution of the fingerprint only
+        EXPECT_EQ(1, countItems(db, 1, 42));
+        EXPECT_EQ(1, countItems(db, 1, 43));
+        db.exec("PRAGMA user_version = 1");
+        EXPECT_EQ(1u, detector.getPlanCount());
+        EXPECT_TRUE(detector.check().empty());
+        EXPECT_TRUE(changes.empty());
+
+        // A schema change committed marks the plans as stale, re-checked out of the statements
+        EXPECT_FALSE(detector.isStale());
+        db.exec("DROP INDEX items_category");
+        EXPECT_TRUE(detector.isStale());
+        EXPECT_TRUE(changes.empty());
+        EXPECT_EQ(1u, detector.checkStale().size());
+        EXPECT_FALSE(detector.isStale());
+        ASSERT_EQ(1u, changes.size());
+        EXPECT_EQ("select count (*) from items where category = ? and price = ?", changes[0].fingerprint.normalized);
+        EXPECT_EQ("-- Items of a category by price\nSELECT count(*) FROM items WHERE category = ? AND price = ?",
+                  changes[0].sql);
+        EXPECT_TRUE(changes[0].oldPlan.usesIndex("items_category"));
+        EXPECT_FALSE(changes[0].oldPlan.hasFullScan());
+        EXPECT_TRUE(changes[0].newPlan.hasFullScan());
+        EXPECT_TRUE(changes[0].bRegression);
+
+        // In a transaction, the plans are stale at the commit
+        {
+            SQLite::Transaction transaction(db);
+            db.exec("CREATE INDEX items_price ON items (price)");
+            EXPECT_FALSE(detector.isStale());
+            transaction.commit();
+        }
+        EXPECT_TRUE(detector.isStale());
+        EXPECT_EQ(1u, detector.checkStale().size());
+        ASSERT_EQ(2u, changes.size());
+        EXPECT_TRUE(changes[1].oldPlan.hasFullScan());
+        EXPECT_TRUE(changes[1].newPlan.usesIndex("items_price"));
+        EXPECT_FALSE(changes[1].bRegression);
+
+        detector.detach(db);
+        db.exec("DROP INDEX items_price");
+        EXPECT_FALSE(detector.isStale());
+        EXPECT_EQ(2u, changes.size());
+    }
+
+    // The plans and their changes are persisted to the sidecar database
+    {
+        SQLite::Database sidecar(SIDECAR);
+        EXPECT_EQ(1, sidecar.execAndGet("SELECT count(*) FROM sqlitecpp_plans").getInt());
+        EXPECT_EQ(2, sidecar.execAndGet("SELECT count(*) FROM sqlitecpp_plan_changes").getInt());
+        EXPECT_EQ(1, sidecar.execAndGet("SELECT sum(regression) FROM sqlitecpp_plan_changes").getInt());
+    }
+    remove(DATABASE);
+    remove(SIDECAR);
+}
+
+TEST(PlanRegressionDetector, persistence)
+{
+    remove(DATABASE);
+    remove(SIDECAR);
+    {
+        SQLite::Database db(DATABASE, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        createItems(db);
+        SQLite::PlanRegressionDetector detector(SIDECAR);
+        detector.attach(db);
+        EXPECT_EQ(1, countItems(db, 1, 42));
+        EXPECT_EQ(1u, detector.getPlanCount());
+    }
+    {
+        // The plan changes while no detector is attached
+        SQLite::Database db(DATABASE, SQLite::OPEN_READWRITE);
+        db.exec("DROP INDEX items_price; DROP INDEX items_category");
+    }
+    {
+        // The plan loaded from the sidecar is compared at the first execution of its fingerprint
+        SQLite::Database db(DATABASE, SQLite::OPEN_READWRITE);
+        std::vector<SQLite::PlanChange> changes;
+        SQLite::PlanRegressionOptions options;
+        options.callback = [&changes](const SQLite::PlanChange& aChange) { changes.push_back(aChange); };
+        SQLite::PlanRegressionDetector detector(SIDECAR, options);
+        EXPECT_EQ(1u, detector.getPlanCount());
+        detector.attach(db);
+        EXPECT_TRUE(changes.empty());
+        EXPECT_EQ(1, countItems(db, 1, 42));
+        ASSERT_EQ(1u, changes.size());
+        EXPECT_FALSE(changes[0].oldPlan.hasFullScan());
+        EXPECT_TRUE(changes[0].newPlan.hasFullScan());
+        EXPECT_TRUE(changes[0].bRegression);
+        EXPECT_EQ(1, countItems(db, 1, 42));
+        EXPECT_EQ(1u, changes.size());
+    }
+    remove(DATABASE);
+    remove(SIDECAR);
+}
+
+TEST(PlanRegressionDetector, analyze)
+{
+    remove(DATABASE);
+    remove(SIDECAR);
+    {
+        SQLite::Database db(DATABASE, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        createItems(db);
+
+        std::vector<SQLite::PlanChange> changes;
+        SQLite::PlanRegressionOptions options;
+        options.callback = [&changes](const SQLite::PlanChange& aChange) { changes.push_back(aChange); };
+        SQLite::PlanRegressionDetector detector(SIDECAR, options);
+        detector.attach(db);
+        SQLite::Statement query(db, "SELECT count(*) FROM items WHERE category = 1 AND price > 990");
+        (void)query.executeStep();
+        EXPECT_EQ(9, query.getColumn(0).getInt());
+
+        // The statistics show that all the items are of the same category
+        db.exec("ANALYZE");
+        EXPECT_TRUE(changes.empty());
+        (void)detector.checkStale();
+        ASSERT_EQ(1u, changes.size());
+        EXPECT_TRUE(changes[0].oldPlan.usesIndex("items_category"));
+        EXPECT_TRUE(changes[0].newPlan.usesIndex("items_price"));
+        EXPECT_FALSE(changes[0].bRegression);
+
+        // Writing the statistics, like Database::importPlannerStats() does, is a schema change too
+        db.exec("DELETE FROM sqlite_stat1");
+        if (db.tableExists("sqlite_stat4"))
+        {
+            db.exec("DELETE FROM sqlite_stat4");
+        }
+        EXPECT_TRUE(detector.isStale());
+        (void)detector.checkStale();
+        ASSERT_EQ(2u, changes.size());
+        EXPECT_TRUE(changes[1].newPlan.usesIndex("items_category"));
+    }
+    remove(DATABASE);
+    remove(SIDECAR);
+}
+
+TEST(PlanRegressionDetector, busy)
+{
+    remove(DATABASE);
+    remove(SIDECAR);
+    {
+        SQLite::Database db(DATABASE, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        createItems(db);
+        SQLite::PlanRegressionDetector detector(SIDECAR);
+        detector.attach(db);
+        EXPECT_EQ(1, countItems(db, 1, 42));
+        db.exec("DROP INDEX items_category; DROP INDEX items_price");
+        EXPECT_TRUE(detector.isStale());
+
+        // The plans cannot be explained while another connection writes the database: they are still stale
+        {
+            SQLite::Database writer(DATABASE, SQLite::OPEN_READWRITE);
+            writer.exec("BEGIN EXCLUSIVE");
+            EXPECT_THROW(detector.checkStale(), SQLite::Exception);
+            EXPECT_TRUE(detector.isStale());
+            writer.exec("ROLLBACK");
+        }
+        const std::vector<SQLite::PlanChange> changes = detector.checkStale();
+        ASSERT_EQ(1u, changes.size());
+        EXPECT_TRUE(changes[0].newPlan.hasFullScan());
+        EXPECT_FALSE(detector.isStale());
+    }
+    remove(DATABASE);
+    remove(SIDECAR);
+}
+
+TEST(PlanRegressionDetector, memory)
+{
+    remove(SIDECAR);
+    {
+        SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+        SQLite::PlanRegressionDetector detector(SIDECAR);
+        EXPECT_THROW(detector.attach(db), SQLite::Exception);
+    }
+    remove(SIDECAR);
+}
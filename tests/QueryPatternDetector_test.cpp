@@ -0,0 +1,267 @@
+/**
+ * @file    QueryPatternDetector_test.cpp
+ * @ingroup tests
+ * @brief   Test of the detection of the N+1 query pattern.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/QueryPatternDetector.h>
+#include <SQLiteCpp/WorkloadRecorder.h>
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Exception.h>
+#include <SQLiteCpp/Statement.h>
+#include <SQLiteCpp/Transaction.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+// Create the tables of the tests, with 20 orders of 3 lines each
+void createOrders(SQLite::Database& aDb)
+{
+    aDb.exec("CREATE TABLE orders (id INTEGER PRIMARY KEY, customer TEXT);"
+             "CREATE TABLE lines (id INTEGER PRIMARY KEY, order_id INTEGER, product TEXT)");
+    SQLite::Transaction transaction(aDb);
+    for (int order = 1; order <= 20; ++order)
+    {
+        aDb.exec("INSERT INTO orders VALUES (" + std::to_string(order) + ", 'customer')");
+        for (int line = 0; line < 3; ++line)
+        {
+            aDb.exec("INSERT INTO lines (order_id, product) VALUES (" + std::to_string(order) + ", 'product')");
+        }
+    }
+    transaction.commit();
+}
+
+// Load the lines of the orders one by one
+int loadLines(SQLite::Database& aDb, SQLite::QueryPatternDetector& aDetector, const int aOrders)
+{
+    int lines = 0;
+    for (int order = 1; order <= aOrders; ++order)
+    {
+        SQLite::QueryPatternDetector::Tag tag(aDetector, "loadLines");
+        SQLite::Statement query(aDb, "SELECT product FROM lines WHERE order_id = ?");
+        query.bind(1, order);
+        while (query.executeStep())
+        {
+            ++lines;
+        }
+    }
+    return lines;
+}
+
+} // namespace
+
+TEST(QueryPatternDetector, scope)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    createOrders(db);
+
+    std::vector<SQLite::QueryBurst> reported;
+    SQLite::QueryPatternOptions options;
+    options.threshold = 10;
+    options.callback = [&reported](const SQLite::QueryBurst& aBurst)
+    {
+        reported.push_back(aBurst);
+    };
+    SQLite::QueryPatternDetector detector(options);
+    detector.attach(db);
+    EXPECT_THROW(detector.attach(db), SQLite::Exception);
+
+    // Not enough executions for a burst
+    {
+        SQLite::QueryPatternDetector::Scope scope(detector, "GET /orders/1");
+        EXPECT_EQ(9, loadLines(db, detector, 3));
+        db.exec("SELECT * FROM orders WHERE id = 1");
+    }
+    EXPECT_TRUE(reported.empty());
+
+    // The lines of 20 orders loaded one by one, literals and parameters alike
+    {
+        SQLite::QueryPatternDetector::Scope scope(detector, "GET /orders");
+        EXPECT_EQ(60, loadLines(db, detector, 20));
+        for (int order = 1; order <= 12; ++order)
+        {
+            db.exec("-- Customer of the order\nSELECT customer FROM orders WHERE id = " + std::to_string(order));
+        }
+        db.exec("SELECT count(*) FROM orders");
+        EXPECT_TRUE(reported.empty());
+    }
+    ASSERT_EQ(2u, reported.size());
+    EXPECT_EQ("GET /orders", reported[0].scope);
+    EXPECT_EQ(20, reported[0].count);
+    EXPECT_EQ("select product from lines where order_id = ?", reported[0].fingerprint.normalized);
+    EXPECT_EQ("SELECT product FROM lines WHERE order_id = ?", reported[0].sql);
+    ASSERT_EQ(1u, reported[0].tags.size());
+    EXPECT_EQ("loadLines", reported[0].tags[0].first);
+    EXPECT_EQ(20, reported[0].tags[0].second);
+    EXPECT_EQ("bind all the keys at once as a JSON array: "
+              "select product from lines where order_id in (select value from json_each(?))",
+              reported[0].suggestion);
+    EXPECT_EQ(12, reported[1].count);
+    EXPECT_EQ("-- Customer of the order\nSELECT customer FROM orders WHERE id = 1", reported[1].sql);
+    EXPECT_TRUE(reported[1].tags.empty());
+
+    // The suggestion works: all the lines in one execution
+    SQLite::Statement batch(db, "SELECT product FROM lines WHERE order_id IN (SELECT value FROM json_each(?))");
+    batch.bind(1, "[1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20]");
+    int lines = 0;
+    while (batch.executeStep())
+    {
+        ++lines;
+    }
+    EXPECT_EQ(60, lines);
+
+    // The bursts are also kept, and the executions out of a scope not counted
+    EXPECT_EQ(2u, detector.getBursts().size());
+    loadLines(db, detector, 20);
+    EXPECT_EQ(2u, detector.getBursts().size());
+    detector.clearBursts();
+    EXPECT_TRUE(detector.getBursts().empty());
+
+    // Nested scopes: the executions are counted in the innermost one
+    reported.clear();
+    {
+        SQLite::QueryPatternDetector::Scope request(detector, "request");
+        {
+            SQLite::QueryPatternDetector::Scope inner(detector, "inner");
+            loadLines(db, detector, 10);
+        }
+        ASSERT_EQ(1u, reported.size());
+        EXPECT_EQ("inner", reported[0].scope);
+        loadLines(db, detector, 5);
+    }
+    EXPECT_EQ(1u, reported.size());
+
+    // Nothing is counted once detached
+    detector.detach(db);
+    reported.clear();
+    {
+        SQLite::QueryPatternDetector::Scope scope(detector, "detached");
+        loadLines(db, detector, 20);
+    }
+    EXPECT_TRUE(reported.empty());
+}
+
+TEST(QueryPatternDetector, transaction)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    createOrders(db);
+
+    db.exec("CREATE TABLE audit (id INTEGER);"
+            "CREATE TRIGGER audited AFTER UPDATE ON orders BEGIN INSERT INTO audit VALUES (new.id); END");
+
+    SQLite::QueryPatternOptions options;
+    options.threshold = 5;
+    SQLite::QueryPatternDetector detector(options);
+    detector.attach(db);
+
+    // The transactions are the scopes of the executions outside of an explicit scope
+    {
+        SQLite::Transaction transaction(db);
+        for (int order = 1; order <= 8; ++order)
+        {
+            db.exec("UPDATE orders SET customer = 'other' WHERE id = " + std::to_string(order));
+        }
+        for (int order = 21; order <= 26; ++order)
+        {
+            db.exec("INSERT INTO orders VALUES (" + std::to_string(order) + ", 'new')");
+        }
+        EXPECT_TRUE(detector.getBursts().empty());
+        transaction.commit();
+    }
+    std::vector<SQLite::QueryBurst> bursts = detector.getBursts();
+    ASSERT_EQ(2u, bursts.size());
+    EXPECT_EQ("transaction", bursts[0].scope);
+    EXPECT_EQ(8, bursts[0].count); // the trigger is not counted as an execution
+    EXPECT_EQ("update orders set customer = ? where id = ?", bursts[0].fingerprint.normalized);
+    EXPECT_EQ("bind all the keys at once as a JSON array: "
+              "update orders set customer = ? where id in (select value from json_each(?))", bursts[0].suggestion);
+    EXPECT_EQ(6, bursts[1].count);
+    EXPECT_EQ("insert into orders values (?, ?)", bursts[1].fingerprint.normalized);
+    EXPECT_NE(std::string::npos, bursts[1].suggestion.find("executeMany"));
+
+    // A rolled back transaction too, and one in progress when detached
+    detector.clearBursts();
+    {
+        SQLite::Transaction transaction(db);
+        loadLines(db, detector, 5);
+    }
+    ASSERT_EQ(1u, detector.getBursts().size());
+    EXPECT_EQ(5, detector.getBursts()[0].count);
+    db.exec("BEGIN");
+    loadLines(db, detector, 6);
+    detector.detach(db);
+    db.exec("COMMIT");
+    ASSERT_EQ(2u, detector.getBursts().size());
+    EXPECT_EQ(6, detector.getBursts()[1].count);
+
+    // No transaction scopes
+    SQLite::QueryPatternOptions noTransactions;
+    noTransactions.threshold = 5;
+    noTransactions.bTransactionScopes = false;
+    SQLite::QueryPatternDetector explicitOnly(noTransactions);
+    explicitOnly.attach(db);
+    {
+        SQLite::Transaction transaction(db);
+        loadLines(db, explicitOnly, 10);
+        transaction.commit();
+    }
+    EXPECT_TRUE(explicitOnly.getBursts().empty());
+}
+
+TEST(QueryPatternDetector, suggestBatching)
+{
+    EXPECT_EQ("bind all the keys at once as a JSON array: "
+              "select * from t as a join u on u.id = a.u where a.\"Key\" in (select value from json_each(?)) and x > ?",
+              SQLite::QueryPatternDetector::suggestBatching(
+                  "select * from t as a join u on u.id = a.u where a.\"Key\" = ? and x > ?"));
+    EXPECT_EQ("merge the executions into one query with a join or an IN list, or run them in one transaction",
+              SQLite::QueryPatternDetector::suggestBatching("select * from t where x > ?"));
+    EXPECT_NE(std::string::npos,
+              SQLite::QueryPatternDetector::suggestBatching("replace into t values (?, ?)").find("VALUES"));
+}
+
+TEST(QueryPatternDetector, withRecorder)
+{
+    // The detector and a workload recorder share the trace events of a connection
+    const std::string log = "query_pattern.workload";
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    createOrders(db);
+    {
+        SQLite::WorkloadRecorder recorder(log);
+        recorder.attach(db);
+        SQLite::QueryPatternDetector detector;
+        detector.attach(db);
+        {
+            SQLite::QueryPatternDetector::Scope scope(detector, "request");
+            loadLines(db, detector, 10);
+        }
+        detector.detach(db);
+        loadLines(db, detector, 2);
+        EXPECT_EQ(1u, detector.getBursts().size());
+        EXPECT_EQ(12, recorder.getExecutionCount());
+    }
+    std::remove(log.c_str());
+
+    // And are both forgotten when the connection is closed first
+    SQLite::QueryPatternDetector detector;
+    {
+        SQLite::Database closed(":memory:", SQLite::OPEN_READWRITE);
+        createOrders(closed);
+        detector.attach(closed);
+        closed.exec("BEGIN");
+        loadLines(closed, detector, 10);
+    }
+    ASSERT_EQ(1u, detector.getBursts().size());
+    EXPECT_EQ("transaction", detector.getBursts()[0].scope);
+}
@@ -0,0 +1,77 @@
+/**
+ * @file    QueryPlanAssertions.h
+ * @ingroup tests
+ * @brief   Googletest assertions on the query plan of a prepared Statement, from EXPLAIN QUERY PLAN.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <SQLiteCpp/QueryPlan.h>
+#include <SQLiteCpp/Statement.h>
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+/*
+ *  Each helper returns a ::testing::AssertionResult, with the SQL text and the whole plan on failure:
+ * @code
+ * SQLite::Statement query(db, "SELECT * FROM orders WHERE customer_id = ? ORDER BY created");
+ * EXPECT_TRUE(SQLite::assertUsesIndex(query, "orders_customer_created"));
+ * EXPECT_TRUE(SQLite::assertNoFullScan(query));
+ * EXPECT_TRUE(SQLite::assertNoTempBTree(query));
+ * @endcode
+ */
+
+namespace SQLite
+{
+
+/// Assert that the query plan of a statement uses the given index.
+inline ::testing::AssertionResult assertUsesIndex(const Statement& aStatement, const std::string& aIndex)
+{
+    const QueryPlan plan = aStatement.getQueryPlan();
+    if (plan.usesIndex(aIndex))
+    {
+        return ::testing::AssertionSuccess();
+    }
+    return ::testing::AssertionFailure() << "\"" << aStatement.getQuery() << "\" does not use the index "
+                                         << aIndex << ", its plan is:\n" << plan.toString();
+}
+
+/// Assert that the query plan of a statement reads no table by a full scan.
+inline ::testing::AssertionResult assertNoFullScan(const Statement& aStatement)
+{
+    const QueryPlan plan = aStatement.getQueryPlan();
+    std::string tables;
+    for (const QueryPlan::Access& access : plan.getAccesses())
+    {
+        if (access.bFullScan)
+        {
+            tables += (tables.empty() ? "" : ", ") + access.table;
+        }
+    }
+    if (tables.empty())
+    {
+        return ::testing::AssertionSuccess();
+    }
+    return ::testing::AssertionFailure() << "\"" << aStatement.getQuery() << "\" scans " << tables
+                                         << ", its plan is:\n" << plan.toString();
+}
+
+/// Assert that the query plan of a statement uses no temporary b-tree, for ORDER BY, GROUP BY, DISTINCT...
+inline ::testing::AssertionResult assertNoTempBTree(const Statement& aStatement)
+{
+    const QueryPlan plan = aStatement.getQueryPlan();
+    if (!plan.hasTempBTree())
+    {
+        return ::testing::AssertionSuccess();
+    }
+    return ::testing::AssertionFailure() << "\"" << aStatement.getQuery() << "\" uses a temporary b-tree"
+                                         << ", its plan is:\n" << plan.toString();
+}
+
+}  // namespace SQLite
@@ -0,0 +1,117 @@
+/**
+ * @file    QueryPlan_test.cpp
+ * @ingroup tests
+ * @brief   Test of the query plans from EXPLAIN QUERY PLAN.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/QueryPlan.h>
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Exception.h>
+#include <SQLiteCpp/Statement.h>
+
+#include "QueryPlanAssertions.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+TEST(QueryPlan, explain)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    db.exec("CREATE TABLE t (id INTEGER PRIMARY KEY, a INTEGER, b INTEGER, c TEXT);"
+            "CREATE INDEX t_a ON t(a);"
+            "CREATE TABLE u (id INTEGER PRIMARY KEY, t_id INTEGER, x TEXT)");
+
+    // Full scan, sorted by a temporary b-tree
+    SQLite::QueryPlan plan = SQLite::explainQueryPlan(db, "SELECT * FROM t AS z WHERE z.b = ? ORDER BY c");
+    ASSERT_EQ(2u, plan.steps.size());
+    std::vector<SQLite::QueryPlan::Access> accesses = plan.getAccesses();
+    ASSERT_EQ(1u, accesses.size());
+    EXPECT_TRUE(accesses[0].table == "z" || accesses[0].table == "t");
+    EXPECT_TRUE(accesses[0].bFullScan);
+    EXPECT_TRUE(accesses[0].index.empty());
+    EXPECT_TRUE(plan.hasFullScan());
+    EXPECT_TRUE(plan.hasTempBTree());
+    EXPECT_FALSE(plan.hasAutomaticIndex());
+    EXPECT_TRUE(plan.getIndexes().empty());
+
+    // Search with an index
+    plan = SQLite::explainQueryPlan(db, "SELECT * FROM t WHERE a = ? AND b > 3");
+    accesses = plan.getAccesses();
+    ASSERT_EQ(1u, accesses.size());
+    EXPECT_EQ("t", accesses[0].table);
+    EXPECT_FALSE(accesses[0].bFullScan);
+    EXPECT_EQ("t_a", accesses[0].index);
+    EXPECT_FALSE(accesses[0].bCovering);
+    EXPECT_EQ("a=?", accesses[0].constraints);
+    EXPECT_TRUE(plan.usesIndex("t_a"));
+    EXPECT_FALSE(plan.usesIndex("t_b"));
+    EXPECT_FALSE(plan.hasFullScan());
+    EXPECT_FALSE(plan.hasTempBTree());
+
+    // Covering index and primary key
+    plan = SQLite::explainQueryPlan(db, "SELECT a FROM t WHERE a > 1");
+    ASSERT_EQ(1u, plan.getAccesses().size());
+    EXPECT_TRUE(plan.getAccesses()[0].bCovering);
+    EXPECT_EQ(std::vector<std::string>{"t_a"}, plan.getIndexes());
+    plan = SQLite::explainQueryPlan(db, "SELECT * FROM t WHERE id = 1");
+    ASSERT_EQ(1u, plan.getAccesses().size());
+    EXPECT_EQ("PRIMARY KEY", plan.getAccesses()[0].index);
+    EXPECT_TRUE(plan.getIndexes().empty());
+
+    // Join through an automatic index, nested in a tree
+    plan = SQLite::explainQueryPlan(db, "SELECT * FROM t, u WHERE u.t_id = t.b");
+    EXPECT_TRUE(plan.hasAutomaticIndex());
+    EXPECT_TRUE(plan.getIndexes().empty());
+    plan = SQLite::explainQueryPlan(db, "SELECT * FROM t WHERE b IN (SELECT t_id FROM u)");
+    EXPECT_EQ(2u, plan.getAccesses().size());
+    const std::string tree = plan.toString();
+    EXPECT_NE(std::string::npos, tree.find("\n  SCAN u\n")) << tree;
+
+    EXPECT_THROW(SQLite::explainQueryPlan(db, "SELECT * FROM missing"), SQLite::Exception);
+}
+
+TEST(QueryPlan, assertions)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    db.exec("CREATE TABLE t (id INTEGER PRIMARY KEY, a INTEGER, b INTEGER, c TEXT);"
+            "CREATE INDEX t_a_c ON t(a, c)");
+
+    // The plan of the statement, prepared and bound but not executed
+    SQLite::Statement search(db, "SELECT * FROM t WHERE a = ? ORDER BY c");
+    search.bind(1, 1);
+    EXPECT_TRUE(search.getQueryPlan().usesIndex("t_a_c"));
+    EXPECT_TRUE(SQLite::assertUsesIndex(search, "t_a_c"));
+    EXPECT_TRUE(SQLite::assertNoFullScan(search));
+    EXPECT_TRUE(SQLite::assertNoTempBTree(search));
+    EXPECT_FALSE(search.executeStep());
+
+    // The failures give the SQL text and the plan
+    SQLite::Statement scan(db, "SELECT * FROM t WHERE b = ? ORDER BY c");
+    const ::testing::AssertionResult usesIndex = SQLite::assertUsesIndex(scan, "t_a_c");
+    EXPECT_FALSE(usesIndex);
+    const std::string usesIndexMessage = usesIndex.message();
+    EXPECT_NE(std::string::npos, usesIndexMessage.find("does not use the index t_a_c")) << usesIndexMessage;
+    EXPECT_NE(std::string::npos, usesIndexMessage.find("SCAN t")) << usesIndexMessage;
+    const ::testing::AssertionResult noFullScan = SQLite::assertNoFullScan(scan);
+    EXPECT_FALSE(noFullScan);
+    const std::string noFullScanMessage = noFullScan.message();
+    EXPECT_NE(std::string::npos, noFullScanMessage.find("\"SELECT * FROM t WHERE b = ? ORDER BY c\" scans t"))
+        << noFullScanMessage;
+    EXPECT_FALSE(SQLite::assertNoTempBTree(scan));
+
+    // The plan is explained again at each call, with the indexes created since the preparation
+    db.exec("CREATE INDEX t_b ON t(b)");
+    EXPECT_TRUE(SQLite::assertUsesIndex(scan, "t_b"));
+    EXPECT_TRUE(SQLite::assertNoFullScan(scan));
+
+    SQLite::Statement missing(db, "SELECT * FROM t");
+    db.exec("DROP TABLE t");
+    EXPECT_THROW(missing.getQueryPlan(), SQLite::Exception);
+}
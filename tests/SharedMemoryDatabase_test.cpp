@@ -0,0 +1,92 @@
+/**
+ * @file    SharedMemoryDatabase_test.cpp
+ * @ingroup tests
+ * @brief   Test of the in-memory database shared by the connections of the process.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/SharedMemoryDatabase.h>
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Exception.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+TEST(SharedMemoryDatabase, connect)
+{
+    SQLite::SharedMemoryDatabase shared("shared?test");
+    EXPECT_EQ("shared?test", shared.getName());
+    EXPECT_EQ("file:/shared%3Ftest?vfs=memdb", shared.getUri());
+    EXPECT_EQ(0, shared.getMemoryUsed());
+    {
+        SQLite::Database writer = shared.connect();
+        writer.exec("CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT)");
+        writer.exec("INSERT INTO test VALUES (1, 'first')");
+    }
+    EXPECT_GT(shared.getMemoryUsed(), 0);
+
+    // All the threads see the same database
+    std::vector<std::thread> threads;
+    std::vector<int64_t> counts(4, 0);
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        threads.emplace_back([&shared, &counts, i]
+        {
+            SQLite::Database db = shared.connect(SQLite::OPEN_READONLY);
+            counts[i] = db.execAndGet("SELECT count(*) FROM test").getInt64();
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    for (const int64_t count : counts)
+    {
+        EXPECT_EQ(1, count);
+    }
+
+    // Another name is another database
+    SQLite::SharedMemoryDatabase other("other");
+    SQLite::Database db = other.connect();
+    EXPECT_FALSE(db.tableExists("test"));
+}
+
+TEST(SharedMemoryDatabase, loadAndSave)
+{
+    remove("test.db3");
+    {
+        SQLite::Database db("test.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        db.exec("CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT)");
+        db.exec("INSERT INTO test VALUES (1, 'first')");
+    }
+
+    SQLite::SharedMemoryDatabase shared("reference");
+    SQLite::Database reader = shared.connect(SQLite::OPEN_READONLY);
+    shared.load("test.db3");
+    EXPECT_EQ("first", reader.execAndGet("SELECT value FROM test").getString());
+    EXPECT_THROW(shared.load("unknown.db3"), SQLite::Exception);
+
+    {
+        SQLite::Database writer = shared.connect();
+        writer.exec("INSERT INTO test VALUES (2, 'second')");
+    }
+    shared.startAutoSave("test.db3", std::chrono::milliseconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_GT(shared.getAutoSaveCount(), 0);
+    EXPECT_TRUE(shared.stopAutoSave());
+    EXPECT_FALSE(shared.stopAutoSave());
+    {
+        SQLite::Database db("test.db3");
+        EXPECT_EQ(2, db.execAndGet("SELECT count(*) FROM test").getInt());
+    }
+
+    shared.save("test.db3");
+    remove("test.db3");
+}
@@ -0,0 +1,165 @@
+/**
+ * @file    SpatialIndex_test.cpp
+ * @ingroup tests
+ * @brief   Test of the R*Tree spatial index.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/SpatialIndex.h>
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Exception.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <set>
+
+TEST(SpatialIndex, hilbertIndex)
+{
+    // The curve of order 1 in 2D visits (0,0), (0,1), (1,1), (1,0)
+    using Index = SQLite::SpatialIndex<2>;
+    EXPECT_EQ(0u, Index::hilbertIndex({{0, 0}}, 1));
+    EXPECT_EQ(1u, Index::hilbertIndex({{0, 1}}, 1));
+    EXPECT_EQ(2u, Index::hilbertIndex({{1, 1}}, 1));
+    EXPECT_EQ(3u, Index::hilbertIndex({{1, 0}}, 1));
+
+    // Each index of a curve of order 4 is visited once, and consecutive cells are adjacent
+    std::vector<std::array<uint32_t, 2>> cells(256);
+    for (uint32_t x = 0; x < 16; ++x)
+    {
+        for (uint32_t y = 0; y < 16; ++y)
+        {
+            const uint64_t index = Index::hilbertIndex({{x, y}}, 4);
+            ASSERT_LT(index, 256u);
+            cells[index] = {{x, y}};
+        }
+    }
+    for (size_t i = 1; i < cells.size(); ++i)
+    {
+        const int dx = static_cast<int>(cells[i][0]) - static_cast<int>(cells[i - 1][0]);
+        const int dy = static_cast<int>(cells[i][1]) - static_cast<int>(cells[i - 1][1]);
+        EXPECT_EQ(1, std::abs(dx) + std::abs(dy));
+    }
+}
+
+#ifdef SQLITE_ENABLE_RTREE
+
+TEST(SpatialIndex, queries)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    SQLite::SpatialIndex<2> index(db, "fences");
+    EXPECT_EQ("fences", index.getName());
+    EXPECT_TRUE(db.tableExists("fences"));
+
+    using Box = SQLite::SpatialIndex<2>::Box;
+    index.insert(1, Box{{{0.0, 0.0}}, {{10.0, 10.0}}});
+    index.insert(2, Box{{{5.0, 5.0}}, {{6.0, 6.0}}});
+    index.insert(3, Box{{{20.0, 20.0}}, {{30.0, 30.0}}});
+    EXPECT_EQ(3, index.size());
+
+    std::vector<int64_t> ids = index.intersecting(Box{{{8.0, 8.0}}, {{25.0, 25.0}}});
+    std::sort(ids.begin(), ids.end());
+    EXPECT_EQ((std::vector<int64_t>{1, 3}), ids);
+    EXPECT_EQ((std::vector<int64_t>{2}), index.within(Box{{{4.0, 4.0}}, {{7.0, 7.0}}}));
+    ids = index.containing(SQLite::SpatialIndex<2>::point({{5.5, 5.5}}));
+    std::sort(ids.begin(), ids.end());
+    EXPECT_EQ((std::vector<int64_t>{1, 2}), ids);
+
+    // Replace and remove
+    index.insert(2, Box{{{21.0, 21.0}}, {{22.0, 22.0}}});
+    EXPECT_EQ((std::vector<int64_t>{1}), index.containing(SQLite::SpatialIndex<2>::point({{5.5, 5.5}})));
+    Box box;
+    EXPECT_TRUE(index.get(2, box));
+    EXPECT_EQ(21.0, box.min[0]);
+    EXPECT_EQ(22.0, box.max[1]);
+    EXPECT_TRUE(index.remove(2));
+    EXPECT_FALSE(index.remove(2));
+    EXPECT_FALSE(index.get(2, box));
+    EXPECT_EQ(2, index.size());
+
+    EXPECT_THROW(index.insert(4, Box{{{1.0, 1.0}}, {{0.0, 0.0}}}), SQLite::Exception);
+}
+
+TEST(SpatialIndex, bulkLoadAndNearest)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+
+    // A grid of 100x100 unit squares, in both orders
+    using Index = SQLite::SpatialIndex<2>;
+    std::vector<Index::Entry> entries;
+    for (int x = 0; x < 100; ++x)
+    {
+        for (int y = 0; y < 100; ++y)
+        {
+            entries.push_back(Index::Entry{x * 100 + y, Index::Box{{{x * 2.0, y * 2.0}}, {{x * 2.0 + 1, y * 2.0 + 1}}}});
+        }
+    }
+    Index hilbert(db, "hilbert");
+    hilbert.bulkLoad(entries, Index::Order::Hilbert);
+    Index str(db, "str");
+    str.bulkLoad(entries, Index::Order::STR, 20);
+    EXPECT_EQ(10000, hilbert.size());
+    EXPECT_EQ(10000, str.size());
+    EXPECT_EQ(4u, hilbert.intersecting(Index::Box{{{10.5, 10.5}}, {{12.5, 12.5}}}).size());
+    EXPECT_EQ(4u, str.intersecting(Index::Box{{{10.5, 10.5}}, {{12.5, 12.5}}}).size());
+
+    // Nearest of a point in a gap between 4 squares
+    std::vector<std::pair<int64_t, double>> neighbors = hilbert.nearest({{11.5, 11.5}}, 4);
+    ASSERT_EQ(4u, neighbors.size());
+    std::set<int64_t> ids;
+    for (const auto& neighbor : neighbors)
+    {
+        ids.insert(neighbor.first);
+        EXPECT_NEAR(std::sqrt(0.5), neighbor.second, 1e-6);
+    }
+    EXPECT_EQ((std::set<int64_t>{505, 506, 605, 606}), ids);
+
+    // Inside a square, then far outside of the grid
+    neighbors = str.nearest({{0.5, 0.5}}, 1);
+    ASSERT_EQ(1u, neighbors.size());
+    EXPECT_EQ(0, neighbors[0].first);
+    EXPECT_EQ(0.0, neighbors[0].second);
+    neighbors = str.nearest({{1000.0, -1000.0}}, 3);
+    ASSERT_EQ(3u, neighbors.size());
+    EXPECT_EQ(9900, neighbors[0].first);
+    EXPECT_LE(neighbors[0].second, neighbors[1].second);
+    EXPECT_LE(neighbors[1].second, neighbors[2].second);
+
+    // More neighbors than boxes
+    Index small(db, "small");
+    EXPECT_TRUE(small.nearest({{0.0, 0.0}}, 3).empty());
+    small.insert(1, Index::point({{1.0, 1.0}}));
+    small.insert(2, Index::point({{2.0, 2.0}}));
+    EXPECT_EQ(2u, small.nearest({{0.0, 0.0}}, 3).size());
+    small.insert(3, Index::point({{-50.0, 0.0}}));
+    EXPECT_EQ(3, small.nearest({{-40.0, 0.0}}, 1)[0].first);
+
+    // Replacing a box once the bounds are cached does not count it twice
+    small.insert(3, Index::point({{-60.0, 0.0}}));
+    EXPECT_EQ(3, small.size());
+    EXPECT_EQ(3u, small.nearest({{0.0, 0.0}}, 5).size());
+    EXPECT_EQ(3, small.nearest({{-60.0, 0.0}}, 1)[0].first);
+}
+
+TEST(SpatialIndex, threeDimensions)
+{
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    using Index = SQLite::SpatialIndex<3>;
+    Index index(db, "volumes");
+    std::vector<Index::Entry> entries;
+    for (int i = 0; i < 1000; ++i)
+    {
+        const double c = static_cast<double>(i);
+        entries.push_back(Index::Entry{i, Index::Box{{{c, -c, c * 0.5}}, {{c + 0.5, -c + 0.5, c * 0.5 + 0.5}}}});
+    }
+    index.bulkLoad(entries);
+    EXPECT_EQ(1000, index.size());
+    EXPECT_EQ((std::vector<int64_t>{500}), index.containing(Index::point({{500.25, -499.75, 250.25}})));
+    EXPECT_EQ(250, index.nearest({{250.0, -250.0, 125.0}}, 1)[0].first);
+}
+
+#endif // SQLITE_ENABLE_RTREE
@@ -0,0 +1,173 @@
+/**
+ * @file    TableDigest_test.cpp
+ * @ingroup tests
+ * @brief   Test of the Merkle tree checksum of a table.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/TableDigest.h>
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Statement.h>
+#include <SQLiteCpp/Transaction.h>
+#include <SQLiteCpp/Exception.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+namespace
+{
+
+void fill(SQLite::Database& aDb, const int aNbRows)
+{
+    aDb.exec("CREATE TABLE orders (id INTEGER PRIMARY KEY, customer TEXT, amount REAL, data BLOB)");
+    SQLite::Transaction transaction(aDb);
+    SQLite::Statement insert(aDb, "INSERT INTO orders VALUES (?, ?, ?, zeroblob(?))");
+    for (int i = 1; i <= aNbRows; ++i)
+    {
+        insert.bind(1, i);
+        insert.bind(2, "customer" + std::to_string(i % 37));
+        insert.bind(3, i * 0.25);
+        insert.bind(4, 1 + i % 13);
+        insert.exec();
+        insert.reset();
+    }
+    transaction.commit();
+}
+
+} // namespace
+
+TEST(TableDigest, diff)
+{
+    SQLite::Database left(":memory:", SQLite::OPEN_READWRITE);
+    SQLite::Database right(":memory:", SQLite::OPEN_READWRITE);
+    fill(left, 1000);
+    fill(right, 1000);
+
+    SQLite::TableDigest leftDigest(left, "orders", 16);
+    SQLite::TableDigest rightDigest(right, "orders", 16);
+    EXPECT_EQ(16, leftDigest.getLeafWidth());
+    EXPECT_EQ(63u, leftDigest.getLeafCount()); // rowids 1 to 1000 in leaves 0 to 62
+    EXPECT_NE(0u, leftDigest.getRootHash());
+    EXPECT_EQ(leftDigest.getRootHash(), rightDigest.getRootHash());
+    EXPECT_TRUE(SQLite::TableDigest::diff(leftDigest, rightDigest).empty());
+
+    // Changes through the connection are tracked by the triggers
+    right.exec("UPDATE orders SET amount = 0 WHERE id = 100");
+    right.exec("DELETE FROM orders WHERE id IN (500, 501)");
+    right.exec("INSERT INTO orders VALUES (2000, 'new', 1.0, NULL)");
+    EXPECT_EQ(3u, rightDigest.getDirtyCount());
+    EXPECT_NE(leftDigest.getRootHash(), rightDigest.getRootHash());
+    EXPECT_EQ(0u, rightDigest.getDirtyCount());
+
+    std::vector<SQLite::TableDigest::Range> ranges = SQLite::TableDigest::diff(leftDigest, rightDigest);
+    ASSERT_EQ(3u, ranges.size());
+    EXPECT_EQ(96, ranges[0].first);
+    EXPECT_EQ(111, ranges[0].last);
+    EXPECT_EQ(496, ranges[1].first);
+    EXPECT_EQ(511, ranges[1].last);
+    EXPECT_EQ(2000, ranges[2].first);
+    EXPECT_EQ(2015, ranges[2].last);
+
+    // Repair the differences range by range
+    for (const SQLite::TableDigest::Range& range : ranges)
+    {
+        SQLite::Statement select(left, "SELECT * FROM orders WHERE id BETWEEN ? AND ?");
+        select.bind(1, range.first);
+        select.bind(2, range.last);
+        right.exec("DELETE FROM orders WHERE id BETWEEN " + std::to_string(range.first) + " AND " +
+                   std::to_string(range.last));
+        SQLite::Statement insert(right, "INSERT INTO orders VALUES (?, ?, ?, ?)");
+        while (select.executeStep())
+        {
+            insert.bind(1, select.getColumn(0).getInt64());
+            insert.bind(2, select.getColumn(1).getString());
+            insert.bind(3, select.getColumn(2).getDouble());
+            insert.bind(4, select.getColumn(3).getBlob(), select.getColumn(3).getBytes());
+            insert.exec();
+            insert.reset();
+        }
+    }
+    EXPECT_TRUE(SQLite::TableDigest::diff(leftDigest, rightDigest).empty());
+    EXPECT_EQ(leftDigest.getRootHash(), rightDigest.getRootHash());
+
+    // The incremental updates match a full computation
+    const uint64_t root = rightDigest.getRootHash();
+    rightDigest.compute();
+    EXPECT_EQ(root, rightDigest.getRootHash());
+
+    // Adjacent leaves are merged
+    left.exec("UPDATE orders SET customer = 'x' WHERE id BETWEEN 20 AND 40");
+    ranges = SQLite::TableDigest::diff(leftDigest, rightDigest);
+    ASSERT_EQ(1u, ranges.size());
+    EXPECT_EQ(16, ranges[0].first);
+    EXPECT_EQ(47, ranges[0].last);
+
+    SQLite::TableDigest other(right, "orders", 32);
+    EXPECT_THROW(SQLite::TableDigest::diff(leftDigest, other), SQLite::Exception);
+    EXPECT_THROW(SQLite::TableDigest(left, "orders", 0), SQLite::Exception);
+    EXPECT_THROW(SQLite::TableDigest(left, "unknown"), SQLite::Exception);
+}
+
+TEST(TableDigest, shapes)
+{
+    SQLite::Database left(":memory:", SQLite::OPEN_READWRITE);
+    SQLite::Database right(":memory:", SQLite::OPEN_READWRITE);
+    left.exec("CREATE TABLE t (v)");
+    right.exec("CREATE TABLE t (v)");
+
+    SQLite::TableDigest leftDigest(left, "t", 10);
+    SQLite::TableDigest rightDigest(right, "t", 10);
+    EXPECT_EQ(0u, leftDigest.getRootHash());
+    EXPECT_EQ(0u, leftDigest.getLeafCount());
+
+    // Trees of different heights, and negative rowids
+    left.exec("INSERT INTO t (rowid, v) VALUES (-25, 'a'), (5, 'b')");
+    right.exec("INSERT INTO t (rowid, v) VALUES (5, 'b'), (1000000, 'c')");
+    std::vector<SQLite::TableDigest::Range> ranges = SQLite::TableDigest::diff(leftDigest, rightDigest);
+    ASSERT_EQ(2u, ranges.size());
+    EXPECT_EQ(-30, ranges[0].first);
+    EXPECT_EQ(-21, ranges[0].last);
+    EXPECT_EQ(1000000, ranges[1].first);
+    EXPECT_EQ(1000009, ranges[1].last);
+
+    // Rows changed by another connection are marked explicitly
+    right.exec("DELETE FROM t WHERE rowid = 1000000");
+    left.exec("DELETE FROM t WHERE rowid = -25");
+    EXPECT_EQ(leftDigest.getRootHash(), rightDigest.getRootHash());
+    EXPECT_EQ(1u, rightDigest.getLeafCount());
+    rightDigest.markDirty(SQLite::TableDigest::Range{0, 99});
+    EXPECT_EQ(10u, rightDigest.getDirtyCount());
+    rightDigest.refresh();
+    EXPECT_EQ(leftDigest.getRootHash(), rightDigest.getRootHash());
+
+    // Same values with different types are different
+    right.exec("UPDATE t SET v = CAST(v AS BLOB)");
+    EXPECT_NE(leftDigest.getRootHash(), rightDigest.getRootHash());
+}
+
+TEST(TableDigest, parallel)
+{
+    remove("tabledigest_test.db3");
+    {
+        SQLite::Database db("tabledigest_test.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        fill(db, 10000);
+
+        SQLite::TableDigest parallel(db, "orders", 100, 4);
+        SQLite::TableDigest single(db, "orders", 100, 1);
+        EXPECT_EQ(101u, parallel.getLeafCount());
+        EXPECT_EQ(single.getRootHash(), parallel.getRootHash());
+        EXPECT_TRUE(SQLite::TableDigest::diff(single, parallel).empty());
+
+        // A pending transaction makes the scan use the connection
+        SQLite::Transaction transaction(db);
+        db.exec("UPDATE orders SET amount = -1 WHERE id = 5000");
+        parallel.compute(4);
+        EXPECT_EQ(single.getRootHash(), parallel.getRootHash());
+    }
+    remove("tabledigest_test.db3");
+}
@@ -0,0 +1,93 @@
+/**
+ * @file    VacuumScheduler_test.cpp
+ * @ingroup tests
+ * @brief   Test of the incremental vacuum scheduler.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/VacuumScheduler.h>
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Exception.h>
+#include <SQLiteCpp/Transaction.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+// Insert then delete rows, to free about 250 pages of 4096 bytes
+static void fillAndDelete(SQLite::Database& aDb)
+{
+    aDb.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 1000) "
+             "INSERT INTO test SELECT zeroblob(1000) FROM n");
+    aDb.exec("DELETE FROM test");
+}
+
+TEST(VacuumScheduler, run)
+{
+    remove("test.db3");
+    {
+        SQLite::Database db("test.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        db.exec("PRAGMA page_size = 4096");
+        db.exec("CREATE TABLE test (data BLOB)");
+        fillAndDelete(db);
+
+        SQLite::VacuumScheduler vacuum(db);
+        EXPECT_FALSE(vacuum.isIncremental());
+        EXPECT_TRUE(vacuum.isNeeded());
+        EXPECT_THROW(vacuum.run(std::chrono::milliseconds(100)), SQLite::Exception);
+
+        // The conversion vacuums all the free pages
+        EXPECT_TRUE(vacuum.convert());
+        EXPECT_TRUE(vacuum.isIncremental());
+        EXPECT_FALSE(vacuum.convert());
+        EXPECT_EQ(0, vacuum.getFreePages());
+        EXPECT_FALSE(vacuum.isNeeded());
+        EXPECT_EQ(0, vacuum.run(std::chrono::milliseconds(100)));
+        EXPECT_EQ(0, vacuum.getMetrics().runs);
+
+        // Pages are not released automatically anymore, but by batches
+        fillAndDelete(db);
+        const int64_t freePages = vacuum.getFreePages();
+        EXPECT_GT(freePages, 200);
+        const int64_t pageCount = db.execAndGet("PRAGMA page_count").getInt64();
+        vacuum.setBatchPages(10);
+        EXPECT_EQ(10, vacuum.getBatchPages());
+        EXPECT_EQ(10, vacuum.run(std::chrono::milliseconds(0)));
+        EXPECT_EQ(pageCount - 10, db.execAndGet("PRAGMA page_count").getInt64());
+        EXPECT_EQ(freePages - 10, vacuum.run(std::chrono::milliseconds(60000)));
+        EXPECT_EQ(0, vacuum.getFreePages());
+        EXPECT_EQ(pageCount - freePages, db.execAndGet("PRAGMA page_count").getInt64());
+
+        const SQLite::VacuumScheduler::Metrics& metrics = vacuum.getMetrics();
+        EXPECT_EQ(2, metrics.runs);
+        EXPECT_EQ((freePages + 9) / 10, metrics.batches);
+        EXPECT_EQ(freePages, metrics.pagesReleased);
+        EXPECT_EQ(0, metrics.busy);
+        EXPECT_EQ(0, metrics.freePages);
+        EXPECT_GT(metrics.duration.count(), 0);
+
+        // Not enough free pages to bother
+        vacuum.setMinFreePages(1000);
+        EXPECT_EQ(1000, vacuum.getMinFreePages());
+        fillAndDelete(db);
+        EXPECT_FALSE(vacuum.isNeeded());
+        EXPECT_EQ(0, vacuum.run(std::chrono::milliseconds(100)));
+        EXPECT_EQ(2, metrics.runs);
+        EXPECT_EQ(vacuum.getFreePages(), metrics.freePages);
+
+        // Yield to another writer
+        vacuum.setMinFreePages(1);
+        SQLite::Database writer("test.db3", SQLite::OPEN_READWRITE);
+        {
+            SQLite::Transaction transaction(writer, SQLite::TransactionBehavior::IMMEDIATE);
+            EXPECT_EQ(0, vacuum.run(std::chrono::milliseconds(100)));
+            EXPECT_EQ(1, metrics.busy);
+        }
+        EXPECT_GT(vacuum.run(std::chrono::milliseconds(100)), 0);
+    } // Close DB test.db3
+    remove("test.db3");
+}
@@ -0,0 +1,321 @@
+/**
+ * @file    WorkloadRecorder_test.cpp
+ * @ingroup tests
+ * @brief   Test of the recording of workloads to a binary log, and of their replay.
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/WorkloadRecorder.h>
+#include <SQLiteCpp/WorkloadReplayer.h>
+#include <SQLiteCpp/Column.h>
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Exception.h>
+#include <SQLiteCpp/Statement.h>
+#include <SQLiteCpp/Transaction.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// Return the index of a SQL text in the log, or -1
+int findSql(const SQLite::WorkloadLog& aLog, const std::string& aSql)
+{
+    for (size_t i = 0; i < aLog.sql.size(); ++i)
+    {
+        if (aLog.sql[i] == aSql)
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+// Return the executions of a SQL text in the log
+std::vector<SQLite::WorkloadLog::Execution> getExecutions(const SQLite::WorkloadLog& aLog, const std::string& aSql)
+{
+    std::vector<SQLite::WorkloadLog::Execution> executions;
+    for (const SQLite::WorkloadLog::Execution& execution : aLog.executions)
+    {
+        if (static_cast<int>(execution.sql) == findSql(aLog, aSql))
+        {
+            executions.push_back(execution);
+        }
+    }
+    return executions;
+}
+
+} // namespace
+
+TEST(WorkloadRecorder, record)
+{
+    remove("workload.log");
+    SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+    db.exec("CREATE TABLE test (id INTEGER PRIMARY KEY, number INTEGER, real REAL, text TEXT, data BLOB)");
+    db.exec("CREATE TABLE audit (id INTEGER)");
+    db.exec("CREATE TRIGGER audited AFTER INSERT ON test BEGIN INSERT INTO audit VALUES (new.id); END");
+    {
+        SQLite::WorkloadRecorder recorder("workload.log");
+        recorder.attach(db);
+        EXPECT_THROW(recorder.attach(db), SQLite::Exception);
+
+        const char* const insertSql = "INSERT INTO test VALUES (?, ?, ?, ?, ?)";
+        SQLite::Statement insert(db, insertSql);
+        for (int i = 1; i <= 3; ++i)
+        {
+            insert.bind(1, i);
+            insert.bind(2, static_cast<int64_t>(-1234567890123) * i);
+            insert.bind(3, 0.5 * i);
+            insert.bind(4, "text " + std::to_string(i));
+            if (i < 3)
+            {
+                insert.bind(5, "\0\1\2", 3);
+            }
+            else
+            {
+                insert.bind(5);
+            }
+            EXPECT_EQ(1, insert.exec());
+            insert.reset();
+        }
+
+        // One row read, then all the rows
+        SQLite::Statement select(db, "SELECT id FROM test WHERE id >= :min");
+        select.bind(":min", 1);
+        EXPECT_TRUE(select.executeStep());
+        select.reset();
+        while (select.executeStep())
+        {
+        }
+        select.reset();
+
+        db.exec("-- Starting with a comment\nUPDATE test SET number = 0 WHERE id = 1");
+        recorder.detach(db);
+        db.exec("DELETE FROM test");
+        EXPECT_EQ(6, recorder.getExecutionCount());
+    }
+
+    const SQLite::WorkloadLog log = SQLite::WorkloadLog::read("workload.log");
+    ASSERT_EQ(1u, log.connections.size());
+    EXPECT_EQ(":memory:", log.connections[0]);
+    ASSERT_EQ(6u, log.executions.size());
+    EXPECT_EQ(-1, findSql(log, "DELETE FROM test"));
+    for (const SQLite::WorkloadLog::Execution& execution : log.executions)
+    {
+        EXPECT_EQ(0u, execution.connection);
+        EXPECT_EQ(0u, execution.thread);
+        EXPECT_GE(execution.duration, 0);
+    }
+
+    // The trigger is not an execution of its own
+    const auto inserts = getExecutions(log, "INSERT INTO test VALUES (?, ?, ?, ?, ?)");
+    ASSERT_EQ(3u, inserts.size());
+    EXPECT_TRUE(inserts[0].bDone);
+    EXPECT_EQ(0, inserts[0].rows);
+    ASSERT_EQ(5u, inserts[0].parameters.size());
+    EXPECT_EQ(1, inserts[0].parameters[0].index);
+    EXPECT_EQ(SQLite::INTEGER, inserts[0].parameters[0].type);
+    EXPECT_EQ(1, inserts[0].parameters[0].integer);
+    EXPECT_EQ(-1234567890123, inserts[0].parameters[1].integer);
+    EXPECT_EQ(SQLite::FLOAT, inserts[0].parameters[2].type);
+    EXPECT_DOUBLE_EQ(0.5, inserts[0].parameters[2].real);
+    EXPECT_EQ(SQLite::TEXT, inserts[0].parameters[3].type);
+    EXPECT_EQ("text 1", inserts[0].parameters[3].bytes);
+    EXPECT_EQ(SQLite::BLOB, inserts[0].parameters[4].type);
+    EXPECT_EQ(std::string("\0\1\2", 3), inserts[0].parameters[4].bytes);
+    EXPECT_EQ(-3703703670369, inserts[2].parameters[1].integer);
+    EXPECT_EQ(SQLite::Null, inserts[2].parameters[4].type);
+    EXPECT_LE(inserts[0].start, inserts[1].start);
+
+    const auto selects = getExecutions(log, "SELECT id FROM test WHERE id >= :min");
+    ASSERT_EQ(2u, selects.size());
+    EXPECT_EQ(1, selects[0].rows);
+    EXPECT_FALSE(selects[0].bDone);
+    EXPECT_EQ(3, selects[1].rows);
+    EXPECT_TRUE(selects[1].bDone);
+    ASSERT_EQ(1u, selects[1].parameters.size());
+    EXPECT_EQ(1, selects[1].parameters[0].integer);
+
+    EXPECT_EQ(1u, getExecutions(log, "-- Starting with a comment\nUPDATE test SET number = 0 WHERE id = 1").size());
+    remove("workload.log");
+}
+
+TEST(WorkloadRecorder, invalidLog)
+{
+    EXPECT_THROW(SQLite::WorkloadLog::read("missing.log"), SQLite::Exception);
+    {
+        std::ofstream file("workload.log", std::ios::binary);
+        file << "not a workload log";
+    }
+    EXPECT_THROW(SQLite::WorkloadLog::read("workload.log"), SQLite::Exception);
+    {
+        SQLite::Database db(":memory:", SQLite::OPEN_READWRITE);
+        SQLite::WorkloadRecorder recorder("workload.log");
+        recorder.attach(db);
+        db.exec("CREATE TABLE test (id INTEGER PRIMARY KEY)");
+    }
+    std::string content;
+    {
+        std::ifstream file("workload.log", std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    EXPECT_EQ(1u, SQLite::WorkloadLog::read("workload.log").executions.size());
+    {
+        std::ofstream file("workload.log", std::ios::binary | std::ios::trunc);
+        file.write(content.data(), static_cast<std::streamsize>(content.size() - 1));
+    }
+    EXPECT_THROW(SQLite::WorkloadLog::read("workload.log"), SQLite::Exception);
+    remove("workload.log");
+}
+
+TEST(WorkloadRecorder, replay)
+{
+    remove("workload.db3");
+    remove("workload.log");
+    {
+        SQLite::Database db("workload.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        db.exec("PRAGMA journal_mode = WAL");
+        db.exec("CREATE TABLE test (id INTEGER PRIMARY KEY, thread INTEGER, value TEXT)");
+        db.cloneTo("replay.db3");
+        db.cloneTo("replay_serial.db3");
+
+        // Two threads, with their own connection, inserting and reading rows
+        SQLite::WorkloadRecorder recorder("workload.log");
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < 2; ++thread)
+        {
+            threads.emplace_back([&recorder, thread]
+            {
+                SQLite::Database connection("workload.db3", SQLite::OPEN_READWRITE, 5000);
+                recorder.attach(connection);
+                SQLite::Statement insert(connection, "INSERT INTO test (thread, value) VALUES (?, ?)");
+                SQLite::Statement count(connection, "SELECT count(*) FROM test WHERE thread = ?");
+                for (int i = 0; i < 20; ++i)
+                {
+                    SQLite::Transaction transaction(connection);
+                    insert.bind(1, thread);
+                    insert.bind(2, "value " + std::to_string(i));
+                    insert.exec();
+                    insert.reset();
+                    transaction.commit();
+                    count.bind(1, thread);
+                    EXPECT_TRUE(count.executeStep());
+                    EXPECT_EQ(i + 1, count.getColumn(0).getInt());
+                    count.reset();
+                }
+                recorder.detach(connection);
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        EXPECT_EQ(2 * 20 * 4, recorder.getExecutionCount());
+    }
+
+    const SQLite::WorkloadLog log = SQLite::WorkloadLog::read("workload.log");
+    EXPECT_EQ(2u, log.connections.size());
+    EXPECT_EQ(160u, log.executions.size());
+    const SQLite::WorkloadReplayer replayer(log);
+
+    // One connection by recorded session
+    const SQLite::ReplayReport report = replayer.replay("replay.db3");
+    EXPECT_EQ(2u, report.connections);
+    EXPECT_EQ(160, report.executions);
+    EXPECT_EQ(0, report.errors) << (report.errorMessages.empty() ? "" : report.errorMessages.front());
+    EXPECT_EQ(log.sql.size(), report.queries.size());
+    int64_t executions = 0;
+    for (const SQLite::ReplayReport::Query& query : report.queries)
+    {
+        executions += query.executions;
+        EXPECT_GE(query.replayedNs, 0);
+    }
+    EXPECT_EQ(160, executions);
+
+    // All the sessions on one connection, at the original speed, with a setup pragma
+    SQLite::ReplayOptions options;
+    options.concurrency = 1;
+    options.speed = 1.0;
+    options.setup.push_back("PRAGMA cache_size = -4096");
+    const SQLite::ReplayReport serial = replayer.replay("replay_serial.db3", options);
+    EXPECT_EQ(1u, serial.connections);
+    EXPECT_EQ(160, serial.executions);
+    // The transactions of the two sessions do not interleave on the single connection
+    EXPECT_EQ(0, serial.errors) << (serial.errorMessages.empty() ? "" : serial.errorMessages.front());
+    const int64_t recordedNs = log.executions.back().start - log.executions.front().start;
+    EXPECT_GE(serial.durationNs, recordedNs);
+
+    for (const char* filename : {"workload.db3", "replay.db3", "replay_serial.db3"})
+    {
+        SQLite::Database db(filename, SQLite::OPEN_READONLY);
+        EXPECT_EQ(40, db.execAndGet("SELECT count(*) FROM test").getInt());
+        EXPECT_EQ(20, db.execAndGet("SELECT count(*) FROM test WHERE thread = 1").getInt());
+    }
+
+    // A setup failure is reported
+    options.setup.push_back("not sql");
+    EXPECT_THROW(replayer.replay("replay_serial.db3", options), SQLite::Exception);
+
+    for (const char* filename : {"workload.db3", "replay.db3", "replay_serial.db3"})
+    {
+        remove(filename);
+        remove((std::string(filename) + "-wal").c_str());
+        remove((std::string(filename) + "-shm").c_str());
+    }
+    remove("workload.log");
+}
+
+TEST(WorkloadRecorder, replayTransactions)
+{
+    remove("workload.db3");
+    remove("workload.log");
+    {
+        SQLite::Database db("workload.db3", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+        db.exec("CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT)");
+
+        // Two connections whose transactions overlap
+        SQLite::WorkloadRecorder recorder("workload.log");
+        SQLite::Database first("workload.db3", SQLite::OPEN_READWRITE);
+        SQLite::Database second("workload.db3", SQLite::OPEN_READWRITE);
+        recorder.attach(first);
+        recorder.attach(second);
+        first.exec("BEGIN");
+        EXPECT_EQ(0, first.execAndGet("SELECT count(*) FROM test").getInt());
+        second.exec("SAVEPOINT \"outer\"");
+        second.exec("SAVEPOINT inner");
+        EXPECT_EQ(0, second.execAndGet("SELECT count(*) FROM test").getInt());
+        second.exec("RELEASE inner");
+        first.exec("COMMIT");
+        second.exec("RELEASE SAVEPOINT \"outer\"");
+        second.exec("INSERT INTO test (value) VALUES ('second')");
+        recorder.detach(first);
+        recorder.detach(second);
+        EXPECT_EQ(9, recorder.getExecutionCount());
+    }
+
+    // Replayed on a single connection, a transaction of a session is never interleaved with the other session
+    SQLite::ReplayOptions options;
+    options.concurrency = 1;
+    const SQLite::ReplayReport report =
+        SQLite::WorkloadReplayer(SQLite::WorkloadLog::read("workload.log")).replay("workload.db3", options);
+    EXPECT_EQ(1u, report.connections);
+    EXPECT_EQ(9, report.executions);
+    EXPECT_EQ(0, report.errors) << (report.errorMessages.empty() ? "" : report.errorMessages.front());
+    {
+        SQLite::Database db("workload.db3", SQLite::OPEN_READONLY);
+        EXPECT_EQ(2, db.execAndGet("SELECT count(*) FROM test").getInt());
+    }
+    remove("workload.db3");
+    remove("workload.log");
+}
@@ -0,0 +1,197 @@
+/**
+ * @file    replay.cpp
+ * @ingroup tools
+ * @brief   sqlitecpp-replay: replay a workload log recorded by SQLite::WorkloadRecorder against a copy of a database.
+ *
+ *  Usage: sqlitecpp-replay LOG DATABASE [--copy FILE | --in-place] [--speed X] [--concurrency N]
+ *                          [--prepare SQL]... [--setup SQL]... [--top N]
+ *
+ * Copyright (c) 2012-2024 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Exception.h>
+#include <SQLiteCpp/WorkloadRecorder.h>
+#include <SQLiteCpp/WorkloadReplayer.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+// Print the usage of the tool
+void usage(const char* apProgram)
+{
+    std::cerr << "Usage: " << apProgram << " LOG DATABASE [options]\n"
+              << "Replay a workload log recorded by SQLite::WorkloadRecorder against a copy of DATABASE.\n"
+              << "  --copy FILE       copy of the database to replay against (default DATABASE.replay)\n"
+              << "  --in-place        replay against DATABASE itself, modifying it\n"
+              << "  --speed X         1 for the original timing, 2 twice as fast, 0 as fast as possible (default)\n"
+              << "  --concurrency N   number of connections, 0 for one by recorded session (default)\n"
+              << "  --prepare SQL     SQL executed once before the replay, like \"CREATE INDEX ...\" (repeatable)\n"
+              << "  --setup SQL       SQL executed on each connection, like \"PRAGMA ...\" (repeatable)\n"
+              << "  --top N           number of statements reported, by replayed time (default 20)\n";
+}
+
+// Return a SQL text on one line, truncated to aWidth characters
+std::string abbreviate(const std::string& aSql, const size_t aWidth)
+{
+    std::string line;
+    for (const char c : aSql)
+    {
+        const bool bSpace = (c == ' ' || c == '\n' || c == '\r' || c == '\t');
+        if (!bSpace || (!line.empty() && line.back() != ' '))
+        {
+            line += bSpace ? ' ' : c;
+        }
+    }
+    if (line.size() > aWidth)
+    {
+        line = line.substr(0, aWidth - 3) + "...";
+    }
+    return line;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> arguments;
+    std::string copy;
+    bool bInPlace = false;
+    size_t top = 20;
+    std::vector<std::string> prepare;
+    SQLite::ReplayOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--in-place")
+        {
+            bInPlace = true;
+        }
+        else if (arg.compare(0, 2, "--") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            const char* pValue = argv[++i];
+            if (arg == "--copy")
+            {
+                copy = pValue;
+            }
+            else if (arg == "--speed")
+            {
+                options.speed = std::max(std::atof(pValue), 0.0);
+            }
+            else if (arg == "--concurrency")
+            {
+                options.concurrency = static_cast<unsigned>(std::max(std::atoi(pValue), 0));
+            }
+            else if (arg == "--prepare")
+            {
+                prepare.push_back(pValue);
+            }
+            else if (arg == "--setup")
+            {
+                options.setup.push_back(pValue);
+            }
+            else if (arg == "--top")
+            {
+                top = static_cast<size_t>(std::max(std::atoi(pValue), 0));
+            }
+            else
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            arguments.push_back(arg);
+        }
+    }
+    if (arguments.size() != 2)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        const SQLite::WorkloadReplayer replayer(SQLite::WorkloadLog::read(arguments[0]));
+        std::string filename = arguments[1];
+        if (!bInPlace)
+        {
+            if (copy.empty())
+            {
+                copy = filename + ".replay";
+            }
+            SQLite::Database(filename, SQLite::OPEN_READWRITE).cloneTo(copy);
+            filename = copy;
+        }
+        if (!prepare.empty())
+        {
+            SQLite::Database db(filename, SQLite::OPEN_READWRITE);
+            for (const std::string& sql : prepare)
+            {
+                db.exec(sql);
+            }
+        }
+
+        const SQLite::WorkloadLog& log = replayer.getLog();
+        std::cout << "Replaying " << log.executions.size() << " executions of " << log.sql.size()
+                  << " statements against " << filename << "\n";
+        const SQLite::ReplayReport report = replayer.replay(filename, options);
+
+        int64_t recordedNs = 0;
+        int64_t replayedNs = 0;
+        for (const SQLite::ReplayReport::Query& query : report.queries)
+        {
+            recordedNs += query.recordedNs;
+            replayedNs += query.replayedNs;
+        }
+        std::printf("%lld executions on %u connections in %.3f s, %lld errors\n",
+                    static_cast<long long>(report.executions), report.connections, report.durationNs / 1e9,
+                    static_cast<long long>(report.errors));
+        std::printf("time in the statements: %.3f ms recorded, %.3f ms replayed\n\n",
+                    recordedNs / 1e6, replayedNs / 1e6);
+
+        std::vector<SQLite::ReplayReport::Query> queries = report.queries;
+        std::sort(queries.begin(), queries.end(),
+                  [](const SQLite::ReplayReport::Query& aLeft, const SQLite::ReplayReport::Query& aRight)
+                  {
+                      return aLeft.replayedNs > aRight.replayedNs;
+                  });
+        queries.resize(std::min(queries.size(), top));
+        std::printf("%12s %12s %7s %10s %7s  %s\n", "replayed ms", "recorded ms", "ratio", "executions", "errors",
+                    "statement");
+        for (const SQLite::ReplayReport::Query& query : queries)
+        {
+            const double ratio = (query.recordedNs > 0) ? static_cast<double>(query.replayedNs) / query.recordedNs
+                                                        : 0.0;
+            std::printf("%12.3f %12.3f %7.2f %10lld %7lld  %s\n", query.replayedNs / 1e6, query.recordedNs / 1e6,
+                        ratio, static_cast<long long>(query.executions), static_cast<long long>(query.errors),
+                        abbreviate(query.sql, 60).c_str());
+        }
+        for (const std::string& message : report.errorMessages)
+        {
+            std::cout << "error: " << message << "\n";
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "sqlitecpp-replay: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}